@@ -36,7 +36,11 @@
 #include <io.h>
 #endif
 
+#include <errno.h>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <thread>
 #include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/optional.hpp>
@@ -48,7 +52,9 @@
 #include "../../application/verbose.h"
 #include "../../base/exception.h"
 #include "../../csv/format.h"
+#include "../../csv/impl/mapped_file.h"
 #include "../../csv/options.h"
+#include "../../math/tdigest.h"
 #include "../../string/string.h"
 
 static void bash_completion( unsigned const ac, char const * const * av )
@@ -56,6 +62,8 @@ static void bash_completion( unsigned const ac, char const * const * av )
     static char const * const arguments =
         " min max mean mode percentile sum centre diameter radius var stddev size"
         " --append"
+        " --threads"
+        " --window --step"
         " --delimiter -d"
         " --fields -f"
         " --output-fields"
@@ -88,7 +96,9 @@ static void usage( bool verbose )
     std::cerr << "    mode: mode value" << std::endl;
     std::cerr << "    percentile=<n>[:<method>]: percentile value" << std::endl;
     std::cerr << "        <n> is the desired percentile (e.g. 0.9)" << std::endl;
-    std::cerr << "        <method> is one of 'nearest' or 'interpolate' (default: nearest)" << std::endl;
+    std::cerr << "        <method> is one of 'nearest', 'interpolate' or 'sketch' (default: nearest)" << std::endl;
+    std::cerr << "        sketch[:<compression>]: approximate percentile from t-digest of fixed size for each id and block" << std::endl;
+    std::cerr << "            instead of keeping all the values in memory; greater compression: more accurate (default: 100)" << std::endl;
     std::cerr << "        see --help --verbose for more details" << std::endl;
     std::cerr << "    radius: size / 2" << std::endl;
     std::cerr << "    size: number of values" << std::endl;
@@ -112,12 +122,28 @@ static void usage( bool verbose )
     std::cerr << "    --output-format: print output format for this operation and then exit (note: requires input-format)" << std::endl;
     std::cerr << "    --format: in ascii mode: format hint string containing the types of the csv data, default: double or time" << std::endl;
     std::cerr << "    --binary,-b: in binary mode: format string of the csv data types" << std::endl;
+    std::cerr << "    --mmap: in binary mode: if stdin is a regular file (e.g. csv-calc ... < file.bin), memory-map it instead of reading" << std::endl;
+    std::cerr << "    --threads=<n>: in binary mode without --append: calculate column by column in batches of records" << std::endl;
+    std::cerr << "                   with given number of threads, 0: use all cores; if not given, calculate record by record" << std::endl;
+    std::cerr << "                   columnar calculation is used only if all the operations are supported: any except mode" << std::endl;
+    std::cerr << "                   and percentile, and fields are not time or strings; work for different ids and fields" << std::endl;
+    std::cerr << "                   is distributed between threads; floating point results may differ in the last digits" << std::endl;
+    std::cerr << "                   from calculation record by record" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
+    std::cerr << "    --window=<size>: calculate on sliding or tumbling window of the last <size> records of each id" << std::endl;
+    std::cerr << "                     <size>: number of records, e.g. --window=1000, or seconds, e.g. --window=10s" << std::endl;
+    std::cerr << "                     if in seconds, windows end at multiples of --step, a window is [end-size,end)" << std::endl;
+    std::cerr << "                     and input is expected to have t field, sorted by time for each id" << std::endl;
+    std::cerr << "                     if in records, a window is output after each --step records, once it is full" << std::endl;
+    std::cerr << "                     output: results, then t (window end or t of the last record), id, block" << std::endl;
+    std::cerr << "                     supported operations: any except mode; percentile only as percentile=<n>:sketch" << std::endl;
+    std::cerr << "                     supported fields: numeric, except t; windows are reset on block change" << std::endl;
+    std::cerr << "    --step=<step>: output window every <step> records or seconds, same units as --window; default: window size (tumbling)" << std::endl;
     std::cerr << comma::csv::format::usage() << std::endl;
     if( verbose )
     {
         std::cerr << "percentile method:" << std::endl;
-        std::cerr << "    The percentile method is either 'nearest' or 'interpolate'." << std::endl;
+        std::cerr << "    The percentile method is either 'nearest', 'interpolate', or 'sketch'." << std::endl;
         std::cerr << "    For an overview of percentile calculation methods see" << std::endl;
         std::cerr << "    https://en.wikipedia.org/wiki/Percentile." << std::endl;
         std::cerr << std::endl;
@@ -135,11 +161,19 @@ static void usage( bool verbose )
         std::cerr << "    'nearest' corresponds to definition 1." << std::endl;
         std::cerr << "    'interpolate' corresponds to definition 6." << std::endl;
         std::cerr << std::endl;
+        std::cerr << "    'sketch' approximates the percentile with a merging t-digest" << std::endl;
+        std::cerr << "    (Dunning, T. and Ertl, O., \"Computing Extremely Accurate Quantiles Using t-Digests\", 2019)," << std::endl;
+        std::cerr << "    memory per id and block is bounded by compression; error is smallest near 0 and 1" << std::endl;
+        std::cerr << "    time values are supported as microseconds since epoch" << std::endl;
+        std::cerr << std::endl;
     }
     std::cerr << "examples" << std::endl;
     std::cerr << "    seq 1 1000 | " << comma::verbose.app_name() << " percentile=0.9" << std::endl;
     std::cerr << "    seq 1 1000 | " << comma::verbose.app_name() << " percentile=0.1,percentile=0.9" << std::endl;
     std::cerr << "    seq 1 1000 | " << comma::verbose.app_name() << " percentile=0.9:interpolate --verbose" << std::endl;
+    std::cerr << "    seq 1 1000000 | " << comma::verbose.app_name() << " percentile=0.5:sketch,percentile=0.99:sketch:200" << std::endl;
+    std::cerr << "    seq 1 1000 | " << comma::verbose.app_name() << " mean,max --window=100 --step=10" << std::endl;
+    std::cerr << "    cat timestamped.csv | " << comma::verbose.app_name() << " mean,percentile=0.99:sketch --fields=t,a,id --window=10s --step=1s" << std::endl;
     std::cerr << std::endl;
     std::cerr << "    {(seq 1 500 | csv-paste \"-\" \"value=0\") ; (seq 1 100 | csv-paste \"-\" \"value=1\") ; (seq 501 1000 | csv-paste \"-\" \"value=0\")} | " << comma::verbose.app_name() << " --fields=a,block percentile=0.9" << std::endl;
     std::cerr << std::endl;
@@ -202,6 +236,9 @@ class Values
         }
 
         const comma::csv::format& format() const { return format_; }
+        const std::vector< comma::csv::format::element >& input_elements() const { return input_elements_; }
+        unsigned int block( const char* buf ) const { return block_index_ ? block_from_bin_( buf + block_element_.offset ) : 0; }
+        unsigned int id( const char* buf ) const { return id_index_ ? id_from_bin_( buf + id_element_.offset ) : 0; }
         unsigned int block() const { return block_; }
         unsigned int id() const { return id_; }
         const char* buffer() const { return &buffer_[0]; }
@@ -328,28 +365,49 @@ class binary_input
             , cur_( &buffer_[0] )
             , end_( &buffer_[0] + buffer_.size() )
             , offset_( 0 )
+            , mapped_( csv.mmap ? comma::csv::impl::mapped_file::open( 0 ) : NULL )
+            , position_( 0 )
+            , last_( NULL )
         {
         }
 
         const Values* read()
         {
+            std::size_t size = csv_.format().size();
+            if( mapped_ )
+            {
+                std::size_t remaining = mapped_->size() - position_;
+                if( remaining == 0 ) { return NULL; }
+                if( remaining < size ) { COMMA_THROW( comma::exception, "expected " << size << " bytes; got " << remaining << " bytes in the last record" ); }
+                last_ = mapped_->data() + position_;
+                values_.set( last_ );
+                position_ += size;
+                return &values_;
+            }
             while( true )
             {
-                if( offset_ >= csv_.format().size() )
+                if( offset_ >= size )
                 {
+                    last_ = cur_;
                     values_.set( cur_ );
-                    line_ = std::string(cur_, csv_.format().size());
-                    cur_ += csv_.format().size();
-                    offset_ -= csv_.format().size();
+                    cur_ += size;
+                    offset_ -= size;
                     if( cur_ == end_ ) { cur_ = &buffer_[0]; offset_ = 0; }
                     return &values_;
                 }
                 int count = ::read( 0, cur_ + offset_, end_ - cur_ - offset_ );
-                if( count <= 0 ) { return NULL; }
+                if( count < 0 && errno == EINTR ) { continue; }
+                if( count < 0 ) { COMMA_THROW( comma::exception, "failed to read stdin: " << std::strerror( errno ) ); }
+                if( count == 0 )
+                {
+                    if( offset_ > 0 ) { COMMA_THROW( comma::exception, "expected " << size << " bytes; got " << offset_ << " bytes in the last record" ); }
+                    return NULL;
+                }
                 offset_ += count;
             }
         }
-        const std::string line() { return line_; }
+
+        const std::string line() { return std::string( last_, csv_.format().size() ); } // copy only if needed, e.g. for --append
 
     private:
         comma::csv::options csv_;
@@ -358,7 +416,9 @@ class binary_input
         char* cur_;
         const char* end_;
         unsigned int offset_;
-        std::string line_;
+        boost::scoped_ptr< comma::csv::impl::mapped_file > mapped_;
+        std::size_t position_;
+        const char* last_;
 };
 
 namespace impl {
@@ -545,17 +605,34 @@ namespace Operations
             std::size_t count_;
     };
 
+    template < typename T > struct percentile_traits
+    {
+        static bool valid( T ) { return true; }
+        static double to_double( T t ) { return t; }
+        static T from_double( double d ) { return static_cast< T >( d ); }
+    };
+
+    template <> struct percentile_traits< boost::posix_time::ptime > // percentiles of time as microseconds since epoch
+    {
+        static bool valid( const boost::posix_time::ptime& t ) { return !t.is_special(); }
+        static double to_double( const boost::posix_time::ptime& t ) { return ( t - epoch() ).total_microseconds(); }
+        static boost::posix_time::ptime from_double( double d ) { return epoch() + boost::posix_time::microseconds( static_cast< comma::int64 >( std::floor( d + 0.5 ) ) ); }
+        static const boost::posix_time::ptime& epoch() { static const boost::posix_time::ptime e( boost::gregorian::date( 1970, 1, 1 ) ); return e; }
+    };
+
     template < typename T, comma::csv::format::types_enum F = comma::csv::format::type_to_enum< T >::value >
     class Percentile : public base
     {
         public:
-            enum Method { nearest, interpolate };
+            enum Method { nearest, interpolate, sketch };
 
             Percentile() : percentile_( 0.0 ), method_( nearest ) {}
 
             void push( const char* buf )
             {
-                values_.insert( comma::csv::format::traits< T, F >::from_bin( buf ));
+                const T& t = comma::csv::format::traits< T, F >::from_bin( buf );
+                if( !percentile_traits< T >::valid( t ) ) { return; }
+                if( method_ == sketch ) { digest_.push( percentile_traits< T >::to_double( t ) ); } else { values_.push_back( t ); }
             }
 
             void set_options( const std::vector< std::string >& options )
@@ -571,37 +648,51 @@ namespace Operations
                     exit( 1 );
                 }
 
-                if( options.size() == 2 ) {
+                if( options.size() >= 2 ) {
                     if( options[1] == "nearest" ) method_ = nearest;
                     else if( options[1] == "interpolate" ) method_ = interpolate;
+                    else if( options[1] == "sketch" ) method_ = sketch;
                     else {
                         std::cerr << comma::verbose.app_name() << ": expected percentile method, got " << options[1] << std::endl;
                         exit( 1 );
                     }
                 }
+                if( options.size() == 3 && method_ == sketch ) { digest_ = comma::math::tdigest( boost::lexical_cast< double >( options[2] ) ); }
+                else if( options.size() > 2 ) {
+                    std::cerr << comma::verbose.app_name() << ": percentile: expected <n>[:<method>] or <n>:sketch[:<compression>], got " << comma::join( options, ':' ) << std::endl;
+                    exit( 1 );
+                }
             }
 
             void calculate( char* buf )
             {
+                if( method_ == sketch )
+                {
+                    if( digest_.count() == 0 ) { return; }
+                    comma::verbose << "calculating " << percentile_*100 << "th percentile using t-digest of " << digest_.count() << " values with compression " << digest_.compression() << std::endl;
+                    comma::csv::format::traits< T, F >::to_bin( percentile_traits< T >::from_double( digest_.quantile( percentile_ ) ), buf );
+                    return;
+                }
                 std::size_t count = values_.size();
 
                 if( count > 0 )
                 {
                     comma::verbose << "calculating " << percentile_*100 << "th percentile using ";
-                    T value;
-                    typename std::multiset< T >::iterator it = values_.begin();
+                    T value = T();
                     switch( method_ )
                     {
                         std::size_t rank;
-                        
+
+                        case sketch: // calculated above
+                            break;
+
                         case nearest:
                             // https://en.wikipedia.org/wiki/Percentile#The_Nearest_Rank_method
                             comma::verbose << "nearest rank method" << std::endl;
                             comma::verbose << "see https://en.wikipedia.org/wiki/Percentile#The_Nearest_Rank_method" << std::endl;
                             rank = ( percentile_ == 0.0 ? 1 : std::ceil( count * percentile_ ));
                             comma::verbose << "n = " << rank << std::endl;
-                            std::advance( it, rank - 1 );
-                            value = *it;
+                            value = nth_( rank - 1 );
                             break;
 
                         case interpolate:
@@ -614,41 +705,39 @@ namespace Operations
                                            << "; p(N + 1) = " << x;
                             if( x <= 1.0 ) {
                                 comma::verbose << "; below 1 - choosing smallest value" << std::endl;
-                                value = *it;
+                                value = *std::min_element( values_.begin(), values_.end() );
                             } else if( x >= count ) {
                                 comma::verbose << "; above N - choosing largest value" << std::endl;
-                                value = *( values_.rbegin() );
+                                value = *std::max_element( values_.begin(), values_.end() );
                             } else {
                                 rank = x;
                                 double remainder = x - rank;
                                 comma::verbose << "; k = " << rank << "; d = " << remainder << std::endl;
-                                std::advance( it, rank - 1 );
-                                double v1 = *it;
-                                double v2 = *++it;
-                                value = v1 + ( v2 - v1 ) * remainder;
+                                double v1 = percentile_traits< T >::to_double( nth_( rank - 1 ) );
+                                double v2 = percentile_traits< T >::to_double( *std::min_element( values_.begin() + rank, values_.end() ) ); // after nth_element, the next value is the least of the rest
+                                value = percentile_traits< T >::from_double( v1 + ( v2 - v1 ) * remainder );
                                 comma::verbose << "v1 = " << v1 << "; v2 = " << v2
                                                << "; result = " << value << std::endl;
                             }
                             break;
                     }
-                    comma::csv::format::traits< T, F >::to_bin( static_cast< T >( value ), buf );
+                    comma::csv::format::traits< T, F >::to_bin( value, buf );
                 }
             }
 
             base* clone() const { return new Percentile< T, F >( *this ); }
 
         private:
-            std::multiset< T > values_;
+            std::vector< T > values_;
+            comma::math::tdigest digest_;
             double percentile_;
             Method method_;
-    };
 
-    template < comma::csv::format::types_enum F >
-    class Percentile< boost::posix_time::ptime, F > : public base
-    {
-        void push( const char* ) { COMMA_THROW( comma::exception, "percentile not implemented for time, todo" ); }
-        void calculate( char* ) { COMMA_THROW( comma::exception, "percentile not implemented for time, todo" ); }
-        base* clone() const { COMMA_THROW( comma::exception, "percentile not implemented for time, todo" ); }
+            const T& nth_( std::size_t n ) // selection instead of sorting all values
+            {
+                std::nth_element( values_.begin(), values_.begin() + n, values_.end() );
+                return values_[n];
+            }
     };
 
     template < typename T, comma::csv::format::types_enum F > class Stddev;
@@ -1224,13 +1313,791 @@ static void calculate( const comma::csv::options& csv, OperationsMap& operations
     operations.clear();
 }
 
+/// columnar execution for binary input: records are read in batches, fields of records with the same id
+/// are gathered into contiguous arrays and reduced with no virtual calls per record; (id, field) pairs
+/// are distributed between threads
+namespace columnar {
+
+/// mergeable count, mean and central moments of order 2 to 4 (Pebay, "Formulas for robust, one-pass
+/// parallel computation of covariances and arbitrary-order statistical moments", 2008)
+struct moments
+{
+    double count;
+    double mean;
+    double m2;
+    double m3;
+    double m4;
+
+    moments() : count( 0 ), mean( 0 ), m2( 0 ), m3( 0 ), m4( 0 ) {}
+
+    template < typename T > void update( const T* values, std::size_t size ) // two passes over values in cache
+    {
+        if( size == 0 ) { return; }
+        double s[4] = { 0, 0, 0, 0 };
+        std::size_t i = 0;
+        for( ; i + 4 <= size; i += 4 ) { for( unsigned int k = 0; k < 4; ++k ) { s[k] += values[ i + k ]; } }
+        for( ; i < size; ++i ) { s[0] += values[i]; }
+        moments b;
+        b.count = size;
+        b.mean = ( s[0] + s[1] + s[2] + s[3] ) / size;
+        double s2[4] = { 0, 0, 0, 0 };
+        double s3[4] = { 0, 0, 0, 0 };
+        double s4[4] = { 0, 0, 0, 0 };
+        for( i = 0; i + 4 <= size; i += 4 )
+        {
+            for( unsigned int k = 0; k < 4; ++k )
+            {
+                double d = values[ i + k ] - b.mean;
+                double d2 = d * d;
+                s2[k] += d2;
+                s3[k] += d2 * d;
+                s4[k] += d2 * d2;
+            }
+        }
+        for( ; i < size; ++i ) { double d = values[i] - b.mean; double d2 = d * d; s2[0] += d2; s3[0] += d2 * d; s4[0] += d2 * d2; }
+        b.m2 = s2[0] + s2[1] + s2[2] + s2[3];
+        b.m3 = s3[0] + s3[1] + s3[2] + s3[3];
+        b.m4 = s4[0] + s4[1] + s4[2] + s4[3];
+        merge( b );
+    }
+
+    void merge( const moments& b )
+    {
+        if( b.count == 0 ) { return; }
+        if( count == 0 ) { *this = b; return; }
+        double n = count + b.count;
+        double delta = b.mean - mean;
+        double delta_n = delta / n;
+        double delta_n2 = delta_n * delta_n;
+        double term = delta * delta_n * count * b.count;
+        m4 += b.m4 + term * delta_n2 * ( count * count - count * b.count + b.count * b.count ) + 6 * delta_n2 * ( count * count * b.m2 + b.count * b.count * m2 ) + 4 * delta_n * ( count * b.m3 - b.count * m3 );
+        m3 += b.m3 + term * delta_n * ( count - b.count ) + 3 * delta_n * ( count * b.m2 - b.count * m2 );
+        m2 += b.m2 + term;
+        mean += delta_n * b.count;
+        count = n;
+    }
+};
+
+static bool supported( Operations::Enum::Values e )
+{
+    switch( e )
+    {
+        case Operations::Enum::mode:
+        case Operations::Enum::percentile:
+            return false;
+        default:
+            return true;
+    }
+}
+
+static bool supported( comma::csv::format::types_enum t ) { return t != comma::csv::format::time && t != comma::csv::format::long_time && t != comma::csv::format::fixed_string; }
+
+struct column_base
+{
+    virtual ~column_base() {}
+    virtual void update( const char* data, std::size_t record_size, const std::vector< std::size_t >& rows ) = 0;
+    virtual void calculate( const Operations::operation_parameters& operation, char* buf ) const = 0;
+};
+
+template < typename T, comma::csv::format::types_enum F >
+class column : public column_base
+{
+    public:
+        column( std::size_t offset, bool with_moments ) : offset_( offset ), with_moments_( with_moments ), count_( 0 ), min_( 0 ), max_( 0 ), sum_( 0 ) {}
+
+        void update( const char* data, std::size_t record_size, const std::vector< std::size_t >& rows )
+        {
+            static thread_local std::vector< T > values;
+            values.resize( rows.size() );
+            for( std::size_t i = 0; i < rows.size(); ++i ) { values[i] = comma::csv::format::traits< T, F >::from_bin( data + rows[i] * record_size + offset_ ); }
+            const std::size_t step = 4096; // to keep the values in cache for the second pass in moments
+            for( std::size_t i = 0; i < values.size(); i += step ) { update_( &values[i], std::min( step, values.size() - i ) ); }
+        }
+
+        void calculate( const Operations::operation_parameters& operation, char* buf ) const
+        {
+            if( count_ == 0 ) { return; }
+            bool sample = !operation.options.empty() && operation.options[0] == "sample";
+            double n = count_;
+            switch( operation.type )
+            {
+                case Operations::Enum::min: to_bin_( min_, buf ); break;
+                case Operations::Enum::max: to_bin_( max_, buf ); break;
+                case Operations::Enum::sum: to_bin_( sum_, buf ); break;
+                case Operations::Enum::centre: to_bin_( min_ + ( max_ - min_ ) / 2, buf ); break;
+                case Operations::Enum::mean: to_bin_( static_cast< T >( moments_.mean ), buf ); break;
+                case Operations::Enum::size: comma::csv::format::traits< comma::uint32 >::to_bin( count_, buf ); break;
+                case Operations::Enum::diameter: comma::csv::format::traits< typename Operations::Diff< T >::Type >::to_bin( Operations::Diff< T >::subtract( max_, min_ ), buf ); break;
+                case Operations::Enum::radius: comma::csv::format::traits< typename Operations::Diff< T >::Type >::to_bin( Operations::Diff< T >::subtract( max_, min_ ) / 2, buf ); break;
+                case Operations::Enum::variance: to_bin_( static_cast< T >( moments_.m2 / ( sample ? n - 1 : n ) ), buf ); break;
+                case Operations::Enum::stddev: to_bin_( static_cast< T >( std::sqrt( static_cast< long double >( moments_.m2 / ( sample ? n - 1 : n ) ) ) ), buf ); break;
+                case Operations::Enum::skew:
+                {
+                    double correction = sample ? std::sqrt( n * ( n - 1 ) ) / ( n - 2 ) : 1; // corrected sample skew requires at least 3 samples
+                    to_bin_( static_cast< T >( correction * std::sqrt( n / ( moments_.m2 * moments_.m2 * moments_.m2 ) ) * moments_.m3 ), buf );
+                    break;
+                }
+                case Operations::Enum::kurtosis:
+                {
+                    bool excess = false;
+                    sample = false;
+                    for( std::size_t i = 0; i < operation.options.size(); ++i )
+                    {
+                        if( operation.options[i] == "sample" ) { sample = true; }
+                        else if( operation.options[i] == "excess" ) { excess = true; }
+                    }
+                    double result = n * moments_.m4 / ( moments_.m2 * moments_.m2 );
+                    if( sample ) { result = n > 3 ? ( n - 1 ) / ( n - 2 ) / ( n - 3 ) * ( ( n + 1 ) * result - 3 * ( n - 1 ) ) + 3 : nan( "" ); } // corrected sample kurtosis requires at least 4 samples
+                    if( excess ) { result = result - 3; }
+                    to_bin_( static_cast< T >( result ), buf );
+                    break;
+                }
+                default: COMMA_THROW( comma::exception, "operation not supported in columnar mode; never here" );
+            }
+        }
+
+    private:
+        std::size_t offset_;
+        bool with_moments_;
+        std::size_t count_;
+        T min_;
+        T max_;
+        T sum_;
+        moments moments_;
+
+        static void to_bin_( T t, char* buf ) { comma::csv::format::traits< T, F >::to_bin( t, buf ); }
+
+        void update_( const T* values, std::size_t size )
+        {
+            T min[4];
+            T max[4];
+            T sum[4] = { 0, 0, 0, 0 };
+            for( unsigned int k = 0; k < 4; ++k ) { min[k] = max[k] = values[0]; }
+            std::size_t i = 0;
+            for( ; i + 4 <= size; i += 4 )
+            {
+                for( unsigned int k = 0; k < 4; ++k )
+                {
+                    const T& t = values[ i + k ];
+                    min[k] = t < min[k] ? t : min[k];
+                    max[k] = max[k] < t ? t : max[k];
+                    sum[k] += t;
+                }
+            }
+            for( ; i < size; ++i ) { min[0] = std::min( min[0], values[i] ); max[0] = std::max( max[0], values[i] ); sum[0] += values[i]; }
+            for( unsigned int k = 1; k < 4; ++k ) { min[0] = std::min( min[0], min[k] ); max[0] = std::max( max[0], max[k] ); sum[0] += sum[k]; }
+            if( count_ == 0 ) { min_ = min[0]; max_ = max[0]; } else { min_ = std::min( min_, min[0] ); max_ = std::max( max_, max[0] ); }
+            sum_ += sum[0];
+            count_ += size;
+            if( with_moments_ ) { moments_.update( values, size ); }
+        }
+};
+
+static column_base* make_column( const comma::csv::format::element& e, bool with_moments )
+{
+    switch( e.type )
+    {
+        case comma::csv::format::char_t: return new column< char, comma::csv::format::char_t >( e.offset, with_moments );
+        case comma::csv::format::int8: return new column< char, comma::csv::format::int8 >( e.offset, with_moments );
+        case comma::csv::format::uint8: return new column< unsigned char, comma::csv::format::uint8 >( e.offset, with_moments );
+        case comma::csv::format::int16: return new column< comma::int16, comma::csv::format::int16 >( e.offset, with_moments );
+        case comma::csv::format::uint16: return new column< comma::uint16, comma::csv::format::uint16 >( e.offset, with_moments );
+        case comma::csv::format::int32: return new column< comma::int32, comma::csv::format::int32 >( e.offset, with_moments );
+        case comma::csv::format::uint32: return new column< comma::uint32, comma::csv::format::uint32 >( e.offset, with_moments );
+        case comma::csv::format::int64: return new column< comma::int64, comma::csv::format::int64 >( e.offset, with_moments );
+        case comma::csv::format::uint64: return new column< comma::uint64, comma::csv::format::uint64 >( e.offset, with_moments );
+        case comma::csv::format::float_t: return new column< float, comma::csv::format::float_t >( e.offset, with_moments );
+        case comma::csv::format::double_t: return new column< double, comma::csv::format::double_t >( e.offset, with_moments );
+        default: COMMA_THROW( comma::exception, "columnar: unsupported type; never here" );
+    }
+}
+
+/// statistics of all fields for one id
+struct columns
+{
+    boost::ptr_vector< column_base > fields;
+    std::vector< std::size_t > rows;
+};
+
+class engine
+{
+    public:
+        engine( const comma::csv::options& csv, const std::vector< Operations::operation_parameters >& operations_parameters, unsigned int threads )
+            : csv_( csv )
+            , values_( csv, csv.format() )
+            , operations_parameters_( operations_parameters )
+            , threads_( threads )
+            , with_moments_( false )
+            , has_block_( csv.has_field( "block" ) )
+            , has_id_( csv.has_field( "id" ) )
+            , last_( NULL )
+            , last_id_( 0 )
+        {
+            init_operations( sample_, operations_parameters_, values_.format() );
+            for( std::size_t i = 0; i < operations_parameters_.size(); ++i )
+            {
+                switch( operations_parameters_[i].type )
+                {
+                    case Operations::Enum::mean: case Operations::Enum::variance: case Operations::Enum::stddev: case Operations::Enum::skew: case Operations::Enum::kurtosis: with_moments_ = true; break;
+                    default: break;
+                }
+            }
+        }
+
+        /// return true, if operations and field types are supported
+        static bool supported( const comma::csv::options& csv, const std::vector< Operations::operation_parameters >& operations_parameters )
+        {
+            for( std::size_t i = 0; i < operations_parameters.size(); ++i ) { if( !columnar::supported( operations_parameters[i].type ) ) { return false; } }
+            Values values( csv, csv.format() );
+            const std::vector< comma::csv::format::element >& elements = values.input_elements();
+            for( std::size_t i = 0; i < elements.size(); ++i ) { if( !columnar::supported( elements[i].type ) ) { return false; } }
+            return true;
+        }
+
+        void run()
+        {
+            std::size_t record_size = csv_.format().size();
+            boost::scoped_ptr< comma::csv::impl::mapped_file > mapped( csv_.mmap ? comma::csv::impl::mapped_file::open( 0 ) : NULL );
+            std::size_t batch = std::max< std::size_t >( 1, std::min< std::size_t >( 65536, ( 1 << 24 ) / record_size ) ); // same batches for pipes and files for the same rounding
+            std::vector< char > buffer( mapped ? 0 : batch * record_size );
+            std::size_t position = 0; // in mapped file
+            boost::optional< comma::uint32 > block = boost::make_optional( false, comma::uint32( 0 ) ); // quiet gcc maybe-uninitialized
+            while( true )
+            {
+                const char* data;
+                std::size_t records;
+                if( mapped )
+                {
+                    std::size_t remaining = mapped->size() - position;
+                    if( remaining > 0 && remaining < record_size ) { COMMA_THROW( comma::exception, "expected " << record_size << " bytes; got " << remaining << " bytes in the last record" ); }
+                    records = std::min( remaining / record_size, batch );
+                    data = mapped->data() + position;
+                    position += records * record_size;
+                }
+                else
+                {
+                    std::size_t size = 0;
+                    while( size < buffer.size() )
+                    {
+                        int count = ::read( 0, &buffer[0] + size, buffer.size() - size );
+                        if( count < 0 && errno == EINTR ) { continue; }
+                        if( count < 0 ) { COMMA_THROW( comma::exception, "failed to read stdin: " << std::strerror( errno ) ); }
+                        if( count == 0 ) { break; }
+                        size += count;
+                    }
+                    if( size % record_size != 0 ) { COMMA_THROW( comma::exception, "expected " << record_size << " bytes; got " << ( size % record_size ) << " bytes in the last record" ); }
+                    records = size / record_size;
+                    data = &buffer[0];
+                }
+                if( records == 0 ) { break; }
+                std::size_t begin = 0;
+                for( std::size_t r = 0; r < records; ++r )
+                {
+                    const char* p = data + r * record_size;
+                    if( has_block_ )
+                    {
+                        comma::uint32 b = values_.block( p );
+                        if( block && *block != b ) { update_( data, begin, r ); output_( *block ); begin = r; }
+                        block = b;
+                    }
+                    comma::uint32 id = values_.id( p );
+                    if( id != last_id_ || !last_ ) { last_ = &columns_( id ); last_id_ = id; }
+                    last_->rows.push_back( r );
+                }
+                update_( data, begin, records );
+            }
+            output_( block ? *block : 0 );
+        }
+
+    private:
+        typedef boost::unordered_map< comma::uint32, columns* > map_t; // same iteration order as OperationsMap, as long as cleared the same way
+        comma::csv::options csv_;
+        Values values_;
+        std::vector< Operations::operation_parameters > operations_parameters_;
+        boost::ptr_vector< Operationbase > sample_;
+        unsigned int threads_;
+        bool with_moments_;
+        bool has_block_;
+        bool has_id_;
+        map_t map_;
+        ResultsMap results_; // kept between blocks to output ids in the same order as without columnar calculation
+        boost::ptr_vector< columns > columns_list_;
+        columns* last_;
+        comma::uint32 last_id_;
+
+        columns& columns_( comma::uint32 id )
+        {
+            map_t::iterator it = map_.find( id );
+            if( it != map_.end() ) { return *it->second; }
+            columns_list_.push_back( new columns );
+            columns& c = columns_list_.back();
+            const std::vector< comma::csv::format::element >& elements = values_.input_elements();
+            for( std::size_t i = 0; i < elements.size(); ++i ) { c.fields.push_back( make_column( elements[i], with_moments_ ) ); }
+            map_[id] = &c;
+            return c;
+        }
+
+        void update_( const char* data, std::size_t begin, std::size_t end )
+        {
+            if( begin == end ) { return; }
+            std::vector< std::pair< columns*, std::size_t > > items;
+            for( std::size_t i = 0; i < columns_list_.size(); ++i )
+            {
+                if( columns_list_[i].rows.empty() ) { continue; }
+                for( std::size_t j = 0; j < columns_list_[i].fields.size(); ++j ) { items.push_back( std::make_pair( &columns_list_[i], j ) ); }
+            }
+            std::size_t record_size = csv_.format().size();
+            auto work = [&]( std::size_t first, std::size_t step ) { for( std::size_t k = first; k < items.size(); k += step ) { items[k].first->fields[ items[k].second ].update( data, record_size, items[k].first->rows ); } };
+            std::size_t threads = std::min< std::size_t >( threads_, items.size() );
+            if( threads < 2 ) { work( 0, 1 ); }
+            else
+            {
+                std::vector< std::thread > workers;
+                for( std::size_t t = 0; t < threads; ++t ) { workers.push_back( std::thread( work, t, threads ) ); }
+                for( std::size_t t = 0; t < workers.size(); ++t ) { workers[t].join(); }
+            }
+            for( std::size_t i = 0; i < columns_list_.size(); ++i ) { columns_list_[i].rows.clear(); }
+        }
+
+        void output_( comma::uint32 block )
+        {
+            for( map_t::const_iterator it = map_.begin(); it != map_.end(); ++it )
+            {
+                std::string r;
+                for( std::size_t i = 0; i < sample_.size(); ++i )
+                {
+                    std::string buf( sample_[i].output_format().size(), 0 );
+                    for( std::size_t j = 0; j < it->second->fields.size(); ++j ) { it->second->fields[j].calculate( operations_parameters_[i], &buf[0] + sample_[i].output_format().offset( j ).offset ); }
+                    r += buf;
+                }
+                results_[ it->first ] = r;
+            }
+            output( csv_, results_, boost::optional< comma::uint32 >( block ), has_block_, has_id_ );
+            map_.clear();
+            columns_list_.clear();
+            last_ = NULL;
+        }
+};
+
+} // namespace columnar {
+
+/// windowed calculation: operations on the last --window records or seconds of each id, output every --step;
+/// each record is added to and evicted from the window once: running power sums, monotonic deques for min and max,
+/// t-digests for each step merged for percentiles
+namespace windowed {
+
+struct config
+{
+    bool by_time;
+    comma::int64 size; // number of records or microseconds
+    comma::int64 step;
+    boost::optional< std::size_t > t_index; // index of t among values
+    bool has_block;
+    bool has_id;
+    comma::csv::options csv;
+    std::vector< Operations::operation_parameters > operations;
+    std::vector< double > compressions; // of percentile operations, in order
+    boost::ptr_vector< Operationbase > sample; // for output formats
+    std::vector< comma::csv::format::element > elements; // of values in input buffer, except t
+    comma::csv::format t_format;
+};
+
+static comma::int64 parse_( const std::string& s, bool& by_time )
+{
+    by_time = !s.empty() && s[ s.size() - 1 ] == 's';
+    if( !by_time ) { return boost::lexical_cast< comma::int64 >( s ); }
+    return static_cast< comma::int64 >( boost::lexical_cast< double >( s.substr( 0, s.size() - 1 ) ) * 1000000 + 0.5 );
+}
+
+/// return index of t among value fields, if any
+static boost::optional< std::size_t > t_index( const comma::csv::options& csv )
+{
+    std::vector< std::string > v = comma::split( csv.fields, ',' );
+    std::size_t k = 0;
+    for( std::size_t i = 0; i < v.size(); ++i )
+    {
+        if( v[i] == "t" ) { return k; }
+        if( !v[i].empty() && v[i] != "block" && v[i] != "id" ) { ++k; }
+    }
+    return boost::none;
+}
+
+/// return format of values except t
+static comma::csv::format values_format( const comma::csv::format& format, const boost::optional< std::size_t >& t_index )
+{
+    comma::csv::format f;
+    for( std::size_t i = 0; i < format.count(); ++i )
+    {
+        if( t_index && *t_index == i ) { continue; }
+        comma::csv::format::element e = format.offset( i );
+        f += comma::csv::format::to_format( e.type, e.size );
+    }
+    return f;
+}
+
+static void to_bin_( comma::csv::format::types_enum type, double d, char* buf )
+{
+    switch( type )
+    {
+        case comma::csv::format::char_t: comma::csv::format::traits< char, comma::csv::format::char_t >::to_bin( static_cast< char >( d ), buf ); break;
+        case comma::csv::format::int8: comma::csv::format::traits< char, comma::csv::format::int8 >::to_bin( static_cast< char >( d ), buf ); break;
+        case comma::csv::format::uint8: comma::csv::format::traits< unsigned char >::to_bin( static_cast< unsigned char >( d ), buf ); break;
+        case comma::csv::format::int16: comma::csv::format::traits< comma::int16 >::to_bin( static_cast< comma::int16 >( d ), buf ); break;
+        case comma::csv::format::uint16: comma::csv::format::traits< comma::uint16 >::to_bin( static_cast< comma::uint16 >( d ), buf ); break;
+        case comma::csv::format::int32: comma::csv::format::traits< comma::int32 >::to_bin( static_cast< comma::int32 >( d ), buf ); break;
+        case comma::csv::format::uint32: comma::csv::format::traits< comma::uint32 >::to_bin( static_cast< comma::uint32 >( d ), buf ); break;
+        case comma::csv::format::int64: comma::csv::format::traits< comma::int64 >::to_bin( static_cast< comma::int64 >( d ), buf ); break;
+        case comma::csv::format::uint64: comma::csv::format::traits< comma::uint64 >::to_bin( static_cast< comma::uint64 >( d ), buf ); break;
+        case comma::csv::format::float_t: comma::csv::format::traits< float >::to_bin( static_cast< float >( d ), buf ); break;
+        case comma::csv::format::double_t: comma::csv::format::traits< double >::to_bin( d, buf ); break;
+        default: COMMA_THROW( comma::exception, "windowed: unsupported type; never here" );
+    }
+}
+
+static double from_bin_( const comma::csv::format::element& e, const char* buf )
+{
+    switch( e.type )
+    {
+        case comma::csv::format::char_t: case comma::csv::format::int8: return comma::csv::format::traits< char >::from_bin( buf );
+        case comma::csv::format::uint8: return comma::csv::format::traits< unsigned char >::from_bin( buf );
+        case comma::csv::format::int16: return comma::csv::format::traits< comma::int16 >::from_bin( buf );
+        case comma::csv::format::uint16: return comma::csv::format::traits< comma::uint16 >::from_bin( buf );
+        case comma::csv::format::int32: return comma::csv::format::traits< comma::int32 >::from_bin( buf );
+        case comma::csv::format::uint32: return comma::csv::format::traits< comma::uint32 >::from_bin( buf );
+        case comma::csv::format::int64: return comma::csv::format::traits< comma::int64 >::from_bin( buf );
+        case comma::csv::format::uint64: return comma::csv::format::traits< comma::uint64 >::from_bin( buf );
+        case comma::csv::format::float_t: return comma::csv::format::traits< float >::from_bin( buf );
+        case comma::csv::format::double_t: return comma::csv::format::traits< double >::from_bin( buf );
+        default: COMMA_THROW( comma::exception, "windowed: expected numeric fields except t, got field of type " << comma::csv::format::to_format( e.type, e.size ) );
+    }
+}
+
+/// window of one id
+class window
+{
+    public:
+        window( const config& c, comma::uint32 id, comma::uint32 block ) : config_( c ), id_( id ), block_( block ), sequence_( 0 ), evicted_( 0 ), fields_( c.elements.size() ) {}
+
+        /// add record, output windows ending before it
+        void push( const Values& v, comma::int64 t, std::ostream& os )
+        {
+            if( config_.by_time )
+            {
+                if( !records_.empty() && t < records_.back().t ) { COMMA_THROW( comma::exception, "windowed: expected records sorted by time for each id; got " << t << " after " << records_.back().t << " microseconds" ); }
+                if( !end_ ) { end_ = next_boundary_( t ); }
+                while( t >= *end_ )
+                {
+                    evict_until_( *end_ - config_.size );
+                    if( !records_.empty() ) { output_( *end_, os ); end_ = *end_ + config_.step; continue; }
+                    end_ = next_boundary_( t );
+                }
+            }
+            add_( v, t );
+            if( config_.by_time ) { return; }
+            while( records_.size() > std::size_t( config_.size ) ) { evict_(); }
+            if( sequence_ % config_.step == 0 && records_.size() == std::size_t( config_.size ) ) { output_( t, os ); }
+        }
+
+        /// output remaining windows with the last records, if any, e.g. at the end of block
+        void flush( std::ostream& os )
+        {
+            if( !config_.by_time || !end_ ) { return; }
+            while( true ) // sliding windows: keep stepping until window start passes the last record
+            {
+                evict_until_( *end_ - config_.size );
+                if( records_.empty() ) { return; }
+                output_( *end_, os );
+                end_ = *end_ + config_.step;
+            }
+        }
+
+    private:
+        struct record
+        {
+            comma::uint64 sequence;
+            comma::int64 t;
+            std::vector< double > values;
+        };
+        struct field
+        {
+            double reference;
+            double sums[4]; // power sums of value - reference
+            std::deque< std::pair< comma::uint64, double > > min; // monotonic deques: sequence number, value
+            std::deque< std::pair< comma::uint64, double > > max;
+            field() : reference( 0 ) { for( unsigned int i = 0; i < 4; ++i ) { sums[i] = 0; } }
+        };
+        struct pane
+        {
+            comma::int64 index;
+            std::vector< comma::math::tdigest > digests; // for each percentile operation and field
+        };
+        const config& config_;
+        comma::uint32 id_;
+        comma::uint32 block_;
+        comma::uint64 sequence_;
+        std::size_t evicted_;
+        std::deque< record > records_;
+        std::vector< field > fields_;
+        std::deque< pane > panes_;
+        boost::optional< comma::int64 > end_;
+
+        comma::int64 floor_( comma::int64 t ) const { return t >= 0 || t % config_.step == 0 ? t / config_.step : t / config_.step - 1; }
+
+        comma::int64 next_boundary_( comma::int64 t ) const { return ( floor_( t ) + 1 ) * config_.step; }
+
+        void add_( const Values& v, comma::int64 t )
+        {
+            records_.push_back( record() );
+            record& r = records_.back();
+            r.sequence = sequence_++;
+            r.t = t;
+            r.values.resize( fields_.size() );
+            for( std::size_t i = 0; i < fields_.size(); ++i ) { r.values[i] = from_bin_( config_.elements[i], v.buffer() + config_.elements[i].offset ); }
+            if( records_.size() == 1 ) { for( std::size_t i = 0; i < fields_.size(); ++i ) { fields_[i].reference = r.values[i]; } }
+            for( std::size_t i = 0; i < fields_.size(); ++i )
+            {
+                field& f = fields_[i];
+                double x = r.values[i];
+                double d = x - f.reference;
+                f.sums[0] += d;
+                f.sums[1] += d * d;
+                f.sums[2] += d * d * d;
+                f.sums[3] += d * d * d * d;
+                while( !f.min.empty() && !( f.min.back().second < x ) ) { f.min.pop_back(); }
+                f.min.push_back( std::make_pair( r.sequence, x ) );
+                while( !f.max.empty() && !( x < f.max.back().second ) ) { f.max.pop_back(); }
+                f.max.push_back( std::make_pair( r.sequence, x ) );
+            }
+            add_to_pane_( r );
+        }
+
+        void add_to_pane_( const record& r )
+        {
+            const std::vector< double >& compressions = config_.compressions;
+            if( compressions.empty() ) { return; }
+            comma::int64 index = config_.by_time ? floor_( r.t ) : comma::int64( r.sequence ) / config_.step;
+            if( panes_.empty() || panes_.back().index != index )
+            {
+                panes_.push_back( pane() );
+                panes_.back().index = index;
+                for( std::size_t i = 0; i < compressions.size(); ++i ) { for( std::size_t j = 0; j < fields_.size(); ++j ) { panes_.back().digests.push_back( comma::math::tdigest( compressions[i] ) ); } }
+            }
+            for( std::size_t i = 0; i < compressions.size(); ++i ) { for( std::size_t j = 0; j < fields_.size(); ++j ) { panes_.back().digests[ i * fields_.size() + j ].push( r.values[j] ); } }
+        }
+
+        void evict_until_( comma::int64 begin ) { while( !records_.empty() && records_.front().t < begin ) { evict_(); } }
+
+        void evict_()
+        {
+            const record& r = records_.front();
+            for( std::size_t i = 0; i < fields_.size(); ++i )
+            {
+                field& f = fields_[i];
+                double d = r.values[i] - f.reference;
+                f.sums[0] -= d;
+                f.sums[1] -= d * d;
+                f.sums[2] -= d * d * d;
+                f.sums[3] -= d * d * d * d;
+                if( f.min.front().first == r.sequence ) { f.min.pop_front(); }
+                if( f.max.front().first == r.sequence ) { f.max.pop_front(); }
+            }
+            records_.pop_front();
+            if( ++evicted_ >= records_.size() ) { recalculate_(); } // once the window has turned over, to keep rounding errors of subtraction bounded
+        }
+
+        void recalculate_()
+        {
+            evicted_ = 0;
+            for( std::size_t i = 0; i < fields_.size(); ++i )
+            {
+                field& f = fields_[i];
+                f.reference = records_.empty() ? 0 : records_.front().values[i];
+                for( unsigned int k = 0; k < 4; ++k ) { f.sums[k] = 0; }
+                for( std::size_t j = 0; j < records_.size(); ++j )
+                {
+                    double d = records_[j].values[i] - f.reference;
+                    f.sums[0] += d;
+                    f.sums[1] += d * d;
+                    f.sums[2] += d * d * d;
+                    f.sums[3] += d * d * d * d;
+                }
+            }
+        }
+
+        void output_( comma::int64 t, std::ostream& os )
+        {
+            comma::int64 first_pane = config_.by_time ? floor_( t - config_.size ) : ( comma::int64( sequence_ ) - config_.size ) / config_.step;
+            while( !panes_.empty() && panes_.front().index < first_pane ) { panes_.pop_front(); }
+            std::string line;
+            std::size_t percentile = 0;
+            for( std::size_t i = 0; i < config_.sample.size(); ++i )
+            {
+                const comma::csv::format& format = config_.sample[i].output_format();
+                std::string buf( format.size(), 0 );
+                bool is_percentile = config_.operations[i].type == Operations::Enum::percentile;
+                for( std::size_t j = 0; j < fields_.size(); ++j )
+                {
+                    comma::csv::format::element e = format.offset( j );
+                    to_bin_( e.type, value_( config_.operations[i], j, is_percentile ? percentile : 0 ), &buf[0] + e.offset );
+                }
+                if( is_percentile ) { ++percentile; }
+                if( config_.csv.binary() ) { line += buf; }
+                else { if( i > 0 ) { line += config_.csv.delimiter; } line += format.bin_to_csv( &buf[0], config_.csv.delimiter, 12 ); }
+            }
+            if( config_.by_time || config_.t_index )
+            {
+                boost::posix_time::ptime time = Operations::percentile_traits< boost::posix_time::ptime >::from_double( t );
+                if( config_.csv.binary() ) { std::string buf( config_.t_format.size(), 0 ); comma::csv::format::traits< boost::posix_time::ptime >::to_bin( time, &buf[0] ); line += buf; }
+                else { line += config_.csv.delimiter; line += boost::posix_time::to_iso_string( time ); }
+            }
+            if( config_.csv.binary() )
+            {
+                os.write( &line[0], line.size() );
+                if( config_.has_id ) { os.write( reinterpret_cast< const char* >( &id_ ), sizeof( comma::uint32 ) ); }
+                if( config_.has_block ) { os.write( reinterpret_cast< const char* >( &block_ ), sizeof( comma::uint32 ) ); }
+                os.flush();
+            }
+            else
+            {
+                os << line;
+                if( config_.has_id ) { os << config_.csv.delimiter << id_; }
+                if( config_.has_block ) { os << config_.csv.delimiter << block_; }
+                os << std::endl;
+            }
+        }
+
+        double value_( const Operations::operation_parameters& p, std::size_t i, std::size_t percentile )
+        {
+            const field& f = fields_[i];
+            double n = records_.size();
+            double s1 = f.sums[0] / n;
+            double s2 = f.sums[1] / n;
+            double s3 = f.sums[2] / n;
+            double s4 = f.sums[3] / n;
+            double m2 = ( s2 - s1 * s1 ) * n; // sums of powers of deviations from mean
+            double m3 = ( s3 - 3 * s1 * s2 + 2 * s1 * s1 * s1 ) * n;
+            double m4 = ( s4 - 4 * s1 * s3 + 6 * s1 * s1 * s2 - 3 * s1 * s1 * s1 * s1 ) * n;
+            if( m2 < 0 ) { m2 = 0; }
+            bool sample = !p.options.empty() && p.options[0] == "sample";
+            double min = f.min.front().second;
+            double max = f.max.front().second;
+            switch( p.type )
+            {
+                case Operations::Enum::min: return min;
+                case Operations::Enum::max: return max;
+                case Operations::Enum::centre: return min + ( max - min ) / 2;
+                case Operations::Enum::diameter: return max - min;
+                case Operations::Enum::radius: return ( max - min ) / 2;
+                case Operations::Enum::size: return n;
+                case Operations::Enum::sum: return f.sums[0] + f.reference * n;
+                case Operations::Enum::mean: return f.reference + s1;
+                case Operations::Enum::variance: return m2 / ( sample ? n - 1 : n );
+                case Operations::Enum::stddev: return std::sqrt( m2 / ( sample ? n - 1 : n ) );
+                case Operations::Enum::skew: return ( sample ? std::sqrt( n * ( n - 1 ) ) / ( n - 2 ) : 1 ) * std::sqrt( n / ( m2 * m2 * m2 ) ) * m3;
+                case Operations::Enum::kurtosis:
+                {
+                    bool excess = false;
+                    sample = false;
+                    for( std::size_t k = 0; k < p.options.size(); ++k )
+                    {
+                        if( p.options[k] == "sample" ) { sample = true; }
+                        else if( p.options[k] == "excess" ) { excess = true; }
+                    }
+                    double result = n * m4 / ( m2 * m2 );
+                    if( sample ) { result = n > 3 ? ( n - 1 ) / ( n - 2 ) / ( n - 3 ) * ( ( n + 1 ) * result - 3 * ( n - 1 ) ) + 3 : nan( "" ); }
+                    return excess ? result - 3 : result;
+                }
+                case Operations::Enum::percentile:
+                {
+                    comma::math::tdigest d( config_.compressions[ percentile ] );
+                    for( std::size_t k = 0; k < panes_.size(); ++k ) { d.merge( panes_[k].digests[ percentile * fields_.size() + i ] ); }
+                    return d.quantile( boost::lexical_cast< double >( p.options[0] ) );
+                }
+                default: COMMA_THROW( comma::exception, "windowed: operation not supported; never here" );
+            }
+        }
+};
+
+static int run( const comma::command_line_options& options
+              , const comma::csv::options& csv
+              , const std::vector< Operations::operation_parameters >& operations
+              , ascii_input* ascii
+              , binary_input* binary )
+{
+    config c;
+    c.csv = csv;
+    c.operations = operations;
+    c.has_block = csv.has_field( "block" );
+    c.has_id = csv.has_field( "id" );
+    c.t_index = t_index( csv );
+    c.t_format = comma::csv::format( "t" );
+    bool step_by_time;
+    c.size = parse_( options.value< std::string >( "--window" ), c.by_time );
+    c.step = parse_( options.value< std::string >( "--step", options.value< std::string >( "--window" ) ), step_by_time );
+    if( c.by_time != step_by_time ) { std::cerr << comma::verbose.app_name() << ": --window and --step: expected both in seconds or both in records" << std::endl; return 1; }
+    if( c.size <= 0 || c.step <= 0 ) { std::cerr << comma::verbose.app_name() << ": expected positive --window and --step" << std::endl; return 1; }
+    if( c.by_time && !c.t_index ) { std::cerr << comma::verbose.app_name() << ": --window in seconds: please specify t field" << std::endl; return 1; }
+    for( std::size_t i = 0; i < operations.size(); ++i )
+    {
+        switch( operations[i].type )
+        {
+            case Operations::Enum::mode: std::cerr << comma::verbose.app_name() << ": --window: mode not supported" << std::endl; return 1;
+            case Operations::Enum::percentile:
+                if( operations[i].options.size() < 2 || operations[i].options[1] != "sketch" ) { std::cerr << comma::verbose.app_name() << ": --window: only percentile=<n>:sketch supported" << std::endl; return 1; }
+                if( c.size % c.step != 0 ) { std::cerr << comma::verbose.app_name() << ": --window: for percentile, expected --window to be a multiple of --step" << std::endl; return 1; }
+                c.compressions.push_back( operations[i].options.size() > 2 ? boost::lexical_cast< double >( operations[i].options[2] ) : 100 );
+                break;
+            default: break;
+        }
+    }
+    typedef boost::unordered_map< comma::uint32, window* > windows_t;
+    windows_t windows;
+    boost::ptr_vector< window > list;
+    boost::optional< comma::uint32 > block;
+    bool initialised = false;
+    while( std::cin.good() && !std::cin.eof() )
+    {
+        const Values* v = binary ? binary->read() : ascii->read();
+        if( v == NULL ) { if( binary ) { break; } else { continue; } }
+        if( !initialised )
+        {
+            initialised = true;
+            if( c.t_index && v->format().offset( *c.t_index ).type != comma::csv::format::time && v->format().offset( *c.t_index ).type != comma::csv::format::long_time ) { COMMA_THROW( comma::exception, "--window: expected t field of type time, got " << comma::csv::format::to_format( v->format().offset( *c.t_index ).type ) ); }
+            comma::csv::format f = values_format( v->format(), c.t_index );
+            init_operations( c.sample, c.operations, f );
+            for( std::size_t i = 0; i < v->format().count(); ++i )
+            {
+                if( c.t_index && *c.t_index == i ) { continue; }
+                c.elements.push_back( v->format().offset( i ) );
+                from_bin_( c.elements.back(), v->buffer() + c.elements.back().offset ); // check type
+            }
+        }
+        if( c.has_block && block && *block != v->block() )
+        {
+            for( std::size_t i = 0; i < list.size(); ++i ) { list[i].flush( std::cout ); }
+            windows.clear();
+            list.clear();
+        }
+        block = v->block();
+        comma::int64 t = 0;
+        if( c.t_index ) { t = Operations::percentile_traits< boost::posix_time::ptime >::to_double( comma::csv::format::traits< boost::posix_time::ptime >::from_bin( v->buffer() + v->format().offset( *c.t_index ).offset ) ); }
+        windows_t::iterator it = windows.find( v->id() );
+        if( it == windows.end() ) { list.push_back( new window( c, v->id(), v->block() ) ); it = windows.insert( std::make_pair( v->id(), &list.back() ) ).first; }
+        it->second->push( *v, t, std::cout );
+    }
+    for( std::size_t i = 0; i < list.size(); ++i ) { list[i].flush( std::cout ); }
+    return 0;
+}
+
+} // namespace windowed {
+
 int main( int ac, char** av )
 {
     try
     {
         comma::command_line_options options( ac, av, usage );
         if( options.exists( "--bash-completion" ) ) bash_completion( ac, av );
-        std::vector< std::string > unnamed = options.unnamed( "", "--binary,-b,--delimiter,-d,--format,--fields,-f,--output-fields" );
+        std::vector< std::string > unnamed = options.unnamed( comma::csv::options::valueless_options(), "--binary,-b,--delimiter,-d,--format,--fields,-f,--output-fields,--threads,--window,--step" );
         comma::csv::options csv( options );
         #ifdef WIN32
         if( csv.binary() ) { _setmode( _fileno( stdin ), _O_BINARY ); _setmode( _fileno( stdout ), _O_BINARY ); }
@@ -1258,6 +2125,9 @@ int main( int ac, char** av )
         bool has_block = csv.has_field( "block" );
         bool has_id = csv.has_field( "id" );
         bool append = options.exists("--append");
+        bool windowed = options.exists( "--window" );
+        if( windowed && append ) { std::cerr << comma::verbose.app_name() << ": --window and --append are mutually exclusive" << std::endl; return 1; }
+        boost::optional< std::size_t > t_index = windowed ? windowed::t_index( csv ) : boost::none;
         
         if( options.exists( "--output-fields" ) )
         {
@@ -1270,10 +2140,11 @@ int main( int ac, char** av )
                 std::replace(v[op].begin(), v[op].end(), ':', '_');
                 for (std::size_t f = 0; f < fields.size(); f++ )
                 {
-                    if (fields[f] == "" || fields[f] == "id" || fields[f] == "block") { continue; }
+                    if (fields[f] == "" || fields[f] == "id" || fields[f] == "block" || ( windowed && fields[f] == "t" )) { continue; }
                     output_fields.push_back(fields[f] + "/" + v[op]);
                 }
             }
+            if (t_index) { output_fields.push_back("t"); }
             if (has_id && !append) { output_fields.push_back("id"); }
             if (has_block && !append ) { output_fields.push_back("block"); }
             std::cout << comma::join(output_fields, ',') << std::endl;
@@ -1283,17 +2154,27 @@ int main( int ac, char** av )
         {
             if ( !format ) { std::cerr << comma::verbose.app_name() << ": option --output-format requires input format to be specified, please use --format or --binary" << std::endl; return 1; }
             boost::ptr_vector< Operationbase > ops;
-            init_operations(ops, operations_parameters, Values(csv, *format).format());
+            init_operations(ops, operations_parameters, windowed ? windowed::values_format( Values(csv, *format).format(), t_index ) : Values(csv, *format).format());
             for ( std::size_t i = 0; i < ops.size(); ++i ) 
             { 
                 if ( i > 0 ) { std::cout << csv.delimiter; }
                 std::cout << ops[i].output_format().string();
             }
+            if (t_index) { std::cout << csv.delimiter << "t"; }
             if (has_id && !append) { std::cout << csv.delimiter << "ui"; }
             if (has_block && !append) { std::cout << csv.delimiter << "ui"; }
             std::cout << std::endl;
             return 0;
         } 
+        if( windowed ) { return windowed::run( options, csv, operations_parameters, ascii.get(), binary.get() ); }
+        if( csv.binary() && !append && options.exists( "--threads" ) && columnar::engine::supported( csv, operations_parameters ) )
+        {
+            unsigned int threads = options.value< unsigned int >( "--threads", 1 );
+            if( threads == 0 ) { threads = std::max( std::thread::hardware_concurrency(), 1u ); }
+            binary.reset(); // columnar engine reads stdin itself
+            columnar::engine( csv, operations_parameters, threads ).run();
+            return 0;
+        }
         while( std::cin.good() && !std::cin.eof() )
         {
             const Values* v = csv.binary() ? binary->read() : ascii->read();
@@ -36,11 +36,12 @@
 #include <io.h>
 #endif
 
-#include <cstring>
 #include <iostream>
+#include <vector>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
+#include "../../csv/codec.h"
 #include "../../csv/format.h"
 
 static const std::string app_name = "csv-cast";
@@ -145,107 +146,34 @@ static void check_conversions( const comma::csv::format& iformat, const comma::c
     }
 }
 
-template< typename To >
-static void lexical_cast( const std::string& in, char* out ) { comma::csv::format::traits< To >::to_bin( boost::lexical_cast< To >( comma::csv::format::traits< std::string >::from_bin( &in[0], in.size() ) ), out ); }
-
-template<>
-void lexical_cast< boost::posix_time::ptime >( const std::string& in, char* out )
+struct field_cast
 {
-    boost::posix_time::ptime t;
-    try { t = boost::posix_time::from_iso_string( in ); }
-    catch ( ... ) { t = boost::posix_time::not_a_date_time; }
-    comma::csv::format::traits< boost::posix_time::ptime >::to_bin( t, out );
-}
-
-static void lexical_cast_long_time( const std::string& in, char* out )
+    std::size_t from_offset;
+    std::size_t from_size;
+    std::size_t to_offset;
+    std::size_t to_size;
+    comma::csv::codec::cast_function function;
+};
+
+static std::vector< field_cast > make_plan( const comma::csv::format& iformat, const comma::csv::format& oformat )
 {
-    boost::posix_time::ptime t;
-    try { t = boost::posix_time::from_iso_string( in ); }
-    catch ( ... ) { t = boost::posix_time::not_a_date_time; }
-    comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::to_bin( t, out );
-}
-
-static void lexical_cast( const comma::csv::format::types_enum to_type, const std::string& in, char* out )
-{
-    switch( to_type )
+    const std::vector< comma::csv::codec::field >& from = iformat.codec().fields();
+    const std::vector< comma::csv::codec::field >& to = oformat.codec().fields();
+    std::vector< field_cast > plan( from.size() );
+    for( unsigned int i = 0; i < from.size(); ++i )
     {
-        case comma::csv::format::int8:          lexical_cast< char >( in, out ); break;
-        case comma::csv::format::uint8:         lexical_cast< unsigned char >( in, out ); break;
-        case comma::csv::format::int16:         lexical_cast< comma::int16 >( in, out ); break;
-        case comma::csv::format::uint16:        lexical_cast< comma::uint16 >( in, out ); break;
-        case comma::csv::format::int32:         lexical_cast< comma::int32 >( in, out ); break;
-        case comma::csv::format::uint32:        lexical_cast< comma::uint32 >( in, out ); break;
-        case comma::csv::format::int64:         lexical_cast< comma::int64 >( in, out ); break;
-        case comma::csv::format::uint64:        lexical_cast< comma::uint64 >( in, out ); break;
-        case comma::csv::format::char_t:        lexical_cast< char >( in, out ); break;
-        case comma::csv::format::float_t:       lexical_cast< float >( in, out ); break;
-        case comma::csv::format::double_t:      lexical_cast< double >( in, out ); break;
-        case comma::csv::format::time:          lexical_cast< boost::posix_time::ptime >( in, out ); break;
-        case comma::csv::format::long_time:     lexical_cast_long_time( in, out ); break;
-        default:                                COMMA_THROW( comma::exception, "type conversion from fixed_string to " << comma::csv::format::to_format( to_type ) << " is not supported" ); break;
+        plan[i].from_offset = from[i].offset;
+        plan[i].from_size = from[i].size;
+        plan[i].to_offset = to[i].offset;
+        plan[i].to_size = to[i].size;
+        plan[i].function = comma::csv::codec::cast( from[i].type, to[i].type );
     }
+    return plan;
 }
 
-template< typename From, typename To >
-static void cast( const char* in, char* out ) { comma::csv::format::traits< To >::to_bin( comma::csv::format::traits< From >::from_bin( in ), out ); }
-
-template < typename From >
-static void cast( const comma::csv::format::types_enum to_type, const char* in, char* out  )
+static void cast( const std::vector< field_cast >& plan, const std::vector< char >& input, std::vector< char >& output )
 {
-    switch( to_type )
-    {
-        case comma::csv::format::int8:          cast< From, char >( in, out ); break;
-        case comma::csv::format::uint8:         cast< From, unsigned char >( in, out ); break;
-        case comma::csv::format::int16:         cast< From, comma::int16 >( in, out ); break;
-        case comma::csv::format::uint16:        cast< From, comma::uint16 >( in, out ); break;
-        case comma::csv::format::int32:         cast< From, comma::int32 >( in, out ); break;
-        case comma::csv::format::uint32:        cast< From, comma::uint32 >( in, out ); break;
-        case comma::csv::format::int64:         cast< From, comma::int64 >( in, out ); break;
-        case comma::csv::format::uint64:        cast< From, comma::uint64 >( in, out ); break;
-        case comma::csv::format::char_t:        cast< From, char >( in, out ); break;
-        case comma::csv::format::float_t:       cast< From, float >( in, out ); break;
-        case comma::csv::format::double_t:      cast< From, double >( in, out ); break;
-        default:                                COMMA_THROW( comma::exception, "type conversion to " << comma::csv::format::to_format( to_type ) << " is not supported" ); break;
-    }
-}
-
-void cast( const comma::csv::format& iformat, const std::vector< char >& input, const comma::csv::format& oformat, std::vector< char >& output )
-{
-    const char* in = &input[0];
-    unsigned int ioffset = 0;
-    unsigned int icount = 0;
-    char* out = &output[0];
-    unsigned int ooffset = 0;
-    unsigned int ocount = 0;
-    for( unsigned int i = 0; i < iformat.count(); ++i, ++icount, ++ocount )
-    {
-        if( icount >= iformat.elements()[ ioffset ].count ) { icount = 0; ++ioffset; }
-        if( ocount >= oformat.elements()[ ooffset ].count ) { ocount = 0; ++ooffset; }
-        comma::csv::format::types_enum from_type = iformat.elements()[ ioffset ].type;
-        comma::csv::format::types_enum to_type = oformat.elements()[ ooffset ].type;
-        if( from_type == to_type ) { std::memcpy( out, in, iformat.elements()[ ioffset ].size ); }
-        else
-        {
-            switch( from_type )
-            {
-                case comma::csv::format::int8:          cast< char >( to_type, in, out ); break;
-                case comma::csv::format::uint8:         cast< unsigned char >( to_type, in, out ); break;
-                case comma::csv::format::int16:         cast< comma::int16 >( to_type, in, out ); break;
-                case comma::csv::format::uint16:        cast< comma::uint16 >( to_type, in, out ); break;
-                case comma::csv::format::int32:         cast< comma::int32 >( to_type, in, out ); break;
-                case comma::csv::format::uint32:        cast< comma::uint32 >( to_type, in, out ); break;
-                case comma::csv::format::int64:         cast< comma::int64 >( to_type, in, out ); break;
-                case comma::csv::format::uint64:        cast< comma::uint64 >( to_type, in, out ); break;
-                case comma::csv::format::char_t:        cast< char >( to_type, in, out ); break;
-                case comma::csv::format::float_t:       cast< float >( to_type, in, out ); break;
-                case comma::csv::format::double_t:      cast< double >( to_type, in, out ); break;
-                case comma::csv::format::fixed_string:  lexical_cast( to_type, std::string( in, iformat.elements()[ ioffset ].size ), out ); break;
-                default:                                COMMA_THROW( comma::exception, "type conversion from " << comma::csv::format::to_format( from_type ) << " to " << comma::csv::format::to_format( to_type ) << " is not supported" ); break;
-            }
-        }
-        in += iformat.elements()[ ioffset ].size;
-        out += oformat.elements()[ ooffset ].size;
-    }
+    for( unsigned int i = 0; i < plan.size(); ++i ) { plan[i].function( &input[ plan[i].from_offset ], plan[i].from_size, &output[ plan[i].to_offset ], plan[i].to_size ); }
 }
 
 int main( int ac, char** av )
@@ -262,6 +190,7 @@ int main( int ac, char** av )
         comma::csv::format iformat( options.value< std::string >( "--binary,-b,--from", av[1] ) );
         comma::csv::format oformat( options.value< std::string >( "--output-binary,--output,-o,--to", av[2] ) );
         check_conversions( iformat, oformat, options.exists( "--force" ) );
+        const std::vector< field_cast >& plan = make_plan( iformat, oformat );
         std::vector< char > in( iformat.size() );
         std::vector< char > out( oformat.size() );
         while( std::cin.good() )
@@ -269,7 +198,7 @@ int main( int ac, char** av )
             std::cin.read( &in[0], iformat.size() );
             if( std::cin.gcount() == 0 ) { break; }
             if( std::cin.gcount() < static_cast< int >( iformat.size() ) ) { COMMA_THROW( comma::exception, "expected " << iformat.size() << " bytes, got only " << std::cin.gcount() ); }
-            cast( iformat, in, oformat, out );
+            cast( plan, in, out );
             std::cout.write( &out[0], oformat.size() ).flush();
         }
         return 0;
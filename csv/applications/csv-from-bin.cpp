@@ -37,11 +37,15 @@
 #endif
 
 #include <stdlib.h>
+#include <algorithm>
 #include <iostream>
+#include <thread>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
+#include "../../csv/codec.h"
 #include "../../csv/format.h"
+#include "../../csv/impl/pipeline.h"
 #include "../../string/string.h"
 
 using namespace comma;
@@ -51,7 +55,11 @@ static void usage()
     std::cerr << std::endl;
     std::cerr << "Usage: cat blah.bin | csv-from-bin <format> --precision <precision> > blah.csv" << std::endl;
     std::cerr << std::endl;
+    std::cerr << "--flush: flush stdout after each record" << std::endl;
     std::cerr << "--precision: set precision (number of mantissa digits) for floating point types" << std::endl;
+    std::cerr << "--threads=<n>: convert on <n> threads, 0: use all cores; a reader thread reads input in large chunks" << std::endl;
+    std::cerr << "               of whole records, chunks are converted in parallel and output in order; output is the same" << std::endl;
+    std::cerr << "               as with a single thread, but is delayed by a chunk, i.e. --threads is for bulk conversion" << std::endl;
     std::cerr << csv::format::usage() << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
@@ -59,6 +67,54 @@ static void usage()
     exit( 0 );
 }
 
+/// read input in chunks
+class chunk_reader
+{
+    public:
+        chunk_reader( std::size_t size ) : size_( size ), eof_( false ) {}
+
+        bool operator()( std::string& chunk )
+        {
+            if( eof_ ) { return false; }
+            chunk.resize( size_ );
+            std::cin.read( &chunk[0], size_ );
+            chunk.resize( std::cin.gcount() );
+            eof_ = !std::cin.good();
+            return !chunk.empty();
+        }
+
+    private:
+        std::size_t size_;
+        bool eof_;
+};
+
+/// convert chunk of records, same as main loop
+class chunk_converter
+{
+    public:
+        chunk_converter( const comma::csv::format& format, char delimiter, const boost::optional< unsigned int >& precision ) : codec_( &format.codec() ), size_( format.size() ), delimiter_( delimiter ), precision_( precision ) {}
+
+        void operator()( const std::string& chunk, std::string& output )
+        {
+            std::size_t i = 0;
+            for( ; i + size_ <= chunk.size(); i += size_ )
+            {
+                line_.clear();
+                codec_->bin_to_csv( line_, &chunk[i], delimiter_, precision_ );
+                output += line_;
+                output += '\n';
+            }
+            if( i < chunk.size() ) { COMMA_THROW( comma::exception, "expected " << size_ << " bytes, got only " << ( chunk.size() - i ) ); }
+        }
+
+    private:
+        const comma::csv::codec* codec_;
+        std::size_t size_;
+        char delimiter_;
+        boost::optional< unsigned int > precision_;
+        std::string line_;
+};
+
 int main( int ac, char** av )
 {
     #ifdef WIN32
@@ -69,17 +125,33 @@ int main( int ac, char** av )
         command_line_options options( ac, av );
         if( ac < 2 || options.exists( "--help" ) || options.exists( "-h" ) ) { usage(); }
         char delimiter = options.value( "--delimiter", ',' );
+        bool flush = options.exists( "--flush" );
         boost::optional< unsigned int > precision;
         if( options.exists( "--precision" ) ) { precision = options.value< unsigned int >( "--precision" ); }
         comma::csv::format format( av[1] );
+        const comma::csv::codec& codec = format.codec();
+        if( options.exists( "--threads" ) )
+        {
+            unsigned int threads = options.value< unsigned int >( "--threads" );
+            if( threads == 0 ) { threads = std::max( std::thread::hardware_concurrency(), 1u ); }
+            std::size_t size = std::max< std::size_t >( 1 << 20, format.size() ) / format.size() * format.size();
+            comma::csv::impl::pipeline< chunk_reader, chunk_converter > pipeline( threads, chunk_reader( size ), chunk_converter( format, delimiter, precision ) );
+            pipeline.run( std::cout, flush );
+            return 0;
+        }
         std::vector< char > w( format.size() ); //char buf[ format.size() ]; // stupid windows
         char* buf = &w[0];
+        std::string line;
         while( std::cin.good() && !std::cin.eof() )
         {
             std::cin.read( buf, format.size() );
             if( std::cin.gcount() == 0 ) { break; }
             if( std::cin.gcount() < static_cast< int >( format.size() ) ) { COMMA_THROW( comma::exception, "expected " << format.size() << " bytes, got only " << std::cin.gcount() ); }
-            std::cout << format.bin_to_csv( buf, delimiter, precision ) << std::endl;
+            line.clear();
+            codec.bin_to_csv( line, buf, delimiter, precision );
+            line += '\n';
+            std::cout.write( &line[0], line.size() );
+            if( flush ) { std::cout.flush(); }
         }
         return 0;
     }
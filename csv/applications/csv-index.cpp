@@ -0,0 +1,185 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../../application/command_line_options.h"
+#include "../../application/contact_info.h"
+#include "../../base/exception.h"
+#include "../../base/types.h"
+#include "../../csv/impl/unstructured.h"
+#include "../../csv/index.h"
+#include "../../csv/stream.h"
+#include "../../string/string.h"
+#include "../../visiting/traits.h"
+
+static void usage( bool verbose )
+{
+    std::cerr << std::endl;
+    std::cerr << "build sparse sidecar index of a data file sorted by key, e.g. timestamp, in ascending order" << std::endl;
+    std::cerr << "the index of <filename> is saved as <filename>.index and holds key and byte offset" << std::endl;
+    std::cerr << "of every n-th record, which lets csv-select, csv-play, csv-time-join (bounding file)" << std::endl;
+    std::cerr << "and csv-join (filter file) skip to the records of interest instead of reading the file" << std::endl;
+    std::cerr << "from the beginning; they use the index automatically, if it exists and is up to date" << std::endl;
+    std::cerr << "and was built for the same key field position and format as theirs" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "usage: csv-index <filename> [<options>]" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "options" << std::endl;
+    std::cerr << "    --every,--records=<n>: index every n-th record; default: 1000" << std::endl;
+    std::cerr << "    --bytes=<n>: also index a record, if it is more than n bytes after the last indexed record" << std::endl;
+    std::cerr << "    --format=<format>: ascii only: format of the records, if key type guessed from the first line is wrong" << std::endl;
+    std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "fields: exactly one non-empty field, which is the key; numeric or time" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "csv options" << std::endl;
+    std::cerr << comma::csv::options::usage( verbose ) << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "examples" << std::endl;
+    std::cerr << "    csv-index log.csv --fields=,,t" << std::endl;
+    std::cerr << "    csv-select --fields=,,t --from=20170101T000000 --to=20170101T000010 --sorted < log.csv" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "    csv-index log.bin --fields=t --binary=t,3d" << std::endl;
+    std::cerr << "    csv-play log.bin --binary=t,3d --from=20170101T000000" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << comma::contact_info << std::endl;
+    std::cerr << std::endl;
+    exit( 0 );
+}
+
+struct record
+{
+    boost::posix_time::ptime t;
+    double key;
+    record() : key( 0 ) {}
+};
+
+namespace comma { namespace visiting {
+
+template <> struct traits< record >
+{
+    template < typename K, typename V > static void visit( const K&, const record& p, V& v ) { v.apply( "t", p.t ); v.apply( "key", p.key ); }
+    template < typename K, typename V > static void visit( const K&, record& p, V& v ) { v.apply( "t", p.t ); v.apply( "key", p.key ); }
+};
+
+} } // namespace comma { namespace visiting {
+
+int main( int ac, char** av )
+{
+    try
+    {
+        comma::command_line_options options( ac, av, usage );
+        bool verbose = options.exists( "--verbose,-v" );
+        const std::vector< std::string >& unnamed = options.unnamed( "--verbose,-v," + comma::csv::options::valueless_options(), "-.*" );
+        if( unnamed.size() != 1 ) { std::cerr << "csv-index: expected data filename, got " << unnamed.size() << " unnamed arguments" << std::endl; return 1; }
+        const std::string& filename = unnamed[0];
+        comma::csv::options csv( options );
+        comma::uint64 every = options.value< comma::uint64 >( "--every,--records", 1000 );
+        if( every == 0 ) { std::cerr << "csv-index: expected positive --every, got 0" << std::endl; return 1; }
+        boost::optional< comma::uint64 > bytes = options.optional< comma::uint64 >( "--bytes" );
+        std::vector< std::string > fields = comma::split( csv.fields, ',' );
+        comma::csv::index index;
+        bool found = false;
+        for( unsigned int i = 0; i < fields.size(); ++i )
+        {
+            if( fields[i].empty() ) { continue; }
+            if( found ) { std::cerr << "csv-index: expected exactly one key field, got: " << csv.fields << std::endl; return 1; }
+            found = true;
+            index.column = i;
+        }
+        if( !found ) { std::cerr << "csv-index: please specify key field, e.g. --fields=,,t" << std::endl; return 1; }
+        std::ifstream ifs( filename.c_str(), csv.binary() ? std::ios::binary : std::ios::in );
+        if( !ifs.is_open() ) { std::cerr << "csv-index: failed to open \"" << filename << "\"" << std::endl; return 1; }
+        comma::csv::format format;
+        if( csv.binary() )
+        {
+            format = csv.format();
+            index.binary = format.string();
+        }
+        else
+        {
+            std::string line;
+            while( ifs.good() && !ifs.eof() && line.empty() ) { std::getline( ifs, line ); line = comma::strip( line, '\r' ); }
+            if( line.empty() ) { std::cerr << "csv-index: \"" << filename << "\" is empty" << std::endl; return 1; }
+            format = options.exists( "--format" ) ? comma::csv::format( options.value< std::string >( "--format" ) ) : comma::csv::impl::unstructured::guess_format( line, csv.delimiter );
+            ifs.clear();
+            ifs.seekg( 0 );
+            index.delimiter = csv.delimiter;
+        }
+        if( index.column >= format.count() ) { std::cerr << "csv-index: expected key field number less than " << format.count() << "; got " << index.column << std::endl; return 1; }
+        switch( format.offset( index.column ).type )
+        {
+            case comma::csv::format::time:
+            case comma::csv::format::long_time:
+                index.time = true;
+                break;
+            case comma::csv::format::fixed_string:
+                std::cerr << "csv-index: expected numeric or time key, got string" << std::endl;
+                return 1;
+            default:
+                break;
+        }
+        if( verbose && !csv.binary() ) { std::cerr << "csv-index: key type: " << ( index.time ? "time" : "numeric" ) << std::endl; }
+        fields[index.column] = index.time ? "t" : "key";
+        csv.fields = comma::join( fields, ',' );
+        csv.full_xpath = false;
+        index.stamp( filename );
+        comma::csv::input_stream< record > istream( ifs, csv );
+        comma::uint64 count = 0;
+        comma::uint64 offset = 0;
+        comma::uint64 last_offset = 0;
+        boost::optional< double > last = boost::make_optional( false, 0.0 ); // quiet gcc maybe-uninitialized
+        while( ifs.good() && !ifs.eof() )
+        {
+            if( !csv.binary() && ( count % every == 0 || bytes ) ) { offset = ifs.tellg(); } // tellg() is a system call
+            const record* r = istream.read();
+            if( !r ) { break; }
+            double key = index.time ? comma::csv::index::key( r->t ) : r->key;
+            if( last && key < *last ) { std::cerr << "csv-index: expected data sorted by key in ascending order; got " << key << " after " << *last << " in record " << count << std::endl; return 1; }
+            if( count % every == 0 || ( bytes && offset - last_offset > *bytes ) ) { index.entries.push_back( comma::csv::index::entry( key, offset ) ); last_offset = offset; }
+            last = key;
+            ++count;
+            if( csv.binary() ) { offset += csv.format().size(); }
+        }
+        std::ofstream ofs( comma::csv::index::filename( filename ).c_str() );
+        if( !ofs.is_open() ) { std::cerr << "csv-index: failed to open \"" << comma::csv::index::filename( filename ) << "\"" << std::endl; return 1; }
+        index.write( ofs );
+        if( verbose ) { std::cerr << "csv-index: indexed " << index.entries.size() << " of " << count << " record(s)" << std::endl; }
+        return 0;
+    }
+    catch( std::exception& ex ) { std::cerr << "csv-index: " << ex.what() << std::endl; }
+    catch( ... ) { std::cerr << "csv-index: unknown exception" << std::endl; }
+    return 1;
+}
@@ -30,10 +30,14 @@
 /// @author vsevolod vlaskine
 
 #include <string.h>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 #include <boost/array.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
@@ -47,6 +51,7 @@
 #include "../../application/signal_flag.h"
 #include "../../base/exception.h"
 #include "../../base/types.h"
+#include "../../csv/index.h"
 #include "../../csv/stream.h"
 #include "../../csv/traits.h"
 #include "../../io/stream.h"
@@ -73,10 +78,23 @@ static void usage( bool more )
     std::cerr << "    --matching: output only matching records from stdin" << std::endl;
     std::cerr << "    --nearest: if --radius specified, output only nearest record" << std::endl;
     std::cerr << "    --not-matching: not matching records as read from stdin, no join performed" << std::endl;
+    std::cerr << "    --sorted: both stdin and filter are sorted by block, if present, and then by keys in ascending order;" << std::endl;
+    std::cerr << "              merge join: read both streams in lockstep, keeping in memory only filter records with" << std::endl;
+    std::cerr << "              the current stdin keys instead of the whole filter block; fail if input is not sorted" << std::endl;
+    std::cerr << "              not supported with --radius or finite state machine" << std::endl;
     std::cerr << "    --strict: fail, if id on stdin is not found, or there are multiple filter keys on --unique, etc" << std::endl;
     std::cerr << "    --radius,--epsilon=<value>; compare keys in given radius; the keys will be interpreted as floating point numbers" << std::endl;
+    std::cerr << "                                radius 0: keys match only if equal, same as --double" << std::endl;
+    std::cerr << "                                if more than one key given, keys are coordinates of a point and records match" << std::endl;
+    std::cerr << "                                if the euclidean distance between them is within radius" << std::endl;
+    std::cerr << "                                filter keys are indexed in voxels of radius size for up to 3 keys" << std::endl;
+    std::cerr << "                                and in a k-d tree for more keys" << std::endl;
+    std::cerr << "    --threads=<n>; default=1; with --radius, number of threads searching for matches of batches of stdin records" << std::endl;
+    std::cerr << "                   of the same block; output is in the order of stdin; 0: use all cores" << std::endl;
     std::cerr << "    --swap-output,--swap; output filter records first with the stdin record appended, a convenience option" << std::endl;
     std::cerr << "    --unique,--unique-matches: expect only unique matches, exit with error otherwise" << std::endl;
+    std::cerr << "    --use-index: if filter file is indexed by block with csv-index, skip filter blocks not present on stdin" << std::endl;
+    std::cerr << "                 using the index; see --help --verbose for details" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
     std::cerr << std::endl;
     std::cerr << "key field options" << std::endl;
@@ -107,6 +125,9 @@ static void usage( bool more )
         std::cerr << "        block acts as a key but stream processing occurs at the end of each" << std::endl;
         std::cerr << "        block. If no block field is given the entire input is considered to be" << std::endl;
         std::cerr << "        one block. Blocks are required to be contiguous in the input stream." << std::endl;
+        std::cerr << "        --use-index: if filter file is indexed by block with csv-index, e.g. csv-index filter.csv --fields=,block," << std::endl;
+        std::cerr << "        filter blocks preceding the next stdin block are skipped using the index instead of being read;" << std::endl;
+        std::cerr << "        it implies that both filter and stdin are sorted by block (as required by csv-index)" << std::endl;
     }
     std::cerr << std::endl;
     std::cerr << "Examples (try them):" << std::endl;
@@ -156,6 +177,7 @@ static comma::csv::options filter_csv;
 boost::scoped_ptr< comma::io::istream > filter_transport;
 static comma::uint32 block = 0;
 static boost::optional< double > radius;
+static boost::optional< comma::csv::index > filter_index;
 
 static void hash_combine_( std::size_t& seed, boost::posix_time::ptime key )
 {
@@ -182,11 +204,15 @@ struct input
         return true;
     }
 
-    bool operator<( const input& rhs ) const
+    bool operator<( const input& rhs ) const // used only with --radius
     {
-        if( keys.empty() ) { COMMA_THROW( comma::exception, "if --radius given, expected exactly one key, got none" ); }
-        if( keys.size() > 1 ) { COMMA_THROW( comma::exception, "if --radius given, expected one key, got: " << keys.size() ); }
-        return comma::math::less( keys[0], rhs.keys[0] ); //, *radius );
+        if( keys.empty() ) { COMMA_THROW( comma::exception, "if --radius given, expected at least one key, got none" ); }
+        for( std::size_t i = 0; i < keys.size(); ++i )
+        {
+            if( comma::math::less( keys[i], rhs.keys[i] ) ) { return true; }
+            if( comma::math::less( rhs.keys[i], keys[i] ) ) { return false; }
+        }
+        return false;
     }
 
     struct hash : public std::unary_function< input, std::size_t >
@@ -203,74 +229,164 @@ struct input
     typedef std::map< input, std::vector< std::string > > map;
 };
 
-template < typename K, bool Strict = true > struct traits
+/// spatial index of filter keys for --radius: for up to 3 keys, a hash of voxels with the size of radius;
+/// for more keys, a k-d tree; matches are returned in the order of the filter map, i.e. sorted by keys
+template < typename Map > class spatial_index
 {
-    typedef typename input< K >::unordered_map map;
-    typedef std::pair< typename map::const_iterator, typename map::const_iterator > pair;
-    static pair find( map& m, const input< K >& k, bool )
-    {
-        typename map::const_iterator it = m.find( k );
-        if( it == m.end() ) { return std::make_pair( it, it ); }
-        typename map::const_iterator end = it;
-        ++end;
-        return std::make_pair( it, end );
-    }
-};
+    public:
+        typedef typename Map::const_iterator iterator;
 
-template < typename K > struct type_traits
-{
-    template < typename Map >
-    static typename std::pair< typename Map::iterator, typename Map::iterator > bounds( Map& m, const input< K >& k ) // quick and dirty
-    {
-        input< K > l = k; // quick and dirty; lame
-        input< K > u = k;
-        l.keys[0] -= *radius;
-        u.keys[0] += *radius;
-        return std::make_pair( m.lower_bound( l ), m.upper_bound( u ) );
-    }
-    
-    template < typename Map >
-    static typename Map::iterator nearest( Map& m, const input< K >& k ) // quick and dirty
-    { 
-        auto b = type_traits< K >::bounds( m, k );
-        typename Map::iterator min = b.first;
-        for( typename Map::iterator it = b.first; it != b.second; ++it )
+        void build( const Map& m, double radius )
+        {
+            if( !( radius > 0 ) ) { COMMA_THROW( comma::exception, "expected positive radius, got " << radius << "; never here" ); }
+            radius_ = radius;
+            entries_.clear();
+            points_.clear();
+            voxels_.clear();
+            tree_.clear();
+            if( m.empty() ) { return; }
+            dimensions_ = m.begin()->first.keys.size();
+            for( iterator it = m.begin(); it != m.end(); ++it )
+            {
+                entries_.push_back( it );
+                points_.insert( points_.end(), it->first.keys.begin(), it->first.keys.end() );
+            }
+            if( dimensions_ <= max_voxel_dimensions )
+            {
+                for( std::size_t i = 0; i < entries_.size(); ++i ) { voxels_[ voxel_( point_( i ) ) ].push_back( i ); }
+                return;
+            }
+            tree_.resize( entries_.size() );
+            for( std::size_t i = 0; i < tree_.size(); ++i ) { tree_[i] = i; }
+            build_tree_( 0, tree_.size(), 0 );
+        }
+
+        /// find entries within radius or, if nearest, the nearest of them; safe to call from multiple threads
+        void find( const std::vector< double >& key, bool nearest, std::vector< iterator >& matches ) const
         {
-            if( std::abs( min->first.keys[0] - k.keys[0] ) > std::abs( it->first.keys[0] - k.keys[0] ) ) { min = it; }
+            matches.clear();
+            if( entries_.empty() ) { return; }
+            static thread_local std::vector< std::size_t > found;
+            found.clear();
+            if( dimensions_ <= max_voxel_dimensions ) { find_in_voxels_( &key[0], found ); } else { find_in_tree_( 0, tree_.size(), 0, &key[0], found ); }
+            if( found.empty() ) { return; }
+            std::sort( found.begin(), found.end() );
+            if( !nearest ) { for( std::size_t i = 0; i < found.size(); ++i ) { matches.push_back( entries_[ found[i] ] ); } return; }
+            std::size_t min = found[0];
+            double min_distance = squared_distance_( min, &key[0] );
+            for( std::size_t i = 1; i < found.size(); ++i )
+            {
+                double d = squared_distance_( found[i], &key[0] );
+                if( d < min_distance ) { min = found[i]; min_distance = d; }
+            }
+            matches.push_back( entries_[ min ] );
         }
-        return min;
-    }
-};
 
-template <> struct type_traits< std::string > // quick and dirty
-{
-    template < typename Map >
-    static std::pair< typename Map::iterator, typename Map::iterator > bounds( Map& m, const input< std::string >& k ) { COMMA_THROW( comma::exception, "never here" ); }    
-    template < typename Map > static typename Map::iterator nearest( Map& m, const input< std::string >& ) { COMMA_THROW( comma::exception, "never here" ); }
+    private:
+        enum { max_voxel_dimensions = 3 };
+        typedef boost::array< comma::int64, max_voxel_dimensions > voxel_t;
+        struct voxel_hash
+        {
+            std::size_t operator()( const voxel_t& v ) const { return boost::hash_range( v.begin(), v.end() ); }
+        };
+        double radius_;
+        std::size_t dimensions_;
+        std::vector< iterator > entries_;
+        std::vector< double > points_;
+        boost::unordered_map< voxel_t, std::vector< std::size_t >, voxel_hash > voxels_;
+        std::vector< std::size_t > tree_;
+
+        const double* point_( std::size_t i ) const { return &points_[ i * dimensions_ ]; }
+
+        voxel_t voxel_( const double* p ) const
+        {
+            voxel_t v = {{ 0, 0, 0 }};
+            for( std::size_t j = 0; j < dimensions_; ++j ) { v[j] = static_cast< comma::int64 >( std::floor( p[j] / radius_ ) ); }
+            return v;
+        }
+
+        double squared_distance_( std::size_t i, const double* k ) const
+        {
+            const double* p = point_( i );
+            double s = 0;
+            for( std::size_t j = 0; j < dimensions_; ++j ) { s += ( p[j] - k[j] ) * ( p[j] - k[j] ); }
+            return s;
+        }
+
+        /// same bounds as for a single key in the map, i.e. with epsilon; for multiple keys, also within the sphere of radius,
+        /// with epsilon relative to radius to tolerate rounding in the distance
+        bool within_( std::size_t i, const double* k ) const
+        {
+            const double* p = point_( i );
+            for( std::size_t j = 0; j < dimensions_; ++j ) { if( comma::math::less( p[j], k[j] - radius_ ) || comma::math::less( k[j] + radius_, p[j] ) ) { return false; } }
+            return dimensions_ == 1 || !comma::math::less( radius_, std::sqrt( squared_distance_( i, k ) ), radius_ * dimensions_ * std::numeric_limits< double >::epsilon() );
+        }
+
+        void find_in_voxels_( const double* k, std::vector< std::size_t >& found ) const
+        {
+            voxel_t lower = {{ 0, 0, 0 }};
+            voxel_t upper = {{ 0, 0, 0 }};
+            for( std::size_t j = 0; j < dimensions_; ++j )
+            {
+                lower[j] = static_cast< comma::int64 >( std::floor( ( k[j] - radius_ - std::numeric_limits< double >::epsilon() ) / radius_ ) );
+                upper[j] = static_cast< comma::int64 >( std::floor( ( k[j] + radius_ + std::numeric_limits< double >::epsilon() ) / radius_ ) );
+            }
+            for( voxel_t v = lower; v[ max_voxel_dimensions - 1 ] <= upper[ max_voxel_dimensions - 1 ]; )
+            {
+                typename boost::unordered_map< voxel_t, std::vector< std::size_t >, voxel_hash >::const_iterator it = voxels_.find( v );
+                if( it != voxels_.end() ) { for( std::size_t i = 0; i < it->second.size(); ++i ) { if( within_( it->second[i], k ) ) { found.push_back( it->second[i] ); } } }
+                std::size_t j = 0;
+                for( ; j + 1 < max_voxel_dimensions && v[j] == upper[j]; ++j ) { v[j] = lower[j]; }
+                ++v[j];
+            }
+        }
+
+        void build_tree_( std::size_t begin, std::size_t end, std::size_t depth )
+        {
+            if( end - begin < 2 ) { return; }
+            std::size_t middle = ( begin + end ) / 2;
+            std::size_t d = depth % dimensions_;
+            std::nth_element( tree_.begin() + begin, tree_.begin() + middle, tree_.begin() + end, [&]( std::size_t lhs, std::size_t rhs ) { return point_( lhs )[d] < point_( rhs )[d]; } );
+            build_tree_( begin, middle, depth + 1 );
+            build_tree_( middle + 1, end, depth + 1 );
+        }
+
+        void find_in_tree_( std::size_t begin, std::size_t end, std::size_t depth, const double* k, std::vector< std::size_t >& found ) const
+        {
+            if( begin >= end ) { return; }
+            std::size_t middle = ( begin + end ) / 2;
+            std::size_t d = depth % dimensions_;
+            double x = point_( tree_[middle] )[d];
+            if( within_( tree_[middle], k ) ) { found.push_back( tree_[middle] ); }
+            if( !comma::math::less( x, k[d] - radius_ ) ) { find_in_tree_( begin, middle, depth + 1, k, found ); }
+            if( !comma::math::less( k[d] + radius_, x ) ) { find_in_tree_( middle + 1, end, depth + 1, k, found ); }
+        }
 };
 
-template <> struct type_traits< boost::posix_time::ptime > // quick and dirty
+template < typename K, bool Strict = true > struct traits
 {
-    template < typename Map >
-    static typename std::pair< typename Map::iterator, typename Map::iterator > bounds( Map& m, const input< boost::posix_time::ptime >& k ) { COMMA_THROW( comma::exception, "never here" ); }
-    template < typename Map >
-    static typename Map::iterator nearest( Map& m, const input< boost::posix_time::ptime >& ) { COMMA_THROW( comma::exception, "never here" ); }
+    typedef typename input< K >::unordered_map map;
+    typedef std::vector< typename map::const_iterator > matches;
+    static void loaded( const map& ) {}
+    static void find( const map& m, const input< K >& k, bool, matches& result )
+    {
+        result.clear();
+        typename map::const_iterator it = m.find( k );
+        if( it != m.end() ) { result.push_back( it ); }
+    }
 };
 
 template < typename K > struct traits< K, false >
 {
     typedef typename input< K >::map map;
-    typedef std::pair< typename map::iterator, typename map::iterator > pair; //typedef std::pair< typename map::const_iterator, typename map::const_iterator > pair;
-    static pair find( map& m, const input< K >& k, bool nearest )
-    {
-        if( !nearest ) { return type_traits< K >::bounds( m, k ); }
-        auto n = type_traits< K >::nearest( m, k );
-        if( n == m.end() ) { return std::make_pair( n, n ); }
-        auto end = n;
-        return std::make_pair( n, ++end );
-    }
+    typedef std::vector< typename map::const_iterator > matches;
+    static spatial_index< map > index;
+    static void loaded( const map& m ) { index.build( m, *radius ); }
+    static void find( const map&, const input< K >& k, bool nearest, matches& result ) { index.find( k.keys, nearest, result ); }
 };
 
+template < typename K > spatial_index< typename traits< K, false >::map > traits< K, false >::index;
+
 namespace comma { namespace visiting {
 
 template < typename T > struct traits< input< T > >
@@ -306,29 +422,92 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
     static typename traits< K, Strict >::map filter_map;
     static input< K > default_input;
 
-    static void read_filter_block()
+    static comma::csv::input_stream< input< K > >& filter_stream()
     {
-        static comma::csv::input_stream< input< K > > filter_stream( **filter_transport, filter_csv, default_input );
+        static comma::csv::input_stream< input< K > > s( **filter_transport, filter_csv, default_input );
+        return s;
+    }
+
+    static void append_last_filter_record( const input< K >& key )
+    {
+        typename traits< K, Strict >::map::mapped_type& d = filter_map[ key ];
+        if( filter_stream().is_binary() )
+        {
+            d.push_back( std::string() );
+            d.back().resize( filter_csv.format().size() );
+            ::memcpy( &d.back()[0], filter_stream().binary().last(), filter_csv.format().size() );
+        }
+        else
+        {
+            d.push_back( comma::join( filter_stream().ascii().last(), stdin_csv.delimiter ) );
+        }
+    }
+
+    /// compare by block, then by keys
+    static int compare( const input< K >& lhs, const input< K >& rhs )
+    {
+        if( lhs.block != rhs.block ) { return lhs.block < rhs.block ? -1 : 1; }
+        for( std::size_t i = 0; i < lhs.keys.size(); ++i )
+        {
+            if( lhs.keys[i] < rhs.keys[i] ) { return -1; }
+            if( rhs.keys[i] < lhs.keys[i] ) { return 1; }
+        }
+        return 0;
+    }
+
+    /// --sorted: load into filter map only filter records with the same block and keys as the given stdin record,
+    /// skipping filter records less than it; keep the loaded records while stdin keys do not change
+    static void read_filter_run( const input< K >& p )
+    {
+        static const input< K >* last = filter_stream().read();
+        static boost::optional< input< K > > previous; // previous stdin record
+        static boost::optional< input< K > > run; // keys of the records in filter map
+        if( previous && compare( p, *previous ) < 0 ) { COMMA_THROW( comma::exception, "--sorted: expected stdin sorted by block and keys; got keys: " << keys_as_string( p ) << " after: " << keys_as_string( *previous ) << "; block: " << p.block ); }
+        previous = p;
+        block = p.block;
+        if( run && compare( p, *run ) == 0 ) { return; }
+        filter_map.clear();
+        run.reset();
+        input< K > filter_previous;
+        while( last && compare( *last, p ) < 0 ) { filter_previous = *last; last = read_sorted_filter_( filter_previous ); }
+        if( !last || compare( *last, p ) != 0 ) { return; }
+        run = *last;
+        while( last && compare( *last, *run ) == 0 ) { append_last_filter_record( *last ); last = read_sorted_filter_( *run ); }
+        if( verbose ) { std::cerr << "csv-join: block " << block << ": loaded " << filter_map.begin()->second.size() << " filter record(s) with keys " << keys_as_string( *run ) << std::endl; }
+    }
+
+    static const input< K >* read_sorted_filter_( const input< K >& previous )
+    {
+        const input< K >* p = filter_stream().read();
+        if( p && compare( *p, previous ) < 0 ) { COMMA_THROW( comma::exception, "--sorted: expected filter sorted by block and keys; got keys: " << keys_as_string( *p ) << " after: " << keys_as_string( previous ) << "; block: " << p->block ); }
+        return p;
+    }
+
+    static void read_filter_block( const boost::optional< comma::uint32 >& next = boost::none )
+    {
+        read_filter_block_( next );
+        traits< K, Strict >::loaded( filter_map );
+    }
+
+    static void read_filter_block_( const boost::optional< comma::uint32 >& next )
+    {
+        comma::csv::input_stream< input< K > >& filter_stream = join_impl_::filter_stream();
         static const input< K >* last = filter_stream.read();
         filter_map.clear();
         if( !last ) { return; }
+        if( next && filter_index && last->block < *next ) // filter indexed by block, thus sorted by block: skip to the next stdin block
+        {
+            std::streamoff offset = filter_index->lower_bound( *next );
+            if( offset > ( *filter_transport )->tellg() ) { ( *filter_transport )->seekg( offset ); last = filter_stream.read(); }
+            while( last && last->block < *next ) { last = filter_stream.read(); }
+            if( !last ) { return; }
+        }
         block = last->block;
         comma::uint64 count = 0;
         static comma::signal_flag is_shutdown( comma::signal_flag::hard );
         while( last->block == block && !is_shutdown )
         {
-            typename traits< K, Strict >::map::mapped_type& d = filter_map[ *last ];
-            if( filter_stream.is_binary() )
-            {
-                typename traits< K, Strict >::map::mapped_type& d = filter_map[ *last ];
-                d.push_back( std::string() );
-                d.back().resize( filter_csv.format().size() );
-                ::memcpy( &d.back()[0], filter_stream.binary().last(), filter_csv.format().size() );
-            }
-            else
-            {
-                d.push_back( comma::join( filter_stream.ascii().last(), stdin_csv.delimiter ) );
-            }
+            append_last_filter_record( *last );
             if( verbose ) { ++count; if( count % 10000 == 0 ) { std::cerr << "csv-join: reading block " << block << "; loaded " << count << " point" << ( count == 1 ? "" : "s" ) << "; hash map size: " << filter_map.size() << std::endl; } }
             //if( ( *filter_transport )->good() && !( *filter_transport )->eof() ) { break; }
             last = filter_stream.read();
@@ -337,6 +516,51 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
         if( verbose ) { std::cerr << "csv-join: read block " << block << " of " << count << " point" << ( count == 1 ? "" : "s" ) << "; hash map size: " << filter_map.size() << std::endl; }
     }
 
+    /// stdin record with its matches in filter
+    struct record
+    {
+        input< K > key;
+        std::string data;
+        typename traits< K, Strict >::matches matches;
+
+        void set( comma::csv::input_stream< input< K > >& stream, const input< K >& p )
+        {
+            key = p;
+            if( stream.is_binary() ) { data.assign( stream.binary().last(), stdin_csv.format().size() ); }
+            else { data = comma::join( stream.ascii().last(), stdin_csv.delimiter ); }
+        }
+    };
+
+    /// --threads: read a batch of stdin records of the same block and find their matches in parallel; output stays in input order
+    static bool read_batch( comma::csv::input_stream< input< K > >& stream, std::vector< record >& batch, unsigned int threads )
+    {
+        static const std::size_t size = 65536;
+        static record ahead;
+        static bool has_ahead = false;
+        batch.resize( size );
+        std::size_t count = 0;
+        if( has_ahead ) { std::swap( batch[ count++ ], ahead ); has_ahead = false; }
+        while( count < size && ( stream.ready() || std::cin.good() ) )
+        {
+            const input< K >* p = stream.read();
+            if( !p ) { break; }
+            if( count > 0 && p->block != batch[0].key.block ) { ahead.set( stream, *p ); has_ahead = true; break; }
+            batch[ count++ ].set( stream, *p );
+        }
+        batch.resize( count );
+        if( count == 0 ) { return false; }
+        if( block != batch[0].key.block ) { read_filter_block( batch[0].key.block ); }
+        std::size_t chunk = ( count + threads - 1 ) / threads;
+        std::vector< std::thread > workers;
+        for( std::size_t begin = 0; begin < count; begin += chunk )
+        {
+            std::size_t end = std::min( begin + chunk, count );
+            workers.push_back( std::thread( [&batch,begin,end]() { for( std::size_t i = begin; i < end; ++i ) { traits< K, Strict >::find( filter_map, batch[i].key, nearest, batch[i].matches ); } } ) );
+        }
+        for( std::size_t i = 0; i < workers.size(); ++i ) { workers[i].join(); }
+        return true;
+    }
+
     static int run( const comma::command_line_options& options )
     {
         std::vector< std::string > v = comma::split( stdin_csv.fields, ',' );
@@ -350,6 +574,11 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
             if( w[k] == "next_state" ) { got_next_state = true; continue; }
         }
         bool is_state_machine = got_state && got_next_state;
+        bool sorted = options.exists( "--sorted" );
+        unsigned int threads = options.value< unsigned int >( "--threads", 1 );
+        if( threads == 0 ) { threads = std::max( std::thread::hardware_concurrency(), 1u ); }
+        if( threads > 1 && ( Strict || is_state_machine ) ) { threads = 1; }
+        if( sorted && is_state_machine ) { std::cerr << "csv-join: --sorted: finite state machine not supported" << std::endl; return 1; }
         std::size_t default_input_keys_count = 0;
         bool no_stdin_key_fields = true;
         bool no_filter_key_fields = true;
@@ -368,6 +597,7 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
             }
         }
         bool do_full_join = no_stdin_key_fields && no_filter_key_fields;
+        if( sorted && do_full_join ) { std::cerr << "csv-join: --sorted: please specify key fields" << std::endl; return 1; }
         if( default_input_keys_count == 0 && !do_full_join ) { std::cerr << "csv-join: please specify at least one common key; fields: " << stdin_csv.fields << "; filter fields: " << filter_csv.fields << std::endl; return 1; }
         //if( default_input_keys_count == 0 ) { std::cerr << "csv-join: please specify at least one common key; fields: " << stdin_csv.fields << "; filter fields: " << filter_csv.fields << std::endl; return 1; }
         K state = options.value< K >( "--initial-state,--state", K() );
@@ -388,55 +618,72 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
         }
         comma::csv::input_stream< input< K > > stdin_stream( std::cin, stdin_csv, default_input );
         filter_transport.reset( new comma::io::istream( filter_csv.filename, filter_csv.binary() ? comma::io::mode::binary : comma::io::mode::ascii ) );
+        if( options.exists( "--use-index" ) && filter_csv.filename != "-" ) { filter_index = comma::csv::index::load( filter_csv.filename, filter_csv, "block" ); }
         if( filter_transport->fd() == comma::io::invalid_file_descriptor ) { std::cerr << "csv-join: failed to open \"" << filter_csv.filename << "\"" << std::endl; return 1; }
         std::size_t discarded = 0;
-        read_filter_block();
+        if( !sorted ) { read_filter_block(); }
         #ifdef WIN32
         if( stdin_stream.is_binary() ) { _setmode( _fileno( stdout ), _O_BINARY ); }
         #endif
-        while( stdin_stream.ready() || std::cin.good() )
+        record r;
+        std::vector< record > batch;
+        std::size_t next = 0;
+        while( true )
         {
-            const input< K >* p = stdin_stream.read();
-            if( !p ) { break; }
-            if( block != p->block ) { read_filter_block(); }
-            typename traits< K, Strict >::pair pair;
-            if( is_state_machine )
+            const record* q = &r;
+            if( threads > 1 )
             {
-                input< K > q( *p );
-                q.keys[ state_index ] = state;
-                pair = traits< K, Strict >::find( filter_map, q, false );
+                if( next == batch.size() ) { std::cout.flush(); if( !read_batch( stdin_stream, batch, threads ) ) { break; } next = 0; }
+                q = &batch[ next++ ];
             }
             else
             {
-                pair = traits< K, Strict >::find( filter_map, *p, nearest );
+                if( !stdin_stream.ready() && !std::cin.good() ) { break; }
+                const input< K >* p = stdin_stream.read();
+                if( !p ) { break; }
+                if( sorted ) { read_filter_run( *p ); }
+                else if( block != p->block ) { read_filter_block( p->block ); }
+                r.set( stdin_stream, *p );
+                if( is_state_machine )
+                {
+                    input< K > k( *p );
+                    k.keys[ state_index ] = state;
+                    traits< K, Strict >::find( filter_map, k, false, r.matches );
+                }
+                else
+                {
+                    traits< K, Strict >::find( filter_map, *p, nearest, r.matches );
+                }
             }
-            if( pair.first == filter_map.end() ) // if( it == filter_map.end() || it->second.empty() )
+            const std::string& data = q->data;
+            if( q->matches.empty() ) // if( it == filter_map.end() || it->second.empty() )
             {
                 if( not_matching )
                 {
-                    if( stdin_stream.is_binary() ) { std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); }
-                    else { std::cout << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ) << std::endl; }
+                    if( stdin_stream.is_binary() ) { std::cout.write( &data[0], data.size() ); }
+                    else { std::cout << data << std::endl; }
                     continue;
                 }
                 if ( flag_matching )
                 {
                     if( stdin_stream.is_binary() ) { 
-                        std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); 
+                        std::cout.write( &data[0], data.size() ); 
                         char match = 0; std::cout.write( &match, 1 );
                     }
-                    else { std::cout << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ) << stdin_csv.delimiter << 0 << std::endl; }
+                    else { std::cout << data << stdin_csv.delimiter << 0 << std::endl; }
                     continue;
                 }
                 if( !strict ) { ++discarded; continue; }
                 std::string s;
                 comma::csv::options c;
                 c.fields = "keys";
-                std::cerr << "csv-join: match not found for key(s): " << comma::csv::ascii< input< K > >( c, default_input ).put( *p, s ) << ", block: " << block << std::endl;
+                std::cerr << "csv-join: match not found for key(s): " << comma::csv::ascii< input< K > >( c, default_input ).put( q->key, s ) << ", block: " << block << std::endl;
                 return 1;
             }
             if( not_matching ) { continue; }
-            for( typename traits< K, Strict >::map::const_iterator it = pair.first; it != pair.second; ++it )
+            for( std::size_t m = 0; m < q->matches.size(); ++m )
             {
+                typename traits< K, Strict >::map::const_iterator it = q->matches[m];
                 if( unique && it->second.size() > 1 )
                 {
                     if( strict ) { std::cerr << "csv-join: with --unique option, expected unique entries, got more than one filter entry on the key: " << keys_as_string( it->first ) << std::endl; return 1; }
@@ -447,21 +694,21 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
                 {
                     for( std::size_t i = 0; i < ( first_matching || unique ? 1 : it->second.size() ); ++i )
                     {
-                        if( !swap_output ) { std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); }
+                        if( !swap_output ) { std::cout.write( &data[0], data.size() ); }
                         if( is_state_machine ) { state = it->first.next_state; }
                         if( flag_matching ) { char match = 1; std::cout.write( &match, 1 ); break; }
                         if( matching ) { break; }
                         std::cout.write( &( it->second[i][0] ), filter_csv.format().size() );
-                        if( swap_output ) { std::cout.write( stdin_stream.binary().last(), stdin_csv.format().size() ); }
-                        std::cout.flush();
+                        if( swap_output ) { std::cout.write( &data[0], data.size() ); }
+                        if( threads < 2 ) { std::cout.flush(); }
                     }
-                    std::cout.flush();
+                    if( threads < 2 ) { std::cout.flush(); }
                 }
                 else
                 {
                     for( std::size_t i = 0; i < ( first_matching || unique ? 1 : it->second.size() ); ++i )
                     {
-                        if( !swap_output ) { std::cout << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ); }
+                        if( !swap_output ) { std::cout << data; }
                         if( is_state_machine ) { state = it->first.next_state; }
                         if( flag_matching ) { std::cout << stdin_csv.delimiter << 1 << std::endl; break; }
                         if( matching ) { std::cout << std::endl; break; }
@@ -469,13 +716,13 @@ template < typename K, bool Strict = true > struct join_impl_ // quick and dirty
                         std::cout << ( filter_csv.binary()
                                      ? filter_csv.format().bin_to_csv( &it->second[i][0], stdin_csv.delimiter )
                                      : it->second[i] );
-                        if( swap_output ) { std::cout << stdin_csv.delimiter << comma::join( stdin_stream.ascii().last(), stdin_csv.delimiter ); }
+                        if( swap_output ) { std::cout << stdin_csv.delimiter << data; }
                         std::cout << std::endl;
                     }
                 }
                 if( first_matching ) { break; }
             }
-            if( first_matching ) { filter_map.erase( pair.first, pair.second ); }
+            if( first_matching ) { for( std::size_t m = 0; m < q->matches.size(); ++m ) { filter_map.erase( q->matches[m] ); } }
         }
         if( verbose ) { std::cerr << "csv-join: discarded " << discarded << " " << ( discarded == 1 ? "entry" : "entries" ) << " with no matches" << std::endl; }
         return 0;
@@ -501,11 +748,13 @@ int main( int ac, char** av )
         nearest = options.exists( "--nearest" );
         swap_output = options.exists( "--swap-output,--swap" );
         if( nearest && !radius ) { std::cerr << "csv-join: if using --nearest, please specify --radius" << std::endl; return 1; }
+        if( radius && *radius < 0 ) { std::cerr << "csv-join: expected non-negative --radius, got " << *radius << std::endl; return 1; }
         options.assert_mutually_exclusive( "--matching,--not-matching,--flag-matching,--swap-output,--swap" );
         options.assert_mutually_exclusive( "--radius,--epsilon,--first-matching" );
+        options.assert_mutually_exclusive( "--radius,--epsilon,--sorted" );
         options.assert_mutually_exclusive( "--radius,--epsilon,--string,-s,--double,--time" );
         stdin_csv = comma::csv::options( options );
-        std::vector< std::string > unnamed = options.unnamed( "--verbose,-v,--first-matching,--matching,--not-matching,--string,-s,--time,--double,--strict,--swap-output,--swap", "-.*" );
+        std::vector< std::string > unnamed = options.unnamed( "--verbose,-v,--first-matching,--matching,--not-matching,--flag-matching,--nearest,--unique,--unique-matches,--string,-s,--time,--double,--strict,--swap-output,--swap,--sorted,--use-index", "-.*" );
         if( unnamed.empty() ) { std::cerr << "csv-join: please specify the second source" << std::endl; return 1; }
         if( unnamed.size() > 1 ) { std::cerr << "csv-join: expected one file or stream to join, got " << comma::join( unnamed, ' ' ) << std::endl; return 1; }
         comma::name_value::parser parser( "filename", ';', '=', false );
@@ -517,8 +766,10 @@ int main( int ac, char** av )
                ? join_impl_< std::string, true >::run( options )
                : options.exists( "--double" )
                ? join_impl_< double, true >::run( options )
-               : radius
+               : radius && *radius > 0
                ? join_impl_< double, false >::run( options )
+               : radius // radius 0: exact match of keys as floating point numbers
+               ? join_impl_< double, true >::run( options )
                : join_impl_< comma::int64, true >::run( options );
     }
     catch( std::exception& ex ) { std::cerr << "csv-join: " << ex.what() << std::endl; }
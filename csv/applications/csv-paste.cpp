@@ -71,6 +71,7 @@ static void usage( bool verbose )
     std::cerr << std::endl;
     std::cerr << "options" << std::endl;
     std::cerr << "    --delimiter,-d <delimiter> : default ','" << std::endl;
+    std::cerr << "    --flush : flush stdout after each ascii line; binary output is always flushed" << std::endl;
     std::cerr << "    --help,-h : help, --help --verbose for more help" << std::endl;
     std::cerr << "    --verbose,-v; more debug output" << std::endl;
     std::cerr << std::endl;
@@ -258,6 +259,7 @@ int main( int ac, char** av )
     {
         comma::command_line_options options( ac, av, usage );
         char delimiter = options.value( "--delimiter,-d", ',' );
+        bool flush = options.exists( "--flush" );
         std::vector< std::string > unnamed = options.unnamed( "--flush,--index,--reverse", "--delimiter,-d,--begin,--size,--block-size" );
         boost::ptr_vector< source > sources;
         bool is_binary = false;
@@ -331,7 +333,8 @@ int main( int ac, char** av )
                     if( i > 0 ) { oss << delimiter; }
                     oss << *s;
                 }
-                std::cout << oss.str() << std::endl;
+                std::cout << oss.str() << '\n';
+                if( flush ) { std::cout.flush(); }
             }
         }
         return 0;
@@ -114,6 +114,8 @@ static void usage()
     std::cerr << "                           default 0.01" << std::endl;
     std::cerr << "    --from <timestamp> : play back data starting at <timestamp> ( iso format )" << std::endl;
     std::cerr << "    --to <timestamp> : play back data up to <timestamp> ( iso format )" << std::endl;
+    std::cerr << "        binary input from regular files is assumed to be sorted by time: the records" << std::endl;
+    std::cerr << "        between --from and --to are found by bisection rather than by reading the files" << std::endl;
     std::cerr << comma::csv::format::usage();
     std::cerr << std::endl;
     std::cerr << "output" << std::endl;
@@ -317,7 +319,7 @@ int main( int argc, char** argv )
         std::string to = options.value< std::string>( "--to", "" );
         bool quiet =  options.exists( "--quiet" );
         bool flush =  !options.exists( "--no-flush" );
-        std::vector< std::string > configstrings = options.unnamed( "--verbose,-v,--interactive,-i,--paused,--paused-at-start,--quiet,--flush,--no-flush","--pause-at,--slow,--slowdown,--speed,--resolution,--binary,--fields,--clients,--from,--to" );
+        std::vector< std::string > configstrings = options.unnamed( "--verbose,-v,--interactive,-i,--paused,--paused-at-start,--quiet,--flush,--no-flush," + comma::csv::options::valueless_options(), "--pause-at,--slow,--slowdown,--speed,--resolution,--binary,--fields,--clients,--from,--to" );
         if( configstrings.empty() ) { configstrings.push_back( "-;-" ); }
         comma::csv::options csvoptions( argc, argv );
         comma::name_value::parser name_value("filename,output", ';', '=', false );
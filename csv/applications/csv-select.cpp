@@ -30,6 +30,18 @@
 
 /// @author vsevolod vlaskine
 
+#ifdef WIN32
+#include <stdio.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <map>
@@ -41,7 +53,11 @@
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
+#include "../../base/last_error.h"
+#include "../../csv/index.h"
 #include "../../csv/stream.h"
+#include "../../csv/impl/iso_time.h"
+#include "../../csv/impl/tokenized_line.h"
 #include "../../csv/impl/unstructured.h"
 #include "../../math/compare.h"
 #include "../../name_value/parser.h"
@@ -63,8 +79,15 @@ void usage()
     std::cerr << "    --from,--greater-or-equal,--ge=<value>: from <value> (inclusive, i.e. greater or equals)" << std::endl;
     std::cerr << "    --to,--less-or-equal,--le=<value>: to <value> (inclusive, i.e. less or equals)" << std::endl;
     std::cerr << "    --regex=<regex>: posix regular expression, string fields only" << std::endl;
+    std::cerr << "    --where=<expression>: select records matching boolean expression on named fields, e.g:" << std::endl;
+    std::cerr << "                          --fields=x,y,name,t --where=\"x > 1 && ( y <= 2 || name =~ 'ab.*' ) && t >= 20170101T000000\"" << std::endl;
+    std::cerr << "                          comparisons: ==, =, !=, <, <=, >, >=; regex match for string fields: =~, !~" << std::endl;
+    std::cerr << "                          a comparison is between a field and a value or between two fields of the same type" << std::endl;
+    std::cerr << "                          values: numbers, times as in iso format, strings in single or double quotes" << std::endl;
+    std::cerr << "                          boolean operators: && or 'and', || or 'or', ! or 'not', parentheses" << std::endl;
+    std::cerr << "                          the expression is parsed once; binary records are evaluated directly on the record buffer" << std::endl;
+    std::cerr << "                          cannot be used with other constraints; --sorted is ignored" << std::endl;
     std::cerr << std::endl;
-    std::cerr << "      todo: implement a simple boolean expression grammar" << std::endl;
     std::cerr << "input/output control options" << std::endl;
     std::cerr << "    --first-matching: output the first record matching the expression, then exit" << std::endl;
     std::cerr << "    --format=<format>: explicitly specify input format, in case if in ascii mode csv-select guesses incorrectly" << std::endl;
@@ -75,6 +98,12 @@ void usage()
     std::cerr << "              attention: this key is applied only to the common constraints, e.g. in the following example" << std::endl;
     std::cerr << "                         --sorted will be applied to the condition --less=2, but NOT to the condition \"x;less=1\"" << std::endl;
     std::cerr << "                         csv-select --less=2 --sorted --fields x \"x;less=1\"" << std::endl;
+    std::cerr << "              if binary input is a regular file (e.g. csv-select ... < a.bin), seek to the first" << std::endl;
+    std::cerr << "              possibly matching record by bisection instead of reading from the beginning" << std::endl;
+    std::cerr << "              (unless --output-all or --not-matching)" << std::endl;
+    std::cerr << "              if input is redirected from a file indexed with csv-index on a sorted field, e.g." << std::endl;
+    std::cerr << "              csv-select --fields=,t --from=20170101T000000 --sorted < a.csv, use the index to skip" << std::endl;
+    std::cerr << "              to the first possibly matching record (unless --or, --output-all, or --not-matching)" << std::endl;
     std::cerr << "    --strict: if constraint field is not present among fields, exit with error (added for backward compatibility)" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
     std::cerr << "    --or: uses 'or' expression instead of 'and' (default is 'and')" << std::endl;
@@ -90,6 +119,7 @@ void usage()
     std::cerr << "    cat xyz.csv | csv-select --fields=x,y,z \"x;from=1;to=2\" \"y;from=-1;to=1.1\" \"z;from=5;to=5.5\"" << std::endl;
     std::cerr << "    cat a.csv | csv-select --fields=t,scalar \"t;from=20120101T000000;sorted\" \"scalar;from=-10;to=20.5\"" << std::endl;
     std::cerr << "    echo hello,world | csv-select --fields=h,w \"h;regex=he.*\"" << std::endl;
+    std::cerr << "    cat xyz.csv | csv-select --fields=x,y,z --where=\"( x >= 1 && x <= 2 ) || z < y\"" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
     std::cerr << std::endl;
@@ -173,6 +203,25 @@ struct constraints
         // todo: more?
         return false;
     }
+
+    boost::optional< T > lower() const // lowest value that can match in sorted input
+    {
+        boost::optional< T > l;
+        if( !sorted ) { return l; }
+        if( from ) { l = *from; }
+        if( greater && ( !l || comma::math::less( *l, *greater ) ) ) { l = *greater; }
+        if( equals && ( !l || comma::math::less( *l, *equals ) ) ) { l = *equals; }
+        return l;
+    }
+
+    bool before( const T& t ) const // true, if neither this nor any preceding value in sorted input can match
+    {
+        if( !sorted ) { return false; }
+        if( from && comma::math::less( t, *from ) ) { return true; }
+        if( greater && !comma::math::less( *greater, t ) ) { return true; }
+        if( equals && comma::math::less( t, *equals ) ) { return true; }
+        return false;
+    }
 };
 
 static bool default_constraints_empty( const comma::command_line_options& options ) // quick and dirty
@@ -209,6 +258,30 @@ struct constrained
         for( unsigned int i = 0; i < constraints.size(); ++i ) { if( !this->constraints[i].done( value ) ) { return false; } }
         return true;
     }
+
+    bool before( bool is_or = false ) const
+    {
+        if( constraints.empty() ) { return is_or; }
+        for( unsigned int i = 0; i < constraints.size(); ++i ) { if( this->constraints[i].before( value ) != is_or ) { return !is_or; } }
+        return is_or;
+    }
+
+    bool sorted() const
+    {
+        for( unsigned int i = 0; i < constraints.size(); ++i ) { if( constraints[i].sorted ) { return true; } }
+        return false;
+    }
+
+    boost::optional< T > lower() const // lowest value that can match in sorted input, 'and' expression only
+    {
+        boost::optional< T > l;
+        for( unsigned int i = 0; i < constraints.size(); ++i )
+        {
+            const boost::optional< T >& c = constraints[i].lower();
+            if( c && ( !l || comma::math::less( *l, *c ) ) ) { l = c; }
+        }
+        return l;
+    }
 };
 
 struct input_t
@@ -257,6 +330,39 @@ struct input_t
             return false;
         }
     }
+
+    bool before( bool is_or ) const // true, if the record and all records preceding it in sorted input cannot match
+    {
+        if( is_or )
+        {
+            for( unsigned int i = 0; i < time.size(); ++i ) { if( !time[i].before( is_or ) ) { return false; } }
+            for( unsigned int i = 0; i < doubles.size(); ++i ) { if( !doubles[i].before( is_or ) ) { return false; } }
+            for( unsigned int i = 0; i < strings.size(); ++i ) { if( !strings[i].before( is_or ) ) { return false; } }
+            return sorted();
+        }
+        else
+        {
+            for( unsigned int i = 0; i < time.size(); ++i ) { if( time[i].before() ) { return true; } }
+            for( unsigned int i = 0; i < doubles.size(); ++i ) { if( doubles[i].before() ) { return true; } }
+            for( unsigned int i = 0; i < strings.size(); ++i ) { if( strings[i].before() ) { return true; } }
+            return false;
+        }
+    }
+
+    bool sorted() const
+    {
+        for( unsigned int i = 0; i < time.size(); ++i ) { if( time[i].sorted() ) { return true; } }
+        for( unsigned int i = 0; i < doubles.size(); ++i ) { if( doubles[i].sorted() ) { return true; } }
+        for( unsigned int i = 0; i < strings.size(); ++i ) { if( strings[i].sorted() ) { return true; } }
+        return false;
+    }
+};
+
+struct before_match
+{
+    bool is_or;
+    before_match( bool is_or ) : is_or( is_or ) {}
+    bool operator()( const input_t& p ) const { return p.before( is_or ); }
 };
 
 namespace comma { namespace visiting {
@@ -341,6 +447,431 @@ static void init_input( const comma::csv::format& format, const comma::command_l
     csv.full_xpath = true;
 }
 
+static boost::optional< double > lower_key( const comma::csv::index& index ) // quick and dirty
+{
+    if( index.column >= fields.size() ) { return boost::none; }
+    const std::string& f = fields[index.column];
+    std::string::size_type b = f.find( '[' );
+    std::string::size_type e = f.find( ']' );
+    if( b == std::string::npos || e == std::string::npos ) { return boost::none; }
+    unsigned int k = boost::lexical_cast< unsigned int >( f.substr( b + 1, e - b - 1 ) );
+    if( f.substr( 0, b ) == "t" )
+    {
+        if( !index.time ) { COMMA_THROW( comma::exception, "expected index on time for field " << ( index.column + 1 ) << ", got numeric index; rebuild it with csv-index" ); }
+        const boost::optional< boost::posix_time::ptime >& l = input.time[k].lower();
+        if( l ) { return comma::csv::index::key( *l ); }
+    }
+    else if( f.substr( 0, b ) == "doubles" )
+    {
+        if( index.time ) { COMMA_THROW( comma::exception, "expected numeric index for field " << ( index.column + 1 ) << ", got index on time; rebuild it with csv-index" ); }
+        return input.doubles[k].lower();
+    }
+    return boost::none;
+}
+
+/// --where expression: parsed once into a tree of comparisons on field slots resolved to
+/// format offsets and types; binary records are evaluated directly on the buffer, ascii
+/// records convert only the fields the evaluation actually reaches
+namespace where {
+
+struct slot
+{
+    enum kinds { number, time, string };
+    kinds kind;
+    std::size_t index; // field index in input
+    comma::csv::format::element element;
+    double ( *number_from_bin )( const char* );
+};
+
+template < typename T > static double number_from_bin_( const char* buf ) { return comma::csv::format::traits< T >::from_bin( buf ); }
+
+static slot make_slot( std::size_t index, const comma::csv::format::element& e )
+{
+    slot s;
+    s.index = index;
+    s.element = e;
+    s.number_from_bin = NULL;
+    s.kind = slot::number;
+    switch( e.type )
+    {
+        case comma::csv::format::char_t: case comma::csv::format::int8: s.number_from_bin = &number_from_bin_< char >; break;
+        case comma::csv::format::uint8: s.number_from_bin = &number_from_bin_< unsigned char >; break;
+        case comma::csv::format::int16: s.number_from_bin = &number_from_bin_< comma::int16 >; break;
+        case comma::csv::format::uint16: s.number_from_bin = &number_from_bin_< comma::uint16 >; break;
+        case comma::csv::format::int32: s.number_from_bin = &number_from_bin_< comma::int32 >; break;
+        case comma::csv::format::uint32: s.number_from_bin = &number_from_bin_< comma::uint32 >; break;
+        case comma::csv::format::int64: s.number_from_bin = &number_from_bin_< comma::int64 >; break;
+        case comma::csv::format::uint64: s.number_from_bin = &number_from_bin_< comma::uint64 >; break;
+        case comma::csv::format::float_t: s.number_from_bin = &number_from_bin_< float >; break;
+        case comma::csv::format::double_t: s.number_from_bin = &number_from_bin_< double >; break;
+        case comma::csv::format::time: case comma::csv::format::long_time: s.kind = slot::time; break;
+        case comma::csv::format::fixed_string: s.kind = slot::string; break;
+    }
+    return s;
+}
+
+/// record as binary buffer
+class binary_record
+{
+    public:
+        binary_record( const std::vector< slot >& slots ) : slots_( slots ), buf_( NULL ) {}
+        void set( const char* buf ) { buf_ = buf; }
+        double number( std::size_t i ) const { return slots_[i].number_from_bin( buf_ + slots_[i].element.offset ); }
+        boost::posix_time::ptime time( std::size_t i ) const
+        {
+            const slot& s = slots_[i];
+            return s.element.type == comma::csv::format::time ? comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::from_bin( buf_ + s.element.offset )
+                                                              : comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::long_time >::from_bin( buf_ + s.element.offset );
+        }
+        std::string string( std::size_t i ) const { return comma::csv::format::traits< std::string, comma::csv::format::fixed_string >::from_bin( buf_ + slots_[i].element.offset, slots_[i].element.size ); }
+
+    private:
+        const std::vector< slot >& slots_;
+        const char* buf_;
+};
+
+/// record as line split in place into fields
+class ascii_record
+{
+    public:
+        ascii_record( const std::vector< slot >& slots ) : slots_( slots ), values_( NULL ) {}
+        void set( const comma::csv::impl::tokenized_line& values ) { values_ = &values; }
+        double number( std::size_t i ) const
+        {
+            const char* s = value_( i );
+            char* end;
+            double d = std::strtod( s, &end );
+            if( end == s || *end ) { COMMA_THROW( comma::exception, "expected number in field " << ( slots_[i].index + 1 ) << ", got \"" << s << "\"" ); }
+            return d;
+        }
+        boost::posix_time::ptime time( std::size_t i ) const
+        {
+            const char* s = value_( i );
+            comma::int64 microseconds;
+            if( !comma::csv::impl::iso_time::parse( s, values_->size( slots_[i].index ), microseconds ) ) { return boost::posix_time::from_iso_string( s ); }
+            return comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::from_bin( reinterpret_cast< const char* >( &microseconds ) );
+        }
+        std::string string( std::size_t i ) const { return std::string( value_( i ), values_->size( slots_[i].index ) ); }
+
+    private:
+        const std::vector< slot >& slots_;
+        const comma::csv::impl::tokenized_line* values_;
+        const char* value_( std::size_t i ) const
+        {
+            if( slots_[i].index >= values_->size() ) { COMMA_THROW( comma::exception, "expected at least " << ( slots_[i].index + 1 ) << " fields, got " << values_->size() ); }
+            return ( *values_ )[ slots_[i].index ];
+        }
+};
+
+class expression
+{
+    public:
+        /// parse expression on given fields and format
+        expression( const std::string& s, const std::vector< std::string >& fields, const comma::csv::format& format )
+            : string_( s )
+            , fields_( fields )
+            , format_( format )
+            , position_( 0 )
+        {
+            next_();
+            root_ = parse_or_();
+            if( token_.type != token::end ) { error_( "unexpected '" + token_.value + "'" ); }
+        }
+
+        template < typename R > bool operator()( const R& r ) const { return evaluate_( root_, r ); }
+
+        const std::vector< slot >& slots() const { return slots_; }
+
+    private:
+        struct token
+        {
+            enum types { end, word, quoted, op, left, right, and_, or_, not_ };
+            types type;
+            std::string value;
+            token( types type = end, const std::string& value = "" ) : type( type ), value( value ) {}
+        };
+        struct node
+        {
+            enum types { and_, or_, not_, compare };
+            enum operators { equal, not_equal, less, less_or_equal, greater, greater_or_equal, matches, not_matches };
+            types type;
+            std::size_t left;
+            std::size_t right;
+            operators op;
+            slot::kinds kind;
+            std::size_t lhs; // slot
+            boost::optional< std::size_t > rhs; // slot, if comparing two fields, otherwise constant below
+            double number;
+            boost::posix_time::ptime time;
+            std::string string;
+            boost::optional< boost::regex > regex;
+        };
+        std::string string_;
+        std::vector< std::string > fields_;
+        comma::csv::format format_;
+        std::size_t position_;
+        token token_;
+        std::vector< node > nodes_;
+        std::vector< slot > slots_;
+        std::size_t root_;
+
+        void error_( const std::string& what ) const { COMMA_THROW( comma::exception, "--where: " << what << " at position " << position_ << " in: " << string_ ); }
+
+        static bool is_word_char_( char c ) { return std::isalnum( static_cast< unsigned char >( c ) ) || c == '_' || c == '.' || c == '/' || c == '[' || c == ']' || c == ':'; }
+
+        void next_()
+        {
+            const std::string& s = string_;
+            while( position_ < s.size() && std::isspace( static_cast< unsigned char >( s[position_] ) ) ) { ++position_; }
+            if( position_ == s.size() ) { token_ = token(); return; }
+            char c = s[position_];
+            char d = position_ + 1 < s.size() ? s[ position_ + 1 ] : 0;
+            if( c == '(' ) { ++position_; token_ = token( token::left, "(" ); return; }
+            if( c == ')' ) { ++position_; token_ = token( token::right, ")" ); return; }
+            if( c == '&' && d == '&' ) { position_ += 2; token_ = token( token::and_, "&&" ); return; }
+            if( c == '|' && d == '|' ) { position_ += 2; token_ = token( token::or_, "||" ); return; }
+            if( c == '\'' || c == '"' )
+            {
+                std::string::size_type end = s.find( c, position_ + 1 );
+                if( end == std::string::npos ) { error_( "unterminated string" ); }
+                token_ = token( token::quoted, s.substr( position_ + 1, end - position_ - 1 ) );
+                position_ = end + 1;
+                return;
+            }
+            static const char* operators[] = { "==", "!=", "<=", ">=", "=~", "!~", "<", ">", "=", "!" };
+            for( unsigned int i = 0; i < sizeof( operators ) / sizeof( operators[0] ); ++i )
+            {
+                std::size_t size = std::strlen( operators[i] );
+                if( s.compare( position_, size, operators[i] ) != 0 ) { continue; }
+                position_ += size;
+                token_ = std::string( operators[i] ) == "!" ? token( token::not_, "!" ) : token( token::op, operators[i] );
+                return;
+            }
+            std::size_t begin = position_;
+            if( c == '-' || c == '+' ) { ++position_; } // sign of a number
+            while( position_ < s.size() && ( is_word_char_( s[position_] ) || ( ( s[position_] == '-' || s[position_] == '+' ) && ( s[ position_ - 1 ] == 'e' || s[ position_ - 1 ] == 'E' ) ) ) ) { ++position_; }
+            if( position_ == begin || ( position_ == begin + 1 && ( c == '-' || c == '+' ) ) ) { error_( std::string( "unexpected character '" ) + c + "'" ); }
+            std::string w = s.substr( begin, position_ - begin );
+            if( w == "and" ) { token_ = token( token::and_, w ); }
+            else if( w == "or" ) { token_ = token( token::or_, w ); }
+            else if( w == "not" ) { token_ = token( token::not_, w ); }
+            else { token_ = token( token::word, w ); }
+        }
+
+        std::size_t add_( const node& n ) { nodes_.push_back( n ); return nodes_.size() - 1; }
+
+        std::size_t binary_( node::types type, std::size_t left, std::size_t right ) { node n; n.type = type; n.left = left; n.right = right; return add_( n ); }
+
+        std::size_t parse_or_()
+        {
+            std::size_t n = parse_and_();
+            while( token_.type == token::or_ ) { next_(); n = binary_( node::or_, n, parse_and_() ); }
+            return n;
+        }
+
+        std::size_t parse_and_()
+        {
+            std::size_t n = parse_unary_();
+            while( token_.type == token::and_ ) { next_(); n = binary_( node::and_, n, parse_unary_() ); }
+            return n;
+        }
+
+        std::size_t parse_unary_()
+        {
+            if( token_.type == token::not_ ) { next_(); return binary_( node::not_, parse_unary_(), 0 ); }
+            if( token_.type == token::left )
+            {
+                next_();
+                std::size_t n = parse_or_();
+                if( token_.type != token::right ) { error_( "expected ')'" ); }
+                next_();
+                return n;
+            }
+            return parse_comparison_();
+        }
+
+        boost::optional< std::size_t > field_( const token& t )
+        {
+            if( t.type != token::word ) { return boost::none; }
+            for( std::size_t i = 0; i < fields_.size(); ++i )
+            {
+                if( fields_[i] != t.value ) { continue; }
+                if( i >= format_.count() ) { error_( "field '" + t.value + "' is not in format " + format_.string() ); }
+                for( std::size_t j = 0; j < slots_.size(); ++j ) { if( slots_[j].index == i ) { return j; } }
+                slots_.push_back( make_slot( i, format_.offset( i ) ) );
+                return slots_.size() - 1;
+            }
+            return boost::none;
+        }
+
+        static node::operators operator_( const std::string& s, bool swap )
+        {
+            if( s == "==" || s == "=" ) { return node::equal; }
+            if( s == "!=" ) { return node::not_equal; }
+            if( s == "<" ) { return swap ? node::greater : node::less; }
+            if( s == "<=" ) { return swap ? node::greater_or_equal : node::less_or_equal; }
+            if( s == ">" ) { return swap ? node::less : node::greater; }
+            if( s == ">=" ) { return swap ? node::less_or_equal : node::greater_or_equal; }
+            if( s == "=~" ) { return node::matches; }
+            return node::not_matches;
+        }
+
+        std::size_t parse_comparison_()
+        {
+            if( token_.type != token::word && token_.type != token::quoted ) { error_( "expected field or value" ); }
+            token lhs = token_;
+            next_();
+            if( token_.type != token::op ) { error_( "expected comparison operator after '" + lhs.value + "'" ); }
+            std::string op = token_.value;
+            next_();
+            if( token_.type != token::word && token_.type != token::quoted ) { error_( "expected field or value after '" + op + "'" ); }
+            token rhs = token_;
+            next_();
+            boost::optional< std::size_t > l = field_( lhs );
+            boost::optional< std::size_t > r = field_( rhs );
+            if( !l && !r ) { error_( "expected at least one of '" + lhs.value + "' and '" + rhs.value + "' to be a field" ); }
+            bool swap = !l;
+            if( swap ) { std::swap( l, r ); std::swap( lhs, rhs ); }
+            node n;
+            n.type = node::compare;
+            n.op = operator_( op, swap );
+            n.lhs = *l;
+            n.rhs = r;
+            n.kind = slots_[ *l ].kind;
+            if( n.op == node::matches || n.op == node::not_matches )
+            {
+                if( swap || r ) { error_( "expected <field> " + op + " '<regex>'" ); }
+                if( n.kind != slot::string ) { error_( "regex implemented only for strings, but field '" + lhs.value + "' is not a string" ); }
+                n.regex = boost::regex( rhs.value );
+                return add_( n );
+            }
+            if( r )
+            {
+                if( slots_[ *r ].kind != n.kind ) { error_( "cannot compare fields '" + lhs.value + "' and '" + rhs.value + "' of different types" ); }
+                return add_( n );
+            }
+            try
+            {
+                switch( n.kind )
+                {
+                    case slot::number: n.number = boost::lexical_cast< double >( rhs.value ); break;
+                    case slot::time: n.time = boost::posix_time::from_iso_string( rhs.value ); break;
+                    case slot::string: n.string = rhs.value; break;
+                }
+            }
+            catch( ... ) { error_( "could not convert '" + rhs.value + "' to the type of field '" + lhs.value + "'" ); }
+            return add_( n );
+        }
+
+        template < typename T > static bool compare_( node::operators op, const T& lhs, const T& rhs )
+        {
+            switch( op )
+            {
+                case node::equal: return lhs == rhs;
+                case node::not_equal: return lhs != rhs;
+                case node::less: return lhs < rhs;
+                case node::less_or_equal: return lhs <= rhs;
+                case node::greater: return lhs > rhs;
+                case node::greater_or_equal: return lhs >= rhs;
+                default: return false; // never here
+            }
+        }
+
+        template < typename R > bool evaluate_( std::size_t i, const R& r ) const
+        {
+            const node& n = nodes_[i];
+            switch( n.type )
+            {
+                case node::and_: return evaluate_( n.left, r ) && evaluate_( n.right, r );
+                case node::or_: return evaluate_( n.left, r ) || evaluate_( n.right, r );
+                case node::not_: return !evaluate_( n.left, r );
+                case node::compare: break;
+            }
+            switch( n.kind )
+            {
+                case slot::number: return compare_( n.op, r.number( n.lhs ), n.rhs ? r.number( *n.rhs ) : n.number );
+                case slot::time: return compare_( n.op, r.time( n.lhs ), n.rhs ? r.time( *n.rhs ) : n.time );
+                case slot::string:
+                    if( n.regex ) { return boost::regex_match( r.string( n.lhs ), *n.regex ) == ( n.op == node::matches ); }
+                    return compare_< std::string >( n.op, r.string( n.lhs ), n.rhs ? r.string( *n.rhs ) : n.string );
+            }
+            return false; // never here
+        }
+};
+
+static int run( const comma::command_line_options& options, const comma::csv::options& csv, const std::vector< std::string >& fields )
+{
+    bool first_matching = options.exists( "--first-matching" );
+    bool not_matching = options.exists( "--not-matching" );
+    bool all = options.exists( "--output-all,--all" );
+    if( csv.binary() )
+    {
+        #ifdef WIN32
+        _setmode( _fileno( stdin ), _O_BINARY );
+        _setmode( _fileno( stdout ), _O_BINARY );
+        #endif
+        expression e( options.value< std::string >( "--where" ), fields, csv.format() );
+        binary_record record( e.slots() );
+        std::size_t size = csv.format().size();
+        std::vector< char > buffer( size > 65536 ? size : 65536 / size * size );
+        std::size_t end = 0;
+        while( true )
+        {
+            int count = ::read( 0, &buffer[0] + end, buffer.size() - end );
+            if( count < 0 && errno == EINTR ) { continue; }
+            if( count < 0 ) { comma::last_error::to_exception( "failed to read stdin" ); }
+            if( count == 0 ) { if( end > 0 ) { COMMA_THROW( comma::exception, "expected " << size << " bytes; got " << end << " bytes in the last record" ); } break; }
+            end += count;
+            std::size_t begin = 0;
+            for( ; begin + size <= end; begin += size )
+            {
+                record.set( &buffer[0] + begin );
+                char match = ( e( record ) == !not_matching ) ? 1 : 0;
+                if( !match && !all ) { continue; }
+                std::cout.write( &buffer[0] + begin, size );
+                if( all ) { std::cout.write( &match, 1 ); }
+                if( first_matching ) { std::cout.flush(); return 0; }
+            }
+            if( csv.flush ) { std::cout.flush(); }
+            end -= begin;
+            if( end > 0 ) { ::memmove( &buffer[0], &buffer[0] + begin, end ); }
+        }
+        return 0;
+    }
+    std::string line;
+    boost::scoped_ptr< expression > e;
+    boost::scoped_ptr< ascii_record > record;
+    std::string buffer; // line tokenized in place
+    comma::csv::impl::tokenized_line values;
+    boost::optional< char > quote = options.exists( "--quote" ) ? csv.quote : boost::optional< char >( '"' ); // as comma::csv::options() default
+    while( std::cin.good() && !std::cin.eof() )
+    {
+        std::getline( std::cin, line );
+        line = comma::strip( line, '\r' ); // windows, sigh...
+        if( line.empty() ) { continue; }
+        if( !e )
+        {
+            comma::csv::format format = options.exists( "--format" ) ? comma::csv::format( options.value< std::string >( "--format" ) ) : comma::csv::impl::unstructured::guess_format( line, csv.delimiter );
+            if( !options.exists( "--format" ) ) { std::cerr << "csv-select: guessed format from the first input line: " << format.string() << "; if you think the guess is wrong, please specify --format" << std::endl; }
+            e.reset( new expression( options.value< std::string >( "--where" ), fields, format ) );
+            record.reset( new ascii_record( e->slots() ) );
+        }
+        buffer = line;
+        if( quote ) { values.split( buffer, csv.delimiter, *quote ); } else { values.split( buffer, csv.delimiter ); }
+        record->set( values );
+        bool match = ( *e )( *record ) == !not_matching;
+        if( !match && !all ) { continue; }
+        std::cout << line;
+        if( all ) { std::cout << csv.delimiter << match; }
+        std::cout << '\n';
+        if( csv.flush ) { std::cout.flush(); }
+        if( first_matching ) { return 0; }
+    }
+    return 0;
+}
+
+} // namespace where {
+
 int main( int ac, char** av )
 {
         comma::command_line_options options( ac, av );
@@ -352,7 +883,7 @@ int main( int ac, char** av )
         csv = comma::csv::options( options );
         fields = comma::split( csv.fields, ',' );
         if( fields.size() == 1 && fields[0].empty() ) { fields.clear(); }
-        std::vector< std::string > unnamed = options.unnamed( "--first-matching,--or,--sorted,--input-sorted,--not-matching,--output-all,--all,--strict,--verbose,-v", "-.*" );
+        std::vector< std::string > unnamed = options.unnamed( "--first-matching,--or,--sorted,--input-sorted,--not-matching,--output-all,--all,--strict,--verbose,-v," + comma::csv::options::valueless_options(), "-.*" );
         //for( unsigned int i = 0; i < unnamed.size(); constraints_map.insert( std::make_pair( comma::split( unnamed[i], ';' )[0], unnamed[i] ) ), ++i );
         bool strict = options.exists( "--strict" );
         bool first_matching = options.exists( "--first-matching" );
@@ -371,13 +902,21 @@ int main( int ac, char** av )
             }
             constraints_map.insert( std::make_pair( field, unnamed[i] ) );
         }
+        if( options.exists( "--where" ) )
+        {
+            if( !constraints_map.empty() || !default_constraints_empty( options ) ) { std::cerr << "csv-select: --where: cannot be used with other constraints" << std::endl; return 1; }
+            return where::run( options, csv, fields );
+        }
         if( csv.binary() )
         {
             #ifdef WIN32
             _setmode( _fileno( stdout ), _O_BINARY );
             #endif
             init_input( csv.format(), options );
+            bool seek = input.sorted() && !all && !not_matching;
+            if( seek ) { csv.mmap = true; } // on a regular file, skip to the first possible match by bisection
             comma::csv::binary_input_stream< input_t > istream( std::cin, csv, input );
+            if( seek && istream.mapped() ) { istream.seek( istream.partition_point( before_match( is_or ) ) ); }
             while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
             {
                 const input_t* p = istream.read();
@@ -418,9 +957,20 @@ int main( int ac, char** av )
             {
                 std::cout << line;
                 if( all ) { std::cout << csv.delimiter << match; }
-                std::cout << std::endl;
+                std::cout << '\n';
+                if( csv.flush ) { std::cout.flush(); }
                 if( first_matching ) { return 0; }
             }
+            if( !is_or && !all && !not_matching )
+            {
+                const boost::optional< comma::csv::index >& index = comma::csv::index::load( 0, csv );
+                const boost::optional< double >& key = index ? lower_key( *index ) : boost::none;
+                if( key )
+                {
+                    std::streamoff offset = index->lower_bound( *key );
+                    if( offset > std::cin.tellg() ) { std::cin.seekg( offset ); }
+                }
+            }
             while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
             {
                 const input_t* p = istream.read();
@@ -430,7 +980,8 @@ int main( int ac, char** av )
                 {
                     std::cout << comma::join( istream.last(), csv.delimiter );
                     if( all ) { std::cout << csv.delimiter << match; }
-                    std::cout << std::endl;
+                    std::cout << '\n';
+                    if( csv.flush ) { std::cout.flush(); }
                     if( first_matching ) { return 0; }
                 }
             }
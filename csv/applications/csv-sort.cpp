@@ -29,16 +29,26 @@
 
 /// @authors matthew imhoff, dewey nguyen, vsevolod vlaskine
 
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <algorithm>
 #include <deque>
+#include <fstream>
+#include <limits>
 #include <iostream>
 #include <map>
+#include <queue>
+#include <thread>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../base/exception.h"
@@ -66,6 +76,9 @@ static void usage( bool more )
     std::cerr << "           fields" << std::endl;
     std::cerr << "               id: if present, multiple id fields accepted; output first record for each set of ids in a given block; e.g. --fields=id,a,,id" << std::endl;
     std::cerr << "               block: if present; output minimum for each contiguous block" << std::endl;
+    std::cerr << "    --memory=<size>: external sort: sort in runs using at most about <size> bytes of memory, spill sorted runs" << std::endl;
+    std::cerr << "                     to temporary files and merge them; <size> may have suffix k, M, G, or T; e.g. --memory=4G" << std::endl;
+    std::cerr << "                     block, --reverse and --unique semantics are the same as for in-memory sort" << std::endl;
     std::cerr << "    --min: output only record(s) with minimum value for a given field." << std::endl;
     std::cerr << "           fields" << std::endl;
     std::cerr << "               id: if present, multiple id fields accepted; output minimum for each set of ids in a given block; e.g. --fields=id,a,,id" << std::endl;
@@ -76,8 +89,11 @@ static void usage( bool more )
     std::cerr << "    --order <fields>: order in which to sort fields; default is input field order" << std::endl;
     std::cerr << "    --reverse,--descending,-r: sort in reverse order" << std::endl;
     std::cerr << "    --sliding-window,--window=<size>: sort last <size> entries" << std::endl;
+    std::cerr << "    --temporary-directory=<dir>: directory for temporary files of --memory; default: $TMPDIR or /tmp" << std::endl;
     std::cerr << "    --string,-s: keys are strings; a quick and dirty option to support strings" << std::endl;
     std::cerr << "                 default: double" << std::endl;
+    std::cerr << "    --threads=<n>: number of threads for sorting; 0: use all cores; default: 1" << std::endl;
+    std::cerr << "                   if there are no string keys, records are radix-sorted, otherwise merge-sorted" << std::endl;
     std::cerr << "    --unique,-u: sort input, output only the first line matching given keys; if no sorting required, use --first for better performance" << std::endl;
     std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
     std::cerr << std::endl;
@@ -189,9 +205,6 @@ struct input_t
         }
         return false;
     }
-    
-    typedef std::map< input_t, std::vector< std::string > > map;
-    
 };
 
 struct input_with_block : public input_t
@@ -583,6 +596,428 @@ int handle_operations_with_ids( const comma::command_line_options& options )
     return 0;
 }
 
+namespace engine {
+
+/// records of a block in one arena and their sort keys in flat arrays; sorting permutes record indices
+/// numeric keys are encoded as unsigned integers preserving order, thus if there are no string keys, records are radix-sorted
+/// both radix and comparison sort are stable: records with equal keys remain in input order
+class records
+{
+    public:
+        records( bool reverse, unsigned int threads ) : reverse_( reverse ), threads_( threads ), numeric_width_( 0 ), strings_width_( 0 )
+        {
+            for( std::size_t i = 0; i < ordering.size(); ++i )
+            {
+                bool is_string = ordering[i].type == ordering_t::str_type;
+                columns_.push_back( std::make_pair( is_string, is_string ? strings_width_++ : numeric_width_++ ) );
+            }
+        }
+
+        /// add record; data: binary record or ascii line terminated with '\n'
+        void push( const input_t& key, const char* data, std::size_t size )
+        {
+            for( std::size_t i = 0; i < ordering.size(); ++i )
+            {
+                const comma::csv::impl::unstructured& k = key.keys;
+                switch( ordering[i].type )
+                {
+                    case ordering_t::str_type:
+                        strings_.push_back( std::make_pair( string_arena_.size(), k.strings[ ordering[i].index ].size() ) );
+                        string_arena_ += k.strings[ ordering[i].index ];
+                        break;
+                    case ordering_t::long_type: numeric_.push_back( encoded_( k.longs[ ordering[i].index ] ) ); break;
+                    case ordering_t::double_type: numeric_.push_back( encoded_( k.doubles[ ordering[i].index ] ) ); break;
+                    case ordering_t::time_type: numeric_.push_back( encoded_( k.time[ ordering[i].index ] ) ); break;
+                }
+            }
+            offsets_.push_back( arena_.size() );
+            arena_.append( data, size );
+        }
+
+        std::size_t size() const { return offsets_.size(); }
+
+        bool empty() const { return offsets_.empty(); }
+
+        /// approximate memory used, including what sort() will need
+        std::size_t bytes() const { return arena_.size() + string_arena_.size() + ( numeric_.size() + strings_.size() * 2 ) * sizeof( comma::uint64 ) + offsets_.size() * ( sizeof( std::size_t ) * 2 + sizeof( pair_t ) * 2 ); }
+
+        void sort()
+        {
+            order_.resize( size() );
+            for( std::size_t i = 0; i < order_.size(); order_[i] = i, ++i );
+            if( order_.size() < 2 ) { return; }
+            if( strings_width_ == 0 ) { radix_sort_(); } else { comparison_sort_(); }
+        }
+
+        /// write sorted records; if unique, write only the first of records with equal keys
+        void write( std::ostream& os, bool unique ) const
+        {
+            for( std::size_t k = 0; k < order_.size(); ++k )
+            {
+                std::size_t i = order_[k];
+                if( unique && k > 0 && equal_( order_[ k - 1 ], i ) ) { continue; }
+                os.write( &arena_[ offsets_[i] ], ( i + 1 == offsets_.size() ? arena_.size() : offsets_[ i + 1 ] ) - offsets_[i] );
+            }
+        }
+
+        void clear() // keeps capacity
+        {
+            arena_.clear();
+            offsets_.clear();
+            numeric_.clear();
+            string_arena_.clear();
+            strings_.clear();
+            order_.clear();
+        }
+
+    private:
+        struct pair_t { comma::uint64 key; std::size_t index; };
+
+        bool reverse_;
+        unsigned int threads_;
+        std::vector< std::pair< bool, std::size_t > > columns_; // is string, index in numeric or string keys
+        std::size_t numeric_width_;
+        std::size_t strings_width_;
+        std::string arena_;
+        std::vector< std::size_t > offsets_;
+        std::vector< comma::uint64 > numeric_;
+        std::string string_arena_;
+        std::vector< std::pair< std::size_t, std::size_t > > strings_; // offset, size in string arena
+        std::vector< std::size_t > order_;
+
+        static comma::uint64 encoded_( comma::int64 v ) { return comma::uint64( v ) ^ 0x8000000000000000ULL; }
+
+        static comma::uint64 encoded_( double v )
+        {
+            if( v == 0 ) { v = 0; } // -0 == 0
+            comma::uint64 u;
+            ::memcpy( &u, &v, sizeof( u ) );
+            return u & 0x8000000000000000ULL ? ~u : u | 0x8000000000000000ULL;
+        }
+
+        static comma::uint64 encoded_( const boost::posix_time::ptime& t )
+        {
+            static const boost::posix_time::ptime epoch( boost::gregorian::date( 1970, 1, 1 ) );
+            if( t.is_neg_infinity() ) { return 0; }
+            if( t.is_pos_infinity() ) { return ~comma::uint64( 0 ); }
+            if( t.is_not_a_date_time() ) { return ~comma::uint64( 0 ) - 1; }
+            return encoded_( comma::int64( ( t - epoch ).total_microseconds() ) );
+        }
+
+        int compare_string_( std::size_t i, std::size_t j, std::size_t column ) const
+        {
+            const std::pair< std::size_t, std::size_t >& a = strings_[ i * strings_width_ + column ];
+            const std::pair< std::size_t, std::size_t >& b = strings_[ j * strings_width_ + column ];
+            int c = string_arena_.compare( a.first, a.second, string_arena_, b.first, b.second );
+            return c < 0 ? -1 : c > 0 ? 1 : 0;
+        }
+
+        int compare_( std::size_t i, std::size_t j ) const
+        {
+            for( std::size_t c = 0; c < columns_.size(); ++c )
+            {
+                if( columns_[c].first )
+                {
+                    int s = compare_string_( i, j, columns_[c].second );
+                    if( s != 0 ) { return s; }
+                    continue;
+                }
+                comma::uint64 a = numeric_[ i * numeric_width_ + columns_[c].second ];
+                comma::uint64 b = numeric_[ j * numeric_width_ + columns_[c].second ];
+                if( a != b ) { return a < b ? -1 : 1; }
+            }
+            return 0;
+        }
+
+        bool equal_( std::size_t i, std::size_t j ) const { return compare_( i, j ) == 0; }
+
+        /// run f( 0 ), f( 1 ), ..., f( count - 1 ) in parallel
+        template < typename F > static void parallel_( unsigned int count, F f )
+        {
+            std::vector< std::thread > threads;
+            for( unsigned int i = 1; i < count; ++i ) { threads.push_back( std::thread( f, i ) ); }
+            f( 0 );
+            for( std::size_t i = 0; i < threads.size(); threads[i].join(), ++i );
+        }
+
+        unsigned int threads_for_( std::size_t size ) const { return std::max( std::size_t( 1 ), std::min( std::size_t( threads_ ), size / 65536 ) ); } // small chunks are not worth a thread
+
+        void comparison_sort_()
+        {
+            const records& r = *this;
+            auto less = [&]( std::size_t i, std::size_t j ) { return ( r.reverse_ ? r.compare_( j, i ) : r.compare_( i, j ) ) < 0; };
+            unsigned int count = threads_for_( order_.size() );
+            std::vector< std::size_t > bounds( count + 1 );
+            for( unsigned int i = 0; i <= count; bounds[i] = order_.size() * i / count, ++i );
+            parallel_( count, [&]( unsigned int i ) { std::stable_sort( order_.begin() + bounds[i], order_.begin() + bounds[ i + 1 ], less ); } );
+            std::vector< std::size_t > merged( order_.size() );
+            while( bounds.size() > 2 ) // merge neighbouring chunks pairwise; std::merge is stable
+            {
+                unsigned int pairs = ( bounds.size() - 1 ) / 2;
+                parallel_( pairs, [&]( unsigned int i ) { std::merge( order_.begin() + bounds[ 2 * i ], order_.begin() + bounds[ 2 * i + 1 ], order_.begin() + bounds[ 2 * i + 1 ], order_.begin() + bounds[ 2 * i + 2 ], merged.begin() + bounds[ 2 * i ], less ); } );
+                if( ( bounds.size() - 1 ) % 2 ) { std::copy( order_.begin() + bounds[ bounds.size() - 2 ], order_.end(), merged.begin() + bounds[ bounds.size() - 2 ] ); }
+                order_.swap( merged );
+                std::vector< std::size_t > b;
+                for( std::size_t i = 0; i < bounds.size(); i += 2 ) { b.push_back( bounds[i] ); }
+                if( b.back() != order_.size() ) { b.push_back( order_.size() ); }
+                bounds.swap( b );
+            }
+        }
+
+        void radix_sort_() // least significant digit first: by the last key first, byte by byte
+        {
+            std::size_t n = order_.size();
+            unsigned int count = threads_for_( n );
+            std::vector< std::size_t > bounds( count + 1 );
+            for( unsigned int i = 0; i <= count; bounds[i] = n * i / count, ++i );
+            std::vector< pair_t > src( n ), dst( n );
+            std::vector< std::vector< std::size_t > > counts( count, std::vector< std::size_t >( 256 * 8 ) );
+            comma::uint64 flip = reverse_ ? ~comma::uint64( 0 ) : 0;
+            for( std::size_t column = numeric_width_; column-- > 0; )
+            {
+                parallel_( count, [&]( unsigned int t )
+                {
+                    std::vector< std::size_t >& c = counts[t];
+                    std::fill( c.begin(), c.end(), 0 );
+                    for( std::size_t k = bounds[t]; k < bounds[ t + 1 ]; ++k )
+                    {
+                        comma::uint64 key = numeric_[ order_[k] * numeric_width_ + column ] ^ flip;
+                        src[k].key = key;
+                        src[k].index = order_[k];
+                        for( unsigned int b = 0; b < 8; ++b, key >>= 8 ) { ++c[ b * 256 + ( key & 0xff ) ]; }
+                    }
+                } );
+                for( unsigned int b = 0; b < 8; ++b )
+                {
+                    bool trivial = false; // all records have the same byte: nothing to do
+                    for( unsigned int d = 0; d < 256 && !trivial; ++d )
+                    {
+                        std::size_t total = 0;
+                        for( unsigned int t = 0; t < count; total += counts[t][ b * 256 + d ], ++t );
+                        trivial = total == n;
+                    }
+                    if( trivial ) { continue; }
+                    unsigned int shift = b * 8;
+                    if( count > 1 && b > 0 ) // chunk histograms of this byte change with every pass
+                    {
+                        parallel_( count, [&]( unsigned int t )
+                        {
+                            std::size_t* c = &counts[t][ b * 256 ];
+                            std::fill( c, c + 256, 0 );
+                            for( std::size_t k = bounds[t]; k < bounds[ t + 1 ]; ++c[ ( src[k].key >> shift ) & 0xff ], ++k );
+                        } );
+                    }
+                    std::vector< std::vector< std::size_t > > offsets( count, std::vector< std::size_t >( 256 ) );
+                    std::size_t offset = 0;
+                    for( unsigned int d = 0; d < 256; ++d ) { for( unsigned int t = 0; t < count; offsets[t][d] = offset, offset += counts[t][ b * 256 + d ], ++t ); }
+                    parallel_( count, [&]( unsigned int t )
+                    {
+                        std::vector< std::size_t >& o = offsets[t];
+                        for( std::size_t k = bounds[t]; k < bounds[ t + 1 ]; ++k ) { dst[ o[ ( src[k].key >> shift ) & 0xff ]++ ] = src[k]; }
+                    } );
+                    src.swap( dst );
+                }
+                for( std::size_t k = 0; k < n; order_[k] = src[k].index, ++k );
+            }
+        }
+};
+
+/// sort records in runs of limited memory, spill sorted runs to temporary files, merge runs block by block
+/// if all records of a block fit in memory, they are sorted and output without temporary files
+class sorter
+{
+    public:
+        sorter( const input_with_block& sample, bool reverse, bool unique, unsigned int threads, std::size_t memory, const std::string& directory )
+            : sample_( sample ), reverse_( reverse ), unique_( unique ), memory_( memory ), directory_( directory ), records_( reverse, threads ) {}
+
+        ~sorter() { remove_runs_(); }
+
+        /// add record to the current block; data: binary record or ascii line terminated with '\n'
+        void push( const input_t& key, const char* data, std::size_t size )
+        {
+            if( !records_.empty() && records_.bytes() + size > memory_ ) { spill_(); }
+            records_.push( key, data, size );
+        }
+
+        /// output current block sorted and start a new block
+        void flush()
+        {
+            if( runs_.empty() ) { records_.sort(); records_.write( std::cout, unique_ ); }
+            else { spill_(); merge_(); }
+            records_.clear();
+            remove_runs_();
+            if( csv.flush ) { std::cout.flush(); }
+        }
+
+    private:
+        /// merge source: sorted run read back from temporary file
+        struct run_t
+        {
+            std::ifstream ifs;
+            boost::scoped_ptr< comma::csv::input_stream< input_with_block > > istream;
+            const input_with_block* current;
+            std::size_t index;
+            run_t( const std::string& filename, const input_with_block& sample, std::size_t index ) : ifs( filename.c_str(), std::ios::binary ), current( NULL ), index( index )
+            {
+                if( !ifs.is_open() ) { COMMA_THROW( comma::exception, "failed to open temporary file \"" << filename << "\"" ); }
+                istream.reset( new comma::csv::input_stream< input_with_block >( ifs, csv, sample ) );
+                current = istream->read();
+            }
+            void write( std::ostream& os ) const
+            {
+                if( csv.binary() ) { os.write( istream->binary().last(), csv.format().size() ); }
+                else { os << comma::join( istream->ascii().last(), csv.delimiter ) << '\n'; }
+            }
+        };
+
+        /// priority queue ordering: the next record to output is on top; equal keys are output in input order, i.e. run by run
+        struct greater_t
+        {
+            bool reverse;
+            greater_t( bool reverse ) : reverse( reverse ) {}
+            bool operator()( const run_t* lhs, const run_t* rhs ) const
+            {
+                if( reverse ? *lhs->current < *rhs->current : *rhs->current < *lhs->current ) { return true; }
+                if( reverse ? *rhs->current < *lhs->current : *lhs->current < *rhs->current ) { return false; }
+                return lhs->index > rhs->index;
+            }
+        };
+
+        static const std::size_t fan_in = 256; // max number of runs merged at once, to stay within open file limits
+
+        input_with_block sample_;
+        bool reverse_;
+        bool unique_;
+        std::size_t memory_;
+        std::string directory_;
+        std::vector< std::string > runs_;
+        records records_;
+
+        std::string make_run_()
+        {
+            std::string filename = directory_ + "/csv-sort.XXXXXX";
+            int fd = ::mkstemp( &filename[0] );
+            if( fd < 0 ) { COMMA_THROW( comma::exception, "failed to create temporary file in \"" << directory_ << "\"; set --temporary-directory" ); }
+            ::close( fd );
+            return filename;
+        }
+
+        void spill_()
+        {
+            if( records_.empty() ) { return; }
+            records_.sort();
+            runs_.push_back( make_run_() );
+            std::ofstream ofs( runs_.back().c_str(), std::ios::binary );
+            records_.write( ofs, unique_ );
+            ofs.close();
+            if( !ofs ) { COMMA_THROW( comma::exception, "failed to write temporary file \"" << runs_.back() << "\"" ); }
+            if( verbose ) { std::cerr << "csv-sort: spilled " << records_.size() << " record(s) to " << runs_.back() << std::endl; }
+            records_.clear();
+        }
+
+        void merge_( std::size_t begin, std::size_t end, std::ostream& os )
+        {
+            boost::ptr_vector< run_t > runs;
+            greater_t greater( reverse_ );
+            std::priority_queue< run_t*, std::vector< run_t* >, greater_t > queue( greater );
+            for( std::size_t i = begin; i < end; ++i )
+            {
+                runs.push_back( new run_t( runs_[i], sample_, i ) );
+                if( runs.back().current ) { queue.push( &runs.back() ); }
+            }
+            boost::optional< input_t > last;
+            while( !queue.empty() )
+            {
+                run_t* r = queue.top();
+                queue.pop();
+                if( !unique_ || !last || !( *last == *r->current ) )
+                {
+                    r->write( os );
+                    if( unique_ ) { last = *r->current; }
+                }
+                r->current = r->istream->read();
+                if( r->current ) { queue.push( r ); }
+            }
+        }
+
+        void merge_()
+        {
+            while( runs_.size() > fan_in ) // merge runs in groups into intermediate runs, preserving their input order
+            {
+                std::vector< std::string > merged;
+                for( std::size_t i = 0; i < runs_.size(); i += fan_in )
+                {
+                    std::size_t end = std::min( i + fan_in, runs_.size() );
+                    merged.push_back( make_run_() );
+                    std::ofstream ofs( merged.back().c_str(), std::ios::binary );
+                    merge_( i, end, ofs );
+                    ofs.close();
+                    if( !ofs ) { COMMA_THROW( comma::exception, "failed to write temporary file \"" << merged.back() << "\"" ); }
+                    for( std::size_t j = i; j < end; ++j ) { ::remove( runs_[j].c_str() ); }
+                }
+                runs_.swap( merged );
+            }
+            merge_( 0, runs_.size(), std::cout );
+        }
+
+        void remove_runs_()
+        {
+            for( std::size_t i = 0; i < runs_.size(); ++i ) { ::remove( runs_[i].c_str() ); }
+            runs_.clear();
+        }
+};
+
+static std::size_t memory_size( const std::string& s )
+{
+    if( s.empty() ) { COMMA_THROW( comma::exception, "expected memory size, got empty string" ); }
+    std::size_t multiplier = 1;
+    std::string n = s;
+    switch( s[ s.size() - 1 ] )
+    {
+        case 'k': case 'K': multiplier = 1024ul; break;
+        case 'm': case 'M': multiplier = 1024ul * 1024; break;
+        case 'g': case 'G': multiplier = 1024ul * 1024 * 1024; break;
+        case 't': case 'T': multiplier = 1024ul * 1024 * 1024 * 1024; break;
+        default: break;
+    }
+    if( multiplier > 1 ) { n = s.substr( 0, s.size() - 1 ); }
+    std::size_t size = boost::lexical_cast< std::size_t >( n ) * multiplier;
+    if( size == 0 ) { COMMA_THROW( comma::exception, "expected positive memory size, got \"" << s << "\"" ); }
+    return size;
+}
+
+static int sort( comma::csv::input_stream< input_with_block >& istream, const std::string& first_line, const input_with_block& default_input, bool reverse, bool unique, const comma::command_line_options& options )
+{
+    const char* tmpdir = ::getenv( "TMPDIR" );
+    unsigned int threads = options.value< unsigned int >( "--threads", 1 );
+    if( threads == 0 ) { threads = std::max( std::thread::hardware_concurrency(), 1u ); }
+    std::size_t memory = options.exists( "--memory" ) ? memory_size( options.value< std::string >( "--memory" ) ) : std::numeric_limits< std::size_t >::max();
+    sorter s( default_input, reverse, unique, threads, memory, options.value< std::string >( "--temporary-directory", tmpdir ? tmpdir : "/tmp" ) );
+    comma::uint32 block = 0;
+    std::string line;
+    if( !first_line.empty() )
+    {
+        input_with_block input = comma::csv::ascii< input_with_block >( csv, default_input ).get( first_line );
+        block = input.block;
+        line = first_line + '\n';
+        s.push( input, &line[0], line.size() );
+    }
+    while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) )
+    {
+        const input_with_block* p = istream.read();
+        if( !p ) { break; }
+        if( p->block != block ) { s.flush(); block = p->block; }
+        if( istream.is_binary() ) { s.push( *p, istream.binary().last(), csv.format().size() ); continue; }
+        line = comma::join( istream.ascii().last(), csv.delimiter );
+        line += '\n';
+        s.push( *p, &line[0], line.size() );
+    }
+    s.flush();
+    return 0;
+}
+
+} // namespace engine {
+
 static int sort( const comma::command_line_options& options )
 {
     input_with_block default_input;
@@ -634,39 +1069,7 @@ static int sort( const comma::command_line_options& options )
     if( options.exists( "--discard-out-of-order,--discard-unsorted" ) ) { return handle_discard_out_of_order( istream, first_line, default_input, reverse ); }
     auto sliding_window = options.optional< unsigned int >( "--sliding-window,--window" );
     if( sliding_window ) { return handle_sliding_window( istream, first_line, default_input, reverse, *sliding_window ); }
-    comma::uint32 block = 0;
-    input_t::map map;
-    if( !first_line.empty() )
-    { 
-        input_with_block input = comma::csv::ascii< input_with_block >( csv, default_input ).get( first_line );
-        block = input.block;
-        input_t::map::mapped_type& d = map[ input ];
-        d.push_back( first_line );
-    }
-    while( istream.ready() || ( std::cin.good() && !std::cin.eof() ) || !map.empty() )
-    {
-        const input_with_block* p = istream.read();
-        if( !p || p->block != block )
-        {
-            if( reverse ) { output_( map.rbegin(), map.rend() ); } else { output_( map.begin(), map.end() ); }
-            map.clear();
-        }
-        if( !p ) { break; }
-        block = p->block;
-        input_t::map::mapped_type& d = map[ *p ];
-        if( unique && !d.empty() ) { continue; }
-        if( istream.is_binary() )
-        {
-            d.push_back( std::string() );
-            d.back().resize( csv.format().size() );
-            ::memcpy( &d.back()[0], istream.binary().last(), csv.format().size() );
-        }
-        else
-        {
-            d.push_back( comma::join( istream.ascii().last(), csv.delimiter ) );
-        }
-    }
-    return 0;
+    return engine::sort( istream, first_line, default_input, reverse, unique, options );
 }
 
 int main( int ac, char** av )
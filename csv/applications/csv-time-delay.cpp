@@ -92,6 +92,7 @@ int main( int ac, char** av )
         comma::csv::options csv( options );
         comma::csv::input_stream< Point > istream( std::cin, csv );
         comma::csv::output_stream< Point > ostream( std::cout, csv );
+        ostream.flush_when_idle( std::cin, 0 );
         while( std::cin.good() && !std::cin.eof() )
         {
             const Point* p = istream.read();
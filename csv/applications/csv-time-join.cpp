@@ -30,15 +30,16 @@
 
 /// @author vsevolod vlaskine
 
-#include <deque>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/optional.hpp>
 #include "../../application/command_line_options.h"
 #include "../../application/contact_info.h"
 #include "../../application/signal_flag.h"
 #include "../../base/types.h"
+#include "../../csv/index.h"
 #include "../../csv/stream.h"
 #include "../../io/stream.h"
 #include "../../csv/traits.h"
@@ -95,10 +96,14 @@ static void usage( bool verbose )
     std::cerr << "    --bound=<seconds>:          output only points within given bound" << std::endl;
     std::cerr << "    --do-not-append,--select:   do not append any field from the second input" << std::endl;
     std::cerr << "    --timestamp-only:           append only timestamp from the second input" << std::endl;
-    std::cerr << "    --buffer:                   bounding data buffer size; default: infinite" << std::endl;
+    std::cerr << "    --buffer:                   bounding data buffer size, at least 2; default: infinite" << std::endl;
     std::cerr << "    --discard-bounding:         discard bounding data if buffer size reached;" << std::endl;
     std::cerr << "                                default is to block until stdin catches up" << std::endl;
     std::cerr << std::endl;
+    std::cerr << "bounding file index" << std::endl;
+    std::cerr << "    if bounding file is indexed by timestamp with csv-index, e.g. csv-index b.csv --fields=t," << std::endl;
+    std::cerr << "    skip bounding records before the first timestamp on stdin (except in --realtime mode)" << std::endl;
+    std::cerr << std::endl;
     std::cerr << "examples" << std::endl;
     std::cerr << "    first field on stdin is timestamp, the first field of filter is timestamp" << std::endl;
     std::cerr << "        - default:" << std::endl;
@@ -180,6 +185,56 @@ boost::posix_time::ptime get_time( const Point& p )
     return p.timestamp ? *p.timestamp : boost::posix_time::microsec_clock::universal_time();
 }
 
+/// bounding records in a ring buffer, ordered by time: amortized constant time push and pop, logarithmic lookup
+class bounding_buffer
+{
+    public:
+        bounding_buffer() : records_( 16 ), begin_( 0 ), size_( 0 ) {}
+
+        std::size_t size() const { return size_; }
+
+        const timestring_t& operator[]( std::size_t i ) const { return records_[ ( begin_ + i ) & ( records_.size() - 1 ) ]; }
+
+        const timestring_t& front() const { return records_[ begin_ ]; }
+
+        void push_back( const boost::posix_time::ptime& t, const std::string& s )
+        {
+            if( size_ == records_.size() ) { grow_(); }
+            timestring_t& r = records_[ ( begin_ + size_ ) & ( records_.size() - 1 ) ];
+            r.first = t;
+            r.second.assign( s ); // reuse string capacity
+            ++size_;
+        }
+
+        void pop_front( std::size_t n = 1 ) { begin_ = ( begin_ + n ) & ( records_.size() - 1 ); size_ -= n; }
+
+        /// return index of the first record with timestamp greater than t
+        std::size_t upper_bound( const boost::posix_time::ptime& t ) const
+        {
+            std::size_t begin = 0;
+            std::size_t end = size_;
+            while( begin < end )
+            {
+                std::size_t middle = begin + ( end - begin ) / 2;
+                if( t < ( *this )[ middle ].first ) { end = middle; } else { begin = middle + 1; }
+            }
+            return begin;
+        }
+
+    private:
+        std::vector< timestring_t > records_; // size is a power of two
+        std::size_t begin_;
+        std::size_t size_;
+
+        void grow_()
+        {
+            std::vector< timestring_t > records( records_.size() * 2 );
+            for( std::size_t i = 0; i < size_; ++i ) { records[i].first = ( *this )[i].first; records[i].second.swap( records_[ ( begin_ + i ) & ( records_.size() - 1 ) ].second ); }
+            records_.swap( records );
+            begin_ = 0;
+        }
+};
+
 static void output_bounding( std::ostream& os, const timestring_t& bounding, bool stdin_first )
 {
     if( !select_only )
@@ -251,6 +306,7 @@ int main( int ac, char** av )
         if( select_only && timestamp_only ) { std::cerr << "csv-time-join: --timestamp-only specified with --select, ignoring --timestamp-only" << std::endl; }
         bool discard_bounding = options.exists( "--discard-bounding" );
         boost::optional< unsigned int > buffer_size = options.optional< unsigned int >( "--buffer" );
+        if( buffer_size && *buffer_size < 2 ) { std::cerr << "csv-time-join: expected --buffer of at least 2 (lower and upper bound); got: " << *buffer_size << std::endl; return 1; }
         if( options.exists( "--bound" ) ) { bound = boost::posix_time::microseconds( static_cast<unsigned int>(options.value< double >( "--bound" ) * 1000000 )); }
         stdin_csv = comma::csv::options( options, "t" );
 
@@ -288,61 +344,38 @@ int main( int ac, char** av )
         comma::io::istream bounding_istream( comma::split( properties, ';' )[0]
                                            , bounding_csv.binary() ? comma::io::mode::binary : comma::io::mode::ascii );
         comma::csv::input_stream< Point > bounding_stream( *bounding_istream, bounding_csv );
-
-        #ifndef WIN32
-        comma::io::select select;
-        comma::io::select bounding_stream_select;
-        select.read().add( 0 );
-        select.read().add( bounding_istream.fd() );
-        bounding_stream_select.read().add( bounding_istream.fd() );
-        #endif // #ifndef WIN32
+        bounding_stream.fd( bounding_istream.fd() );
+        static const boost::posix_time::ptime immediately( boost::posix_time::neg_infin ); // read only what is already available
 
         const Point* p = NULL;
 
         if( method == how::realtime )
         {
             #ifndef WIN32
-            bool end_of_input = false;
             bool end_of_bounds = false;
-            
-            boost::optional<timestring_t> joined_line;
-            
-            while (!is_shutdown && !end_of_input)
+            boost::optional< timestring_t > joined_line;
+            while( !is_shutdown )
             {
-                if ( !bounding_stream.ready() && !stdin_stream.ready() )
-                {
-                    select.wait(boost::posix_time::milliseconds(1));
-                }
-                
-                if ( !is_shutdown && !end_of_input && ( stdin_stream.ready() || ( select.check() && select.read().ready( comma::io::stdin_fd ) ) ) )
+                bool idle = true;
+                while( !end_of_bounds ) // catch up with the latest bounding record
                 {
-                    p = stdin_stream.read();
-                    if( p )
-                    {
-                        timestring_t input_line = std::make_pair( get_time( *p ), stdin_stream.last() );
-                        if( joined_line ) { output( input_line, *joined_line, stdin_first ); }
-                    }
-                    else
-                    {
-                        comma::verbose << "end of input stream" << std::endl;
-                        end_of_input = true;
-                    }
+                    const Point* q = bounding_stream.read( immediately );
+                    if( q ) { joined_line = std::make_pair( get_time( *q ), bounding_stream.last() ); idle = false; continue; }
+                    if( !bounding_istream->good() ) { comma::verbose << "end of bounding stream" << std::endl; end_of_bounds = true; }
+                    break;
                 }
-                
-                if ( !is_shutdown && !end_of_bounds &&
-                   ( bounding_stream.ready() || ( select.check() && select.read().ready( bounding_istream.fd() ))))
+                p = stdin_stream.read( immediately );
+                if( p )
                 {
-                    p = bounding_stream.read();
-                    if( p )
-                    {
-                        joined_line = std::make_pair( get_time( *p ), bounding_stream.last() );
-                    }
-                    else
-                    {
-                        comma::verbose << "end of bounding stream" << std::endl;
-                        end_of_bounds = true;
-                    }
+                    if( joined_line ) { output( std::make_pair( get_time( *p ), stdin_stream.last() ), *joined_line, stdin_first ); }
+                    continue;
                 }
+                if( !std::cin.good() ) { comma::verbose << "end of input stream" << std::endl; break; }
+                if( !idle ) { continue; }
+                comma::io::select select; // block until either stream has data
+                select.read().add( 0 ); // never empty: on end of input the loop exits above
+                if( !end_of_bounds ) { select.read().add( bounding_istream.fd() ); }
+                select.wait();
             }
             if (is_shutdown) { comma::verbose << "got a signal" << std::endl; return 0; }
             #else
@@ -351,122 +384,76 @@ int main( int ac, char** av )
         }
         else
         {
-            std::deque<timestring_t> bounding_queue;
-            bool next = true;
-            bool bounding_data_available;
-            bool upper_bound_added = false;
+            bounding_buffer bounding_queue;
+            bool pending = false; // stdin record waiting for bounding data
+            bool end_of_input = false;
+            bool end_of_bounds = false;
 
             // add a fake entry for an lower bound to allow stdin before first bound to match
-            bounding_queue.push_back( std::make_pair( boost::posix_time::neg_infin, "" ));
+            bounding_queue.push_back( boost::posix_time::neg_infin, "" );
 
-            while( ( stdin_stream.ready() || ( std::cin.good() && !std::cin.eof() ) ) )
+            std::string bounding_filename = comma::split( properties, ';' )[0];
+            const boost::optional< comma::csv::index >& bounding_index = bounding_filename == "-" ? boost::none : comma::csv::index::load( bounding_filename, bounding_csv, "t" );
+            if( bounding_index && bounding_index->time ) // bounding file indexed by csv-index: skip to the first input timestamp
             {
-                if( !std::cin.good() ) { select.read().remove( 0 ); }
-                if( !bounding_istream->good() ) { select.read().remove( bounding_istream.fd() ); }
-                bounding_data_available = bounding_stream.ready() || ( bounding_istream->good() && !bounding_istream->eof() );
-                #ifdef WIN32
-                bool bounding_stream_ready = true;
-                bool stdin_stream_ready = true;
-                #else // #ifdef WIN32
-                //check so we do not block
-                bool bounding_stream_ready = bounding_stream.ready();
-                bool stdin_stream_ready = stdin_stream.ready();
-
-                if( next )
+                p = stdin_stream.read();
+                if( !p ) { return 0; }
+                bounding_istream->seekg( bounding_index->lower_bound( comma::csv::index::key( get_time( *p ) ) ) );
+                pending = true;
+            }
+
+            while( !is_shutdown )
+            {
+                bool idle = true;
+                if( !pending && !end_of_input )
                 {
-                    if( !bounding_stream_ready || !stdin_stream_ready )
-                    {
-                        if( !bounding_stream_ready && !stdin_stream_ready )
-                        {
-                            select.wait( boost::posix_time::milliseconds(10) );
-                        }
-                        else
-                        {
-                            select.check();
-                        }
-                        if( select.read().ready( bounding_istream.fd() )) { bounding_stream_ready = true; }
-                        if( select.read().ready(0) ) { stdin_stream_ready=true; }
-                    }
+                    p = stdin_stream.read( immediately );
+                    if( p ) { pending = true; idle = false; }
+                    else if( !std::cin.good() ) { end_of_input = true; }
                 }
-                else
+                if( !pending && end_of_input ) { break; }
+                if( pending )
                 {
-                    if( !bounding_stream_ready )
+                    boost::posix_time::ptime t = get_time( *p );
+                    std::size_t upper = bounding_queue.upper_bound( t ); // drop bounds before the lower bound of t
+                    if( upper > 1 ) { bounding_queue.pop_front( upper - 1 ); }
+                    if( bounding_queue.size() >= 2 ) // bound available
                     {
-                        bounding_stream_select.wait( boost::posix_time::milliseconds(10) );
-                        if( bounding_stream_select.read().ready( bounding_istream.fd() )) { bounding_stream_ready=true; }
+                        pending = false;
+                        if( method == how::by_lower && t < bounding_queue.front().first ) { continue; }
+                        bool is_first = ( method == how::by_lower )
+                            || ( method == how::nearest && ( t - bounding_queue[0].first ) < ( bounding_queue[1].first - t ));
+                        output( std::make_pair( t, stdin_stream.last() ), is_first ? bounding_queue[0] : bounding_queue[1], stdin_first );
+                        continue;
                     }
+                    if( end_of_bounds ) { break; } // bound not found and no more data
                 }
-                #endif //#ifdef WIN32
-
                 //keep storing available bounding data
-                if( bounding_stream_ready )
+                if( !end_of_bounds && ( !buffer_size || bounding_queue.size() < *buffer_size || discard_bounding ) )
                 {
-                    if( !buffer_size || bounding_queue.size() < *buffer_size || discard_bounding )
+                    const Point* q = bounding_stream.read( immediately );
+                    if( q )
                     {
-                        const Point* q = bounding_stream.read();
-                        if( q )
-                        {
-                            bounding_queue.push_back( std::make_pair( get_time( *q ), bounding_stream.last() ));
-                        }
-                        else
-                        {
-                            bounding_data_available=false;
-                        }
+                        bounding_queue.push_back( get_time( *q ), bounding_stream.last() );
+                        if( buffer_size && bounding_queue.size() > *buffer_size && discard_bounding ) { bounding_queue.pop_front(); }
+                        idle = false;
                     }
-                    if( buffer_size && bounding_queue.size() > *buffer_size && discard_bounding )
+                    else if( !bounding_istream->good() )
                     {
-                        bounding_queue.pop_front();
+                        // add a fake entry for an upper bound to allow stdin data above last bound to match
+                        bounding_queue.push_back( boost::posix_time::pos_infin, "" );
+                        end_of_bounds = true;
+                        idle = false;
                     }
                 }
-                if( !upper_bound_added && bounding_istream->eof() )
-                {
-                    // add a fake entry for an upper bound to allow stdin data above last bound to match
-                    bounding_queue.push_back( std::make_pair( boost::posix_time::pos_infin, "" ));
-                    upper_bound_added = true;
-                }
-
-                //if we are done with the last bounded point get next
-                if( next )
-                {
-                    if(!stdin_stream_ready) { continue; }
-                    p = stdin_stream.read();
-                    if( !p ) { break; }
-                }
-
-                boost::posix_time::ptime t = get_time(*p);
-              
-                //get bound
-                while(bounding_queue.size()>=2)
-                {
-                    if( t < bounding_queue[1].first ) { break; }
-                    bounding_queue.pop_front();
-                }
-
-                if(bounding_queue.size()<2)
-                {
-                    //bound not found
-                    //do we have more data?
-                    if(!bounding_data_available) { break; }
-                    next=false;
-                    continue;
-                }
-
-                //bound available
-
-                if( method == how::by_lower && t < bounding_queue.front().first )
-                {
-                    next = true;
-                    continue;
-                }
-
-                bool is_first = ( method == how::by_lower )
-                    || ( method == how::nearest && ( t - bounding_queue[0].first ) < ( bounding_queue[1].first - t ));
-
-                const timestring_t& chosen_bound = is_first ? bounding_queue[0] : bounding_queue[1];;
-                timestring_t input_line = std::make_pair( t, stdin_stream.last() );
-
-                output( input_line, chosen_bound, stdin_first );
-                next=true;
+                if( !idle ) { continue; }
+                #ifndef WIN32
+                comma::io::select select; // block until there is data to make progress on
+                if( !pending && !end_of_input ) { select.read().add( 0 ); }
+                if( !end_of_bounds && ( !buffer_size || bounding_queue.size() < *buffer_size || discard_bounding ) ) { select.read().add( bounding_istream.fd() ); }
+                if( select.read()().empty() ) { COMMA_THROW( comma::exception, "nothing to wait for: input record pending, but bounding buffer full; increase --buffer" ); } // would block forever
+                select.wait();
+                #endif // #ifndef WIN32
             }
         }
         return 0;     
@@ -146,6 +146,7 @@ int main( int ac, char** av )
         comma::csv::options csv( options );
         comma::csv::input_stream< point_t > istrm( std::cin, csv );
         comma::csv::output_stream< point_t > ostrm( std::cout, csv );
+        ostrm.flush_when_idle( std::cin, 0 );
 
         while( std::cin.good() && !std::cin.eof() )
         {
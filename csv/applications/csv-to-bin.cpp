@@ -37,10 +37,16 @@
 #endif
 
 #include <stdlib.h>
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <thread>
 #include "../../application/contact_info.h"
 #include "../../application/command_line_options.h"
+#include "../../csv/codec.h"
 #include "../../csv/format.h"
+#include "../../csv/impl/pipeline.h"
+#include "../../csv/impl/tokenized_line.h"
 #include "../../string/string.h"
 
 //#include <google/profiler.h>
@@ -55,6 +61,9 @@ static void usage( bool )
     std::cerr << "options" << std::endl;
     std::cerr << "    --delimiter=[<delimiter>]; default: , (comma)" << std::endl;
     std::cerr << "    --flush; flush stdout after each record" << std::endl;
+    std::cerr << "    --threads=<n>; convert on <n> threads, 0: use all cores; a reader thread splits input into large chunks" << std::endl;
+    std::cerr << "                   of whole lines, chunks are converted in parallel and output in order; output is the same" << std::endl;
+    std::cerr << "                   as with a single thread, but is delayed by a chunk, i.e. --threads is for bulk conversion" << std::endl;
     std::cerr << std::endl;
     std::cerr << csv::format::usage() << std::endl;
     std::cerr << std::endl;
@@ -63,6 +72,76 @@ static void usage( bool )
     exit( 0 );
 }
 
+/// error in a line converted on a worker thread
+struct line_error : public std::runtime_error
+{
+    std::string line;
+    line_error( const std::string& what, const std::string& line ) : std::runtime_error( what ), line( line ) {}
+};
+
+/// read input in chunks of whole lines
+class chunk_reader
+{
+    public:
+        chunk_reader( std::size_t size ) : size_( size ), eof_( false ) {}
+
+        bool operator()( std::string& chunk )
+        {
+            chunk.swap( remainder_ );
+            remainder_.clear();
+            while( !eof_ )
+            {
+                std::size_t size = chunk.size();
+                chunk.resize( size + size_ );
+                std::cin.read( &chunk[size], size_ );
+                chunk.resize( size + std::cin.gcount() );
+                if( !std::cin.good() ) { eof_ = true; break; }
+                std::string::size_type end = chunk.rfind( '\n' );
+                if( end == std::string::npos || end < size ) { continue; } // line longer than chunk
+                remainder_.assign( chunk, end + 1, std::string::npos );
+                chunk.resize( end + 1 );
+                return true;
+            }
+            return !chunk.empty();
+        }
+
+    private:
+        std::size_t size_;
+        bool eof_;
+        std::string remainder_;
+};
+
+/// convert chunk of lines, same as main loop
+class chunk_converter
+{
+    public:
+        chunk_converter( const comma::csv::format& format, char delimiter ) : codec_( &format.codec() ), delimiter_( delimiter ), buf_( format.size() ) {}
+
+        void operator()( const std::string& chunk, std::string& output )
+        {
+            for( std::size_t begin = 0; begin < chunk.size(); )
+            {
+                std::string::size_type end = chunk.find( '\n', begin );
+                if( end == std::string::npos ) { end = chunk.size(); }
+                line_.assign( chunk, begin, end - begin );
+                begin = end + 1;
+                if( !line_.empty() && *line_.rbegin() == '\r' ) { line_.resize( line_.length() - 1 ); } // windows... sigh...
+                if( line_.empty() ) { continue; }
+                tokens_.split( line_, delimiter_ );
+                try { codec_->csv_to_bin( &buf_[0], tokens_ ); }
+                catch( std::exception& ex ) { std::replace( line_.begin(), line_.end(), '\0', delimiter_ ); throw line_error( ex.what(), line_ ); }
+                output.append( &buf_[0], buf_.size() );
+            }
+        }
+
+    private:
+        const comma::csv::codec* codec_;
+        char delimiter_;
+        std::vector< char > buf_;
+        std::string line_;
+        comma::csv::impl::tokenized_line tokens_;
+};
+
 int main( int ac, char** av )
 {
     #ifdef WIN32
@@ -70,24 +149,48 @@ int main( int ac, char** av )
     #endif
     std::string line;
     line.reserve( 4000 );
+    char delimiter = ',';
     try
     {
         command_line_options options( ac, av, usage );
-        char delimiter = options.value( "--delimiter", ',' );
+        delimiter = options.value( "--delimiter", ',' );
         bool flush = options.exists( "--flush" );
         comma::csv::format format( av[1] );
+        const comma::csv::codec& codec = format.codec();
+        comma::csv::impl::tokenized_line tokens;
+        std::vector< char > buf( format.size() );
+        if( options.exists( "--threads" ) )
+        {
+            unsigned int threads = options.value< unsigned int >( "--threads" );
+            if( threads == 0 ) { threads = std::max( std::thread::hardware_concurrency(), 1u ); }
+            comma::csv::impl::pipeline< chunk_reader, chunk_converter > pipeline( threads, chunk_reader( 1 << 20 ), chunk_converter( format, delimiter ) );
+            pipeline.run( std::cout, flush );
+            return 0;
+        }
         //{ ProfilerStart( "csv-to-bin.prof" );
         while( std::cin.good() && !std::cin.eof() )
         {
             std::getline( std::cin, line );
-            if( !line.empty() && *line.rbegin() == '\r' ) { line = line.substr( 0, line.length() - 1 ); } // windows... sigh...
-            if( !line.empty() ) { format.csv_to_bin( std::cout, line, delimiter, flush ); }
+            if( !line.empty() && *line.rbegin() == '\r' ) { line.resize( line.length() - 1 ); } // windows... sigh...
+            if( line.empty() ) { continue; }
+            tokens.split( line, delimiter );
+            codec.csv_to_bin( &buf[0], tokens );
+            std::cout.write( &buf[0], buf.size() );
+            if( flush ) { std::cout.flush(); }
         }
         //ProfilerStop(); }
         return 0;
     }
+    catch( line_error& ex )
+    {
+        std::cerr << "csv-to-bin: " << ex.what() << std::endl;
+        std::cerr <<   "format: " << av[1]
+                  << "\ninput: " << ex.line
+                  << "\n============================================" << std::endl;
+    }
     catch( std::exception& ex )
     {
+        std::replace( line.begin(), line.end(), '\0', delimiter ); // undo tokenizing in place
         std::cerr << "csv-to-bin: " << ex.what() << std::endl;
         std::cerr <<   "format: " << av[1]
                   << "\ninput: " << line
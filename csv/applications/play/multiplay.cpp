@@ -32,6 +32,7 @@
 
 #include <sstream>
 #include <boost/thread/thread.hpp>
+#include "../../../csv/index.h"
 #include "../../../string/string.h"
 #include "multiplay.h"
 
@@ -60,13 +61,17 @@ Multiplay::Multiplay( const std::vector< SourceConfig >& configs
     , m_to( to )
     , ascii_( configs.size() )
     , binary_( configs.size() )
+    , sorted_( configs.size(), false )
+    , finished_( configs.size(), false )
 {
     for( unsigned int i = 0; i < configs.size(); i++ )
     {
         // todo: quick and dirty for now: blocking streams for named pipes
         istreams_[i].reset( new io::istream( configs[i].options.filename, m_configs[i].options.binary() ? io::mode::binary : io::mode::ascii, io::mode::blocking ) );
         if( !( *istreams_[i] )() ) { COMMA_THROW( comma::exception, "named pipe " << configs[i].options.filename << " is closed (todo: support closed named pipes)" ); }
+        if( m_configs[i].options.binary() && !( m_from.is_not_a_date_time() && m_to.is_not_a_date_time() ) ) { m_configs[i].options.mmap = true; }
         m_inputStreams[i].reset( new csv::input_stream< time >( *( *istreams_[i] )(), m_configs[i].options ) );
+        if( !( m_from.is_not_a_date_time() && m_to.is_not_a_date_time() ) ) { seek_( i ); }
         unsigned int j;
         for( j = 0; j < i && configs[j].outputFileName != configs[i].outputFileName; ++j ); // quick and dirty: unique publishers
         if( j == i ) { m_publishers[i].reset( new io::publisher( configs[i].outputFileName, m_configs[i].options.binary() ? io::mode::binary : io::mode::ascii, true, flush ) ); }
@@ -105,8 +110,37 @@ static std::string endl()
     return oss.str();
 }
 
+struct earlier
+{
+    boost::posix_time::ptime t;
+    boost::posix_time::time_duration offset;
+    bool or_equal;
+    earlier( const boost::posix_time::ptime& t, const boost::posix_time::time_duration& offset, bool or_equal ) : t( t ), offset( offset ), or_equal( or_equal ) {}
+    bool operator()( const Multiplay::time& r ) const { return or_equal ? !( t < r.timestamp + offset ) : r.timestamp + offset < t; }
+};
+
 } // namespace impl {
 
+/// on a regular binary file sorted by time, bisect to the first record from m_from;
+/// on a file indexed by csv-index, seek to the first record from m_from by the index;
+/// such inputs are sorted, thus stop reading them after m_to
+void Multiplay::seek_( unsigned int i )
+{
+    if( m_configs[i].options.binary() && m_inputStreams[i]->binary().mapped() )
+    {
+        csv::binary_input_stream< time >& is = m_inputStreams[i]->binary();
+        if( !m_from.is_not_a_date_time() ) { is.seek( is.partition_point( impl::earlier( m_from, m_configs[i].offset, false ) ) ); }
+        sorted_[i] = true;
+        return;
+    }
+    csv::options options = m_configs[i].options;
+    if( options.fields.empty() ) { options.fields = "t"; }
+    const boost::optional< csv::index >& index = options.filename == "-" ? csv::index::load( 0, options, "t" ) : csv::index::load( options.filename, options, "t" );
+    if( !index || !index->time ) { return; }
+    if( !m_from.is_not_a_date_time() ) { ( *istreams_[i] )()->seekg( index->lower_bound( csv::index::key( m_from - m_configs[i].offset ) ) ); }
+    sorted_[i] = true;
+}
+
 bool Multiplay::ready() // quick and dirty; should not it be in io::Publisher?
 {
     if( m_started ) { return true; }
@@ -134,6 +168,7 @@ bool Multiplay::read()
     for( unsigned int i = 0U; i < m_configs.size(); ++i )
     {
         if( !m_timestamps[i].is_not_a_date_time() ) { end = false; continue; }
+        if( finished_[i] ) { continue; }
         const time* time = m_inputStreams[i]->read();
         if( time == NULL ) { continue; }
         boost::posix_time::ptime t = time->timestamp;
@@ -141,12 +176,13 @@ bool Multiplay::read()
         {
             t += m_configs[i].offset;
         }
-        end = false;
         if( ( ( !m_from.is_not_a_date_time() ) && ( t < m_from ) ) || ( ( !m_to.is_not_a_date_time() ) && ( t > m_to ) ) )
-        {            
+        {
+            if( sorted_[i] && !m_to.is_not_a_date_time() && t > m_to ) { finished_[i] = true; continue; }
             i--;
             continue;
         }
+        end = false;
         m_timestamps[i] = t;
     }
     if( end ) { return false; }
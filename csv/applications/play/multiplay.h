@@ -97,7 +97,10 @@ class Multiplay
         std::vector< boost::shared_ptr< csv::ascii< time > > > ascii_;
         std::vector< boost::shared_ptr< csv::binary< time > > > binary_;
         std::vector< char > buf_fer;
+        std::vector< bool > sorted_;
+        std::vector< bool > finished_;
         bool ready();
+        void seek_( unsigned int i );
 };
 
 } // namespace comma {
@@ -41,6 +41,7 @@
 
 #include <boost/lexical_cast.hpp>
 #include "../../../io/file_descriptor.h"
+#include "../../../io/poller.h"
 #include "../../../base/exception.h"
 #include "split.h"
 
@@ -129,7 +130,7 @@ split< T >::~split()
 template < typename T >
 void split< T >::accept_()
 {
-    comma::io::select select;
+    comma::io::poller select;
     {
         transaction t( publishers_ );
         for( auto& ii : *t ) { if( ii->acceptor_file_descriptor() != comma::io::invalid_file_descriptor ) { select.read().add( ii->acceptor_file_descriptor() ); } } 
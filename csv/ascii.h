@@ -58,6 +58,9 @@ class ascii
         /// get value (returns reference pointing to the parameter)
         const S& get( S& s, const std::vector< std::string >& v ) const;
 
+        /// get value from line tokenized in place (only fields present in column names are parsed, no temporary strings)
+        const S& get( S& s, const impl::tokenized_line& line ) const;
+
         /// get value (convenience function)
         const S& get( S& s, const std::string& line ) const { return get( s, split( line, delimiter_ ) ); }
 
@@ -139,6 +142,14 @@ inline const S& ascii< S >::get( S& s, const std::vector< std::string >& v ) con
     return s;
 }
 
+template < typename S >
+inline const S& ascii< S >::get( S& s, const impl::tokenized_line& line ) const
+{
+    impl::from_ascii_ f( ascii_.indices(), ascii_.optional(), line );
+    visiting::apply( f, s );
+    return s;
+}
+
 template < typename S >
 inline const std::vector< std::string >& ascii< S >::put( const S& s, std::vector< std::string >& v ) const
 {
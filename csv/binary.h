@@ -95,7 +95,7 @@ inline const S& binary< S >::get( S& s, const char* buf ) const
 {
     if( binary_ )
     {
-        impl::from_binary_ f( binary_->offsets(), binary_->optional(), buf );
+        impl::from_binary_ f( binary_->offsets(), binary_->from_bin(), binary_->optional(), buf );
         visiting::apply( f, s );
     }
     else // quick and dirty for better performance
@@ -110,7 +110,7 @@ inline char* binary< S >::put( const S& s, char* buf ) const
 {
     if( binary_ )
     {
-        impl::to_binary f( binary_->offsets(), buf );
+        impl::to_binary f( binary_->offsets(), binary_->to_bin(), buf );
         visiting::apply( f, s );
     }
     else // quick and dirty for better performance
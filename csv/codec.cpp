@@ -0,0 +1,317 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#include <string.h>
+#include <boost/lexical_cast.hpp>
+#include "../base/exception.h"
+#include "../base/types.h"
+#include "codec.h"
+#include "impl/iso_time.h"
+#include "impl/lexical.h"
+
+namespace comma { namespace csv {
+
+namespace impl { namespace kernels {
+
+// csv to binary
+
+template < typename T >
+static std::size_t from_csv( char* buf, const char* s, std::size_t length, std::size_t )
+{
+    *reinterpret_cast< T* >( buf ) = lexical::cast< T >( s, length );
+    return sizeof( T );
+}
+
+static std::size_t from_csv_int8( char* buf, const char* s, std::size_t length, std::size_t )
+{
+    int i = lexical::cast< int >( s, length );
+    if( i < -127 || i > 128 ) { COMMA_THROW( comma::exception, "expected byte, got " << i ); }
+    *buf = static_cast< char >( i );
+    return sizeof( char );
+}
+
+static std::size_t from_csv_uint8( char* buf, const char* s, std::size_t length, std::size_t )
+{
+    unsigned int i = lexical::cast< unsigned int >( s, length );
+    if( i > 255 ) { COMMA_THROW( comma::exception, "expected unsigned byte, got " << i ); }
+    *buf = static_cast< unsigned char >( i );
+    return sizeof( unsigned char );
+}
+
+static boost::posix_time::ptime time_from_iso_string( const std::string& s )
+{
+    if ( s.empty() || s == "not-a-date-time" ) { return boost::posix_time::not_a_date_time; }
+    else if ( s == "+infinity" || s == "+inf" || s == "inf" ) { return boost::posix_time::pos_infin; }
+    else if ( s == "-infinity" || s == "-inf" ) { return boost::posix_time::neg_infin; }
+    else 
+    { 
+        try { return boost::posix_time::from_iso_string( s ); }
+        catch ( ... ) { return boost::posix_time::not_a_date_time; }
+    }
+    return boost::posix_time::not_a_date_time;
+}
+
+static std::size_t from_csv_time( char* buf, const char* s, std::size_t length, std::size_t )
+{
+    comma::int64 microseconds;
+    if( iso_time::parse( s, length, microseconds ) ) { *reinterpret_cast< comma::int64* >( buf ) = microseconds; }
+    else { format::traits< boost::posix_time::ptime, format::time >::to_bin( time_from_iso_string( std::string( s, length ) ), buf ); }
+    return format::traits< boost::posix_time::ptime, format::time >::size;
+}
+
+static std::size_t from_csv_long_time( char* buf, const char* s, std::size_t length, std::size_t )
+{
+    comma::int64 microseconds;
+    if( iso_time::parse( s, length, microseconds ) ) // same as traits::to_bin: seconds rounded towards zero
+    {
+        *reinterpret_cast< comma::int64* >( buf ) = microseconds / 1000000;
+        *reinterpret_cast< comma::int32* >( buf + sizeof( comma::int64 ) ) = static_cast< comma::int32 >( microseconds % 1000000 ) * 1000;
+    }
+    else
+    {
+        format::traits< boost::posix_time::ptime, format::long_time >::to_bin( time_from_iso_string( std::string( s, length ) ), buf );
+    }
+    return format::traits< boost::posix_time::ptime, format::long_time >::size;
+}
+
+static std::size_t from_csv_fixed_string( char* buf, const char* s, std::size_t length, std::size_t size )
+{
+    if( length > size ) { COMMA_THROW( comma::exception, "expected string not longer than " << size << "; got \"" << std::string( s, length ) << "\"" ); }
+    ::memset( buf, 0, size );
+    if( length > 1 && s[0] == '\"' && s[ length - 1 ] == '\"' ) { length -= 2; ++s; } // todo quick and dirty; implement proper character escaping and consistent semantics
+    ::memcpy( buf, s, length );
+    return size;
+}
+
+// binary to csv
+
+template < typename T >
+static void to_csv( std::string& s, const char* buf, std::size_t, unsigned int )
+{
+    char b[20];
+    s.append( b, lexical::to_chars( b, static_cast< comma::int64 >( *reinterpret_cast< const T* >( buf ) ) ) );
+}
+
+static void to_csv_uint64( std::string& s, const char* buf, std::size_t, unsigned int )
+{
+    char b[20];
+    s.append( b, lexical::to_chars( b, *reinterpret_cast< const comma::uint64* >( buf ) ) );
+}
+
+static void to_csv_char( std::string& s, const char* buf, std::size_t, unsigned int ) { s += *buf; }
+
+static void to_csv_float( std::string& s, const char* buf, std::size_t, unsigned int precision ) { lexical::append( s, *reinterpret_cast< const float* >( buf ), precision ); }
+
+static void to_csv_double( std::string& s, const char* buf, std::size_t, unsigned int precision ) { lexical::append( s, *reinterpret_cast< const double* >( buf ), precision ); }
+
+static void to_csv_time( std::string& s, const char* buf, std::size_t, unsigned int ) // special values and dates out of range are not on the fast path
+{
+    if( iso_time::append( s, *reinterpret_cast< const comma::int64* >( buf ) ) ) { return; }
+    s += boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::time >::from_bin( buf ) );
+}
+
+static void to_csv_long_time( std::string& s, const char* buf, std::size_t, unsigned int )
+{
+    static const comma::int64 max_seconds = 1000000000000LL; // well beyond year 9999, but no overflow in microseconds
+    comma::int64 seconds = *reinterpret_cast< const comma::int64* >( buf );
+    if( seconds > -max_seconds && seconds < max_seconds && iso_time::append( s, seconds * 1000000 + *reinterpret_cast< const comma::int32* >( buf + sizeof( comma::int64 ) ) / 1000 ) ) { return; }
+    s += boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf ) );
+}
+
+static void to_csv_fixed_string( std::string& s, const char* buf, std::size_t size, unsigned int )
+{
+    if( buf[ size - 1 ] == 0 ) { s += buf; } else { s.append( buf, size ); }
+}
+
+// binary to binary
+
+static void copy( const char* from, std::size_t from_size, char* to, std::size_t to_size ) // sizes differ only for fixed-size strings
+{
+    if( from_size >= to_size ) { ::memcpy( to, from, to_size ); return; }
+    ::memcpy( to, from, from_size );
+    ::memset( to + from_size, 0, to_size - from_size );
+}
+
+template < typename From, typename To >
+static void cast( const char* from, std::size_t, char* to, std::size_t ) { format::traits< To >::to_bin( format::traits< From >::from_bin( from ), to ); }
+
+template < typename To >
+static void lexical_cast( const char* from, std::size_t from_size, char* to, std::size_t )
+{
+    const std::string& s = format::traits< std::string >::from_bin( from, from_size );
+    format::traits< To >::to_bin( lexical::cast< To >( s.c_str(), s.size() ), to );
+}
+
+static void lexical_cast_time( const char* from, std::size_t from_size, char* to, std::size_t )
+{
+    const std::string& s = format::traits< std::string >::from_bin( from, from_size );
+    from_csv_time( to, s.c_str(), s.size(), 0 );
+}
+
+static void lexical_cast_long_time( const char* from, std::size_t from_size, char* to, std::size_t )
+{
+    const std::string& s = format::traits< std::string >::from_bin( from, from_size );
+    from_csv_long_time( to, s.c_str(), s.size(), 0 );
+}
+
+template < typename From >
+static codec::cast_function cast( format::types_enum to )
+{
+    switch( to )
+    {
+        case format::int8: return &cast< From, char >;
+        case format::uint8: return &cast< From, unsigned char >;
+        case format::int16: return &cast< From, comma::int16 >;
+        case format::uint16: return &cast< From, comma::uint16 >;
+        case format::int32: return &cast< From, comma::int32 >;
+        case format::uint32: return &cast< From, comma::uint32 >;
+        case format::int64: return &cast< From, comma::int64 >;
+        case format::uint64: return &cast< From, comma::uint64 >;
+        case format::char_t: return &cast< From, char >;
+        case format::float_t: return &cast< From, float >;
+        case format::double_t: return &cast< From, double >;
+        default: COMMA_THROW( comma::exception, "type conversion to " << format::to_format( to ) << " is not supported" );
+    }
+}
+
+static codec::cast_function lexical_cast( format::types_enum to )
+{
+    switch( to )
+    {
+        case format::int8: return &lexical_cast< char >;
+        case format::uint8: return &lexical_cast< unsigned char >;
+        case format::int16: return &lexical_cast< comma::int16 >;
+        case format::uint16: return &lexical_cast< comma::uint16 >;
+        case format::int32: return &lexical_cast< comma::int32 >;
+        case format::uint32: return &lexical_cast< comma::uint32 >;
+        case format::int64: return &lexical_cast< comma::int64 >;
+        case format::uint64: return &lexical_cast< comma::uint64 >;
+        case format::char_t: return &lexical_cast< char >;
+        case format::float_t: return &lexical_cast< float >;
+        case format::double_t: return &lexical_cast< double >;
+        case format::time: return &lexical_cast_time;
+        case format::long_time: return &lexical_cast_long_time;
+        default: COMMA_THROW( comma::exception, "type conversion from fixed_string to " << format::to_format( to ) << " is not supported" );
+    }
+}
+
+} } // namespace impl { namespace kernels {
+
+codec::codec( const csv::format& f ) : size_( f.size() )
+{
+    fields_.reserve( f.count() );
+    for( unsigned int i = 0; i < f.elements().size(); ++i )
+    {
+        const format::element& e = f.elements()[i];
+        field d;
+        d.size = e.size;
+        d.type = e.type;
+        d.precision = e.type == format::float_t ? 6 : e.type == format::double_t ? 16 : 0;
+        switch( e.type )
+        {
+            case format::int8: d.from_csv = &impl::kernels::from_csv_int8; d.to_csv = &impl::kernels::to_csv< signed char >; break;
+            case format::uint8: d.from_csv = &impl::kernels::from_csv_uint8; d.to_csv = &impl::kernels::to_csv< unsigned char >; break;
+            case format::int16: d.from_csv = &impl::kernels::from_csv< comma::int16 >; d.to_csv = &impl::kernels::to_csv< comma::int16 >; break;
+            case format::uint16: d.from_csv = &impl::kernels::from_csv< comma::uint16 >; d.to_csv = &impl::kernels::to_csv< comma::uint16 >; break;
+            case format::int32: d.from_csv = &impl::kernels::from_csv< comma::int32 >; d.to_csv = &impl::kernels::to_csv< comma::int32 >; break;
+            case format::uint32: d.from_csv = &impl::kernels::from_csv< comma::uint32 >; d.to_csv = &impl::kernels::to_csv< comma::uint32 >; break;
+            case format::int64: d.from_csv = &impl::kernels::from_csv< comma::int64 >; d.to_csv = &impl::kernels::to_csv< comma::int64 >; break;
+            case format::uint64: d.from_csv = &impl::kernels::from_csv< comma::uint64 >; d.to_csv = &impl::kernels::to_csv_uint64; break;
+            case format::char_t: d.from_csv = &impl::kernels::from_csv< char >; d.to_csv = &impl::kernels::to_csv_char; break;
+            case format::float_t: d.from_csv = &impl::kernels::from_csv< float >; d.to_csv = &impl::kernels::to_csv_float; break;
+            case format::double_t: d.from_csv = &impl::kernels::from_csv< double >; d.to_csv = &impl::kernels::to_csv_double; break;
+            case format::time: d.from_csv = &impl::kernels::from_csv_time; d.to_csv = &impl::kernels::to_csv_time; break;
+            case format::long_time: d.from_csv = &impl::kernels::from_csv_long_time; d.to_csv = &impl::kernels::to_csv_long_time; break;
+            case format::fixed_string: d.from_csv = &impl::kernels::from_csv_fixed_string; d.to_csv = &impl::kernels::to_csv_fixed_string; break;
+            default: COMMA_THROW( comma::exception, "on type: " << e.type << ": todo: not implemented" );
+        }
+        for( std::size_t j = 0; j < e.count; ++j ) { d.offset = e.offset + e.size * j; fields_.push_back( d ); }
+    }
+}
+
+void codec::from_csv_( char* buf, const char* s, std::size_t length, std::size_t index ) const
+{
+    const field& f = fields_[index];
+    try
+    {
+        try { f.from_csv( buf + f.offset, s, length, f.size ); }
+        catch( std::exception& ex ) { COMMA_THROW( comma::exception, "failed to convert \"" << std::string( s, length ) << "\" to type \"" << format::to_format( f.type ) << "\": "  << ex.what() ); }
+    }
+    catch( std::exception& ex )
+    {
+        COMMA_THROW( comma::exception, "column " << index + 1 << ": "  << ex.what() );
+    }
+}
+
+void codec::csv_to_bin( char* buf, const std::vector< std::string >& v ) const
+{
+    if( v.size() != fields_.size() ) { COMMA_THROW( comma::exception, "expected csv string with " << fields_.size() << " elements, got [" << comma::join( v, ',' ) << "]" ); }
+    for( std::size_t i = 0; i < fields_.size(); ++i ) { from_csv_( buf, v[i].c_str(), v[i].size(), i ); }
+}
+
+void codec::csv_to_bin( char* buf, const impl::tokenized_line& line ) const
+{
+    if( line.size() != fields_.size() ) { COMMA_THROW( comma::exception, "expected csv string with " << fields_.size() << " elements, got [" << line.join( ',' ) << "]" ); }
+    for( std::size_t i = 0; i < fields_.size(); ++i ) { from_csv_( buf, line[i], line.size( i ), i ); }
+}
+
+void codec::bin_to_csv( std::string& s, const char* buf, char delimiter, const boost::optional< unsigned int >& precision ) const
+{
+    for( std::size_t i = 0; i < fields_.size(); ++i )
+    {
+        const field& f = fields_[i];
+        if( i > 0 ) { s += delimiter; }
+        f.to_csv( s, buf + f.offset, f.size, precision ? *precision : f.precision );
+    }
+}
+
+codec::cast_function codec::cast( format::types_enum from, format::types_enum to )
+{
+    if( from == to ) { return &impl::kernels::copy; }
+    switch( from )
+    {
+        case format::int8: return impl::kernels::cast< char >( to );
+        case format::uint8: return impl::kernels::cast< unsigned char >( to );
+        case format::int16: return impl::kernels::cast< comma::int16 >( to );
+        case format::uint16: return impl::kernels::cast< comma::uint16 >( to );
+        case format::int32: return impl::kernels::cast< comma::int32 >( to );
+        case format::uint32: return impl::kernels::cast< comma::uint32 >( to );
+        case format::int64: return impl::kernels::cast< comma::int64 >( to );
+        case format::uint64: return impl::kernels::cast< comma::uint64 >( to );
+        case format::char_t: return impl::kernels::cast< char >( to );
+        case format::float_t: return impl::kernels::cast< float >( to );
+        case format::double_t: return impl::kernels::cast< double >( to );
+        case format::fixed_string: return impl::kernels::lexical_cast( to );
+        default: COMMA_THROW( comma::exception, "type conversion from " << format::to_format( from ) << " to " << format::to_format( to ) << " is not supported" );
+    }
+}
+
+} } // namespace comma { namespace csv {
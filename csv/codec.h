@@ -0,0 +1,105 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_CODEC_H_
+#define COMMA_CSV_CODEC_H_
+
+#include <string>
+#include <vector>
+#include <boost/optional.hpp>
+#include "format.h"
+#include "impl/tokenized_line.h"
+
+namespace comma { namespace csv {
+
+/// compiled record codec: conversion plan resolved once for a given format
+///
+/// for each field, the offset, size and conversion functions are resolved
+/// at construction, thus converting a record does not switch on the field
+/// type for every field of every record; conversion semantics are the same
+/// as in format::csv_to_bin() and format::bin_to_csv(), which use it
+class codec
+{
+    public:
+        /// convert csv field s of a given length to binary, return binary size
+        typedef std::size_t ( *from_csv_function )( char* buf, const char* s, std::size_t length, std::size_t size );
+
+        /// append csv representation of a binary field to s
+        typedef void ( *to_csv_function )( std::string& s, const char* buf, std::size_t size, unsigned int precision );
+
+        /// convert binary field of one type to binary field of another type, e.g. as in csv-cast
+        typedef void ( *cast_function )( const char* from, std::size_t from_size, char* to, std::size_t to_size );
+
+        /// conversion plan for a field
+        struct field
+        {
+            std::size_t offset;
+            std::size_t size;
+            format::types_enum type;
+            unsigned int precision; /// default output precision
+            from_csv_function from_csv;
+            to_csv_function to_csv;
+        };
+
+        /// constructor
+        codec( const csv::format& f = csv::format() );
+
+        /// return field conversion plans, one per field, i.e. as in format::expanded_string()
+        const std::vector< field >& fields() const { return fields_; }
+
+        /// return binary record size
+        std::size_t size() const { return size_; }
+
+        /// return number of fields
+        std::size_t count() const { return fields_.size(); }
+
+        /// convert csv fields to binary record; buf should have space for at least size() bytes
+        void csv_to_bin( char* buf, const std::vector< std::string >& v ) const;
+
+        /// convert fields of a line tokenized in place to binary record; buf should have space for at least size() bytes
+        void csv_to_bin( char* buf, const impl::tokenized_line& line ) const;
+
+        /// append csv representation of binary record to s
+        void bin_to_csv( std::string& s, const char* buf, char delimiter = ',', const boost::optional< unsigned int >& precision = boost::optional< unsigned int >() ) const;
+
+        /// return conversion function from one binary type to another, throw if conversion is not supported
+        /// @note conversion from fixed-size string to numbers and time is lexical
+        static cast_function cast( format::types_enum from, format::types_enum to );
+
+    private:
+        std::vector< field > fields_;
+        std::size_t size_;
+        void from_csv_( char* buf, const char* s, std::size_t length, std::size_t index ) const;
+};
+
+} } // namespace comma { namespace csv {
+
+#endif // COMMA_CSV_CODEC_H_
@@ -41,6 +41,7 @@
 #include "../base/types.h"
 #include "../string/string.h"
 #include "../csv/format.h"
+#include "codec.h"
 #include "impl/epoch.h"
 
 namespace comma { namespace csv {
@@ -51,7 +52,7 @@ format::format( const std::string& f )
     , count_( 0 )
 {
     std::string format = comma::strip( f, " \t\r\n" );
-    if( format == "" ) { return; }
+    if( format == "" ) { codec_.reset( new csv::codec( *this ) ); return; }
     format = comma::strip( format, "%" );
     std::vector< std::string > v = comma::split( format, ",%" );
     std::size_t offset = 0;
@@ -90,6 +91,7 @@ format::format( const std::string& f )
         offset += size;
         size_ += size;
     }
+    codec_.reset( new csv::codec( *this ) );
 }
 
 const std::string& format::string() const { return string_; }
@@ -185,151 +187,6 @@ std::string format::usage()
 static boost::array< unsigned int, 14 > format_sizes = Sizesimpl();
 std::size_t format::size_of( types_enum type ) { return format_sizes[ static_cast< std::size_t >( type ) ]; }
 
-namespace impl {
-
-template < typename T >
-static std::size_t csv_to_bin( char* buf, const std::string& s )
-{
-    // T t = boost::lexical_cast< T >( s );
-    //::memcpy( buf, &t, sizeof( T ) );
-    *reinterpret_cast< T* >( buf ) = boost::lexical_cast< T >( s );
-    return sizeof( T );
-}
-
-template < typename T >
-static void withPrecision( std::ostringstream& oss, T t, const boost::optional< unsigned int >& ) { oss << t; }
-
-static void withPrecision( std::ostringstream& oss, float t, const boost::optional< unsigned int >& precision )
-{
-    oss.precision( precision ? *precision : 6 );
-    oss << t;
-}
-
-static void withPrecision( std::ostringstream& oss, double t, const boost::optional< unsigned int >& precision )
-{
-    oss.precision( precision ? *precision : 16 );
-    oss << t;
-}
-
-template < typename T >
-static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, const boost::optional< unsigned int >& precision )
-{
-    //T t;
-    //::memcpy( &t, buf, sizeof( T ) );
-    //withPrecision( oss, t, precision );
-    withPrecision( oss, *reinterpret_cast< const T* >( buf ), precision );
-    return sizeof( T );
-}
-
-static boost::posix_time::ptime time_from_iso_string( const std::string& s )
-{
-    if ( s.empty() || s == "not-a-date-time" ) { return boost::posix_time::not_a_date_time; }
-    else if ( s == "+infinity" || s == "+inf" || s == "inf" ) { return boost::posix_time::pos_infin; }
-    else if ( s == "-infinity" || s == "-inf" ) { return boost::posix_time::neg_infin; }
-    else 
-    { 
-        try { return boost::posix_time::from_iso_string( s ); }
-        catch ( ... ) { return boost::posix_time::not_a_date_time; }
-    }
-    return boost::posix_time::not_a_date_time;
-}
-
-static std::size_t csv_to_bin( char* buf, const std::string& s, format::types_enum type, std::size_t size )
-{
-    try
-    {
-        switch( type ) // todo: tear down csv_to_bin, use format::traits
-        {
-            case format::int8:
-            {
-                int i = boost::lexical_cast< int >( s );
-                if( i < -127 || i > 128 ) { COMMA_THROW( comma::exception, "expected byte, got " << i ); }
-                *buf = static_cast< char >( i );
-                return sizeof( char );
-            }
-            case format::uint8:
-            {
-                unsigned int i = boost::lexical_cast< unsigned int >( s );
-                if( i > 255 ) { COMMA_THROW( comma::exception, "expected unsigned byte, got " << i ); }
-                //unsigned char c = static_cast< unsigned char >( i );
-                //::memcpy( buf, &c, 1 );
-                *buf = static_cast< unsigned char >( i );
-                return sizeof( unsigned char );
-            }
-            case format::int16: return csv_to_bin< comma::int16 >( buf, s );
-            case format::uint16: return csv_to_bin< comma::uint16 >( buf, s );
-            case format::int32: return csv_to_bin< comma::int32 >( buf, s );
-            case format::uint32: return csv_to_bin< comma::uint32 >( buf, s );
-            case format::int64: return csv_to_bin< comma::int64 >( buf, s );
-            case format::uint64: return csv_to_bin< comma::uint64 >( buf, s );
-            case format::char_t: return csv_to_bin< char >( buf, s );
-            case format::float_t: return csv_to_bin< float >( buf, s );
-            case format::double_t: return csv_to_bin< double >( buf, s );
-            case format::time: // TODO: quick and dirty: use serialization traits
-                format::traits< boost::posix_time::ptime, format::time >::to_bin( time_from_iso_string(s), buf );
-                return format::traits< boost::posix_time::ptime, format::time >::size;
-            case format::long_time: // TODO: quick and dirty: use serialization traits
-                format::traits< boost::posix_time::ptime, format::long_time >::to_bin( time_from_iso_string(s), buf );
-                return format::traits< boost::posix_time::ptime, format::long_time >::size;
-            case format::fixed_string:
-            {
-                if( s.length() > size ) { COMMA_THROW( comma::exception, "expected string not longer than " << size << "; got \"" << s << "\"" ); }
-                ::memset( buf, 0, size );
-                if( !s.empty() )
-                {
-                    unsigned int length = s.length();
-                    unsigned int begin = 0;
-                    if( length > 1 && s[0] == '\"' && s[ s.length() - 1 ] == '\"' ) { length -= 2; ++begin; } // todo quick and dirty; implement proper character escaping and consistent semantics
-                    ::memcpy( buf, &s[begin], length );
-                }
-                return size;
-            }
-            default: COMMA_THROW( comma::exception, "todo: not implemented" );
-        }
-    }
-    catch( std::exception& ex )
-    {
-        COMMA_THROW( comma::exception, "failed to convert \"" << s << "\" to type \"" << format::to_format(type) << "\": "  << ex.what() );
-    }
-    catch( ... )
-    {
-        throw;
-    }
-}
-
-static std::size_t bin_to_csv( std::ostringstream& oss, const char* buf, format::types_enum type, std::size_t size, const boost::optional< unsigned int >& precision )
-{
-    switch( type ) // todo: tear down bin_to_csv, use format::traits
-    {
-        case format::int8:
-            oss << static_cast< int >( *buf );
-            return sizeof( char );
-        case format::uint8:
-            oss << static_cast< unsigned int >( static_cast< unsigned char >( *buf ) );
-            return sizeof( unsigned char );
-        case format::int16: return bin_to_csv< comma::int16 >( oss, buf, precision );
-        case format::uint16: return bin_to_csv< comma::uint16 >( oss, buf, precision );
-        case format::int32: return bin_to_csv< comma::int32 >( oss, buf, precision );
-        case format::uint32: return bin_to_csv< comma::uint32 >( oss, buf, precision );
-        case format::int64: return bin_to_csv< comma::int64 >( oss, buf, precision );
-        case format::uint64: return bin_to_csv< comma::uint64 >( oss, buf, precision );
-        case format::char_t: return bin_to_csv< char >( oss, buf, precision );
-        case format::float_t: return bin_to_csv< float >( oss, buf, precision );
-        case format::double_t: return bin_to_csv< double >( oss, buf, precision );
-        case format::time:
-            oss << boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::time >::from_bin( buf, sizeof( comma::uint64 ) ) );
-            return format::traits< boost::posix_time::ptime, format::time >::size;
-        case format::long_time:
-            oss << boost::posix_time::to_iso_string( format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf, sizeof( comma::uint64 ) + sizeof( comma::uint32 ) ) );
-            return format::traits< boost::posix_time::ptime, format::long_time >::size;
-        case format::fixed_string:
-            oss << ( buf[ size - 1 ] == 0 ? std::string( buf ) : std::string( buf, size ) );
-            return size;
-        default : COMMA_THROW( comma::exception, "on type: " << type << ": todo: not implemented" );
-    }
-}
-
-} // namespace impl {
 
 void format::csv_to_bin( std::ostream& os, const std::string& csv, char delimiter, bool flush ) const
 {
@@ -339,23 +196,8 @@ void format::csv_to_bin( std::ostream& os, const std::string& csv, char delimite
 
 void format::csv_to_bin( std::ostream& os, const std::vector< std::string >& v, bool flush ) const
 {
-    if( v.size() != count_ ) { COMMA_THROW( comma::exception, "expected csv string with " << count_ << " elements, got [" << comma::join( v, ',' ) << "]" ); }
     std::vector< char > buf( size_ ); //char buf[ size_ ]; // stupid Windows
-    char* p = &buf[0];
-    unsigned int offsetIndex = 0u;
-    unsigned int count = 0u;
-    for( unsigned int i = 0; i < v.size(); ++i, ++count )
-    {
-        try
-        {
-            if( count >= elements_[ offsetIndex ].count ) { count = 0; ++offsetIndex; }
-            p += impl::csv_to_bin( p, v[i], elements_[ offsetIndex ].type, elements_[ offsetIndex ].size );
-        }
-        catch( std::exception& ex )
-        {
-            COMMA_THROW( comma::exception, "column " << i + 1 << ": "  << ex.what() );
-        }
-    }
+    codec_->csv_to_bin( &buf[0], v );
     os.write( &buf[0], size_ );
     if( flush ) { os.flush(); }
 }
@@ -382,17 +224,10 @@ std::string format::bin_to_csv( const std::string& bin, char delimiter, const bo
 
 std::string format::bin_to_csv( const char* buf, char delimiter, const boost::optional< unsigned int >& precision ) const
 {
-    std::ostringstream oss;
-    const char* p = buf;
-    unsigned int offsetIndex = 0u; // index in elements_
-    unsigned int count = 0u;
-    for( unsigned int i = 0u; i < count_; ++i, ++count )
-    {
-        if( i > 0 ) { oss << delimiter; }
-        if( count >= elements_[ offsetIndex ].count ) { count = 0; ++offsetIndex; }
-        p += impl::bin_to_csv( oss, p, elements_[ offsetIndex ].type, elements_[ offsetIndex ].size, precision );
-    }
-    return oss.str();
+    std::string s;
+    s.reserve( count_ * 8 );
+    codec_->bin_to_csv( s, buf, delimiter, precision );
+    return s;
 }
 
 const std::vector< format::element >& format::elements() const { return elements_; }
@@ -39,6 +39,7 @@
 #include <string>
 #include <vector>
 #include <boost/optional.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/type_traits.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include "../base/exception.h"
@@ -53,6 +54,7 @@ namespace comma { namespace csv {
 
 /// forward declaration
 namespace impl { class to_format; }
+class codec;
 
 /// csv to/from bin format
 /// @todo the interface has got real messy; fully refactor!
@@ -138,6 +140,9 @@ class format
         /// return as a string in minimal format, e.g. "d,d,f,f,f" -> "2d,3f"
         std::string collapsed_string() const;
         
+        /// return compiled codec for this format, which csv_to_bin() and bin_to_csv() use
+        const csv::codec& codec() const { return *codec_; }
+
         /// return format usage
         static std::string usage();
         
@@ -162,6 +167,7 @@ class format
         std::size_t size_;
         std::size_t count_;
         std::size_t elements_number_; /// total number of elements
+        boost::shared_ptr< const csv::codec > codec_;
         friend class impl::to_format;
         template < typename T > static std::string value_impl( const T& t );
 };
@@ -0,0 +1,131 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_BINARY_CAST_H_
+#define COMMA_CSV_IMPL_BINARY_CAST_H_
+
+#include <string>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../../base/exception.h"
+#include "../../csv/format.h"
+#include "../../string/string.h"
+#include "static_cast.h"
+
+namespace comma { namespace csv { namespace impl {
+
+inline void cast_( std::string& v, const std::string& s ) { v = s; }
+
+inline void cast_( char& v, const std::string& s ) { if( !s.empty() ) { v = s[0]; } }
+
+template < typename T > inline void cast_( T& v, const std::string& s ) // quick and dirty, watch performance
+{
+    const std::string& stripped = comma::strip( s, ' ' );
+    if( !stripped.empty() ) { v = boost::lexical_cast< T >( stripped ); }
+}
+
+/// conversion between a binary field of a given type and a value of type T,
+/// if they do not match, e.g. a struct member is double, but binary field is float
+///
+/// the conversion function is resolved once per field (see binary_visitor)
+/// and then called via type-erased pointer for every record instead of
+/// switching on the field type for every field of every record
+struct binary_cast
+{
+    typedef void ( *from_bin_function )( void* value, const char* buf, std::size_t size );
+
+    typedef void ( *to_bin_function )( const void* value, char* buf, std::size_t size );
+
+    template < typename T > static from_bin_function from_bin( format::types_enum type );
+
+    template < typename T > static to_bin_function to_bin( format::types_enum type );
+
+    private:
+        template < typename T, typename F, format::types_enum E >
+        static void from_bin_( void* value, const char* buf, std::size_t size ) { *static_cast< T* >( value ) = static_cast_impl< T >::value( format::traits< F, E >::from_bin( buf, size ) ); }
+
+        template < typename T >
+        static void from_string_( void* value, const char* buf, std::size_t size ) { cast_( *static_cast< T* >( value ), format::traits< std::string >::from_bin( buf, size ) ); }
+
+        template < typename T, typename F, format::types_enum E >
+        static void to_bin_( const void* value, char* buf, std::size_t size ) { format::traits< F, E >::to_bin( static_cast_impl< F >::value( *static_cast< const T* >( value ) ), buf, size ); }
+};
+
+template < typename T >
+inline binary_cast::from_bin_function binary_cast::from_bin( format::types_enum type )
+{
+    switch( type )
+    {
+        case format::int8: return &from_bin_< T, char, format::int8 >;
+        case format::uint8: return &from_bin_< T, unsigned char, format::uint8 >;
+        case format::int16: return &from_bin_< T, comma::int16, format::int16 >;
+        case format::uint16: return &from_bin_< T, comma::uint16, format::uint16 >;
+        case format::int32: return &from_bin_< T, comma::int32, format::int32 >;
+        case format::uint32: return &from_bin_< T, comma::uint32, format::uint32 >;
+        case format::int64: return &from_bin_< T, comma::int64, format::int64 >;
+        case format::uint64: return &from_bin_< T, comma::uint64, format::uint64 >;
+        case format::char_t: return &from_bin_< T, char, format::int8 >;
+        case format::float_t: return &from_bin_< T, float, format::float_t >;
+        case format::double_t: return &from_bin_< T, double, format::double_t >;
+        case format::time: return &from_bin_< T, boost::posix_time::ptime, format::time >;
+        case format::long_time: return &from_bin_< T, boost::posix_time::ptime, format::long_time >;
+        // quick and dirty: relax casting and see if it works...
+        case format::fixed_string: return &from_string_< T >;
+    }
+    COMMA_THROW( comma::exception, "expected type, got " << type );
+}
+
+template < typename T >
+inline binary_cast::to_bin_function binary_cast::to_bin( format::types_enum type )
+{
+    switch( type )
+    {
+        case format::int8: return &to_bin_< T, char, format::int8 >;
+        case format::uint8: return &to_bin_< T, unsigned char, format::uint8 >;
+        case format::int16: return &to_bin_< T, comma::int16, format::int16 >;
+        case format::uint16: return &to_bin_< T, comma::uint16, format::uint16 >;
+        case format::int32: return &to_bin_< T, comma::int32, format::int32 >;
+        case format::uint32: return &to_bin_< T, comma::uint32, format::uint32 >;
+        case format::int64: return &to_bin_< T, comma::int64, format::int64 >;
+        case format::uint64: return &to_bin_< T, comma::uint64, format::uint64 >;
+        case format::char_t: return &to_bin_< T, char, format::int8 >;
+        case format::float_t: return &to_bin_< T, float, format::float_t >;
+        case format::double_t: return &to_bin_< T, double, format::double_t >;
+        case format::time: return &to_bin_< T, boost::posix_time::ptime, format::time >;
+        case format::long_time: return &to_bin_< T, boost::posix_time::ptime, format::long_time >;
+        case format::fixed_string: return &to_bin_< T, std::string, format::fixed_string >;
+    }
+    COMMA_THROW( comma::exception, "expected type, got " << type );
+}
+
+} } } // namespace comma { namespace csv { namespace impl {
+
+#endif // COMMA_CSV_IMPL_BINARY_CAST_H_
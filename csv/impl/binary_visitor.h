@@ -44,6 +44,7 @@
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
 #include "../../xpath/xpath.h"
+#include "binary_cast.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -119,6 +120,9 @@ class binary_visitor
                 o = offset( t, it->second );
             }
             offsets_.push_back( o );
+            bool cast = o && o->type != format::traits< T >::type;
+            from_bin_.push_back( cast ? binary_cast::from_bin< T >( o->type ) : NULL );
+            to_bin_.push_back( cast ? binary_cast::to_bin< T >( o->type ) : NULL );
         }
         
         /// a convenience type
@@ -129,6 +133,12 @@ class binary_visitor
         
         /// return flags, which are true for optional values that are present
         const std::deque< bool >& optional() const { return optional_; }
+
+        /// return conversions from binary for fields, whose types do not match the format, null for others
+        const std::vector< binary_cast::from_bin_function >& from_bin() const { return from_bin_; }
+
+        /// return conversions to binary for fields, whose types do not match the format, null for others
+        const std::vector< binary_cast::to_bin_function >& to_bin() const { return to_bin_; }
         
     private:
         std::map< std::string, std::size_t > map_;
@@ -136,6 +146,8 @@ class binary_visitor
         bool full_path_as_name_;
         xpath xpath_;
         std::vector< optional_element > offsets_;
+        std::vector< binary_cast::from_bin_function > from_bin_;
+        std::vector< binary_cast::to_bin_function > to_bin_;
         std::deque< bool > empty_;
         std::deque< bool > optional_;
         const xpath& append( std::size_t index ) { xpath_.elements.back().index = index; return xpath_; }
@@ -45,6 +45,8 @@
 #include "../../string/string.h"
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
+#include "lexical.h"
+#include "tokenized_line.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -58,6 +60,11 @@ class from_ascii_
                   , const std::deque< bool >& optional
                   , const std::vector< std::string >& line );
 
+        /// constructor from line tokenized in place
+        from_ascii_( const std::vector< boost::optional< std::size_t > >& indices
+                  , const std::deque< bool >& optional
+                  , const tokenized_line& line );
+
         /// apply
         template < typename K, typename T > void apply( const K& name, boost::optional< T >& value );
 
@@ -79,29 +86,33 @@ class from_ascii_
     private:
         const std::vector< boost::optional< std::size_t > >& indices_;
         const std::deque< bool >& optional_;
-        const std::vector< std::string >& row_;
+        const std::vector< std::string >* row_;
+        const tokenized_line* tokens_;
         std::size_t index_;
         std::size_t optional_index;
-        static void lexical_cast_( char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< char >( boost::lexical_cast< int >( s ) ); }
-        static void lexical_cast_( unsigned char& v, const std::string& s ) { v = s.at( 0 ) == '\'' && s.at( 2 ) == '\'' && s.length() == 3 ? s.at( 1 ) : static_cast< unsigned char >( boost::lexical_cast< unsigned int >( s ) ); }
-        static void lexical_cast_( boost::posix_time::ptime& v, const std::string& s )
-        { 
-            if( s.empty() ) { return; }
+        std::size_t size_() const { return row_ ? row_->size() : tokens_->size(); }
+        std::string line_() const { return row_ ? join( *row_, ',' ) : tokens_->join( ',' ); }
+        static void lexical_cast_( char& v, const char* s, std::size_t size ) { v = size == 3 && s[0] == '\'' && s[2] == '\'' ? s[1] : static_cast< char >( lexical::cast< int >( s, size ) ); }
+        static void lexical_cast_( unsigned char& v, const char* s, std::size_t size ) { v = size == 3 && s[0] == '\'' && s[2] == '\'' ? s[1] : static_cast< unsigned char >( lexical::cast< unsigned int >( s, size ) ); }
+        static void lexical_cast_( boost::posix_time::ptime& v, const char* s, std::size_t size )
+        {
+            if( size == 0 ) { return; }
             try
-            { 
-                v = boost::posix_time::from_iso_string( s );
+            {
+                v = boost::posix_time::from_iso_string( std::string( s, size ) );
             }
             catch( ... )
             {
-                v = s == "+infinity" || s == "+inf" || s == "inf" ? boost::posix_time::pos_infin
-                  : s == "-infinity" || s == "-inf" ? boost::posix_time::neg_infin
+                const std::string t( s, size );
+                v = t == "+infinity" || t == "+inf" || t == "inf" ? boost::posix_time::pos_infin
+                  : t == "-infinity" || t == "-inf" ? boost::posix_time::neg_infin
                   : boost::posix_time::not_a_date_time;
             }
         }
-        static void lexical_cast_( std::string& v, const std::string& s ) { v = comma::strip( s, "\"" ); }
-        static void lexical_cast_( bool& v, const std::string& s ) { if( s.empty() ) { return; } v = static_cast< bool >( boost::lexical_cast< unsigned int >( s ) ); }
+        static void lexical_cast_( std::string& v, const char* s, std::size_t size ) { v = comma::strip( std::string( s, size ), "\"" ); }
+        static void lexical_cast_( bool& v, const char* s, std::size_t size ) { if( size == 0 ) { return; } v = static_cast< bool >( lexical::cast< unsigned int >( s, size ) ); }
         template < typename T >
-        static void lexical_cast_( T& v, const std::string& s ) { if( s.empty() ) { return; } v = boost::lexical_cast< T >( s ); }
+        static void lexical_cast_( T& v, const char* s, std::size_t size ) { if( size == 0 ) { return; } v = lexical::cast< T >( s, size ); }
 };
 
 inline from_ascii_::from_ascii_( const std::vector< boost::optional< std::size_t > >& indices
@@ -109,7 +120,20 @@ inline from_ascii_::from_ascii_( const std::vector< boost::optional< std::size_t
                            , const std::vector< std::string >& line )
     : indices_( indices )
     , optional_( optional )
-    , row_( line )
+    , row_( &line )
+    , tokens_( NULL )
+    , index_( 0 )
+    , optional_index( 0 )
+{
+}
+
+inline from_ascii_::from_ascii_( const std::vector< boost::optional< std::size_t > >& indices
+                           , const std::deque< bool >& optional
+                           , const tokenized_line& line )
+    : indices_( indices )
+    , optional_( optional )
+    , row_( NULL )
+    , tokens_( &line )
     , index_( 0 )
     , optional_index( 0 )
 {
@@ -157,9 +181,10 @@ inline void from_ascii_::apply_final( const K& key, T& value )
     if( indices_[ index_ ] )
     {
         std::size_t i = *indices_[ index_ ];
-        if( i >= row_.size() ) { COMMA_THROW( comma::exception, "got column index " << i << ", for " << row_.size() << " column(s) in line: \"" << join( row_, ',' ) << "\"" ); }
-        const std::string& s = row_[i];
-        if( !s.empty() ) { lexical_cast_( value, s ); }
+        if( i >= size_() ) { COMMA_THROW( comma::exception, "got column index " << i << ", for " << size_() << " column(s) in line: \"" << line_() << "\"" ); }
+        const char* s = row_ ? ( *row_ )[i].c_str() : ( *tokens_ )[i];
+        std::size_t size = row_ ? ( *row_ )[i].size() : tokens_->size( i );
+        if( size > 0 ) { lexical_cast_( value, s, size ); }
     }
     ++index_;
 }
@@ -46,7 +46,7 @@
 #include "../../string/string.h"
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
-#include "static_cast.h"
+#include "binary_cast.h"
 
 namespace comma { namespace csv { namespace impl {
     
@@ -56,7 +56,9 @@ class from_binary_
 {
     public:
         /// constructor
+        /// @param casts conversions resolved once for fields, whose types do not match the binary format
         from_binary_( const std::vector< boost::optional< format::element > >& offsets
+                  , const std::vector< binary_cast::from_bin_function >& casts
                   , const std::deque< bool >& optional
                   , const char* buf );
         
@@ -80,6 +82,7 @@ class from_binary_
         
     private:
         const std::vector< boost::optional< format::element > >& offsets_;
+        const std::vector< binary_cast::from_bin_function >& casts_;
         const std::deque< bool >& optional_;
         std::size_t optional_index;
         const char* buf_;
@@ -101,9 +104,11 @@ class from_binary_
 };
 
 inline from_binary_::from_binary_( const std::vector< boost::optional< format::element > >& offsets
+                               , const std::vector< binary_cast::from_bin_function >& casts
                                , const std::deque< bool >& optional
                                , const char* buf )
     : offsets_( offsets )
+    , casts_( casts )
     , optional_( optional )
     , optional_index( 0 )
     , buf_( buf )
@@ -146,16 +151,6 @@ inline void from_binary_::apply( const K& name, T& value )
 template < typename K, typename T >
 inline void from_binary_::apply_next( const K& name, T& value ) { comma::visiting::visit( name, value, *this ); }
 
-inline void cast_( std::string& v, const std::string& s ) { v = s; }
-
-inline void cast_( char& v, const std::string& s ) { if( !s.empty() ) { v = s[0]; } }
-
-template < typename T > inline void cast_( T& v, const std::string& s ) // quick and dirty, watch performance
-{
-    const std::string& stripped = comma::strip( s, ' ' );
-    if( !stripped.empty() ) { v = boost::lexical_cast< T >( stripped ); }
-}
-
 template < typename K, typename T >
 inline void from_binary_::apply_final( const K&, T& value )
 {
@@ -169,27 +164,9 @@ inline void from_binary_::apply_final( const K&, T& value )
         {
             value = format::traits< T >::from_bin( buf, size ); // copy( value, buf, size );
         }
-        else
+        else // conversion resolved once in binary_visitor
         {
-            switch( type )
-            {
-                case format::int8: value = static_cast_impl< T >::value( format::traits< char >::from_bin( buf ) ); break;
-                case format::uint8: value = static_cast_impl< T >::value( format::traits< unsigned char >::from_bin( buf ) ); break;
-                case format::int16: value = static_cast_impl< T >::value( format::traits< comma::int16 >::from_bin( buf ) ); break;
-                case format::uint16: value = static_cast_impl< T >::value( format::traits< comma::uint16 >::from_bin( buf ) ); break;
-                case format::int32: value = static_cast_impl< T >::value( format::traits< comma::int32 >::from_bin( buf ) ); break;
-                case format::uint32: value = static_cast_impl< T >::value( format::traits< comma::uint32 >::from_bin( buf ) ); break;
-                case format::int64: value = static_cast_impl< T >::value( format::traits< comma::int64 >::from_bin( buf ) ); break;
-                case format::uint64: value = static_cast_impl< T >::value( format::traits< comma::uint64 >::from_bin( buf ) ); break;
-                case format::char_t: value = static_cast_impl< T >::value( format::traits< char >::from_bin( buf ) ); break;
-                case format::float_t: value = static_cast_impl< T >::value( format::traits< float >::from_bin( buf ) ); break;
-                case format::double_t: value = static_cast_impl< T >::value( format::traits< double >::from_bin( buf ) ); break;
-                case format::time: value = static_cast_impl< T >::value( format::traits< boost::posix_time::ptime, format::time >::from_bin( buf ) ); break;
-                case format::long_time: value = static_cast_impl< T >::value( format::traits< boost::posix_time::ptime, format::long_time >::from_bin( buf ) ); break;
-                // quick and dirty: relax casting and see if it works...
-                //case format::fixed_string: value = static_cast_impl< T >::value( format::traits< std::string >::from_bin( buf, size ) ); break;
-                case format::fixed_string: cast_( value, format::traits< std::string >::from_bin( buf, size ) ); break;
-            };
+            casts_[ index_ ]( &value, buf, size );
         }
     }
     ++index_;
@@ -0,0 +1,150 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_ISO_TIME_H_
+#define COMMA_CSV_IMPL_ISO_TIME_H_
+
+#include <string>
+#include "../../base/types.h"
+
+namespace comma { namespace csv { namespace impl { namespace iso_time {
+
+/// fixed-layout conversion between iso time strings YYYYMMDDTHHMMSS[.f{1,6}]
+/// and microseconds since epoch without constructing boost::posix_time::ptime
+///
+/// only years 1400 to 9999 (supported by boost::gregorian) and valid
+/// dates and times are handled; parse() and print() return false and 0
+/// respectively for anything else, in which case the caller is expected
+/// to fall back to boost::posix_time
+
+/// days since 1970-01-01 for a given date of the proleptic gregorian calendar
+inline comma::int64 days_from_civil( int year, unsigned int month, unsigned int day )
+{
+    year -= month <= 2;
+    const int era = ( year >= 0 ? year : year - 399 ) / 400;
+    const unsigned int year_of_era = static_cast< unsigned int >( year - era * 400 );
+    const unsigned int day_of_year = ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 + day - 1;
+    const unsigned int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return static_cast< comma::int64 >( era ) * 146097 + static_cast< comma::int64 >( day_of_era ) - 719468;
+}
+
+/// date of the proleptic gregorian calendar for a given number of days since 1970-01-01
+inline void civil_from_days( comma::int64 days, int& year, unsigned int& month, unsigned int& day )
+{
+    days += 719468;
+    const comma::int64 era = ( days >= 0 ? days : days - 146096 ) / 146097;
+    const unsigned int day_of_era = static_cast< unsigned int >( days - era * 146097 );
+    const unsigned int year_of_era = ( day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096 ) / 365;
+    const unsigned int day_of_year = day_of_era - ( 365 * year_of_era + year_of_era / 4 - year_of_era / 100 );
+    const unsigned int m = ( 5 * day_of_year + 2 ) / 153;
+    day = day_of_year - ( 153 * m + 2 ) / 5 + 1;
+    month = m < 10 ? m + 3 : m - 9;
+    year = static_cast< int >( year_of_era + era * 400 ) + ( month <= 2 );
+}
+
+inline unsigned int days_in_month( int year, unsigned int month )
+{
+    static const unsigned int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return month == 2 && ( year % 4 == 0 && ( year % 100 != 0 || year % 400 == 0 ) ) ? 29 : days[ month - 1 ];
+}
+
+inline bool digits_( const char* s, unsigned int n, unsigned int& value )
+{
+    value = 0;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        unsigned int d = static_cast< unsigned char >( s[i] ) - static_cast< unsigned char >( '0' );
+        if( d > 9 ) { return false; }
+        value = value * 10 + d;
+    }
+    return true;
+}
+
+/// parse YYYYMMDDTHHMMSS[.f{1,6}] into microseconds since epoch, return false if not on the fast path
+inline bool parse( const char* s, std::size_t size, comma::int64& microseconds )
+{
+    if( size < 15 || size == 16 || size > 22 || s[8] != 'T' ) { return false; }
+    unsigned int year, month, day, hours, minutes, seconds, fraction = 0;
+    if(    !digits_( s, 4, year ) || !digits_( s + 4, 2, month ) || !digits_( s + 6, 2, day )
+        || !digits_( s + 9, 2, hours ) || !digits_( s + 11, 2, minutes ) || !digits_( s + 13, 2, seconds ) ) { return false; }
+    if( year < 1400 || month < 1 || month > 12 || day < 1 || day > days_in_month( year, month ) || hours > 23 || minutes > 59 || seconds > 59 ) { return false; }
+    if( size > 15 )
+    {
+        if( s[15] != '.' || !digits_( s + 16, size - 16, fraction ) ) { return false; }
+        for( std::size_t i = size - 16; i < 6; ++i ) { fraction *= 10; }
+    }
+    comma::int64 t = days_from_civil( year, month, day ) * 86400 + hours * 3600 + minutes * 60 + seconds;
+    microseconds = t * 1000000 + fraction;
+    return true;
+}
+
+/// print microseconds since epoch as boost::posix_time::to_iso_string() does, i.e. YYYYMMDDTHHMMSS[.ffffff],
+/// return number of characters written or 0 if not on the fast path
+/// @note buf must have space for at least 22 characters
+inline std::size_t print( comma::int64 microseconds, char* buf )
+{
+    comma::int64 seconds = microseconds / 1000000;
+    comma::int64 fraction = microseconds % 1000000;
+    if( fraction < 0 ) { fraction += 1000000; --seconds; }
+    comma::int64 days = seconds / 86400;
+    comma::int64 time_of_day = seconds % 86400;
+    if( time_of_day < 0 ) { time_of_day += 86400; --days; }
+    int year;
+    unsigned int month, day;
+    civil_from_days( days, year, month, day );
+    if( year < 1400 || year > 9999 ) { return 0; }
+    unsigned int values[] = { static_cast< unsigned int >( year ), month, day, static_cast< unsigned int >( time_of_day / 3600 ), static_cast< unsigned int >( time_of_day / 60 % 60 ), static_cast< unsigned int >( time_of_day % 60 ) };
+    static const unsigned int widths[] = { 4, 2, 2, 2, 2, 2 };
+    char* p = buf;
+    for( unsigned int i = 0; i < 6; ++i )
+    {
+        if( i == 3 ) { *p++ = 'T'; }
+        for( unsigned int j = widths[i]; j > 0; --j, values[i] /= 10 ) { p[ j - 1 ] = static_cast< char >( '0' + values[i] % 10 ); }
+        p += widths[i];
+    }
+    if( fraction == 0 ) { return p - buf; }
+    *p++ = '.';
+    for( unsigned int j = 6; j > 0; --j, fraction /= 10 ) { p[ j - 1 ] = static_cast< char >( '0' + fraction % 10 ); }
+    return p + 6 - buf;
+}
+
+/// append microseconds since epoch as print() writes them, return false and append nothing if not on the fast path
+inline bool append( std::string& s, comma::int64 microseconds )
+{
+    char buf[22];
+    std::size_t size = print( microseconds, buf );
+    s.append( buf, size );
+    return size > 0;
+}
+
+} } } } // namespace comma { namespace csv { namespace impl { namespace iso_time {
+
+#endif // COMMA_CSV_IMPL_ISO_TIME_H_
@@ -0,0 +1,191 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_LEXICAL_H_
+#define COMMA_CSV_IMPL_LEXICAL_H_
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <boost/lexical_cast.hpp>
+#include "../../base/types.h"
+
+namespace comma { namespace csv { namespace impl { namespace lexical {
+
+/// fast conversion of a field to a number without creating temporary strings
+///
+/// only plain decimal notation is handled on the fast path; anything else
+/// (hexadecimal, nan, inf, leading spaces, overflow, etc) is passed to
+/// boost::lexical_cast, thus the result and the exceptions thrown are the same as before
+///
+/// @note s[size] must not be a digit, e.g. it is the terminating zero of std::string
+///       or a delimiter replaced with zero by tokenized_line
+template < typename T > struct parser { static bool parse( const char*, std::size_t, T& ) { return false; } };
+
+template < typename T > struct integer_parser
+{
+    static bool parse( const char* s, std::size_t size, T& t )
+    {
+        const char* end = s + size;
+        bool negative = false;
+        if( s == end ) { return false; }
+        if( *s == '-' ) { if( !std::numeric_limits< T >::is_signed ) { return false; } negative = true; ++s; }
+        else if( *s == '+' ) { ++s; }
+        if( s == end ) { return false; }
+        comma::uint64 v = 0;
+        for( ; s != end; ++s )
+        {
+            unsigned int d = static_cast< unsigned char >( *s ) - static_cast< unsigned char >( '0' );
+            if( d > 9 || v > ( std::numeric_limits< comma::uint64 >::max() - d ) / 10 ) { return false; }
+            v = v * 10 + d;
+        }
+        if( !negative )
+        {
+            if( v > static_cast< comma::uint64 >( std::numeric_limits< T >::max() ) ) { return false; }
+            t = static_cast< T >( v );
+            return true;
+        }
+        if( v > static_cast< comma::uint64 >( std::numeric_limits< T >::max() ) + 1 ) { return false; }
+        t = v == 0 ? T( 0 ) : static_cast< T >( -static_cast< comma::int64 >( v - 1 ) - 1 );
+        return true;
+    }
+};
+
+template < typename T > struct real_parser
+{
+    static bool parse( const char* s, std::size_t size, T& t )
+    {
+        if( size == 0 ) { return false; }
+        for( const char* p = s; p != s + size; ++p ) // plain decimal notation only
+        {
+            switch( *p )
+            {
+                case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+                case '.': case 'e': case 'E': case '+': case '-':
+                    break;
+                default:
+                    return false;
+            }
+        }
+        char* end;
+        errno = 0;
+        T v = strto_( s, &end );
+        if( end != s + size || errno != 0 ) { return false; }
+        t = v;
+        return true;
+    }
+
+    private:
+        static float strto_( const char* s, char** end, float* ) { return ::strtof( s, end ); }
+        static double strto_( const char* s, char** end, double* ) { return ::strtod( s, end ); }
+        static long double strto_( const char* s, char** end, long double* ) { return ::strtold( s, end ); }
+        static T strto_( const char* s, char** end ) { return strto_( s, end, static_cast< T* >( NULL ) ); }
+};
+
+template <> struct parser< comma::int16 > : public integer_parser< comma::int16 > {};
+template <> struct parser< comma::uint16 > : public integer_parser< comma::uint16 > {};
+template <> struct parser< comma::int32 > : public integer_parser< comma::int32 > {};
+template <> struct parser< comma::uint32 > : public integer_parser< comma::uint32 > {};
+template <> struct parser< long > : public integer_parser< long > {};
+template <> struct parser< unsigned long > : public integer_parser< unsigned long > {};
+template <> struct parser< long long > : public integer_parser< long long > {};
+template <> struct parser< unsigned long long > : public integer_parser< unsigned long long > {};
+template <> struct parser< float > : public real_parser< float > {};
+template <> struct parser< double > : public real_parser< double > {};
+template <> struct parser< long double > : public real_parser< long double > {};
+
+/// convert field of given size to a number, fall back to boost::lexical_cast if not on the fast path
+template < typename T >
+inline T cast( const char* s, std::size_t size )
+{
+    T t;
+    return parser< T >::parse( s, size, t ) ? t : boost::lexical_cast< T >( s, size );
+}
+
+/// write unsigned integer in decimal notation, return number of characters written
+/// @note buf must have space for at least 20 characters
+inline std::size_t to_chars( char* buf, comma::uint64 v )
+{
+    char digits[20];
+    char* p = digits + sizeof( digits );
+    do { *--p = static_cast< char >( '0' + v % 10 ); v /= 10; } while( v != 0 );
+    std::size_t size = digits + sizeof( digits ) - p;
+    for( std::size_t i = 0; i < size; ++i ) { buf[i] = p[i]; }
+    return size;
+}
+
+/// write signed integer in decimal notation, return number of characters written
+/// @note buf must have space for at least 20 characters
+inline std::size_t to_chars( char* buf, comma::int64 v )
+{
+    if( v >= 0 ) { return to_chars( buf, static_cast< comma::uint64 >( v ) ); }
+    *buf = '-';
+    return 1 + to_chars( buf + 1, static_cast< comma::uint64 >( -( v + 1 ) ) + 1 );
+}
+
+/// write floating point number exactly as std::ostream with given precision
+/// in default notation does, i.e. as printf( "%.*g" ); integral values are
+/// written without going through printf, return number of characters written
+/// @note buf must have space for at least precision + 16 characters
+inline std::size_t to_chars( char* buf, double v, unsigned int precision )
+{
+    if( precision == 0 ) { precision = 1; } // as printf does
+    if( std::fabs( v ) < 1e15 && v == static_cast< double >( static_cast< comma::int64 >( v ) ) )
+    {
+        comma::int64 i = static_cast< comma::int64 >( v );
+        comma::uint64 a = i < 0 ? -i : i;
+        unsigned int digits = 1;
+        for( comma::uint64 m = 10; digits < 16 && a >= m; m *= 10, ++digits );
+        if( digits <= precision )
+        {
+            if( i == 0 && std::signbit( v ) ) { buf[0] = '-'; buf[1] = '0'; return 2; }
+            return to_chars( buf, i );
+        }
+    }
+    int size = ::snprintf( buf, precision + 16, "%.*g", static_cast< int >( precision ), v );
+    return size < 0 ? 0 : static_cast< std::size_t >( size );
+}
+
+/// append floating point number as to_chars() writes it; very high precisions go through std::ostream
+inline void append( std::string& s, double v, unsigned int precision )
+{
+    if( precision > 48 ) { std::ostringstream oss; oss.precision( precision ); oss << v; s += oss.str(); return; }
+    char buf[64];
+    s.append( buf, to_chars( buf, v, precision ) );
+}
+
+} } } } // namespace comma { namespace csv { namespace impl { namespace lexical {
+
+#endif // COMMA_CSV_IMPL_LEXICAL_H_
@@ -0,0 +1,140 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "mapped_file.h"
+
+namespace comma { namespace csv { namespace impl {
+
+#ifdef WIN32
+
+mapped_file* mapped_file::open( const std::string& ) { return NULL; } // todo
+
+mapped_file* mapped_file::open( int ) { return NULL; } // todo
+
+mapped_file::~mapped_file() {}
+
+#else // #ifdef WIN32
+
+// if the file gets truncated while mapped, reading past its new end raises SIGBUS (with MAP_PRIVATE, too),
+// which would otherwise kill the process without a word; exit with an error instead
+// mapped files are registered in a fixed-size table, since it is read from the signal handler; no locking, since mapping is done in the main thread
+static const unsigned int max_mappings = 32;
+static const char* volatile mappings_begin[ max_mappings ];
+static const char* volatile mappings_end[ max_mappings ];
+static struct sigaction previous_sigbus_action;
+static bool sigbus_handler_installed = false;
+
+static void on_sigbus( int sig, siginfo_t* info, void* context )
+{
+    const char* address = static_cast< const char* >( info->si_addr );
+    for( unsigned int i = 0; i < max_mappings; ++i )
+    {
+        if( mappings_begin[i] && mappings_begin[i] <= address && address < mappings_end[i] )
+        {
+            static const char message[] = "comma: mapped file: bus error on reading mapped file; the file probably has been truncated while mapped\n";
+            if( ::write( 2, message, sizeof( message ) - 1 ) < 0 ) {}
+            ::_exit( 1 );
+        }
+    }
+    if( previous_sigbus_action.sa_flags & SA_SIGINFO ) { if( previous_sigbus_action.sa_sigaction ) { previous_sigbus_action.sa_sigaction( sig, info, context ); return; } }
+    else if( previous_sigbus_action.sa_handler != SIG_DFL && previous_sigbus_action.sa_handler != SIG_IGN ) { previous_sigbus_action.sa_handler( sig ); return; }
+    ::signal( SIGBUS, SIG_DFL ); // not ours: the faulting access is retried and terminates the process as usual
+}
+
+static void register_mapping( const char* data, std::size_t size )
+{
+    if( !sigbus_handler_installed )
+    {
+        struct sigaction action;
+        ::memset( &action, 0, sizeof( action ) );
+        action.sa_sigaction = on_sigbus;
+        action.sa_flags = SA_SIGINFO;
+        ::sigemptyset( &action.sa_mask );
+        if( ::sigaction( SIGBUS, &action, &previous_sigbus_action ) != 0 ) { return; }
+        sigbus_handler_installed = true;
+    }
+    for( unsigned int i = 0; i < max_mappings; ++i )
+    {
+        if( mappings_begin[i] ) { continue; }
+        mappings_end[i] = data + size;
+        mappings_begin[i] = data;
+        return;
+    }
+}
+
+static void unregister_mapping( const char* data )
+{
+    for( unsigned int i = 0; i < max_mappings; ++i ) { if( mappings_begin[i] == data ) { mappings_begin[i] = NULL; return; } }
+}
+
+mapped_file* mapped_file::open( const std::string& filename )
+{
+    struct stat s;
+    if( ::stat( filename.c_str(), &s ) != 0 || !S_ISREG( s.st_mode ) ) { return NULL; } // e.g. do not block on opening named pipes
+    int fd = ::open( filename.c_str(), O_RDONLY );
+    if( fd < 0 ) { return NULL; }
+    mapped_file* f = open( fd );
+    ::close( fd );
+    return f;
+}
+
+mapped_file* mapped_file::open( int fd )
+{
+    struct stat s;
+    if( ::fstat( fd, &s ) != 0 || !S_ISREG( s.st_mode ) ) { return NULL; }
+    off_t offset = ::lseek( fd, 0, SEEK_CUR );
+    if( offset < 0 || offset > s.st_size ) { return NULL; }
+    if( s.st_size == 0 ) { return new mapped_file( NULL, 0, 0 ); } // nothing to map
+    void* data = ::mmap( NULL, s.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    if( data == MAP_FAILED ) { return NULL; }
+    ::madvise( data, s.st_size, MADV_SEQUENTIAL );
+    register_mapping( static_cast< const char* >( data ), s.st_size );
+    return new mapped_file( static_cast< char* >( data ), s.st_size, offset );
+}
+
+mapped_file::~mapped_file()
+{
+    if( !data_ ) { return; }
+    unregister_mapping( data_ );
+    ::munmap( data_, size_ );
+}
+
+#endif // #ifdef WIN32
+
+} } } // namespace comma { namespace csv { namespace impl {
@@ -0,0 +1,71 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_MAPPED_FILE_H_
+#define COMMA_CSV_IMPL_MAPPED_FILE_H_
+
+#include <string>
+#include <boost/noncopyable.hpp>
+
+namespace comma { namespace csv { namespace impl {
+
+/// read-only memory mapping of a regular file
+/// @note if the file is truncated while mapped, reading the lost pages would raise SIGBUS;
+///       instead, the process exits with an error message, since there is no way to recover
+class mapped_file : public boost::noncopyable
+{
+    public:
+        /// map file; return NULL, if it cannot be mapped, e.g. it is not a regular file
+        static mapped_file* open( const std::string& filename );
+
+        /// map file from the current position of the file descriptor to the end; return NULL, if it cannot be mapped
+        /// @note the file descriptor can be closed afterwards
+        static mapped_file* open( int fd );
+
+        /// destructor
+        ~mapped_file();
+
+        /// return mapped data
+        const char* data() const { return data_ + offset_; }
+
+        /// return size of mapped data
+        std::size_t size() const { return size_ - offset_; }
+
+    private:
+        mapped_file( char* data, std::size_t size, std::size_t offset ) : data_( data ), size_( size ), offset_( offset ) {}
+        char* data_;
+        std::size_t size_;
+        std::size_t offset_;
+};
+
+} } } // namespace comma { namespace csv { namespace impl {
+
+#endif // COMMA_CSV_IMPL_MAPPED_FILE_H_
@@ -0,0 +1,192 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_PIPELINE_H_
+#define COMMA_CSV_IMPL_PIPELINE_H_
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace comma { namespace csv { namespace impl {
+
+/// convert input in chunks on worker threads, write converted chunks in input order
+///
+/// reader is called on a dedicated thread: bool reader( std::string& chunk ), fills chunk
+/// and returns true or returns false on end of input; converter is copied for each worker:
+/// void converter( const std::string& chunk, std::string& output ), appends to output
+/// and on error should throw leaving in output whatever it converted before the error;
+/// at most capacity chunks are in flight; an exception thrown by reader or converter is
+/// rethrown by run() once all the chunks preceding it have been written, as if the input
+/// had been converted sequentially
+template < typename Reader, typename Converter >
+class pipeline : public boost::noncopyable
+{
+    public:
+        pipeline( unsigned int threads, const Reader& reader, const Converter& converter, unsigned int capacity = 0 )
+            : state_( new state_t( reader, capacity == 0 ? threads * 2 + 2 : capacity ) )
+        {
+            reader_ = std::thread( &pipeline::read_, state_ );
+            for( unsigned int i = 0; i < ( threads == 0 ? 1 : threads ); ++i ) { workers_.push_back( std::thread( &pipeline::convert_, state_, converter ) ); }
+        }
+
+        ~pipeline()
+        {
+            bool reading;
+            {
+                std::lock_guard< std::mutex > lock( state_->mutex );
+                state_->stopped = true;
+                reading = state_->reading;
+            }
+            state_->condition.notify_all();
+            for( std::size_t i = 0; i < workers_.size(); ++i ) { workers_[i].join(); }
+            if( reading ) { reader_.detach(); } else { reader_.join(); } // reader may be blocked on input; it shares the state and exits once input returns
+        }
+
+        /// write converted chunks to stream until end of input
+        void run( std::ostream& os, bool flush = false )
+        {
+            state_t& s = *state_;
+            while( true )
+            {
+                chunk* c;
+                {
+                    std::unique_lock< std::mutex > lock( s.mutex );
+                    s.condition.wait( lock, [&]() { return ( s.written < s.read && s.at( s.written ).converted ) || ( s.end && s.written == s.read ); } );
+                    if( s.written == s.read ) { return; }
+                    c = &s.at( s.written );
+                }
+                os.write( &c->output[0], c->output.size() ); // on error, output converted before it
+                if( flush || c->error ) { os.flush(); }
+                if( c->error ) { std::rethrow_exception( c->error ); }
+                {
+                    std::lock_guard< std::mutex > lock( s.mutex );
+                    c->input.clear();
+                    c->output.clear();
+                    c->converted = false;
+                    ++s.written;
+                }
+                s.condition.notify_all();
+            }
+        }
+
+    private:
+        struct chunk
+        {
+            std::string input;
+            std::string output;
+            bool converted;
+            std::exception_ptr error;
+            chunk() : converted( false ) {}
+        };
+
+        struct state_t
+        {
+            Reader reader;
+            std::vector< chunk > chunks;
+            std::size_t read; // number of chunks read
+            std::size_t converting; // number of chunks taken by workers
+            std::size_t written;
+            bool end;
+            bool stopped;
+            bool reading;
+            std::mutex mutex;
+            std::condition_variable condition;
+            state_t( const Reader& reader, unsigned int capacity ) : reader( reader ), chunks( capacity ), read( 0 ), converting( 0 ), written( 0 ), end( false ), stopped( false ), reading( false ) {}
+            chunk& at( std::size_t i ) { return chunks[ i % chunks.size() ]; }
+        };
+
+        boost::shared_ptr< state_t > state_;
+        std::thread reader_;
+        std::vector< std::thread > workers_;
+
+        static void read_( boost::shared_ptr< state_t > state )
+        {
+            state_t& s = *state;
+            while( true )
+            {
+                chunk* c;
+                {
+                    std::unique_lock< std::mutex > lock( s.mutex );
+                    s.condition.wait( lock, [&]() { return s.stopped || s.read - s.written < s.chunks.size(); } );
+                    if( s.stopped ) { return; }
+                    c = &s.at( s.read );
+                    s.reading = true;
+                }
+                bool ok = false;
+                try { ok = s.reader( c->input ); }
+                catch( ... ) { c->error = std::current_exception(); ok = true; } // chunk with error is the last one
+                {
+                    std::lock_guard< std::mutex > lock( s.mutex );
+                    s.reading = false;
+                    if( ok ) { ++s.read; }
+                    if( !ok || c->error ) { s.end = true; }
+                }
+                s.condition.notify_all();
+                if( !ok || c->error ) { return; }
+            }
+        }
+
+        static void convert_( boost::shared_ptr< state_t > state, Converter converter )
+        {
+            state_t& s = *state;
+            while( true )
+            {
+                chunk* c;
+                {
+                    std::unique_lock< std::mutex > lock( s.mutex );
+                    s.condition.wait( lock, [&]() { return s.stopped || s.converting < s.read || s.end; } );
+                    if( s.stopped || s.converting == s.read ) { return; }
+                    c = &s.at( s.converting++ );
+                }
+                if( !c->error ) // otherwise, failed to read
+                {
+                    try { converter( c->input, c->output ); }
+                    catch( ... ) { c->error = std::current_exception(); }
+                }
+                {
+                    std::lock_guard< std::mutex > lock( s.mutex );
+                    c->converted = true;
+                }
+                s.condition.notify_all();
+            }
+        }
+};
+
+} } } // namespace comma { namespace csv { namespace impl {
+
+#endif // COMMA_CSV_IMPL_PIPELINE_H_
@@ -32,6 +32,8 @@
 #ifndef COMMA_CSV_IMPL_TOASCII_HEADER_GUARD_
 #define COMMA_CSV_IMPL_TOASCII_HEADER_GUARD_
 
+#include <limits>
+#include <sstream>
 #include <vector>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/lexical_cast.hpp>
@@ -43,6 +45,9 @@
 #include "../../string/string.h"
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
+#include "epoch.h"
+#include "iso_time.h"
+#include "lexical.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -87,15 +92,27 @@ class to_ascii
         boost::optional< unsigned int > precision_;
         boost::optional< char > quote_;
 
-        std::string as_string_( const boost::posix_time::ptime& v ) { return to_iso_string( v ); }
+        std::string as_string_( const boost::posix_time::ptime& v );
         std::string as_string_( const std::string& v ) { return quote_ ? *quote_ + v + *quote_ : v; } // todo: escape/unescape
         // todo: better output semantics for char/unsigned char
-        std::string as_string_( const char& v ) { std::ostringstream oss; oss << static_cast< int >( v ); return oss.str(); }
-        std::string as_string_( const unsigned char& v ) { std::ostringstream oss; oss << static_cast< unsigned int >( v ); return oss.str(); }
+        std::string as_string_( const char& v ) { char buf[20]; return std::string( buf, lexical::to_chars( buf, static_cast< comma::int64 >( v ) ) ); }
+        std::string as_string_( const unsigned char& v ) { char buf[20]; return std::string( buf, lexical::to_chars( buf, static_cast< comma::uint64 >( v ) ) ); }
+        std::string as_string_( float v ) { return as_string_( static_cast< double >( v ) ); }
+        std::string as_string_( double v );
         void set_precision_( std::ostringstream& oss ) const;
 
         template < typename T >
-        std::string as_string_( T v )
+        std::string as_string_( T v ) { return as_string_( v, boost::is_integral< T >() ); }
+
+        template < typename T >
+        std::string as_string_( T v, boost::true_type )
+        {
+            char buf[20];
+            return std::string( buf, std::numeric_limits< T >::is_signed ? lexical::to_chars( buf, static_cast< comma::int64 >( v ) ) : lexical::to_chars( buf, static_cast< comma::uint64 >( v ) ) );
+        }
+
+        template < typename T >
+        std::string as_string_( T v, boost::false_type )
         {
             std::ostringstream oss;
             set_precision_( oss );
@@ -104,6 +121,21 @@ class to_ascii
         }
 };
 
+inline std::string to_ascii::as_string_( const boost::posix_time::ptime& v )
+{
+    static const boost::posix_time::ptime base( impl::epoch );
+    if( v.is_special() ) { return to_iso_string( v ); }
+    std::string s;
+    return iso_time::append( s, ( v - base ).total_microseconds() ) ? s : to_iso_string( v );
+}
+
+inline std::string to_ascii::as_string_( double v )
+{
+    std::string s;
+    lexical::append( s, v, precision_ ? *precision_ : 6 ); // default precision as std::ostream
+    return s;
+}
+
 inline to_ascii::to_ascii( const std::vector< boost::optional< std::size_t > >& indices
                          , std::vector< std::string >& line
                          , boost::optional< char > quote )
@@ -43,7 +43,7 @@
 #include "../../csv/format.h"
 #include "../../visiting/visit.h"
 #include "../../visiting/while.h"
-#include "static_cast.h"
+#include "binary_cast.h"
 
 namespace comma { namespace csv { namespace impl {
 
@@ -53,7 +53,8 @@ class to_binary
 {
     public:
         /// constructor
-        to_binary( const std::vector< boost::optional< format::element > >& offsets, char* buf );
+        /// @param casts conversions resolved once for fields, whose types do not match the binary format
+        to_binary( const std::vector< boost::optional< format::element > >& offsets, const std::vector< binary_cast::to_bin_function >& casts, char* buf );
         
         /// apply
         template < typename K, typename T > void apply( const K& name, const boost::optional< T >& value );
@@ -78,6 +79,7 @@ class to_binary
         
     private:
         const std::vector< boost::optional< format::element > >& offsets_;
+        const std::vector< binary_cast::to_bin_function >& casts_;
         char* buf_;
         std::size_t index_;
 //         static void copy( char* buf, const boost::posix_time::ptime& v, std::size_t )
@@ -100,8 +102,9 @@ class to_binary
 //         static void copy( char* buf, T v, std::size_t size ) { ::memcpy( buf, &v, size ); }
 };
 
-inline to_binary::to_binary( const std::vector< boost::optional< format::element > >& offsets, char* buf )
+inline to_binary::to_binary( const std::vector< boost::optional< format::element > >& offsets, const std::vector< binary_cast::to_bin_function >& casts, char* buf )
     : offsets_( offsets )
+    , casts_( casts )
     , buf_( buf )
     , index_( 0 )
 {
@@ -149,25 +152,9 @@ inline void to_binary::apply_final( const K&, const T& value )
         {
             format::traits< T >::to_bin( value, buf, size ); //copy( buf, value, size );
         }
-        else
+        else // conversion resolved once in binary_visitor
         {
-            switch( type )
-            {
-                case format::int8: format::traits< char >::to_bin( static_cast_impl< char >::value( value ), buf ); break;
-                case format::uint8: format::traits< unsigned char >::to_bin( static_cast_impl< unsigned char >::value( value ), buf ); break;
-                case format::int16: format::traits< comma::int16 >::to_bin( static_cast_impl< comma::int16 >::value( value ), buf ); break;
-                case format::uint16: format::traits< comma::uint16 >::to_bin( static_cast_impl< comma::uint16 >::value( value ), buf ); break;
-                case format::int32: format::traits< comma::int32 >::to_bin( static_cast_impl< comma::int32 >::value( value ), buf ); break;
-                case format::uint32: format::traits< comma::int32 >::to_bin( static_cast_impl< comma::uint32 >::value( value ), buf ); break;
-                case format::int64: format::traits< comma::int64 >::to_bin( static_cast_impl< comma::int64 >::value( value ), buf ); break;
-                case format::uint64: format::traits< comma::uint64 >::to_bin( static_cast_impl< comma::uint64 >::value( value ), buf ); break;
-                case format::char_t: format::traits< char >::to_bin( static_cast_impl< char >::value( value ), buf ); break;
-                case format::float_t: format::traits< float >::to_bin( static_cast_impl< float >::value( value ), buf ); break;
-                case format::double_t: format::traits< double >::to_bin( static_cast_impl< double >::value( value ), buf ); break;
-                case format::time: format::traits< boost::posix_time::ptime, format::time >::to_bin( static_cast_impl< boost::posix_time::ptime >::value( value ), buf ); break;
-                case format::long_time: format::traits< boost::posix_time::ptime, format::long_time >::to_bin( static_cast_impl< boost::posix_time::ptime >::value( value ), buf ); break;
-                case format::fixed_string: format::traits< std::string >::to_bin( static_cast_impl< std::string >::value( value ), buf, size ); break;
-            };
+            casts_[ index_ ]( &value, buf, size );
         }
     }
     ++index_;
@@ -0,0 +1,130 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_IMPL_TOKENIZED_LINE_H_
+#define COMMA_CSV_IMPL_TOKENIZED_LINE_H_
+
+#include <string>
+#include <vector>
+
+namespace comma { namespace csv { namespace impl {
+
+/// line split in place into fields, each field being an (offset, size) slice of the line buffer
+///
+/// delimiters are replaced with zeros, thus each field is a null-terminated string
+/// that can be parsed without copying; the slice buffer is reused between lines,
+/// thus once warmed up, tokenizing a line does not allocate memory
+class tokenized_line
+{
+    public:
+        struct slice
+        {
+            std::size_t offset;
+            std::size_t size;
+            slice( std::size_t offset = 0, std::size_t size = 0 ) : offset( offset ), size( size ) {}
+        };
+
+        tokenized_line() : data_( NULL ) {}
+
+        /// split line in place; the line must not be modified or destroyed while tokenized_line is in use
+        void split( std::string& line, char delimiter )
+        {
+            slices_.clear();
+            data_ = line.c_str();
+            std::size_t begin = 0;
+            for( std::size_t i = 0; i < line.size(); ++i )
+            {
+                if( line[i] != delimiter ) { continue; }
+                line[i] = 0;
+                slices_.push_back( slice( begin, i - begin ) );
+                begin = i + 1;
+            }
+            slices_.push_back( slice( begin, line.size() - begin ) );
+        }
+
+        /// split line in place as above, but do not split on delimiters inside quotes;
+        /// enclosing quotes are not part of a field (the closing quote is replaced with zero)
+        void split( std::string& line, char delimiter, char quote )
+        {
+            slices_.clear();
+            data_ = line.c_str();
+            std::size_t begin = 0;
+            bool quoted = false;
+            for( std::size_t i = 0; i <= line.size(); ++i )
+            {
+                if( i < line.size() )
+                {
+                    if( line[i] == quote ) { quoted = !quoted; }
+                    if( quoted || line[i] != delimiter ) { continue; }
+                    line[i] = 0;
+                }
+                std::size_t size = i - begin;
+                if( size > 1 && line[begin] == quote && line[ i - 1 ] == quote ) { line[ i - 1 ] = 0; slices_.push_back( slice( begin + 1, size - 2 ) ); }
+                else { slices_.push_back( slice( begin, size ) ); }
+                begin = i + 1;
+            }
+        }
+
+        /// return number of fields
+        std::size_t size() const { return slices_.size(); }
+
+        /// return null-terminated field
+        const char* operator[]( std::size_t i ) const { return data_ + slices_[i].offset; }
+
+        /// return field size
+        std::size_t size( std::size_t i ) const { return slices_[i].size; }
+
+        /// return field slices
+        const std::vector< slice >& slices() const { return slices_; }
+
+        /// copy fields into strings, reusing already allocated strings
+        void to_strings( std::vector< std::string >& v ) const
+        {
+            v.resize( slices_.size() );
+            for( std::size_t i = 0; i < slices_.size(); ++i ) { v[i].assign( data_ + slices_[i].offset, slices_[i].size ); }
+        }
+
+        /// return fields joined with delimiter (convenience function, slow)
+        std::string join( char delimiter ) const
+        {
+            std::string s;
+            for( std::size_t i = 0; i < slices_.size(); ++i ) { if( i > 0 ) { s += delimiter; } s.append( data_ + slices_[i].offset, slices_[i].size ); }
+            return s;
+        }
+
+    private:
+        const char* data_;
+        std::vector< slice > slices_;
+};
+
+} } } // namespace comma { namespace csv { namespace impl {
+
+#endif // COMMA_CSV_IMPL_TOKENIZED_LINE_H_
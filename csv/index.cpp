@@ -0,0 +1,155 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <boost/lexical_cast.hpp>
+#include "../base/exception.h"
+#include "../string/string.h"
+#include "index.h"
+
+namespace comma { namespace csv {
+
+index::index() : column( 0 ), time( false ), delimiter( ',' ), size( 0 ), modified( 0 ) {}
+
+double index::key( const boost::posix_time::ptime& t )
+{
+    static const boost::posix_time::ptime epoch( boost::gregorian::date( 1970, 1, 1 ) );
+    if( t.is_special() ) { COMMA_THROW( comma::exception, "expected valid time as key, got " << boost::posix_time::to_iso_string( t ) ); }
+    return ( t - epoch ).total_microseconds();
+}
+
+static bool less_( const index::entry& lhs, double rhs ) { return lhs.key < rhs; }
+
+comma::uint64 index::lower_bound( double key ) const
+{
+    std::vector< entry >::const_iterator it = std::lower_bound( entries.begin(), entries.end(), key, less_ );
+    if( it == entries.begin() ) { return 0; } // first entry, which key is not less than given, may be preceded by records with the same key
+    return ( --it )->offset;
+}
+
+void index::stamp( const std::string& data_filename )
+{
+    #ifdef WIN32
+    COMMA_THROW( comma::exception, "not implemented on windows" );
+    #else
+    struct stat s;
+    if( ::stat( data_filename.c_str(), &s ) != 0 ) { COMMA_THROW( comma::exception, "failed to stat '" << data_filename << "'" ); }
+    size = s.st_size;
+    modified = s.st_mtime;
+    #endif
+}
+
+void index::write( std::ostream& os ) const
+{
+    os << "comma-csv-index;column=" << column << ";time=" << time << ";delimiter=" << int( delimiter ) << ";binary=" << binary << ";size=" << size << ";modified=" << modified << std::endl;
+    char buf[64];
+    for( std::size_t i = 0; i < entries.size(); ++i )
+    {
+        ::snprintf( buf, sizeof( buf ), "%.17g", entries[i].key );
+        os << buf << ',' << entries[i].offset << '\n';
+    }
+    os.flush();
+}
+
+index index::read( std::istream& is )
+{
+    index r;
+    std::string line;
+    std::getline( is, line );
+    const std::vector< std::string >& v = comma::split( line, ';' );
+    if( v.empty() || v[0] != "comma-csv-index" ) { COMMA_THROW( comma::exception, "expected index header, got: \"" << line << "\"" ); }
+    for( std::size_t i = 1; i < v.size(); ++i )
+    {
+        std::string::size_type p = v[i].find( '=' );
+        if( p == std::string::npos ) { COMMA_THROW( comma::exception, "expected <name>=<value> in index header, got: \"" << v[i] << "\"" ); }
+        std::string name = v[i].substr( 0, p );
+        std::string value = v[i].substr( p + 1 );
+        if( name == "column" ) { r.column = boost::lexical_cast< unsigned int >( value ); }
+        else if( name == "time" ) { r.time = value == "1"; }
+        else if( name == "delimiter" ) { r.delimiter = char( boost::lexical_cast< int >( value ) ); }
+        else if( name == "binary" ) { r.binary = value; }
+        else if( name == "size" ) { r.size = boost::lexical_cast< comma::uint64 >( value ); }
+        else if( name == "modified" ) { r.modified = boost::lexical_cast< comma::int64 >( value ); }
+    }
+    while( is.good() && !is.eof() )
+    {
+        std::getline( is, line );
+        if( line.empty() ) { continue; }
+        char* end;
+        double key = ::strtod( line.c_str(), &end );
+        if( *end != ',' ) { COMMA_THROW( comma::exception, "expected <key>,<offset> in index, got: \"" << line << "\"" ); }
+        r.entries.push_back( entry( key, boost::lexical_cast< comma::uint64 >( end + 1 ) ) );
+    }
+    return r;
+}
+
+boost::optional< index > index::load( const std::string& data_filename, const csv::options& csv, const std::string& field )
+{
+    std::ifstream ifs( filename( data_filename ).c_str() );
+    if( !ifs.is_open() ) { return boost::none; }
+    index i;
+    try { i = read( ifs ); }
+    catch( std::exception& ex ) { COMMA_THROW( comma::exception, "failed to load index \"" << filename( data_filename ) << "\": " << ex.what() ); }
+    index s;
+    try { s.stamp( data_filename ); } catch( ... ) { return boost::none; }
+    if( i.size != s.size || i.modified != s.modified ) { return boost::none; }
+    if( !field.empty() )
+    {
+        const std::vector< std::string >& fields = comma::split( csv.fields, ',' );
+        if( i.column >= fields.size() || fields[i.column] != field ) { return boost::none; }
+    }
+    if( csv.binary() ) { if( i.binary.empty() || csv::format( i.binary ).expanded_string() != csv.format().expanded_string() ) { return boost::none; } }
+    else if( !i.binary.empty() || i.delimiter != csv.delimiter ) { return boost::none; }
+    return i;
+}
+
+boost::optional< index > index::load( int fd, const csv::options& csv, const std::string& field )
+{
+    #ifdef __linux__
+    char path[4096];
+    ssize_t size = ::readlink( ( "/proc/self/fd/" + boost::lexical_cast< std::string >( fd ) ).c_str(), path, sizeof( path ) - 1 );
+    if( size <= 0 ) { return boost::none; }
+    path[size] = 0;
+    if( path[0] != '/' ) { return boost::none; } // e.g. pipe:[12345]
+    return load( std::string( path ), csv, field );
+    #else
+    return boost::none;
+    #endif
+}
+
+} } // namespace comma { namespace csv {
@@ -0,0 +1,114 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_CSV_INDEX_H_
+#define COMMA_CSV_INDEX_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/optional.hpp>
+#include "../base/types.h"
+#include "../csv/options.h"
+
+namespace comma { namespace csv {
+
+/// sparse sidecar index of an ascii or binary data file sorted by a key field:
+/// key of every n-th record and byte offset of that record in the file
+/// (see csv-index for building it)
+///
+/// the index of e.g. data.csv is stored next to it as data.csv.index
+/// and is discarded by load(), if the data file changed since
+class index
+{
+    public:
+        struct entry
+        {
+            double key;
+            comma::uint64 offset;
+            entry() : key( 0 ), offset( 0 ) {}
+            entry( double key, comma::uint64 offset ) : key( key ), offset( offset ) {}
+        };
+
+        /// key field number in the record
+        unsigned int column;
+
+        /// true, if key is time (stored as microseconds since epoch)
+        bool time;
+
+        /// delimiter, for ascii data
+        char delimiter;
+
+        /// binary format, empty for ascii data
+        std::string binary;
+
+        /// data file size at the time of indexing
+        comma::uint64 size;
+
+        /// data file modification time at the time of indexing, seconds since epoch
+        comma::int64 modified;
+
+        /// entries in the order of data
+        std::vector< entry > entries;
+
+        /// constructor
+        index();
+
+        /// return index filename for given data filename
+        static std::string filename( const std::string& data_filename ) { return data_filename + ".index"; }
+
+        /// return key for given time
+        static double key( const boost::posix_time::ptime& t );
+
+        /// return offset of a record such that all records with key not less than given are at or after this offset
+        comma::uint64 lower_bound( double key ) const;
+
+        /// set size and modification time from data file
+        void stamp( const std::string& data_filename );
+
+        /// write index
+        void write( std::ostream& os ) const;
+
+        /// read index
+        static index read( std::istream& is );
+
+        /// load index of given data file indexed on given field as in given csv options (if field is empty, any key field);
+        /// return none, if there is no index, or data file changed since indexing, or index does not match csv options
+        static boost::optional< index > load( const std::string& data_filename, const csv::options& csv, const std::string& field = "" );
+
+        /// load index of data file open as given file descriptor, e.g. of stdin redirected from file; linux only, otherwise return none
+        static boost::optional< index > load( int fd, const csv::options& csv, const std::string& field = "" );
+};
+
+} } // namespace comma { namespace csv {
+
+#endif // COMMA_CSV_INDEX_H_
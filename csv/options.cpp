@@ -75,11 +75,13 @@ inline static void init( comma::csv::options& csv_options, const comma::command_
         }
     }
     csv_options.flush = options.exists( "--flush" );
+    csv_options.mmap = options.exists( "--mmap" );
+    csv_options.output_buffer = options.value< std::size_t >( "--output-buffer", 0 );
 }
 
 } // namespace impl {
 
-options::options() : full_xpath( false ), delimiter( ',' ), precision( 12 ), quote( '"' ), flush( false ) {}
+options::options() : full_xpath( false ), delimiter( ',' ), precision( 12 ), quote( '"' ), flush( false ), mmap( false ), output_buffer( 0 ) {}
 
 options::options( int argc, char** argv, const std::string& defaultFields )
 {
@@ -109,6 +111,11 @@ std::string options::usage( const std::string& default_fields, bool verbose )
         oss << "    --flush: if present, flush output stream after each record" << std::endl;
         oss << "    --format <format>: explicitly set input format in csv mode (if not set, guess format from first line)" << std::endl;
         oss << "    --binary,-b <format>: use binary format" << std::endl;
+        oss << "    --mmap: binary input only: if input is a regular file, memory-map it instead of reading it" << std::endl;
+        oss << "    --output-buffer=<bytes>: binary output only: accumulate output records in buffer of given size and write" << std::endl;
+        oss << "                             them in large chunks; with --flush, write out the buffer after each record or," << std::endl;
+        oss << "                             if the application supports it, whenever there is no more input ready;" << std::endl;
+        oss << "                             default: 0, i.e. write each record separately" << std::endl;
         oss << format::usage();
     }
     else
@@ -174,6 +181,6 @@ bool options::has_some_of_paths( const std::string& paths ) const
     return false;
 }
 
-std::string options::valueless_options() { return "--full-xpath,--flush"; }
+std::string options::valueless_options() { return "--full-xpath,--flush,--mmap"; }
 
 } } // namespace comma { namespace csv {
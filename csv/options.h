@@ -78,6 +78,12 @@ class options
         /// if true, flush output stream after each record
         bool flush;
 
+        /// if true, memory-map binary input, if it is a regular file (falls back to stream reading otherwise)
+        bool mmap;
+
+        /// binary output buffer size in bytes; if non-zero, output records are accumulated and written in large chunks
+        std::size_t output_buffer;
+
         /// return format
         const csv::format& format() const;
 
@@ -27,6 +27,12 @@
 // OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
 // IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#ifndef WIN32
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#endif
 #include "stream.h"
 
 namespace comma { namespace csv { namespace detail {
@@ -46,4 +52,75 @@ void unsynchronize_with_stdio()
     ( void )( dummy ); // necessary, otherwise linker would not link to dummy symbol
 }
 
+void write( int fd, const char* buf, std::size_t size )
+{
+    while( size > 0 )
+    {
+        #ifdef WIN32
+        int written = ::_write( fd, buf, static_cast< unsigned int >( size ) );
+        if( written < 0 ) { COMMA_THROW( comma::exception, "failed to write " << size << " bytes to file descriptor " << fd ); }
+        #else
+        ssize_t written = ::write( fd, buf, size );
+        if( written < 0 )
+        {
+            if( errno == EINTR ) { continue; }
+            if( errno == EAGAIN || errno == EWOULDBLOCK ) { struct pollfd p = { fd, POLLOUT, 0 }; ::poll( &p, 1, -1 ); continue; } // non-blocking descriptor
+            COMMA_THROW( comma::exception, "failed to write " << size << " bytes to file descriptor " << fd << ": " << ::strerror( errno ) );
+        }
+        #endif
+        buf += written;
+        size -= written;
+    }
+}
+
+bool wait( int fd, const boost::posix_time::ptime& deadline )
+{
+    #ifdef WIN32
+    return true; // not implemented; reading will block
+    #else
+    while( true )
+    {
+        int milliseconds = -1;
+        if( !deadline.is_pos_infinity() && !deadline.is_not_a_date_time() )
+        {
+            boost::posix_time::time_duration remaining = deadline - boost::posix_time::microsec_clock::universal_time();
+            milliseconds = remaining.is_negative() ? 0 : int( ( remaining.total_microseconds() + 999 ) / 1000 );
+        }
+        struct pollfd p = { fd, POLLIN, 0 };
+        int r = ::poll( &p, 1, milliseconds );
+        if( r >= 0 ) { return r > 0; } // on hang-up or error, the subsequent read reports end of stream or fails
+        if( errno != EINTR ) { COMMA_THROW( comma::exception, "failed to poll file descriptor " << fd << ": " << ::strerror( errno ) ); }
+    }
+    #endif
+}
+
+bool idle( std::istream& is, int fd )
+{
+    #ifdef WIN32
+    return true; // not implemented; always flush
+    #else
+    if( is.rdbuf()->in_avail() > 0 ) { return false; }
+    struct pollfd p = { fd, POLLIN, 0 };
+    int r = ::poll( &p, 1, 0 );
+    return r <= 0 || !( p.revents & POLLIN ); // on hang-up with no data left, there is no more input to wait for
+    #endif
+}
+
+bool read_some( std::istream& is, int fd, const boost::posix_time::ptime& deadline, std::string& buffer )
+{
+    std::streamsize available = is.rdbuf()->in_avail();
+    if( available < 0 ) { is.setstate( std::ios::eofbit ); return true; }
+    if( available == 0 )
+    {
+        if( fd >= 0 && !wait( fd, deadline ) ) { return false; }
+        if( std::istream::traits_type::eq_int_type( is.rdbuf()->sgetc(), std::istream::traits_type::eof() ) ) { is.setstate( std::ios::eofbit ); return true; } // a single read by stream buffer
+        available = is.rdbuf()->in_avail();
+        if( available <= 0 ) { return true; }
+    }
+    std::size_t size = buffer.size();
+    buffer.resize( size + available );
+    buffer.resize( size + is.rdbuf()->sgetn( &buffer[size], available ) );
+    return true;
+}
+
 } } } // namespace comma { namespace csv { namespace detail {
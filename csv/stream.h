@@ -39,19 +39,41 @@
 #include <io.h>
 #endif
 
+#include <algorithm>
 #include <iostream>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "../base/exception.h"
 #include "../csv/ascii.h"
 #include "../csv/binary.h"
 #include "../csv/options.h"
+#include "../csv/impl/mapped_file.h"
 #include "../string/string.h"
 
 namespace comma { namespace csv {
 
 /// @todo document
-namespace detail { void unsynchronize_with_stdio(); }
+namespace detail {
+
+void unsynchronize_with_stdio();
+
+/// write the whole buffer to file descriptor, retrying on partial writes and interrupts; throw on error
+void write( int fd, const char* buf, std::size_t size );
+
+/// wait until file descriptor is ready for reading or deadline is reached; return true, if ready
+bool wait( int fd, const boost::posix_time::ptime& deadline );
+
+/// return true, if there is no input buffered in the stream and none ready on its file descriptor, i.e. reading would block
+bool idle( std::istream& is, int fd );
+
+/// append to buffer whatever the stream can give without blocking; if nothing is buffered in the stream,
+/// wait on file descriptor until deadline and then let the stream buffer do a single read;
+/// set eofbit on end of stream; return false on timeout
+/// @note if file descriptor is negative (unknown), there is nothing to wait on and a read may block
+bool read_some( std::istream& is, int fd, const boost::posix_time::ptime& deadline, std::string& buffer );
+
+} // namespace detail {
 
 template < typename S > class output_stream;
 template < typename S > class input_stream;
@@ -75,12 +97,21 @@ class ascii_input_stream : public boost::noncopyable
         /// read; return NULL, if end of stream or alike
         const S* read();
 
-        /// read with timeout; return NULL, if insufficient data (e.g. end of stream)
-        /// @todo implement
+        /// read with timeout; return NULL, if no complete line arrived before timeout or end of stream
+        /// a partial line is kept in the reassembly buffer until the next read
+        /// @note waits on fd(), which is 0 for std::cin; for other streams, set fd() or a read may block
         const S* read( const boost::posix_time::ptime& timeout );
 
+        /// read up to n records; return number of records read, 0 if end of stream
+        std::size_t read_many( std::vector< S >& records, std::size_t n );
+
         /// return the last line read
-        const std::vector< std::string >& last() const { return line_; }
+        /// @note fields are copied into strings only on the first call after read(), thus
+        ///       applications that do not need the original line do not pay for it
+        const std::vector< std::string >& last() const;
+
+        /// return the last line read, tokenized in place (fast, no copying)
+        const impl::tokenized_line& tokenized() const { return tokenized_; }
 
         /// a helper: return the engine
         const csv::ascii< S > ascii() const { return ascii_; }
@@ -91,9 +122,15 @@ class ascii_input_stream : public boost::noncopyable
         /// returns true if the stream has data in its buffer to be read
         /// the buffered data may not contain a complete line and a subsequent read (getline) may block
         /// this is under the consideration that the ascii_input_stream is mainly used for
-        /// debug purposes only
+        /// debug purposes only; use read( timeout ) for bounded-latency reads
         bool ready() const;
 
+        /// return file descriptor to wait on in read( timeout ), -1 if unknown
+        int fd() const { return fd_; }
+
+        /// set file descriptor to wait on in read( timeout ), e.g. comma::io::istream::fd()
+        void fd( int d ) { fd_ = d; }
+
     private:
         friend class input_stream<S>;
         template < typename W, typename T >
@@ -105,8 +142,17 @@ class ascii_input_stream : public boost::noncopyable
         csv::ascii< S > ascii_;
         const S default_;
         S result_;
-        std::vector< std::string > line_;
+        std::string buffer_;
+        std::string next_;
+        impl::tokenized_line tokenized_;
+        mutable std::vector< std::string > line_;
+        mutable bool line_is_valid_;
         std::vector< std::string > fields_;
+        int fd_;
+        std::string reassembly_;
+        std::size_t reassembled_;
+        bool next_line_( bool end );
+        const S* get_();
 };
 
 /// ascii csv output stream
@@ -118,6 +164,7 @@ class ascii_output_stream : public boost::noncopyable
         ascii_output_stream( std::ostream& os, const std::string& column_names = "", char delimiter = ',', bool full_path_as_name = false, const S& sample = S() );
 
         /// constructor from csv options
+        /// @note lines are flushed only if o.flush is set, otherwise output is buffered by std::ostream
         ascii_output_stream( std::ostream& os, const options& o, const S& sample = S() );
 
         /// constructor from csv options
@@ -136,8 +183,7 @@ class ascii_output_stream : public boost::noncopyable
         void write( const S& s, std::vector< std::string >& line );
 
         /// flush
-        /// @todo: to implement
-        void flush() {}
+        void flush() { os_.flush(); }
 
         /// set precision
         void precision( unsigned int p ) { ascii_.precision( p ); }
@@ -158,6 +204,7 @@ class ascii_output_stream : public boost::noncopyable
         std::ostream& os_;
         csv::ascii< S > ascii_;
         std::vector< std::string > fields_;
+        bool flush_;
 };
 
 /// binary csv input stream
@@ -174,12 +221,27 @@ class binary_input_stream : public boost::noncopyable
         /// read; return NULL, if insufficient data (e.g. end of stream)
         const S* read();
 
-        /// read with timeout; return NULL, if insufficient data (e.g. end of stream)
-        /// @todo implement
+        /// read with timeout; return NULL, if no complete record arrived before timeout or end of stream
+        /// a partial record is kept in the reassembly buffer until the next read
+        /// @note waits on fd(), which is 0 for std::cin; for other streams, set fd() or a read may block
         const S* read( const boost::posix_time::ptime& timeout );
 
-        /// return the last line read
-        const char* last() const { return &buf_[0]; }
+        /// default block size in bytes for read_block()
+        static const std::size_t block_size = 1024 * 1024;
+
+        /// read up to n records as a single block of raw data with one read from the stream
+        /// @param data set to the beginning of the block, valid until the next read
+        /// @param n number of records to read; if 0, read as many as fit in block_size bytes
+        /// @return number of records read, 0 if end of stream
+        /// @note blocks until n records are read or end of stream is reached
+        std::size_t read_block( const char*& data, std::size_t n = 0 );
+
+        /// read and decode up to n records with one read from the stream; return number of records read, 0 if end of stream
+        /// @note blocks until n records are read or end of stream is reached
+        std::size_t read_many( std::vector< S >& records, std::size_t n );
+
+        /// return the last record read
+        const char* last() const { return last_; }
 
         /// a helper: return the engine
         const csv::binary< S > binary() const { return binary_; }
@@ -193,6 +255,34 @@ class binary_input_stream : public boost::noncopyable
         /// return true, if read will not block
         bool ready() const;
 
+        /// return file descriptor to wait on in read( timeout ), -1 if unknown
+        int fd() const { return fd_; }
+
+        /// set file descriptor to wait on in read( timeout ), e.g. comma::io::istream::fd()
+        void fd( int d ) { fd_ = d; }
+
+        /// return true, if input is memory-mapped (see options::mmap);
+        /// then last() and read_block() point directly into the mapping
+        bool mapped() const { return bool( mapped_ ); }
+
+        /// return number of records in the mapping from the initial stream position, 0 if not mapped
+        std::size_t count() const { return mapped_ ? mapped_->size() / size_ : 0; }
+
+        /// return pointer to the i-th record in the mapping, memory-mapped input only
+        const char* at( std::size_t i ) const { return mapped_->data() + i * size_; }
+
+        /// make the i-th record in the mapping the next to read, memory-mapped input only
+        void seek( std::size_t i );
+
+        /// return number of the next record to read, memory-mapped input only
+        std::size_t tell() const { return position_ / size_; }
+
+        /// bisect records from the next to read to the end of the mapping, memory-mapped input only;
+        /// records are expected to be partitioned by predicate, i.e. it is true for all records
+        /// before some record and false for this record and all records after it (e.g. for records sorted by key)
+        /// @return number of the first record for which predicate is false, count() if none
+        template < typename P > std::size_t partition_point( P predicate ) const;
+
     private:
         friend class input_stream<S>;
         template < typename W, typename T>
@@ -206,7 +296,17 @@ class binary_input_stream : public boost::noncopyable
         S result_;
         const std::size_t size_;
         std::vector< char > buf_;
+        std::vector< char > block_;
+        const char* last_;
         std::vector< std::string > fields_;
+        boost::scoped_ptr< impl::mapped_file > mapped_;
+        std::size_t position_;
+        int fd_;
+        std::string reassembly_;
+        std::size_t reassembled_;
+        std::size_t buffered_() const { return reassembly_.size() - reassembled_; }
+        bool next_record_();
+        const S* get_();
 };
 
 /// binary csv output stream
@@ -221,7 +321,7 @@ class binary_output_stream : public boost::noncopyable
         binary_output_stream( std::ostream& os, const options& o, const S& sample = S() );
 
         /// destructor
-        ~binary_output_stream() { flush(); }
+        ~binary_output_stream();
 
         /// write
         void write( const S& s );
@@ -232,6 +332,20 @@ class binary_output_stream : public boost::noncopyable
         /// flush
         void flush();
 
+        /// set output buffer size in bytes, rounded down to whole records (but at least one record)
+        /// if set, records are accumulated and written out in large chunks, with ::write() for stdout;
+        /// if flush is set, the buffer is written out after each record, or, see flush_when_idle(), when input is idle
+        /// default: 0, i.e. each record is written to the output stream separately
+        /// @note while buffering, do not write to the underlying output stream directly without calling flush() first
+        void buffer_size( std::size_t size );
+
+        /// if buffered and flush is set, write out the buffer at a record boundary only when there is
+        /// no more input ready in the given input stream, e.g. std::cin with file descriptor 0
+        void flush_when_idle( std::istream& is, int fd );
+
+        /// return output buffer size in bytes, 0 if not buffered
+        std::size_t buffer_size() const { return buffer_.size(); }
+
         /// a helper: return the engine
         const csv::binary< S > binary() const { return binary_; }
 
@@ -247,14 +361,17 @@ class binary_output_stream : public boost::noncopyable
 
         std::ostream& os_;
         csv::binary< S > binary_;
-        //const std::size_t size_;
         std::vector< char > buf_;
-        //char* begin_;
-        //const char* end_;
-        //char* cur_;
+        std::vector< char > buffer_;
+        std::size_t size_;
         std::vector< std::string > fields_;
         bool flush_;
-        /// bool is_stdout;
+        bool is_stdout_;
+        std::istream* input_;
+        int input_fd_;
+        void write_( const char* buf, std::size_t size );
+        void write_buffer_();
+        void write_through_( const char* buf, std::size_t size );
 };
 
 /// trivial generic csv input stream wrapper, less optimized, but more convenient
@@ -280,6 +397,10 @@ class input_stream : public boost::noncopyable
         /// read with timeout; return NULL, if insufficient data (e.g. end of stream)
         const S* read( const boost::posix_time::ptime& timeout ) { return ascii_ ? ascii_->read( timeout ) : binary_->read( timeout ); }
 
+        /// read up to n records; return number of records read, 0 if end of stream
+        /// for binary streams, records are read with a single read from the underlying stream
+        std::size_t read_many( std::vector< S >& records, std::size_t n ) { return ascii_ ? ascii_->read_many( records, n ) : binary_->read_many( records, n ); }
+
         /// return fields
         const std::vector< std::string >& fields() const { return ascii_ ? ascii_->fields() : binary_->fields(); }
 
@@ -298,6 +419,9 @@ class input_stream : public boost::noncopyable
 
         bool ready() const { return binary_ ? binary_->ready() : ascii_->ready(); }
 
+        /// set file descriptor to wait on in read( timeout )
+        void fd( int d ) { if( ascii_ ) { ascii_->fd( d ); } else { binary_->fd( d ); } }
+
     private:
         boost::scoped_ptr< ascii_input_stream< S > > ascii_;
         boost::scoped_ptr< binary_input_stream< S > > binary_;
@@ -344,6 +468,9 @@ class output_stream : public boost::noncopyable
         /// flush
         void flush() { if( ascii_ ) { ascii_->flush(); } else { binary_->flush(); } }
 
+        /// see binary_output_stream::flush_when_idle(); ascii output is not buffered
+        void flush_when_idle( std::istream& is, int fd ) { if( binary_ ) { binary_->flush_when_idle( is, fd ); } }
+
         /// return fields
         const std::vector< std::string >& fields() const { return ascii_ ? ascii_->fields() : binary_->fields(); }
 
@@ -374,14 +501,7 @@ inline void output_stream< S >::append( const std::string& line, const S& s )
     }
     else
     {
-        /// do not do it unless a properly scalable solution devised; see generic backlog; also see the notes inside the passed<> implementation
-        /// auto& bos = binary();
-        /// if ( bos.is_stdout ) {
-        ///     ::write( 1, &line[0], line.size() );
-        /// } else {
-        ///    bos.os_.write(&line[0], line.size());
-        /// }
-        binary().os_.write( &line[0], line.size() );
+        binary().write_( &line[0], line.size() ); // keep order, if output is buffered
     }
     write( s );
 }
@@ -392,21 +512,15 @@ inline void append( const input_stream< S >& is, output_stream< T >& os, const D
 {
     if( is.is_binary() )
     {
-        /// do not do it unless a properly scalable solution devised; see generic backlog; also see the notes inside the passed<> implementation
-        /// auto& bos = os.binary();
-        /// if ( bos.is_stdout ) {
-        ///     ::write( 1, is.binary().last(), is.binary().size() );
-        /// } else {
-        ///     bos.os_.write( is.binary().last(), is.binary().size() );
-        /// }
-        os.binary().os_.write( is.binary().last(), is.binary().size() );
-        os.write( data );  // todo: low-hanging fruit for append() only: add writing to stdout as a private method or alike (i.e. hide from the user) and still use ::write() for stdout
+        os.binary().write_( is.binary().last(), is.binary().size() ); // keep order, if output is buffered
+        os.write( data );
     }
     else
     {
         std::string sbuf;
         os.ascii().ascii().put( data, sbuf );
-        os.ascii().os_ << comma::join( is.ascii().last(), os.ascii().ascii().delimiter() ) << os.ascii().ascii().delimiter() << sbuf << std::endl;
+        os.ascii().os_ << comma::join( is.ascii().last(), os.ascii().ascii().delimiter() ) << os.ascii().ascii().delimiter() << sbuf << '\n';
+        if( os.ascii().flush_ ) { os.ascii().os_.flush(); }
     }
 }
 
@@ -485,6 +599,10 @@ class passed
 //  - according to git grep, only view-points was using this class template at the moment; therefore,
 //    the change is very localized and we preserve it in this class
 //  - however, all the other similar modifications have been commented out using /// symbol
+//
+// To keep the order of records, std::cout is flushed before each C-level write, thus whatever the
+// application has written to std::cout directly goes out first; partial writes and interrupts are
+// handled by detail::write(). binary_output_stream uses the same approach when its output is buffered.
             is_stdout_ = os.rdbuf() == std::cout.rdbuf();
         }
 
@@ -492,14 +610,18 @@ class passed
         {
             if( is_.is_binary() ) {
                 if ( is_stdout_ ) {
-                    ::write( 1, is_.binary().last(), is_.binary().size() );
+                    os_.flush();
+                    detail::write( 1, is_.binary().last(), is_.binary().size() );
                     if(flush) { ::fflush( stdout ); }
                 } else {
                     os_.write( is_.binary().last(), is_.binary().size() );
                     if(flush) { os_.flush(); }
                 }
             }
-            else os_ << comma::join( is_.ascii().last(), is_.ascii().ascii().delimiter() ) << std::endl;
+            else {
+                os_ << comma::join( is_.ascii().last(), is_.ascii().ascii().delimiter() ) << '\n';
+                if(flush) { os_.flush(); }
+            }
         }
 
     private:
@@ -515,7 +637,10 @@ inline ascii_input_stream< S >::ascii_input_stream( std::istream& is, const std:
     , ascii_( column_names, delimiter, full_path_as_name, sample )
     , default_( sample )
     , result_( sample )
+    , line_is_valid_( false )
     , fields_( split( column_names, ',' ) )
+    , fd_( &is == &std::cin ? 0 : -1 )
+    , reassembled_( 0 )
 {
     detail::unsynchronize_with_stdio();
 }
@@ -526,7 +651,10 @@ inline ascii_input_stream< S >::ascii_input_stream(std::istream& is, const optio
     , ascii_( o, sample )
     , default_( sample )
     , result_( sample )
+    , line_is_valid_( false )
     , fields_( split( o.fields, ',' ) )
+    , fd_( &is == &std::cin ? 0 : -1 )
+    , reassembled_( 0 )
 {
     detail::unsynchronize_with_stdio();
 }
@@ -537,7 +665,10 @@ inline ascii_input_stream< S >::ascii_input_stream(std::istream& is, const S& sa
     , ascii_( options().fields, options().delimiter, true, sample ) // , ascii_( options().fields, options().delimiter, o.full_xpath, sample )
     , default_( sample )
     , result_( sample )
+    , line_is_valid_( false )
     , fields_( split( options().fields, ',' ) )
+    , fd_( &is == &std::cin ? 0 : -1 )
+    , reassembled_( 0 )
 {
     detail::unsynchronize_with_stdio();
 }
@@ -545,25 +676,86 @@ inline ascii_input_stream< S >::ascii_input_stream(std::istream& is, const S& sa
 template < typename S >
 inline bool ascii_input_stream< S >::ready() const
 {
-    return is_.rdbuf()->in_avail() > 0;
+    return reassembly_.find( '\n', reassembled_ ) != std::string::npos || is_.rdbuf()->in_avail() > 0;
+}
+
+template < typename S >
+inline bool ascii_input_stream< S >::next_line_( bool end )
+{
+    if( reassembled_ == reassembly_.size() ) { return false; }
+    std::size_t n = reassembly_.find( '\n', reassembled_ );
+    if( n == std::string::npos )
+    {
+        if( !end ) { return false; }
+        n = reassembly_.size();
+    }
+    next_.assign( reassembly_, reassembled_, n - reassembled_ );
+    reassembled_ = n + 1;
+    if( reassembled_ >= reassembly_.size() ) { reassembly_.clear(); reassembled_ = 0; } // keeps capacity
+    return true;
+}
+
+template < typename S >
+inline const S* ascii_input_stream< S >::get_()
+{
+    if( !next_.empty() && *next_.rbegin() == '\r' ) { next_.resize( next_.size() - 1 ); } // windows... sigh...
+    if( next_.empty() ) { return NULL; }
+    buffer_.swap( next_ ); // last line remains valid, if end of stream is reached
+    result_ = default_;
+    tokenized_.split( buffer_, ascii_.delimiter() );
+    line_is_valid_ = false;
+    ascii_.get( result_, tokenized_ );
+    return &result_;
 }
 
 template < typename S >
 inline const S* ascii_input_stream< S >::read()
 {
-    while( is_.good() && !is_.eof() )
+    while( true )
     {
-        /// @todo implement reassembly
-        std::string s;
-        std::getline( is_, s );
-        if( !s.empty() && *s.rbegin() == '\r' ) { s = s.substr( 0, s.length() - 1 ); } // windows... sigh...
-        if( s.empty() ) { continue; }
-        result_ = default_;
-        line_ = split( s, ascii_.delimiter() );
-        ascii_.get( result_, line_ );
-        return &result_;
+        bool end = !is_.good() || is_.eof();
+        if( !next_line_( end ) ) // nothing left over from read( timeout )
+        {
+            if( end ) { return NULL; }
+            std::getline( is_, next_ ); // buffers keep their capacity, thus no allocation per line
+            if( reassembled_ < reassembly_.size() ) { next_.insert( 0, reassembly_, reassembled_, std::string::npos ); reassembly_.clear(); reassembled_ = 0; }
+        }
+        const S* s = get_();
+        if( s ) { return s; }
+    }
+}
+
+template < typename S >
+inline const S* ascii_input_stream< S >::read( const boost::posix_time::ptime& timeout )
+{
+    while( true )
+    {
+        bool end = !is_.good() || is_.eof();
+        if( next_line_( end ) )
+        {
+            const S* s = get_();
+            if( s ) { return s; }
+            continue;
+        }
+        if( end || !detail::read_some( is_, fd_, timeout, reassembly_ ) ) { return NULL; }
     }
-    return NULL;
+}
+
+template < typename S >
+inline std::size_t ascii_input_stream< S >::read_many( std::vector< S >& records, std::size_t n )
+{
+    records.resize( n, default_ );
+    std::size_t count = 0;
+    for( const S* p; count < n && ( p = read() ); ++count ) { records[count] = *p; }
+    records.resize( count, default_ );
+    return count;
+}
+
+template < typename S >
+inline const std::vector< std::string >& ascii_input_stream< S >::last() const
+{
+    if( !line_is_valid_ ) { tokenized_.to_strings( line_ ); line_is_valid_ = true; }
+    return line_;
 }
 
 template < typename S >
@@ -571,6 +763,7 @@ inline ascii_output_stream< S >::ascii_output_stream( std::ostream& os, const st
     : os_( os )
     , ascii_( column_names, delimiter, full_path_as_name, sample )
     , fields_( split( column_names, ',' ) )
+    , flush_( false )
 {
 }
 
@@ -579,6 +772,7 @@ inline ascii_output_stream< S >::ascii_output_stream( std::ostream& os, const co
     : os_( os )
     , ascii_( o, sample )
     , fields_( split( o.fields, ',' ) )
+    , flush_( o.flush )
 {
 }
 
@@ -587,6 +781,7 @@ inline ascii_output_stream< S >::ascii_output_stream( std::ostream& os, const S&
     : os_( os )
     , ascii_( options().fields, options().delimiter, true, sample ) // , ascii_( options().fields, options().delimiter, o.full_xpath, sample )
     , fields_( split( options().fields, ',' ) )
+    , flush_( false )
 {
 }
 
@@ -618,7 +813,8 @@ inline void ascii_output_stream< S >::write( const S& s, std::vector< std::strin
     if( v.empty() ) { return; } // never here, though
     os_ << v[0];
     for( std::size_t i = 1; i < v.size(); ++i ) { os_ << ascii_.delimiter() << v[i]; }
-    os_ << std::endl;
+    os_ << '\n'; // no std::endl: flushing each line is expensive, flush only if asked for
+    if( flush_ ) { os_.flush(); }
 }
 
 template < typename S >
@@ -629,7 +825,11 @@ inline binary_input_stream< S >::binary_input_stream( std::istream& is, const st
     , result_( sample )
     , size_( binary_.format().size() )
     , buf_( size_ )
+    , last_( &buf_[0] )
     , fields_( split( column_names, ',' ) )
+    , position_( 0 )
+    , fd_( &is == &std::cin ? 0 : -1 )
+    , reassembled_( 0 )
 {
     #ifdef WIN32
     if( &is == &std::cin ) { _setmode( _fileno( stdin ), _O_BINARY ); }
@@ -645,43 +845,169 @@ inline binary_input_stream< S >::binary_input_stream( std::istream& is, const op
     , result_( sample )
     , size_( binary_.format().size() )
     , buf_( size_ )
+    , last_( &buf_[0] )
     , fields_( split( o.fields, ',' ) )
+    , position_( 0 )
+    , fd_( &is == &std::cin ? 0 : -1 )
+    , reassembled_( 0 )
 {
     #ifdef WIN32
     if( &is == &std::cin ) { _setmode( _fileno( stdin ), _O_BINARY ); }
     #endif
     detail::unsynchronize_with_stdio();
+    if( !o.mmap ) { return; }
+    if( &is == &std::cin ) { mapped_.reset( impl::mapped_file::open( 0 ) ); }
+    else if( !o.filename.empty() && o.filename != "-" ) { mapped_.reset( impl::mapped_file::open( o.filename ) ); }
 }
 
 template < typename S >
 inline bool binary_input_stream< S >::ready() const
 {
-    return is_.rdbuf()->in_avail() >= int( size_ );
+    if( mapped_ ) { return mapped_->size() - position_ >= size_; }
+    return buffered_() + std::max( is_.rdbuf()->in_avail(), std::streamsize( 0 ) ) >= size_;
 }
 
 template < typename S >
-inline const S* binary_input_stream< S >::read()
+inline bool binary_input_stream< S >::next_record_()
 {
-    is_.read( &buf_[0], size_ );
-    if( is_.gcount() == 0 ) { return NULL; }
-    if( is_.gcount() != int( size_ ) ) { COMMA_THROW( comma::exception, "expected " << size_ << " bytes; got " << is_.gcount() ); }
+    if( buffered_() < size_ ) { return false; }
+    ::memcpy( &buf_[0], &reassembly_[reassembled_], size_ );
+    reassembled_ += size_;
+    if( reassembled_ == reassembly_.size() ) { reassembly_.clear(); reassembled_ = 0; } // keeps capacity
+    return true;
+}
+
+template < typename S >
+inline const S* binary_input_stream< S >::get_()
+{
+    last_ = &buf_[0];
     result_ = default_;
     binary_.get( result_, &buf_[0] );
     return &result_;
 }
 
+template < typename S >
+inline void binary_input_stream< S >::seek( std::size_t i )
+{
+    if( !mapped_ ) { COMMA_THROW( comma::exception, "seek: expected memory-mapped input" ); }
+    if( i > count() ) { COMMA_THROW( comma::exception, "seek: expected record number not greater than " << count() << "; got " << i ); }
+    position_ = i * size_;
+}
+
+template < typename S >
+template < typename P >
+inline std::size_t binary_input_stream< S >::partition_point( P predicate ) const
+{
+    if( !mapped_ ) { COMMA_THROW( comma::exception, "partition_point: expected memory-mapped input" ); }
+    std::size_t first = tell();
+    std::size_t n = count() - first;
+    S s( default_ );
+    while( n > 0 )
+    {
+        std::size_t half = n / 2;
+        s = default_;
+        if( predicate( binary_.get( s, at( first + half ) ) ) ) { first += half + 1; n -= half + 1; } else { n = half; }
+    }
+    return first;
+}
+
+template < typename S >
+inline const S* binary_input_stream< S >::read()
+{
+    if( mapped_ )
+    {
+        std::size_t remaining = mapped_->size() - position_;
+        if( remaining == 0 ) { return NULL; }
+        if( remaining < size_ ) { COMMA_THROW( comma::exception, "expected " << size_ << " bytes; got " << remaining ); }
+        last_ = mapped_->data() + position_;
+        position_ += size_;
+        result_ = default_;
+        binary_.get( result_, last_ );
+        return &result_;
+    }
+    if( next_record_() ) { return get_(); }
+    std::size_t buffered = buffered_(); // partial record left over from read( timeout )
+    if( buffered > 0 ) { ::memcpy( &buf_[0], &reassembly_[reassembled_], buffered ); reassembly_.clear(); reassembled_ = 0; }
+    is_.read( &buf_[buffered], size_ - buffered );
+    std::size_t count = buffered + is_.gcount();
+    if( count == 0 ) { return NULL; }
+    if( count != size_ ) { COMMA_THROW( comma::exception, "expected " << size_ << " bytes; got " << count ); }
+    return get_();
+}
+
+template < typename S >
+inline const S* binary_input_stream< S >::read( const boost::posix_time::ptime& timeout )
+{
+    if( mapped_ ) { return read(); } // never blocks
+    while( !next_record_() )
+    {
+        if( !is_.good() || is_.eof() )
+        {
+            if( buffered_() > 0 ) { COMMA_THROW( comma::exception, "expected " << size_ << " bytes; got " << buffered_() ); }
+            return NULL;
+        }
+        if( !detail::read_some( is_, fd_, timeout, reassembly_ ) ) { return NULL; }
+    }
+    return get_();
+}
+
+template < typename S >
+inline std::size_t binary_input_stream< S >::read_block( const char*& data, std::size_t n )
+{
+    if( n == 0 ) { n = block_size > size_ ? block_size / size_ : 1; }
+    if( mapped_ )
+    {
+        std::size_t remaining = mapped_->size() - position_;
+        std::size_t count = std::min( n, remaining / size_ );
+        if( count == 0 )
+        {
+            if( remaining > 0 ) { COMMA_THROW( comma::exception, "expected " << size_ << " bytes; got " << remaining << " bytes in the last record" ); }
+            return 0;
+        }
+        data = mapped_->data() + position_;
+        position_ += count * size_;
+        last_ = data + ( count - 1 ) * size_;
+        return count;
+    }
+    if( block_.size() < n * size_ ) { block_.resize( n * size_ ); }
+    std::size_t buffered = std::min( buffered_(), n * size_ ); // left over from read( timeout )
+    if( buffered > 0 )
+    {
+        ::memcpy( &block_[0], &reassembly_[reassembled_], buffered );
+        reassembled_ += buffered;
+        if( reassembled_ == reassembly_.size() ) { reassembly_.clear(); reassembled_ = 0; }
+    }
+    if( buffered < n * size_ ) { is_.read( &block_[buffered], n * size_ - buffered ); }
+    std::size_t count = buffered + ( buffered < n * size_ ? is_.gcount() : 0 );
+    if( count % size_ != 0 ) { COMMA_THROW( comma::exception, "expected " << size_ << " bytes; got " << ( count % size_ ) << " bytes in the last record" ); }
+    count /= size_;
+    if( count == 0 ) { return 0; }
+    data = &block_[0];
+    last_ = data + ( count - 1 ) * size_;
+    return count;
+}
+
+template < typename S >
+inline std::size_t binary_input_stream< S >::read_many( std::vector< S >& records, std::size_t n )
+{
+    const char* data = NULL;
+    std::size_t count = read_block( data, n );
+    records.resize( count, default_ );
+    for( std::size_t i = 0; i < count; ++i, data += size_ ) { records[i] = default_; binary_.get( records[i], data ); }
+    return count;
+}
+
 template < typename S >
 inline binary_output_stream< S >::binary_output_stream( std::ostream& os, const std::string& format, const std::string& column_names, bool full_path_as_name, bool flush, const S& sample )
     : os_( os )
     , binary_( format, column_names, full_path_as_name, sample )
-    //, size_( binary_.format().size() * ( 4098 / binary_.format().size() ) ) // quick and dirty
-    , buf_( binary_.format().size() ) //, buf_( size_ )
-    //, begin_( &buf_[0] )
-    //, end_( begin_ + size_ )
-    //, cur_( begin_ )
+    , buf_( binary_.format().size() )
+    , size_( 0 )
     , fields_( split( column_names, ',' ) )
     , flush_( flush )
-    /// , is_stdout( os_.rdbuf() == std::cout.rdbuf() )
+    , is_stdout_( os_.rdbuf() == std::cout.rdbuf() )
+    , input_( NULL )
+    , input_fd_( 0 )
 {
     #ifdef WIN32
     if( &os == &std::cout ) { _setmode( _fileno( stdout ), _O_BINARY ); }
@@ -693,46 +1019,95 @@ template < typename S >
 inline binary_output_stream< S >::binary_output_stream( std::ostream& os, const options& o, const S& sample )
     : os_( os )
     , binary_( o.format().string(), o.fields, o.full_xpath, sample )
-//     , size_( binary_.format().size() ) //, size_( binary_.format().size() * ( 4098 / binary_.format().size() ) ) // quick and dirty
-    , buf_( binary_.format().size() ) //, buf_( size_ )
-//     , begin_( &buf_[0] )
-//     , end_( begin_ + size_ )
-//     , cur_( begin_ )
+    , buf_( binary_.format().size() )
+    , size_( 0 )
     , fields_( split( o.fields, ',' ) )
     , flush_( o.flush )
-    /// , is_stdout( os_.rdbuf() == std::cout.rdbuf() )
+    , is_stdout_( os_.rdbuf() == std::cout.rdbuf() )
+    , input_( NULL )
+    , input_fd_( 0 )
 {
     #ifdef WIN32
     if( &os == &std::cout ) { _setmode( _fileno( stdout ), _O_BINARY ); }
     else if( &os == &std::cerr ) { _setmode( _fileno( stderr ), _O_BINARY ); }
     #endif
+    buffer_size( o.output_buffer );
+}
+
+template < typename S >
+inline binary_output_stream< S >::~binary_output_stream()
+{
+    try { flush(); } catch( ... ) {} // e.g. broken pipe on exit, nothing we can do
+}
+
+template < typename S >
+inline void binary_output_stream< S >::buffer_size( std::size_t size )
+{
+    write_buffer_();
+    std::size_t record_size = binary_.format().size();
+    buffer_.resize( size == 0 ? 0 : size < record_size ? record_size : ( size / record_size ) * record_size );
+}
+
+template < typename S >
+inline void binary_output_stream< S >::flush_when_idle( std::istream& is, int fd )
+{
+    input_ = &is;
+    input_fd_ = fd;
+}
+
+template < typename S >
+inline void binary_output_stream< S >::write_buffer_()
+{
+    if( size_ == 0 ) { return; }
+    std::size_t size = size_;
+    size_ = 0; // reset first, in case of exception
+    write_through_( &buffer_[0], size );
+}
+
+template < typename S >
+inline void binary_output_stream< S >::write_through_( const char* buf, std::size_t size )
+{
+    if( is_stdout_ ) // see the notes inside the passed<> implementation
+    {
+        os_.flush(); // whatever the application wrote to std::cout directly goes first
+        detail::write( 1, buf, size );
+    }
+    else
+    {
+        os_.write( buf, size );
+        if( flush_ ) { os_.flush(); }
+    }
+}
+
+template < typename S >
+inline void binary_output_stream< S >::write_( const char* buf, std::size_t size )
+{
+    if( buffer_.empty() ) { os_.write( buf, size ); return; }
+    if( size_ + size > buffer_.size() ) { write_buffer_(); }
+    if( size > buffer_.size() ) { write_through_( buf, size ); return; }
+    ::memcpy( &buffer_[size_], buf, size );
+    size_ += size;
 }
 
 template < typename S >
 inline void binary_output_stream< S >::flush()
 {
+    write_buffer_();
     os_.flush();
-//     if( cur_ == begin_ ) { return; }
-//     os_.write( begin_, cur_ - begin_ );
-//     os_.flush();
-//     cur_ = begin_;
 }
 
 template < typename S >
 inline void binary_output_stream< S >::write( const S& s )
 {
     binary_.put( s, &buf_[0] );
-    /// if ( is_stdout ) {
-        /// do not do it! see the notes inside the passed<> implementation
-        /// ::write( 1, &buf_[0], binary_.format().size() );
-        /// if( flush_ ) { ::fflush( stdout ); }
-    /// } else {
+    if( buffer_.empty() )
+    {
         os_.write( &buf_[0], binary_.format().size() );
         if( flush_ ) { os_.flush(); }
-    /// }
-//     binary_.put( s, cur_ );
-//     cur_ += binary_.format().size();
-//     if( cur_ == end_ ) { flush(); }
+        return;
+    }
+    write_( &buf_[0], binary_.format().size() );
+    if( flush_ && ( !input_ || detail::idle( *input_, input_fd_ ) ) ) { write_buffer_(); }
 }
 
 template < typename S >
@@ -740,9 +1115,6 @@ inline void binary_output_stream< S >::write( const S& s, const char* buf )
 {
     ::memcpy( &buf_[0], buf, binary_.format().size() );
     write( s );
-//     ::memcpy( cur_, buf, binary_.format().size() );
-//     write( s );
-//    if( flush_ ) { os_.flush(); }
 }
 
 template < typename S >
@@ -778,7 +1150,7 @@ template < typename S >
 inline output_stream< S >::output_stream( std::ostream& os, bool binary, bool full_xpath, bool flush, const S& sample )
 {
     if( binary ) { binary_.reset( new binary_output_stream< S >( os, "", "", full_xpath, flush, sample ) ); }
-    else { ascii_.reset( new ascii_output_stream< S >( os, sample ) ); }
+    else { ascii_.reset( new ascii_output_stream< S >( os, sample ) ); ascii_->flush_ = flush; }
 }
 
 
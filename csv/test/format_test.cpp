@@ -31,6 +31,7 @@
 #include <gtest/gtest.h>
 #include <limits>
 #include "boost/date_time/posix_time/posix_time.hpp"
+#include "../../csv/codec.h"
 #include "../../csv/format.h"
 #include "../../csv/options.h"
 #include "../../csv/impl/unstructured.h"
@@ -396,3 +397,111 @@ TEST( csv, collapse )
     EXPECT_EQ( "s[10],s[10]", comma::csv::format( "s[10],s[10]" ).collapsed_string() );
     EXPECT_EQ( "i,3f,s[10],2f", comma::csv::format( "i,f,f,f,s[10],f,f" ).collapsed_string() );
 }
+
+TEST( csv, format_time_fast_path )
+{
+    const char* times[] = { "20151231T235959", "20151231T235959.5", "20151231T235959.000001", "19691231T235959.5", "16000229T120000.123456", "14000101T000000", "99991231T235959.999999", "19700101T000000" };
+    comma::csv::format t( "t" );
+    comma::csv::format lt( "lt" );
+    boost::posix_time::ptime epoch( boost::gregorian::date( 1970, 1, 1 ) );
+    for( unsigned int i = 0; i < sizeof( times ) / sizeof( times[0] ); ++i )
+    {
+        boost::posix_time::ptime expected = boost::posix_time::from_iso_string( times[i] );
+        std::string b = t.csv_to_bin( times[i] );
+        EXPECT_EQ( ( expected - epoch ).total_microseconds(), *reinterpret_cast< const comma::int64* >( &b[0] ) );
+        EXPECT_EQ( boost::posix_time::to_iso_string( expected ), t.bin_to_csv( b ) );
+        EXPECT_EQ( boost::posix_time::to_iso_string( expected ), lt.bin_to_csv( lt.csv_to_bin( times[i] ) ) );
+    }
+    EXPECT_EQ( "not-a-date-time", t.bin_to_csv( t.csv_to_bin( "20151232T000000" ) ) );
+    EXPECT_EQ( "20151231T235959.123456", t.bin_to_csv( t.csv_to_bin( "20151231T235959.1234567" ) ) ); // as boost: extra digits truncated
+    EXPECT_EQ( "+infinity", lt.bin_to_csv( lt.csv_to_bin( "+infinity" ) ) );
+    EXPECT_EQ( "-infinity", t.bin_to_csv( t.csv_to_bin( "-inf" ) ) );
+    std::string b = lt.csv_to_bin( "19691231T235959.5" );
+    EXPECT_EQ( 0, *reinterpret_cast< const comma::int64* >( &b[0] ) );
+    EXPECT_EQ( -500000000, *reinterpret_cast< const comma::int32* >( &b[8] ) );
+}
+
+TEST( csv, format_floating_point_as_ostream )
+{
+    const double values[] = { 0, -0.0, 1, -1, 12345, 123456789012345., 1e15, 1e16, 0.1, -2.5, 1.0 / 3, 1e-7, 6.02214076e23, std::numeric_limits< double >::max(), std::numeric_limits< double >::min(), std::numeric_limits< double >::infinity(), std::numeric_limits< double >::quiet_NaN() };
+    const unsigned int precisions[] = { 0, 1, 3, 6, 12, 16, 17, 20, 40 };
+    for( unsigned int i = 0; i < sizeof( values ) / sizeof( values[0] ); ++i )
+    {
+        for( unsigned int j = 0; j < sizeof( precisions ) / sizeof( precisions[0] ); ++j )
+        {
+            comma::csv::format d( "d" );
+            comma::csv::format f( "f" );
+            std::ostringstream oss;
+            oss.precision( precisions[j] );
+            oss << values[i];
+            EXPECT_EQ( oss.str(), d.bin_to_csv( std::string( reinterpret_cast< const char* >( &values[i] ), sizeof( double ) ), ',', precisions[j] ) );
+            std::ostringstream fss;
+            fss.precision( precisions[j] );
+            fss << static_cast< float >( values[i] );
+            float v = static_cast< float >( values[i] );
+            EXPECT_EQ( fss.str(), f.bin_to_csv( std::string( reinterpret_cast< const char* >( &v ), sizeof( float ) ), ',', precisions[j] ) );
+        }
+    }
+    std::string b = comma::csv::format( "d" ).csv_to_bin( "0.3333333333333333" );
+    EXPECT_EQ( 0.3333333333333333, *reinterpret_cast< const double* >( &b[0] ) );
+    comma::csv::format l( "b,ub,l,ul,c" );
+    EXPECT_EQ( "-127,255,-9223372036854775808,18446744073709551615,x", l.bin_to_csv( l.csv_to_bin( "-127,255,-9223372036854775808,18446744073709551615,x" ) ) );
+}
+
+TEST( csv, codec )
+{
+    comma::csv::format f( "t,2ub,w,s[4],d" );
+    const comma::csv::codec& codec = f.codec();
+    ASSERT_EQ( 6u, codec.count() );
+    EXPECT_EQ( f.size(), codec.size() );
+    EXPECT_EQ( 0u, codec.fields()[0].offset );
+    EXPECT_EQ( 9u, codec.fields()[2].offset );
+    EXPECT_EQ( comma::csv::format::fixed_string, codec.fields()[4].type );
+    EXPECT_EQ( 4u, codec.fields()[4].size );
+    std::vector< char > buf( codec.size() );
+    std::string line = "20150101T000000.5,1,2,-3,\"ab\",1.5";
+    comma::csv::impl::tokenized_line tokens;
+    tokens.split( line, ',' );
+    codec.csv_to_bin( &buf[0], tokens );
+    EXPECT_EQ( f.csv_to_bin( "20150101T000000.5,1,2,-3,\"ab\",1.5" ), std::string( &buf[0], buf.size() ) );
+    std::string s = "x:";
+    codec.bin_to_csv( s, &buf[0], ';' );
+    EXPECT_EQ( "x:20150101T000000.500000;1;2;-3;ab;1.5", s );
+    line = "20150101T000000,1,2,3,ab";
+    tokens.split( line, ',' );
+    EXPECT_THROW( codec.csv_to_bin( &buf[0], tokens ), comma::exception );
+    line = "20150101T000000,1,256,3,ab,1";
+    tokens.split( line, ',' );
+    EXPECT_THROW( codec.csv_to_bin( &buf[0], tokens ), comma::exception );
+}
+
+TEST( csv, tokenized_line_quoted )
+{
+    std::string line = "1,\"a,b\",,\"\",x\"y";
+    comma::csv::impl::tokenized_line tokens;
+    tokens.split( line, ',', '"' );
+    ASSERT_EQ( 5u, tokens.size() );
+    EXPECT_EQ( std::string( "1" ), tokens[0] );
+    EXPECT_EQ( std::string( "a,b" ), tokens[1] );
+    EXPECT_EQ( 3u, tokens.size( 1 ) );
+    EXPECT_EQ( std::string( "" ), tokens[2] );
+    EXPECT_EQ( std::string( "" ), tokens[3] );
+    EXPECT_EQ( std::string( "x\"y" ), tokens[4] );
+}
+
+TEST( csv, codec_cast )
+{
+    double d = 2.5;
+    float f;
+    comma::csv::codec::cast( comma::csv::format::double_t, comma::csv::format::float_t )( reinterpret_cast< const char* >( &d ), sizeof( double ), reinterpret_cast< char* >( &f ), sizeof( float ) );
+    EXPECT_EQ( 2.5f, f );
+    char s[8] = { '1', '2', '3', 0, 0, 0, 0, 0 };
+    comma::int32 i;
+    comma::csv::codec::cast( comma::csv::format::fixed_string, comma::csv::format::int32 )( s, sizeof( s ), reinterpret_cast< char* >( &i ), sizeof( i ) );
+    EXPECT_EQ( 123, i );
+    char t[22] = "20150101T000000.5";
+    comma::int64 microseconds;
+    comma::csv::codec::cast( comma::csv::format::fixed_string, comma::csv::format::time )( t, sizeof( t ), reinterpret_cast< char* >( &microseconds ), sizeof( microseconds ) );
+    EXPECT_EQ( 1420070400500000LL, microseconds );
+    EXPECT_THROW( comma::csv::codec::cast( comma::csv::format::double_t, comma::csv::format::time ), comma::exception );
+}
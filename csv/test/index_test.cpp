@@ -0,0 +1,85 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include "../../csv/index.h"
+
+namespace comma { namespace csv {
+
+TEST( csv, index_lower_bound )
+{
+    index i;
+    EXPECT_EQ( 0, i.lower_bound( 5 ) );
+    i.entries.push_back( index::entry( 1, 0 ) );
+    i.entries.push_back( index::entry( 3, 100 ) );
+    i.entries.push_back( index::entry( 3, 200 ) );
+    i.entries.push_back( index::entry( 7, 300 ) );
+    EXPECT_EQ( 0, i.lower_bound( 0 ) );
+    EXPECT_EQ( 0, i.lower_bound( 1 ) );
+    EXPECT_EQ( 0, i.lower_bound( 2 ) );
+    EXPECT_EQ( 0, i.lower_bound( 3 ) ); // records with key 3 may precede the entry at offset 100
+    EXPECT_EQ( 200, i.lower_bound( 4 ) );
+    EXPECT_EQ( 200, i.lower_bound( 7 ) );
+    EXPECT_EQ( 300, i.lower_bound( 8 ) );
+}
+
+TEST( csv, index_read_write )
+{
+    index i;
+    i.column = 2;
+    i.time = true;
+    i.delimiter = ';';
+    i.binary = "t,3d";
+    i.size = 123456;
+    i.modified = 1500000000;
+    i.entries.push_back( index::entry( index::key( boost::posix_time::from_iso_string( "20170101T000000.000001" ) ), 0 ) );
+    i.entries.push_back( index::entry( 0.1, 12345678901234ULL ) );
+    std::ostringstream oss;
+    i.write( oss );
+    std::istringstream iss( oss.str() );
+    index j = index::read( iss );
+    EXPECT_EQ( 2, j.column );
+    EXPECT_TRUE( j.time );
+    EXPECT_EQ( ';', j.delimiter );
+    EXPECT_EQ( "t,3d", j.binary );
+    EXPECT_EQ( 123456, j.size );
+    EXPECT_EQ( 1500000000, j.modified );
+    ASSERT_EQ( 2, j.entries.size() );
+    EXPECT_EQ( 1483228800000001.0, j.entries[0].key );
+    EXPECT_EQ( 0, j.entries[0].offset );
+    EXPECT_EQ( 0.1, j.entries[1].key );
+    EXPECT_EQ( 12345678901234ULL, j.entries[1].offset );
+    std::istringstream bad( "not an index\n" );
+    EXPECT_THROW( index::read( bad ), comma::exception );
+}
+
+} } // namespace comma { namespace csv {
@@ -28,13 +28,21 @@
 // IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 
+#include <stdlib.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
+#include <fstream>
 #include <sstream>
 #include <vector>
 #include <boost/array.hpp>
+#ifdef __GLIBCXX__
+#include <ext/stdio_filebuf.h>
+#endif
 //#include <google/profiler.h>
 #include "../../base/types.h"
 #include "../../csv/stream.h"
+#include "../../csv/traits.h"
+#include "../../name_value/parser.h"
 
 namespace comma { namespace csv { namespace stream_test {
 
@@ -117,6 +125,331 @@ TEST( csv, container )
     }
 }
 
+TEST( csv, ascii_input_stream_tokenized )
+{
+    comma::csv::options csv;
+    csv.fields = ",x,,y";
+    std::istringstream iss( "a,1,b,2\n\nc,+3,d,4\r\ne,5,f,z\n" );
+    comma::csv::input_stream< test_struct > istream( iss, csv );
+    const test_struct* t = istream.read();
+    ASSERT_TRUE( t != NULL );
+    EXPECT_EQ( 1, t->x );
+    EXPECT_EQ( 2, t->y );
+    EXPECT_EQ( "a,1,b,2", istream.last() );
+    t = istream.read();
+    ASSERT_TRUE( t != NULL );
+    EXPECT_EQ( 3, t->x );
+    EXPECT_EQ( 4, t->y );
+    EXPECT_EQ( 4, istream.ascii().tokenized().size() );
+    EXPECT_EQ( "d", std::string( istream.ascii().tokenized()[2] ) );
+    EXPECT_EQ( "c,+3,d,4", istream.last() );
+    EXPECT_THROW( istream.read(), std::exception );
+    EXPECT_TRUE( istream.read() == NULL );
+    EXPECT_EQ( "e,5,f,z", istream.last() );
+}
+
+TEST( csv, binary_input_stream_read_many )
+{
+    comma::csv::options csv;
+    csv.format( "2ui" );
+    std::string buffer;
+    for( comma::uint32 i = 0; i < 10; ++i ) { comma::uint32 r[2] = { i, i * 10 }; buffer.append( reinterpret_cast< const char* >( r ), sizeof( r ) ); }
+    std::istringstream iss( buffer );
+    comma::csv::input_stream< test_struct > istream( iss, csv );
+    const test_struct* t = istream.read();
+    ASSERT_TRUE( t != NULL );
+    EXPECT_EQ( 0, t->x );
+    std::vector< test_struct > records;
+    EXPECT_EQ( 4, istream.read_many( records, 4 ) );
+    ASSERT_EQ( 4, records.size() );
+    for( unsigned int i = 0; i < 4; ++i ) { EXPECT_EQ( i + 1, records[i].x ); EXPECT_EQ( ( i + 1 ) * 10, records[i].y ); }
+    EXPECT_EQ( 4, reinterpret_cast< const comma::uint32* >( istream.binary().last() )[0] );
+    t = istream.read();
+    ASSERT_TRUE( t != NULL );
+    EXPECT_EQ( 5, t->x );
+    const char* data = NULL;
+    EXPECT_EQ( 4, istream.binary().read_block( data ) );
+    EXPECT_EQ( 6, reinterpret_cast< const comma::uint32* >( data )[0] );
+    EXPECT_EQ( 9, reinterpret_cast< const comma::uint32* >( istream.binary().last() )[0] );
+    EXPECT_EQ( 0, istream.read_many( records, 4 ) );
+    EXPECT_TRUE( records.empty() );
+}
+
+struct x_less
+{
+    comma::uint32 x;
+    x_less( comma::uint32 x ) : x( x ) {}
+    bool operator()( const test_struct& t ) const { return t.x < x; }
+};
+
+TEST( csv, binary_input_stream_mmap )
+{
+    char filename[] = "/tmp/comma-csv-stream-test-XXXXXX";
+    int fd = ::mkstemp( filename );
+    ASSERT_TRUE( fd >= 0 );
+    ::close( fd );
+    {
+        std::ofstream ofs( filename, std::ios::binary );
+        for( comma::uint32 i = 0; i < 10; ++i ) { comma::uint32 r[2] = { i, i * 10 }; ofs.write( reinterpret_cast< const char* >( r ), sizeof( r ) ); }
+    }
+    comma::csv::options csv = comma::name_value::parser( "filename", ';' ).get< comma::csv::options >( std::string( filename ) + ";binary=2ui;mmap" );
+    EXPECT_TRUE( csv.mmap );
+    {
+        std::ifstream ifs( filename, std::ios::binary );
+        comma::csv::input_stream< test_struct > istream( ifs, csv );
+        ASSERT_TRUE( istream.binary().mapped() );
+        EXPECT_EQ( 10, istream.binary().count() );
+        const test_struct* t = istream.read();
+        ASSERT_TRUE( t != NULL );
+        EXPECT_EQ( 0, t->x );
+        EXPECT_EQ( istream.binary().at( 0 ), istream.binary().last() );
+        const char* data = NULL;
+        EXPECT_EQ( 4, istream.binary().read_block( data, 4 ) );
+        EXPECT_EQ( istream.binary().at( 1 ), data );
+        EXPECT_EQ( istream.binary().at( 4 ), istream.binary().last() );
+        EXPECT_EQ( 5, istream.binary().tell() );
+        EXPECT_EQ( 7, istream.binary().partition_point( x_less( 7 ) ) );
+        EXPECT_EQ( 5, istream.binary().partition_point( x_less( 2 ) ) );
+        EXPECT_EQ( 10, istream.binary().partition_point( x_less( 20 ) ) );
+        istream.binary().seek( 8 );
+        EXPECT_TRUE( istream.ready() );
+        t = istream.read();
+        ASSERT_TRUE( t != NULL );
+        EXPECT_EQ( 8, t->x );
+        EXPECT_EQ( 80, t->y );
+        std::vector< test_struct > records;
+        EXPECT_EQ( 1, istream.read_many( records, 4 ) );
+        EXPECT_EQ( 9, records[0].x );
+        EXPECT_FALSE( istream.ready() );
+        EXPECT_TRUE( istream.read() == NULL );
+        EXPECT_THROW( istream.binary().seek( 11 ), comma::exception );
+    }
+    csv.mmap = false;
+    {
+        std::ifstream ifs( filename, std::ios::binary );
+        comma::csv::input_stream< test_struct > istream( ifs, csv );
+        EXPECT_FALSE( istream.binary().mapped() );
+        EXPECT_THROW( istream.binary().seek( 0 ), comma::exception );
+    }
+    ::unlink( filename );
+}
+
+TEST( csv, ascii_input_stream_read_many )
+{
+    std::istringstream iss( "1,2\n3,4\n5,6\n" );
+    comma::csv::input_stream< test_struct > istream( iss );
+    std::vector< test_struct > records;
+    EXPECT_EQ( 2, istream.read_many( records, 2 ) );
+    EXPECT_EQ( 3, records[1].x );
+    EXPECT_EQ( 1, istream.read_many( records, 2 ) );
+    ASSERT_EQ( 1, records.size() );
+    EXPECT_EQ( 6, records[0].y );
+    EXPECT_EQ( 0, istream.read_many( records, 2 ) );
+}
+
+TEST( csv, binary_output_stream_buffered )
+{
+    comma::csv::options csv;
+    csv.format( "2ui" );
+    std::ostringstream oss;
+    {
+        comma::csv::output_stream< test_struct > ostream( oss, csv );
+        ostream.binary().buffer_size( 20 ); // rounded down to 2 records
+        EXPECT_EQ( 16, ostream.binary().buffer_size() );
+        ostream.write( test_struct( 1, 2 ) );
+        ostream.write( test_struct( 3, 4 ) );
+        EXPECT_TRUE( oss.str().empty() );
+        ostream.write( test_struct( 5, 6 ) );
+        EXPECT_EQ( 16, oss.str().size() );
+        comma::uint32 r[2] = { 7, 8 };
+        ostream.append( std::string( reinterpret_cast< const char* >( r ), sizeof( r ) ), test_struct( 9, 10 ) );
+        ostream.flush();
+        EXPECT_EQ( 40, oss.str().size() );
+        ostream.write( test_struct( 11, 12 ) );
+    }
+    const std::string output = oss.str();
+    ASSERT_EQ( 48, output.size() );
+    const comma::uint32* p = reinterpret_cast< const comma::uint32* >( &output[0] );
+    for( unsigned int i = 0; i < 12; ++i ) { EXPECT_EQ( i + 1, p[i] ); }
+}
+
+TEST( csv, binary_output_stream_buffer_from_options )
+{
+    const char* argv[] = { "test", "--binary=2ui", "--output-buffer=20" };
+    comma::csv::options csv( comma::command_line_options( 3, const_cast< char** >( argv ) ) );
+    EXPECT_EQ( 20, csv.output_buffer );
+    std::ostringstream oss;
+    comma::csv::output_stream< test_struct > ostream( oss, csv );
+    EXPECT_EQ( 16, ostream.binary().buffer_size() );
+    ostream.write( test_struct( 1, 2 ) );
+    EXPECT_TRUE( oss.str().empty() );
+    ostream.flush();
+    EXPECT_EQ( 8, oss.str().size() );
+}
+
+TEST( csv, binary_output_stream_flush_when_idle )
+{
+    comma::csv::options csv;
+    csv.format( "2ui" );
+    csv.flush = true;
+    std::ostringstream oss;
+    comma::csv::output_stream< test_struct > ostream( oss, csv );
+    ostream.binary().buffer_size( 16 );
+    ostream.write( test_struct( 1, 2 ) );
+    EXPECT_EQ( 8, oss.str().size() ); // input unknown: flush each record
+    int fds[2];
+    ASSERT_EQ( 0, ::pipe( fds ) );
+    std::istringstream iss;
+    ostream.flush_when_idle( iss, fds[0] );
+    char c[2] = { 0, 0 };
+    ASSERT_EQ( 2, ::write( fds[1], c, 2 ) );
+    ostream.write( test_struct( 3, 4 ) );
+    EXPECT_EQ( 8, oss.str().size() ); // more input ready: keep buffering
+    ::close( fds[1] );
+    ASSERT_EQ( 1, ::read( fds[0], c, 1 ) );
+    ostream.write( test_struct( 5, 6 ) );
+    EXPECT_EQ( 8, oss.str().size() ); // writer hung up, but input is still left
+    ASSERT_EQ( 1, ::read( fds[0], c, 1 ) );
+    ostream.write( test_struct( 7, 8 ) );
+    EXPECT_EQ( 32, oss.str().size() ); // input idle: write out
+    ::close( fds[0] );
+}
+
+class sync_counting_buffer : public std::stringbuf
+{
+    public:
+        sync_counting_buffer() : syncs( 0 ) {}
+        unsigned int syncs;
+    protected:
+        int sync() { ++syncs; return std::stringbuf::sync(); }
+};
+
+TEST( csv, ascii_output_stream_flush )
+{
+    comma::csv::options csv;
+    csv.fields = "x,y";
+    {
+        sync_counting_buffer buffer;
+        std::ostream os( &buffer );
+        comma::csv::output_stream< test_struct > ostream( os, csv );
+        ostream.write( test_struct( 1, 2 ) );
+        ostream.write( test_struct( 3, 4 ) );
+        EXPECT_EQ( 0, buffer.syncs );
+        EXPECT_EQ( "1,2\n3,4\n", buffer.str() );
+    }
+    csv.flush = true;
+    {
+        sync_counting_buffer buffer;
+        std::ostream os( &buffer );
+        comma::csv::output_stream< test_struct > ostream( os, csv );
+        ostream.write( test_struct( 1, 2 ) );
+        ostream.write( test_struct( 3, 4 ) );
+        EXPECT_EQ( 2, buffer.syncs );
+        EXPECT_EQ( "1,2\n3,4\n", buffer.str() );
+    }
+}
+
+#ifdef __GLIBCXX__
+
+static boost::posix_time::ptime soon() { return boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds( 20 ); }
+
+TEST( csv, ascii_input_stream_timed_read )
+{
+    int fds[2];
+    ASSERT_EQ( 0, ::pipe( fds ) );
+    __gnu_cxx::stdio_filebuf< char > buf( fds[0], std::ios::in );
+    std::istream is( &buf );
+    ascii_input_stream< test_struct > istream( is, "x,y" );
+    istream.fd( fds[0] );
+    EXPECT_TRUE( istream.read( soon() ) == NULL );
+    ASSERT_EQ( 7, ::write( fds[1], "1,2\n3,4", 7 ) );
+    const test_struct* p = istream.read( soon() );
+    ASSERT_TRUE( p != NULL );
+    EXPECT_EQ( 1, p->x );
+    EXPECT_EQ( 2, p->y );
+    EXPECT_TRUE( istream.read( soon() ) == NULL ); // partial line kept
+    ASSERT_EQ( 8, ::write( fds[1], "\n\n5,6\n7,", 8 ) );
+    p = istream.read( soon() );
+    ASSERT_TRUE( p != NULL );
+    EXPECT_EQ( 3, p->x );
+    EXPECT_EQ( 4, p->y );
+    EXPECT_TRUE( istream.ready() );
+    p = istream.read( soon() );
+    ASSERT_TRUE( p != NULL );
+    EXPECT_EQ( 5, p->x );
+    EXPECT_EQ( 6, p->y );
+    EXPECT_TRUE( istream.read( soon() ) == NULL );
+    ASSERT_EQ( 2, ::write( fds[1], "8\n", 2 ) );
+    p = istream.read(); // blocking read completes partial line
+    ASSERT_TRUE( p != NULL );
+    EXPECT_EQ( 7, p->x );
+    EXPECT_EQ( 8, p->y );
+    ASSERT_EQ( 3, ::write( fds[1], "9,1", 3 ) );
+    ::close( fds[1] );
+    p = istream.read( soon() );
+    ASSERT_TRUE( p != NULL ); // last line without newline
+    EXPECT_EQ( 9, p->x );
+    EXPECT_EQ( 1, p->y );
+    EXPECT_TRUE( istream.read( soon() ) == NULL );
+    EXPECT_TRUE( istream.read() == NULL );
+}
+
+TEST( csv, binary_input_stream_timed_read )
+{
+    int fds[2];
+    ASSERT_EQ( 0, ::pipe( fds ) );
+    __gnu_cxx::stdio_filebuf< char > buf( fds[0], std::ios::in );
+    std::istream is( &buf );
+    binary_input_stream< test_struct > istream( is, "2ui", "x,y" );
+    istream.fd( fds[0] );
+    comma::uint32 data[] = { 1, 2, 3, 4, 5, 6 };
+    const char* d = reinterpret_cast< const char* >( data );
+    EXPECT_TRUE( istream.read( soon() ) == NULL );
+    ASSERT_EQ( 12, ::write( fds[1], d, 12 ) );
+    const test_struct* p = istream.read( soon() );
+    ASSERT_TRUE( p != NULL );
+    EXPECT_EQ( 1, p->x );
+    EXPECT_EQ( 2, p->y );
+    EXPECT_FALSE( istream.ready() );
+    EXPECT_TRUE( istream.read( soon() ) == NULL ); // partial record kept
+    ASSERT_EQ( 2, ::write( fds[1], d + 12, 2 ) );
+    EXPECT_TRUE( istream.read( soon() ) == NULL );
+    ASSERT_EQ( 8, ::write( fds[1], d + 14, 8 ) );
+    p = istream.read( soon() );
+    ASSERT_TRUE( p != NULL );
+    EXPECT_EQ( 3, p->x );
+    EXPECT_EQ( 4, p->y );
+    EXPECT_EQ( 0, std::memcmp( istream.last(), d + 8, 8 ) );
+    EXPECT_FALSE( istream.ready() );
+    EXPECT_TRUE( istream.read( soon() ) == NULL );
+    ASSERT_EQ( 2, ::write( fds[1], d + 22, 2 ) );
+    ::close( fds[1] );
+    p = istream.read(); // blocking read completes partial record
+    ASSERT_TRUE( p != NULL );
+    EXPECT_EQ( 5, p->x );
+    EXPECT_EQ( 6, p->y );
+    EXPECT_TRUE( istream.read( soon() ) == NULL );
+}
+
+#endif // #ifdef __GLIBCXX__
+
+TEST( csv, ascii_lexical_cast )
+{
+    EXPECT_EQ( 123, impl::lexical::cast< int >( "123", 3 ) );
+    EXPECT_EQ( -123, impl::lexical::cast< int >( "-123", 4 ) );
+    EXPECT_EQ( std::numeric_limits< comma::int64 >::min(), impl::lexical::cast< comma::int64 >( "-9223372036854775808", 20 ) );
+    EXPECT_EQ( std::numeric_limits< comma::uint64 >::max(), impl::lexical::cast< comma::uint64 >( "18446744073709551615", 20 ) );
+    EXPECT_THROW( impl::lexical::cast< comma::int64 >( "9223372036854775808", 19 ), boost::bad_lexical_cast );
+    EXPECT_THROW( impl::lexical::cast< comma::uint16 >( "65536", 5 ), boost::bad_lexical_cast );
+    EXPECT_THROW( impl::lexical::cast< int >( "1.5", 3 ), boost::bad_lexical_cast );
+    EXPECT_THROW( impl::lexical::cast< int >( " 1", 2 ), boost::bad_lexical_cast );
+    EXPECT_DOUBLE_EQ( 1.5, impl::lexical::cast< double >( "1.5", 3 ) );
+    EXPECT_DOUBLE_EQ( -1.5e-3, impl::lexical::cast< double >( "-1.5e-3", 7 ) );
+    EXPECT_FLOAT_EQ( 0.1f, impl::lexical::cast< float >( "0.1", 3 ) );
+    EXPECT_THROW( impl::lexical::cast< double >( "1.5x", 4 ), boost::bad_lexical_cast );
+    EXPECT_THROW( impl::lexical::cast< double >( ".", 1 ), boost::bad_lexical_cast );
+}
+
 } } } // namespace comma { namespace csv { namespace stream_test {
 
 namespace comma { namespace csv { namespace stream_test {
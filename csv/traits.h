@@ -49,6 +49,8 @@ template <> struct traits< comma::csv::options >
         v.apply( "precision", p.precision );
         v.apply( "quote", p.quote ? std::string( 1, *p.quote ) : std::string() );
         v.apply( "flush", p.flush );
+        v.apply( "mmap", p.mmap );
+        v.apply( "output-buffer", p.output_buffer );
         if( p.binary() ) { v.apply( "binary", p.format().string() ); }
         
     }
@@ -70,6 +72,8 @@ template <> struct traits< comma::csv::options >
             case 2: COMMA_THROW( comma::exception, "expected a quote character, got \"" << quote << "\"" );
         }
         v.apply( "flush", p.flush );
+        v.apply( "mmap", p.mmap );
+        v.apply( "output-buffer", p.output_buffer );
         std::string s;
         v.apply( "binary", s );
         if( s != "" ) { p.format( s ); }
@@ -34,8 +34,9 @@
 #include <sys/ioctl.h>
 #endif
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
-#include <boost/asio/ip/udp.hpp>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
@@ -45,7 +46,9 @@
 #include "../../base/exception.h"
 #include "../../base/types.h"
 #include "../../io/stream.h"
-#include "../../io/select.h"
+#include "../../io/impl/shm_ring.h"
+#include "../../io/impl/udp_receiver.h"
+#include "../../io/poller.h"
 #include "../../string/string.h"
 
 void usage( bool verbose = false )
@@ -59,6 +62,8 @@ void usage( bool verbose = false )
     std::cerr << "    local:<path>: local socket" << std::endl;
     std::cerr << "    tcp:<host>:<port>: tcp socket" << std::endl;
     std::cerr << "    udp:<port>: udp socket" << std::endl;
+    std::cerr << "    udp:<group>:<port>: udp socket joining multicast group, e.g. udp:239.1.1.1:12345" << std::endl;
+    std::cerr << "    shm:<name>: shared memory ring, e.g. written by io-publish shm:<name>" << std::endl;
     std::cerr << "    zmp-<protocol>:<address>: zmq (todo)" << std::endl;
     std::cerr << "    <filename>: file" << std::endl;
     std::cerr << "    <fifo>: named pipe" << std::endl;
@@ -72,9 +77,12 @@ void usage( bool verbose = false )
     std::cerr << "                                         before checking other inputs" << std::endl;
     std::cerr << "                                         if not specified, read from each input" << std::endl;
     std::cerr << "                                         all available data" << std::endl;
-    std::cerr << "                                         ignored for udp streams, where one full udp" << std::endl;
-    std::cerr << "                                         packet at a time is always read" << std::endl;
+    std::cerr << "                                         for udp streams, a packet is a udp packet; without" << std::endl;
+    std::cerr << "                                         --round-robin, all received udp packets that fit" << std::endl;
+    std::cerr << "                                         into the read buffer are read at once" << std::endl;
     std::cerr << "    --size,-s=[<size>]: packet size, if binary data (required only for multiple sources)" << std::endl;
+    std::cerr << "    --receive-buffer=<bytes>: udp socket receive buffer size; if not privileged, capped by" << std::endl;
+    std::cerr << "                              /proc/sys/net/core/rmem_max; default: system default" << std::endl;
     std::cerr << "    --verbose,-v: more output" << std::endl;
     std::cerr << std::endl;
     std::cerr << "connect options" << std::endl;
@@ -82,7 +90,7 @@ void usage( bool verbose = false )
     std::cerr << "    --connect-period=<seconds>; default=1; how long to wait before the next connect attempt" << std::endl;
     std::cerr << "    --permissive; run even if connection to some sources fails" << std::endl;
     std::cerr << std::endl;
-    std::cerr << "supported address types: tcp, udp, local (unix) sockets, named pipes, files, zmq (todo)" << std::endl;
+    std::cerr << "supported address types: tcp, udp, local (unix) sockets, shared memory, named pipes, files, zmq (todo)" << std::endl;
     std::cerr << std::endl;
     std::cerr << "examples" << std::endl;
     std::cerr << std::endl;
@@ -90,6 +98,7 @@ void usage( bool verbose = false )
     std::cerr << "        io-cat tcp:localhost:12345" << std::endl;
     std::cerr << "        io-cat udp:12345" << std::endl;
     std::cerr << "        io-cat local:/tmp/socket" << std::endl;
+    std::cerr << "        io-cat shm:camera --size 6220800" << std::endl;
     std::cerr << "        io-cat some/pipe" << std::endl;
     std::cerr << "        io-cat some/file" << std::endl;
     std::cerr << "        io-cat zmq-local:/tmp/socket (not implemented)" << std::endl;
@@ -122,6 +131,7 @@ class stream
         virtual bool closed() const = 0;
         virtual bool connected() const = 0;
         virtual void connect() = 0;
+        virtual void wait( const boost::posix_time::time_duration& ) {} // for streams without file descriptor
         const std::string& address() const { return address_; }
         
     protected:
@@ -131,11 +141,15 @@ class stream
 class udp_stream : public stream
 {
     public:
-        udp_stream( const std::string& address ) : stream( address )
+        udp_stream( const std::string& address, std::size_t receive_buffer, bool one_packet ) : stream( address ), index_( 0 ), one_packet_( one_packet )
         {
             const std::vector< std::string >& v = comma::split( address, ':' );
-            if( v.size() != 2 ) { COMMA_THROW( comma::exception, "io-cat: expected udp:<port>, e.g. udp:12345, got '" << address << "'" ); }
-            port_ = boost::lexical_cast< unsigned short >( v[1] );
+            if( v.size() != 2 && v.size() != 3 ) { COMMA_THROW( comma::exception, "io-cat: expected udp:<port> or udp:<group>:<port>, e.g. udp:12345, got '" << address << "'" ); }
+            port_ = boost::lexical_cast< unsigned short >( v.back() );
+            options_.size = 65536;
+            options_.kernel_timestamps = false;
+            options_.receive_buffer = receive_buffer;
+            if( v.size() == 3 ) { options_.group = v[1]; }
         }
         
         bool eof() const { return false; }
@@ -146,37 +160,36 @@ class udp_stream : public stream
         
         bool closed() const { return false; }
         
-        comma::io::file_descriptor fd() const { return socket_->native_handle(); }
+        comma::io::file_descriptor fd() const { return receiver_->fd(); }
         
-        unsigned int read_available( std::vector< char >& buffer, unsigned int )
+        unsigned int read_available( std::vector< char >& buffer, unsigned int ) // copy as many received packets as fit (or one, in round-robin); receive more only when all have been copied
         {
-            boost::system::error_code error;
-            std::size_t size = socket_->receive( boost::asio::buffer( buffer ), 0, error );
-            return error ? 0 : size;
+            if( index_ == receiver_->count() ) { index_ = 0; if( receiver_->receive() == 0 ) { return 0; } }
+            std::size_t size = 0;
+            for( ; index_ < receiver_->count() && ( size == 0 || ( !one_packet_ && size + receiver_->size( index_ ) <= buffer.size() ) ); ++index_ )
+            {
+                std::size_t s = std::min( receiver_->size( index_ ), buffer.size() - size );
+                ::memcpy( &buffer[size], receiver_->data( index_ ), s );
+                size += s;
+            }
+            return size;
         }
         
-        bool connected() const { return bool( socket_ ); }
+        bool connected() const { return bool( receiver_ ); }
         
         void connect()
         {
-            if( socket_ ) { return; }
-            socket_.reset( new boost::asio::ip::udp::socket( service_ ) );
-            socket_->open( boost::asio::ip::udp::v4() );
-            boost::system::error_code error;
-            socket_->set_option( boost::asio::ip::udp::socket::broadcast( true ), error );
-            if( error ) { socket_.reset(); COMMA_THROW( comma::exception, "io-cat: udp failed to set broadcast option on port " << port_ ); }
-            socket_->bind( boost::asio::ip::udp::endpoint( boost::asio::ip::udp::v4(), port_ ), error );
-            if( error ) { socket_.reset(); COMMA_THROW( comma::exception, "io-cat: udp failed to bind port " << port_ ); }
+            if( receiver_ ) { return; }
+            try { receiver_.reset( new comma::io::impl::udp_receiver( port_, options_ ) ); }
+            catch( std::exception& ex ) { COMMA_THROW( comma::exception, "io-cat: udp: " << ex.what() ); }
         }
         
     private:
         unsigned short port_;
-#if (BOOST_VERSION >= 106600)
-        boost::asio::io_context service_;
-#else
-        boost::asio::io_service service_;
-#endif
-        mutable boost::scoped_ptr< boost::asio::ip::udp::socket > socket_; // boost::asio::ip::udp::socket::fd() is non-const for some reason
+        comma::io::impl::udp_receiver::options options_;
+        boost::scoped_ptr< comma::io::impl::udp_receiver > receiver_;
+        std::size_t index_;
+        bool one_packet_;
 };
 
 class any_stream : public stream
@@ -247,10 +260,73 @@ class any_stream : public stream
         }
 };
 
-static stream* make_stream( const std::string& address, unsigned int size, bool binary )
+class shm_stream : public stream
+{
+    public:
+        shm_stream( const std::string& address, unsigned int size, bool binary ): stream( address ), size_( size ), binary_( binary ), closed_( false ), dropped_( 0 ) {}
+        
+        comma::io::file_descriptor fd() const { return comma::io::invalid_file_descriptor; }
+        
+        unsigned int read_available( std::vector< char >& buffer, unsigned int max_count )
+        {
+            if( binary_ && size_ )
+            {
+                std::size_t count = std::min< std::size_t >( reader_->available() / size_, max_count ? max_count : 1 );
+                std::size_t size = ( count == 0 ? 1 : count ) * size_; // read at least one packet
+                std::size_t bytes_read = 0;
+                while( bytes_read < size ) { std::size_t n = reader_->read( &buffer[bytes_read], size - bytes_read ); if( n == 0 ) { break; } bytes_read += n; }
+                return bytes_read;
+            }
+            if( binary_ ) { return reader_->read( &buffer[0], buffer.size(), false ); }
+            std::size_t n = reader_->read( &buffer[0], buffer.size(), false ); // output only full lines
+            if( reader_->dropped() != dropped_ ) { pending_.clear(); dropped_ = reader_->dropped(); } // partial line lost with dropped data; reader resumes on record boundary
+            pending_.append( &buffer[0], n );
+            std::string::size_type end = pending_.rfind( '\n' );
+            if( end == std::string::npos )
+            {
+                if( pending_.empty() || !reader_->eof() ) { return 0; }
+                pending_ += '\n';
+                end = pending_.size() - 1;
+            }
+            if( end >= buffer.size() ) { buffer.resize( end + 1 ); }
+            ::memcpy( &buffer[0], &pending_[0], end + 1 );
+            pending_.erase( 0, end + 1 );
+            return end + 1;
+        }
+        
+        bool empty() const { return !connected() || closed_ || ( reader_->available() == 0 && ( pending_.empty() || !reader_->eof() ) ); }
+        
+        bool eof() const { return reader_->eof() && pending_.empty(); }
+        
+        void close() { closed_ = true; reader_->close(); }
+        
+        bool closed() const { return closed_; }
+        
+        bool connected() const { return bool( reader_ ); }
+        
+        void connect()
+        {
+            if( reader_ ) { return; }
+            try { reader_.reset( new comma::io::impl::shm_reader( address_ ) ); }
+            catch( std::exception& ex ) { COMMA_THROW( comma::exception, "io-cat: shm: " << ex.what() ); }
+        }
+        
+        void wait( const boost::posix_time::time_duration& timeout ) { reader_->wait( timeout ); }
+        
+    private:
+        boost::scoped_ptr< comma::io::impl::shm_reader > reader_;
+        unsigned int size_;
+        bool binary_;
+        bool closed_;
+        std::string pending_;
+        comma::uint64 dropped_;
+};
+
+static stream* make_stream( const std::string& address, unsigned int size, bool binary, std::size_t receive_buffer, bool round_robin )
 {
     const std::vector< std::string >& v = comma::split( address, ':' );
-    if( v[0] == "udp" ) { return new udp_stream( address ); }
+    if( v[0] == "udp" ) { return new udp_stream( address, receive_buffer, round_robin ); }
+    if( v[0] == "shm" ) { return new shm_stream( address, size, binary ); }
     if( v[0] == "zmq-local" || v[0] == "zero-local" || v[0] == "zmq-tcp" || v[0] == "zero-tcp" ) { COMMA_THROW( comma::exception, "io-cat: zmq support not implemented" ); }
     return new any_stream( address, size, binary );
 }
@@ -260,16 +336,26 @@ static unsigned int connect_max_attempts;
 static boost::posix_time::time_duration connect_period;
 static bool permissive;
 
-static bool ready( const boost::ptr_vector< stream >& streams, comma::io::select& select, bool connected_all_we_could )
+static std::vector< stream* > unselectable( boost::ptr_vector< stream >& streams ) // open streams without file descriptor, e.g. shared memory
+{
+    std::vector< stream* > s;
+    for( unsigned int i = 0; i < streams.size(); ++i ) { if( streams[i].connected() && !streams[i].closed() && streams[i].fd() == comma::io::invalid_file_descriptor ) { s.push_back( &streams[i] ); } }
+    return s;
+}
+
+static bool ready( boost::ptr_vector< stream >& streams, comma::io::poller& select, bool connected_all_we_could )
 {
     for( unsigned int i = 0; i < streams.size(); ++i ) { if( !streams[i].empty() ) { select.check(); return true; } }
-    if( !select.read()().empty() ) { return select.wait( boost::posix_time::seconds( 1 ) ) > 0; }
+    const std::vector< stream* >& u = unselectable( streams );
+    for( unsigned int i = 0; i < u.size(); ++i ) { if( u[i]->eof() ) { select.check(); return true; } }
+    if( !select.read()().empty() ) { return select.wait( boost::posix_time::milliseconds( u.empty() ? 1000 : 10 ) ) > 0; } // quick and dirty: poll streams without file descriptor
+    if( !u.empty() ) { u[0]->wait( boost::posix_time::milliseconds( u.size() == 1 ? 1000 : 10 ) ); return true; }
     if( connected_all_we_could ) { return true; }
     boost::this_thread::sleep( connect_period );
     return false;
 }
 
-static bool try_connect( boost::ptr_vector< stream >& streams, comma::io::select& select )
+static bool try_connect( boost::ptr_vector< stream >& streams, comma::io::poller& select )
 {
     static boost::posix_time::ptime next_connect_attempt_time;
     static unsigned int attempts = 0;
@@ -331,11 +417,12 @@ int main( int argc, char** argv )
         #endif
         if( unnamed.empty() ) { std::cerr << "io-cat: please specify at least one source" << std::endl; return 1; }
         boost::ptr_vector< stream > streams;
-        comma::io::select select;
-        for( unsigned int i = 0; i < unnamed.size(); ++i ) { streams.push_back( make_stream( unnamed[i], size, size || unnamed.size() == 1 ) ); }
+        std::size_t receive_buffer = options.value< std::size_t >( "--receive-buffer", 0 );
+        comma::io::poller select;
+        unsigned int round_robin_count = unnamed.size() > 1 ? options.value( "--round-robin", 0 ) : 0;
+        for( unsigned int i = 0; i < unnamed.size(); ++i ) { streams.push_back( make_stream( unnamed[i], size, size || unnamed.size() == 1, receive_buffer, round_robin_count > 0 ) ); }
         const unsigned int max_count = size ? ( size > 65536u ? 1 : 65536u / size ) : 0;
         std::vector< char > buffer( size ? size * max_count : 65536u );        
-        unsigned int round_robin_count = unnamed.size() > 1 ? options.value( "--round-robin", 0 ) : 0;
         for( bool done = false; !done; )
         {
             if( is_shutdown ) { std::cerr << "io-cat: received signal" << std::endl; break; }
@@ -353,7 +440,7 @@ int main( int argc, char** argv )
                     if( verbose ) { std::cerr << "io-cat: stream " << i << " (" << unnamed[i] << "): closed" << std::endl; }
                     select.read().remove( streams[i].fd() );
                     streams[i].close();
-                    if( exit_on_first_closed || ( connected_all_we_could && select.read()().empty() ) ) { return 0; }
+                    if( exit_on_first_closed || ( connected_all_we_could && select.read()().empty() && unselectable( streams ).empty() ) ) { return 0; }
                     continue;
                 }
                 if( !ready && empty ) { done = false; continue; }
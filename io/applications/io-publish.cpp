@@ -44,6 +44,7 @@
 #include "../../application/signal_flag.h"
 #include "../../base/last_error.h"
 #include "../../io/file_descriptor.h"
+#include "../../io/poller.h"
 #include "../../io/publisher.h"
 #include "../../string/string.h"
 #include "../../sync/synchronized.h"
@@ -70,6 +71,23 @@ static void usage( bool verbose = false )
     std::cerr << "    --multiplier,-m: multiplier for packet size, default is 1. The actual packet size will be m * s" << std::endl;
     std::cerr << "    --no-discard: if present, do blocking write to every open stream" << std::endl;
     std::cerr << "    --no-flush: if present, do not flush the output stream (use on high bandwidth sources)" << std::endl;
+    std::cerr << "    --buffer=<bytes>: queue up to <bytes> of packets for each client and write them in background" << std::endl;
+    std::cerr << "                      with non-blocking writes, so that a slow client does not stall others;" << std::endl;
+    std::cerr << "                      clients still receive only full packets; not supported for udp and zeromq;" << std::endl;
+    std::cerr << "                      ignored for shared memory, which is a buffer itself" << std::endl;
+    std::cerr << "    --on-full=<policy>: with --buffer, what to do with a new packet, if client buffer is full" << std::endl;
+    std::cerr << "                        drop-oldest: discard oldest packets not yet written to client (default)" << std::endl;
+    std::cerr << "                        drop-newest: discard the new packet" << std::endl;
+    std::cerr << "                        disconnect: disconnect slow client" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "udp options" << std::endl;
+    std::cerr << "    with --no-flush, packets are packed into datagrams of up to --mtu bytes, which are sent in batches;" << std::endl;
+    std::cerr << "    otherwise, each packet is sent immediately in its own datagram; a packet is never split across datagrams" << std::endl;
+    std::cerr << "    --mtu=<bytes>: maximum datagram size, including sequence number; default: 1472" << std::endl;
+    std::cerr << "    --sequence: binary only; start each datagram with 8-byte little-endian unsigned sequence number," << std::endl;
+    std::cerr << "                so that receivers can detect lost datagrams" << std::endl;
+    std::cerr << "    --multicast-ttl,--ttl=<hops>: multicast time to live; default: 1" << std::endl;
+    std::cerr << "    --multicast-interface=<address>: ip address of interface to send multicast from; default: chosen by system" << std::endl;
     std::cerr << "    --exec=[<cmd>]: read from cmd rather than stdin" << std::endl;
     std::cerr << "    -- [<cmd>]: alternate syntax for specifying a command (simplifies quoting)" << std::endl;
     std::cerr << "    --on-demand: only run <cmd> when a client is connected" << std::endl;
@@ -99,8 +117,15 @@ static void usage( bool verbose = false )
     std::cerr << std::endl;
     std::cerr << "output streams" << std::endl;
     std::cerr << "    tcp:<port>: e.g. tcp:1234" << std::endl;
-    std::cerr << "    udp:<port>: e.g. udp:1234 (todo)" << std::endl;
+    std::cerr << "    udp:<port>: broadcast, e.g. udp:1234" << std::endl;
+    std::cerr << "    udp:<address>:<port>: unicast, broadcast, or multicast address, e.g. udp:239.1.1.1:1234" << std::endl;
     std::cerr << "    local:<name>: linux/unix local server socket e.g. local:./tmp/my_socket" << std::endl;
+    std::cerr << "    shm:<name>[:<bytes>]: shared memory ring of given size, default: 16MB, e.g. shm:camera:100000000" << std::endl;
+    std::cerr << "                          readers (e.g. io-cat shm:camera) attach and detach at any time and get" << std::endl;
+    std::cerr << "                          data without system calls; a packet must fit into the ring; a reader that" << std::endl;
+    std::cerr << "                          falls behind by more than ring size skips all the packets written so far" << std::endl;
+    std::cerr << "                          and continues from the next one, unless --no-discard is given, in which" << std::endl;
+    std::cerr << "                          case io-publish waits for the slowest reader" << std::endl;
     std::cerr << "    <named pipe name>: named pipe, which will be re-opened, if client reconnects" << std::endl;
     std::cerr << "    <filename>: a regular file" << std::endl;
     std::cerr << std::endl;
@@ -108,6 +133,9 @@ static void usage( bool verbose = false )
     std::cerr << "    cat data | io-publish tcp:1234 --size 100" << std::endl;
     std::cerr << "    io-publish tcp:1234 --size 24000 --on-demand --exec \"camera-cat arg1 arg2\"" << std::endl;
     std::cerr << "    io-publish tcp:1234 --size 24000 --on-demand -- camera-cat arg1 arg2" << std::endl;
+    std::cerr << "    cat data | io-publish tcp:1234 --size 1000000 --buffer 100000000 --on-full drop-oldest" << std::endl;
+    std::cerr << "    cat data | io-publish udp:239.1.1.1:1234 --size 100 --sequence --multicast-ttl 4" << std::endl;
+    std::cerr << "    camera-cat | io-publish shm:camera:200000000 --size 6220800 --no-flush" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
     std::cerr << std::endl;
@@ -125,6 +153,9 @@ class publish
                , unsigned int packet_size
                , bool discard
                , bool flush
+               , std::size_t buffer_size
+               , comma::io::publisher::policy::values policy
+               , const comma::io::publisher::udp_options& udp_options
                , bool output_number_of_clients
                , bool report_no_clients )
             : buffer_( packet_size, '\0' )
@@ -142,12 +173,12 @@ class publish
             sigaction( SIGPIPE, NULL, &old_action );
             sigaction( SIGPIPE, &new_action, NULL );
             transaction_t t( publishers_ );
+            comma::io::mode::value mode = is_binary_() ? comma::io::mode::binary : comma::io::mode::ascii;
             for( std::size_t i = 0; i < filenames.size(); ++i )
             {
-                t->push_back( new comma::io::publisher( filenames[i]
-                                                      , is_binary_() ? comma::io::mode::binary : comma::io::mode::ascii
-                                                      , !discard
-                                                      , flush ));
+                t->push_back( filenames[i].substr( 0, 4 ) == "udp:" ? new comma::io::publisher( filenames[i], mode, udp_options, flush )
+                            : buffer_size == 0 || filenames[i].substr( 0, 4 ) == "shm:" ? new comma::io::publisher( filenames[i], mode, !discard, flush )
+                            : new comma::io::publisher( filenames[i], mode, buffer_size, policy ) );
             }
             acceptor_thread_.reset( new boost::thread( boost::bind( &publish::accept_, boost::ref( *this ))));
         }
@@ -214,7 +245,7 @@ class publish
         
         void accept_()
         {
-            comma::io::select select;
+            comma::io::poller select;
             {
                 transaction_t t( publishers_ );
                 for( unsigned int i = 0; i < t->size(); ++i ) { if( ( *t )[i].acceptor_file_descriptor() != comma::io::invalid_file_descriptor ) { select.read().add( ( *t )[i].acceptor_file_descriptor() ); } }
@@ -295,16 +326,31 @@ int main( int ac, char** av )
         for( int i = 0; i < ac && std::string( "--" ) != av[i]; ++i ) { head.push_back( av[i] ); }
         for( int i = head.size() + 1; i < ac; ++i ) { tail.push_back( av[i] ); }
         comma::command_line_options options( head, usage );
-        const std::vector< std::string >& names = options.unnamed( "--no-discard,--verbose,-v,--no-flush,--output-number-of-clients,--clients,--exit-on-no-clients,-e,--on-demand", "-.+" );
+        const std::vector< std::string >& names = options.unnamed( "--no-discard,--verbose,-v,--no-flush,--sequence,--output-number-of-clients,--clients,--exit-on-no-clients,-e,--on-demand", "-.+" );
         if( names.empty() ) { std::cerr << "io-publish: please specify at least one stream; use '-' for stdout" << std::endl; return 1; }
         const boost::array< comma::signal_flag::signals, 2 > signals = { { comma::signal_flag::sigint, comma::signal_flag::sigterm } };
         comma::signal_flag is_shutdown( signals );
         bool on_demand = options.exists( "--on-demand" );
         bool exit_on_no_clients = options.exists( "--exit-on-no-clients,-e" );
+        std::size_t buffer_size = options.value< std::size_t >( "--buffer", 0 );
+        if( buffer_size > 0 && options.exists( "--no-discard" ) ) { std::cerr << "io-publish: --buffer and --no-discard are mutually exclusive" << std::endl; return 1; }
+        for( std::size_t i = 0; buffer_size > 0 && i < names.size(); ++i )
+        {
+            if( names[i].substr( 0, 4 ) == "udp:" || names[i].substr( 0, 4 ) == "zero" ) { std::cerr << "io-publish: --buffer: not supported for udp and zeromq; got: " << names[i] << std::endl; return 1; }
+        }
+        comma::io::publisher::udp_options udp_options;
+        udp_options.mtu = options.value( "--mtu", udp_options.mtu );
+        udp_options.sequence = options.exists( "--sequence" );
+        udp_options.ttl = options.value( "--multicast-ttl,--ttl", udp_options.ttl );
+        udp_options.interface = options.value< std::string >( "--multicast-interface", "" );
+        if( udp_options.sequence && !options.exists( "-s,--size" ) ) { std::cerr << "io-publish: --sequence: binary input only, please specify --size" << std::endl; return 1; }
         publish p( names
                  , options.value( "-s,--size", 0 ) * options.value( "-m,--multiplier", 1 )
                  , !options.exists( "--no-discard" )
                  , !options.exists( "--no-flush" )
+                 , buffer_size
+                 , comma::io::publisher::policy::from_string( options.value< std::string >( "--on-full", "drop-oldest" ) )
+                 , udp_options
                  , options.exists( "--output-number-of-clients,--clients" )
                  , exit_on_no_clients || on_demand );
         std::string exec_command = options.value< std::string >( "--exec", "" );
@@ -35,14 +35,15 @@
 #endif
 #include <iostream>
 #include <boost/array.hpp>
-#include <boost/asio/ip/udp.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/static_assert.hpp>
 #include "../../application/contact_info.h"
 #include "../../application/command_line_options.h"
 #include "../../base/types.h"
 #include "../../csv/format.h"
+#include "../../io/impl/udp_receiver.h"
 
 void usage()
 {
@@ -56,9 +57,16 @@ void usage()
     std::cerr << "    --ascii: output timestamp as ascii; default: 64-bit binary" << std::endl;
     std::cerr << "    --binary: output timestamp as 64-bit binary; default" << std::endl;
     std::cerr << "    --delimiter=<delimiter>: if ascii and --timestamp, use this delimiter; default: ','" << std::endl;
-    std::cerr << "    --size=<size>: hint of maximum buffer size; default 16384" << std::endl;
+    std::cerr << "    --size=<size>: maximum packet size, longer packets get truncated; default 16384" << std::endl;
+    std::cerr << "    --batch=<n>: maximum number of packets to receive in one system call; default 64" << std::endl;
+    std::cerr << "    --receive-buffer=<bytes>: socket receive buffer size; if not privileged, capped by" << std::endl;
+    std::cerr << "                              /proc/sys/net/core/rmem_max; default: system default" << std::endl;
     std::cerr << "    --reuse-addr,--reuseaddr: reuse udp address/port" << std::endl;
-    std::cerr << "    --timestamp: output packet timestamp (currently just system time)" << std::endl;
+    std::cerr << "    --multicast-group,--group=<address>: join multicast group" << std::endl;
+    std::cerr << "    --multicast-interface=<address>: ip address of interface to join multicast group on" << std::endl;
+    std::cerr << "    --timestamp: output packet timestamp: time when kernel received packet, if available" << std::endl;
+    std::cerr << "    --system-time: with --timestamp, use system time after packet was read instead" << std::endl;
+    std::cerr << "    --verbose,-v: more output to stderr" << std::endl;
     std::cerr << std::endl;
     std::cerr << comma::contact_info << std::endl;
     std::cerr << std::endl;
@@ -69,30 +77,24 @@ int main( int argc, char** argv )
 {
     comma::command_line_options options( argc, argv );
     if( argc < 2 || options.exists( "--help,-h" ) ) { usage(); }
-    const std::vector< std::string >& unnamed = options.unnamed( "--ascii,--binary,--reuse-addr,--reuseaddr,--timestamp", "--delimiter,--size" );
+    const std::vector< std::string >& unnamed = options.unnamed( "--ascii,--binary,--reuse-addr,--reuseaddr,--timestamp,--system-time,--verbose,-v", "-.+" );
     if( unnamed.empty() ) { std::cerr << "udp-client: please specify port" << std::endl; return 1; }
     unsigned short port = boost::lexical_cast< unsigned short >( unnamed[0] );
     bool timestamped = options.exists( "--timestamp" );
     bool binary = !options.exists( "--ascii" );
     char delimiter = options.value( "--delimiter", ',' );
-    std::vector< char > packet( options.value( "--size", 16384 ) );
-#if (BOOST_VERSION >= 106600)
-    boost::asio::io_context service;
-#else
-    boost::asio::io_service service;
-#endif
-    boost::asio::ip::udp::socket socket( service );
-    socket.open( boost::asio::ip::udp::v4() );
-    boost::system::error_code error;
-    socket.set_option( boost::asio::ip::udp::socket::broadcast( true ), error );
-    if( error ) { std::cerr << "udp-client: failed to set broadcast option on port " << port << std::endl; return 1; }
-    if( options.exists( "--reuse-addr,--reuseaddr" ) )
-    {
-        socket.set_option( boost::asio::ip::udp::socket::reuse_address( true ), error );
-        if( error ) { std::cerr << "udp-client: failed to set reuse address option on port " << port << std::endl; return 1; }
-    }
-    socket.bind( boost::asio::ip::udp::endpoint( boost::asio::ip::udp::v4(), port ), error );
-    if( error ) { std::cerr << "udp-client: failed to bind port " << port << std::endl; return 1; }
+    comma::io::impl::udp_receiver::options receiver_options;
+    receiver_options.size = options.value( "--size", receiver_options.size );
+    receiver_options.batch = options.value( "--batch", receiver_options.batch );
+    receiver_options.receive_buffer = options.value( "--receive-buffer", receiver_options.receive_buffer );
+    receiver_options.reuse_address = options.exists( "--reuse-addr,--reuseaddr" );
+    receiver_options.kernel_timestamps = timestamped && !options.exists( "--system-time" );
+    receiver_options.group = options.value< std::string >( "--multicast-group,--group", "" );
+    receiver_options.interface = options.value< std::string >( "--multicast-interface", "" );
+    boost::scoped_ptr< comma::io::impl::udp_receiver > receiver;
+    try { receiver.reset( new comma::io::impl::udp_receiver( port, receiver_options ) ); }
+    catch( std::exception& ex ) { std::cerr << "udp-client: " << ex.what() << std::endl; return 1; }
+    if( options.exists( "--verbose,-v" ) ) { std::cerr << "udp-client: receive buffer size: " << receiver->receive_buffer_size() << " bytes" << std::endl; }
 
     #ifdef WIN32
     if( binary )
@@ -103,25 +105,29 @@ int main( int argc, char** argv )
     
     while( std::cout.good() )
     {
-        boost::system::error_code error;
-        std::size_t size = socket.receive( boost::asio::buffer( packet ), 0, error );
-        if( error || size == 0 ) { break; }
-        if( timestamped )
+        std::size_t count;
+        try { count = receiver->receive(); }
+        catch( std::exception& ex ) { std::cerr << "udp-client: " << ex.what() << std::endl; return 1; }
+        for( std::size_t i = 0; i < count; ++i )
         {
-            boost::posix_time::ptime timestamp = boost::posix_time::microsec_clock::universal_time();
-            BOOST_STATIC_ASSERT( sizeof( boost::posix_time::ptime ) == sizeof( comma::uint64 ) );
-            if( binary )
-            { 
-                static char buf[ sizeof( comma::int64 ) ];
-                comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::to_bin( timestamp, buf );
-                std::cout.write( buf, sizeof( comma::int64 ) );
-            }
-            else
+            if( receiver->size( i ) == 0 ) { return 0; }
+            if( timestamped )
             {
-                std::cout << boost::posix_time::to_iso_string( timestamp ) << delimiter;
+                const boost::posix_time::ptime& timestamp = receiver->timestamp( i );
+                BOOST_STATIC_ASSERT( sizeof( boost::posix_time::ptime ) == sizeof( comma::uint64 ) );
+                if( binary )
+                {
+                    static char buf[ sizeof( comma::int64 ) ];
+                    comma::csv::format::traits< boost::posix_time::ptime, comma::csv::format::time >::to_bin( timestamp, buf );
+                    std::cout.write( buf, sizeof( comma::int64 ) );
+                }
+                else
+                {
+                    std::cout << boost::posix_time::to_iso_string( timestamp ) << delimiter;
+                }
             }
+            std::cout.write( receiver->data( i ), receiver->size( i ) );
         }
-        std::cout.write( &packet[0], size );
         std::cout.flush();
    }
    return 0;
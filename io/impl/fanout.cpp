@@ -0,0 +1,338 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifdef __linux__
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#endif
+#include <algorithm>
+#include <iostream>
+#include <boost/bind.hpp>
+#include "../../base/exception.h"
+#include "../../base/last_error.h"
+#include "fanout.h"
+
+namespace comma { namespace io { namespace impl {
+
+fanout::policy::values fanout::policy::from_string( const std::string& s )
+{
+    if( s == "drop-oldest" ) { return drop_oldest; }
+    if( s == "drop-newest" ) { return drop_newest; }
+    if( s == "disconnect" ) { return disconnect; }
+    COMMA_THROW( comma::exception, "expected drop-oldest, drop-newest, or disconnect; got: '" << s << "'" );
+}
+
+#ifdef __linux__
+
+fanout::fanout( std::size_t capacity, policy::values p )
+    : capacity_( capacity )
+    , policy_( p )
+    , dropped_( 0 )
+    , epoll_fd_( ::epoll_create1( EPOLL_CLOEXEC ) )
+    , event_fd_( ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) )
+    , signalled_( false )
+    , shutdown_( false )
+{
+    if( epoll_fd_ < 0 ) { comma::last_error::to_exception( "failed to create epoll descriptor" ); }
+    if( event_fd_ < 0 ) { ::close( epoll_fd_ ); comma::last_error::to_exception( "failed to create event descriptor" ); }
+    ::epoll_event e;
+    e.events = EPOLLIN;
+    e.data.fd = event_fd_;
+    if( ::epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, event_fd_, &e ) != 0 ) { ::close( event_fd_ ); ::close( epoll_fd_ ); comma::last_error::to_exception( "failed to add event descriptor to epoll" ); }
+    thread_.reset( new boost::thread( boost::bind( &fanout::run_, this ) ) );
+}
+
+fanout::~fanout()
+{
+    {
+        boost::mutex::scoped_lock lock( mutex_ );
+        shutdown_ = true;
+        signalled_ = false;
+        signal_();
+    }
+    thread_->join();
+    for( clients_t::iterator it = clients_.begin(); it != clients_.end(); ++it ) { ::fcntl( it->first, F_SETFL, it->second.flags ); }
+    ::close( event_fd_ );
+    ::close( epoll_fd_ );
+}
+
+void fanout::add( const stream_type& stream )
+{
+    client c;
+    c.stream = stream;
+    c.fd = stream->fd();
+    if( c.fd == io::invalid_file_descriptor ) { COMMA_THROW( comma::exception, "expected stream with file descriptor; got invalid descriptor for " << stream->name() ); }
+    c.flags = ::fcntl( c.fd, F_GETFL, 0 );
+    if( c.flags < 0 ) { comma::last_error::to_exception( "failed to get flags of " + stream->name() ); }
+    ::fcntl( c.fd, F_SETFL, c.flags | O_NONBLOCK );
+    struct stat s;
+    c.is_socket = ::fstat( c.fd, &s ) == 0 && S_ISSOCK( s.st_mode );
+    ::epoll_event e;
+    e.events = EPOLLOUT | EPOLLET;
+    e.data.fd = c.fd;
+    if( ::epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, c.fd, &e ) == 0 ) { c.polled = true; }
+    else if( errno != EPERM ) { ::fcntl( c.fd, F_SETFL, c.flags ); comma::last_error::to_exception( "failed to add " + stream->name() + " to epoll" ); } // regular files cannot be polled, but are always writable
+    boost::mutex::scoped_lock lock( mutex_ );
+    clients_[ c.fd ] = c;
+}
+
+unsigned int fanout::write( const char* buf, std::size_t size )
+{
+    if( size == 0 ) { return 0; }
+    packet p( new std::string( buf, size ) );
+    boost::mutex::scoped_lock lock( mutex_ );
+    unsigned int count = 0;
+    bool ready = false;
+    for( clients_t::iterator i = clients_.begin(); i != clients_.end(); )
+    {
+        clients_t::iterator it = i++;
+        client& c = it->second;
+        if( c.removing ) { continue; }
+        if( !c.packets.empty() && c.size + size > capacity_ )
+        {
+            switch( policy_ )
+            {
+                case policy::drop_newest:
+                    ++dropped_;
+                    continue;
+                case policy::disconnect:
+                    remove_( it );
+                    continue;
+                case policy::drop_oldest:
+                    for( std::deque< packet >::iterator j = c.packets.begin() + std::max< std::size_t >( c.sending, c.offset > 0 ); j != c.packets.end() && c.size + size > capacity_; ++dropped_ ) // partially written packet and packets being written have to go through
+                    {
+                        c.size -= ( *j )->size();
+                        j = c.packets.erase( j );
+                    }
+                    if( !c.packets.empty() && c.size + size > capacity_ ) { ++dropped_; continue; }
+                    break;
+            }
+        }
+        c.packets.push_back( p );
+        c.size += size;
+        ++count;
+        if( !c.blocked ) { ready = true; }
+    }
+    if( ready ) { signal_(); }
+    return count;
+}
+
+std::vector< fanout::stream_type > fanout::removed()
+{
+    std::vector< stream_type > r;
+    boost::mutex::scoped_lock lock( mutex_ );
+    r.swap( removed_ );
+    return r;
+}
+
+std::vector< fanout::stream_type > fanout::close( boost::posix_time::time_duration timeout )
+{
+    boost::mutex::scoped_lock lock( mutex_ );
+    for( unsigned int i = 0; i < 2; ++i )
+    {
+        boost::system_time deadline = boost::get_system_time() + timeout;
+        while( true )
+        {
+            bool empty = true;
+            for( clients_t::const_iterator it = clients_.begin(); empty && it != clients_.end(); ++it ) { empty = it->second.packets.empty(); }
+            if( empty || !drained_.timed_wait( lock, deadline ) ) { break; }
+        }
+        for( clients_t::iterator it = clients_.begin(); it != clients_.end(); ++it ) // give slow clients another chance to receive the rest of partially written packet
+        {
+            client& c = it->second;
+            std::size_t size = std::max< std::size_t >( c.sending, c.offset > 0 );
+            dropped_ += c.packets.size() - size;
+            c.packets.resize( size );
+            c.size = 0;
+            for( std::deque< packet >::const_iterator j = c.packets.begin(); j != c.packets.end(); ++j ) { c.size += ( *j )->size(); }
+            c.size -= c.offset;
+        }
+    }
+    while( true ) // wait for packets being written to be accounted for
+    {
+        bool sending = false;
+        for( clients_t::const_iterator it = clients_.begin(); !sending && it != clients_.end(); ++it ) { sending = it->second.sending > 0; }
+        if( !sending ) { break; }
+        drained_.wait( lock );
+    }
+    while( !clients_.empty() ) { remove_( clients_.begin() ); }
+    std::vector< stream_type > r;
+    r.swap( removed_ );
+    return r;
+}
+
+std::size_t fanout::size() const { boost::mutex::scoped_lock lock( mutex_ ); return clients_.size(); }
+
+std::size_t fanout::dropped() const { boost::mutex::scoped_lock lock( mutex_ ); return dropped_; }
+
+void fanout::signal_()
+{
+    if( signalled_ ) { return; }
+    signalled_ = true;
+    ::uint64_t one = 1;
+    while( ::write( event_fd_, &one, sizeof( one ) ) < 0 && errno == EINTR );
+}
+
+void fanout::flush_( int fd )
+{
+    static const unsigned int max_size = 64;
+    ::iovec iov[ max_size ];
+    packet packets[ max_size ];
+    while( true )
+    {
+        unsigned int size = 0;
+        bool is_socket;
+        {
+            boost::mutex::scoped_lock lock( mutex_ );
+            clients_t::iterator it = clients_.find( fd );
+            if( it == clients_.end() || it->second.removing || it->second.blocked ) { return; }
+            client& c = it->second;
+            std::size_t offset = c.offset;
+            for( std::deque< packet >::const_iterator j = c.packets.begin(); j != c.packets.end() && size < max_size; ++j, ++size, offset = 0 )
+            {
+                packets[size] = *j;
+                iov[size].iov_base = const_cast< char* >( ( *j )->data() ) + offset;
+                iov[size].iov_len = ( *j )->size() - offset;
+            }
+            if( size == 0 ) { return; }
+            c.sending = size;
+            is_socket = c.is_socket;
+        }
+        ::ssize_t n; // write outside of the lock, so that a slow client does not hold up writers and other clients
+        if( is_socket )
+        {
+            ::msghdr m = ::msghdr();
+            m.msg_iov = iov;
+            m.msg_iovlen = size;
+            n = ::sendmsg( fd, &m, MSG_NOSIGNAL );
+        }
+        else
+        {
+            n = ::writev( fd, iov, size );
+        }
+        int error = n < 0 ? errno : 0;
+        for( unsigned int i = 0; i < size; ++i ) { packets[i].reset(); }
+        boost::mutex::scoped_lock lock( mutex_ );
+        clients_t::iterator it = clients_.find( fd ); // client is still there, since its removal is deferred while sending
+        client& c = it->second;
+        c.sending = 0;
+        drained_.notify_all();
+        if( n > 0 )
+        {
+            c.size -= n;
+            for( std::size_t left = n; left > 0; )
+            {
+                std::size_t remaining = c.packets.front()->size() - c.offset;
+                if( left < remaining ) { c.offset += left; break; }
+                left -= remaining;
+                c.offset = 0;
+                c.packets.pop_front();
+            }
+        }
+        if( c.removing ) { remove_( it ); return; }
+        if( n >= 0 || error == EINTR ) { continue; }
+        if( error == EAGAIN || error == EWOULDBLOCK ) { c.blocked = c.polled; return; }
+        remove_( it );
+        return;
+    }
+}
+
+void fanout::remove_( clients_t::iterator it )
+{
+    if( it->second.sending > 0 ) { it->second.removing = true; return; }
+    if( it->second.polled ) { ::epoll_ctl( epoll_fd_, EPOLL_CTL_DEL, it->first, NULL ); }
+    ::fcntl( it->first, F_SETFL, it->second.flags );
+    removed_.push_back( it->second.stream );
+    clients_.erase( it );
+}
+
+void fanout::run_()
+{
+    static const int max_size = 64;
+    ::epoll_event events[ max_size ];
+    std::vector< int > ready;
+    while( true )
+    {
+        int size = ::epoll_wait( epoll_fd_, events, max_size, -1 );
+        if( size < 0 && errno != EINTR ) { std::cerr << "comma::io::publisher: epoll_wait failed: " << comma::last_error::to_string() << std::endl; return; }
+        ready.clear();
+        {
+            boost::mutex::scoped_lock lock( mutex_ );
+            if( shutdown_ ) { return; }
+            bool signalled = false;
+            for( int i = 0; i < size; ++i )
+            {
+                if( events[i].data.fd == event_fd_ )
+                {
+                    ::uint64_t value;
+                    while( ::read( event_fd_, &value, sizeof( value ) ) < 0 && errno == EINTR );
+                    signalled_ = false;
+                    signalled = true;
+                    continue;
+                }
+                clients_t::iterator it = clients_.find( events[i].data.fd );
+                if( it == clients_.end() ) { continue; }
+                if( events[i].events & ( EPOLLERR | EPOLLHUP ) ) { remove_( it ); continue; }
+                it->second.blocked = false;
+                if( !signalled ) { ready.push_back( it->first ); }
+            }
+            if( signalled )
+            {
+                ready.clear();
+                for( clients_t::const_iterator it = clients_.begin(); it != clients_.end(); ++it ) { if( !it->second.blocked && !it->second.packets.empty() ) { ready.push_back( it->first ); } }
+            }
+        }
+        for( std::size_t i = 0; i < ready.size(); ++i ) { flush_( ready[i] ); }
+        boost::mutex::scoped_lock lock( mutex_ );
+        drained_.notify_all();
+    }
+}
+
+#else // #ifdef __linux__
+
+fanout::fanout( std::size_t, policy::values ) { COMMA_THROW( comma::exception, "buffered publishing: not implemented on this platform" ); }
+fanout::~fanout() {}
+void fanout::add( const stream_type& ) {}
+unsigned int fanout::write( const char*, std::size_t ) { return 0; }
+std::vector< fanout::stream_type > fanout::removed() { return std::vector< stream_type >(); }
+std::vector< fanout::stream_type > fanout::close( boost::posix_time::time_duration ) { return std::vector< stream_type >(); }
+std::size_t fanout::size() const { return 0; }
+std::size_t fanout::dropped() const { return 0; }
+
+#endif // #ifdef __linux__
+
+} } } // namespace comma { namespace io { namespace impl {
@@ -0,0 +1,135 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_IO_IMPL_FANOUT_H_
+#define COMMA_IO_IMPL_FANOUT_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "../stream.h"
+
+namespace comma { namespace io { namespace impl {
+
+/// writes packets to many clients from a background event loop (epoll)
+/// with non-blocking partial writes; each client has a bounded queue
+/// of packets; a client always receives whole packets, since a packet
+/// is dropped only if none of its bytes has been written yet
+class fanout
+{
+    public:
+        /// what to do with a packet, if a client queue is full
+        struct policy
+        {
+            enum values { drop_oldest, drop_newest, disconnect };
+
+            /// drop-oldest | drop-newest | disconnect
+            static values from_string( const std::string& s );
+        };
+
+        typedef boost::shared_ptr< io::ostream > stream_type;
+
+        /// @param capacity maximum number of bytes queued for a client
+        /// @param p what to do, if a client queue is full
+        fanout( std::size_t capacity, policy::values p );
+
+        /// stop event loop, does not close streams
+        ~fanout();
+
+        /// add client stream, which will be switched to non-blocking mode
+        void add( const stream_type& stream );
+
+        /// queue packet for all clients
+        /// @return number of clients the packet has been queued for
+        unsigned int write( const char* buf, std::size_t size );
+
+        /// remove clients that have disconnected or failed since last call
+        /// @return streams of removed clients; it is up to the caller to close them
+        std::vector< stream_type > removed();
+
+        /// try to write queued packets for up to a given time, then drop
+        /// packets not started yet and try to finish partially written
+        /// packets for up to the same time, then remove all clients
+        /// @return streams of all clients; it is up to the caller to close them
+        std::vector< stream_type > close( boost::posix_time::time_duration timeout = boost::posix_time::seconds( 1 ) );
+
+        /// return current number of clients
+        std::size_t size() const;
+
+        /// return number of packets dropped so far across all clients
+        std::size_t dropped() const;
+
+    private:
+        typedef boost::shared_ptr< const std::string > packet;
+        struct client
+        {
+            stream_type stream;
+            int fd;
+            int flags;
+            bool is_socket;
+            bool polled;
+            bool blocked;
+            std::deque< packet > packets;
+            std::size_t size;
+            std::size_t offset;
+            std::size_t sending; // number of packets at the front of the queue being written outside of the lock; they are never dropped
+            bool removing; // removal deferred until packets being written are accounted for
+            client() : fd( -1 ), flags( 0 ), is_socket( false ), polled( false ), blocked( false ), size( 0 ), offset( 0 ), sending( 0 ), removing( false ) {}
+        };
+        typedef std::map< int, client > clients_t;
+        std::size_t capacity_;
+        policy::values policy_;
+        clients_t clients_;
+        std::vector< stream_type > removed_;
+        std::size_t dropped_;
+        int epoll_fd_;
+        int event_fd_;
+        bool signalled_;
+        bool shutdown_;
+        mutable boost::mutex mutex_;
+        boost::condition_variable drained_;
+        boost::scoped_ptr< boost::thread > thread_;
+        void run_();
+        void signal_();
+        void flush_( int fd );
+        void remove_( clients_t::iterator it );
+};
+
+} } } // namespace comma { namespace io { namespace impl {
+
+#endif // #ifndef COMMA_IO_IMPL_FANOUT_H_
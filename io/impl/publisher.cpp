@@ -181,7 +181,7 @@ class socket_acceptor : public acceptor
 
     private:
         io::mode::value mode_;
-        io::select select_;
+        io::poller select_;
 #if (BOOST_VERSION >= 106600)
         boost::asio::io_context m_service;
 #else
@@ -218,6 +218,32 @@ class zero_acceptor_ : public acceptor
 publisher::publisher( const std::string& name, io::mode::value mode, bool blocking, bool flush )
     : blocking_( blocking ),
       flush_( flush )
+{
+    init_( name, mode );
+}
+
+publisher::publisher( const std::string& name, io::mode::value mode, std::size_t buffer_size, fanout::policy::values policy )
+    : blocking_( false ),
+      flush_( false )
+{
+    if( name.substr( 0, 4 ) == "zero" ) { COMMA_THROW( comma::exception, "buffered publishing to zeromq: not supported" ); }
+    if( name.substr( 0, 4 ) == "udp:" ) { COMMA_THROW( comma::exception, "buffered publishing to udp: not supported" ); }
+    if( name.substr( 0, 4 ) == "shm:" ) { COMMA_THROW( comma::exception, "buffered publishing to shared memory: not supported; use shm:<name>:<bytes> to set ring size instead" ); }
+    fanout_.reset( new fanout( buffer_size, policy ) );
+    init_( name, mode );
+    for( streams::const_iterator it = streams_.begin(); it != streams_.end(); ++it ) { select_.write().remove( **it ); fanout_->add( *it ); }
+    streams_.clear();
+}
+
+publisher::publisher( const std::string& name, io::mode::value mode, const udp_sender::options& options, bool flush )
+    : blocking_( false ),
+      flush_( flush )
+{
+    if( name.substr( 0, 4 ) != "udp:" ) { COMMA_THROW( comma::exception, "expected udp address, got '" << name << "'" ); }
+    init_( name, mode, options );
+}
+
+void publisher::init_( const std::string& name, io::mode::value mode, const udp_sender::options& udp )
 {
     std::vector< std::string > v = comma::split( name, ':' );
     if( v[0] == "tcp" )
@@ -227,7 +253,11 @@ publisher::publisher( const std::string& name, io::mode::value mode, bool blocki
     }
     else if( v[0] == "udp" )
     {
-        COMMA_THROW( comma::exception, "udp: todo" );
+        udp_.reset( new udp_sender( name, udp ) );
+    }
+    else if( v[0] == "shm" )
+    {
+        shm_.reset( new shm_writer( name, blocking_ ) );
     }
     else if( v[0] == "local" )
     {
@@ -265,6 +295,9 @@ publisher::publisher( const std::string& name, io::mode::value mode, bool blocki
 unsigned int publisher::write( const char* buf, std::size_t size, bool do_accept )
 {
     if( do_accept ) { accept(); }
+    if( fanout_ ) { remove_( fanout_->removed() ); return fanout_->write( buf, size ); }
+    if( udp_ ) { udp_->write( buf, size, flush_ ); return 1; }
+    if( shm_ ) { shm_->write( buf, size ); return shm_->readers(); }
     if( !blocking_ ) { select_.check(); } // todo: if slow, put all the files in one select
     unsigned int count = 0;
     for( streams::iterator i = streams_.begin(); i != streams_.end(); )
@@ -281,18 +314,24 @@ unsigned int publisher::write( const char* buf, std::size_t size, bool do_accept
 
 void publisher::close()
 {
+    if( !line_.empty() ) { write( &line_[0], line_.size() ); line_.clear(); } // last line without end of line
     if( acceptor_ ) { acceptor_->close(); }
+    if( fanout_ ) { remove_( fanout_->close() ); }
+    if( udp_ ) { udp_->close(); }
+    if( shm_ ) { shm_->close(); }
     while( streams_.begin() != streams_.end() ) { remove_( streams_.begin() ); }
 }
 
 unsigned int publisher::accept()
 {
     if( !acceptor_ ) { return 0; }
+    if( fanout_ ) { remove_( fanout_->removed() ); }
     unsigned int count = 0;
     while( true ) // while( streams_.size() < maxSize ?
     {
         io::ostream* s = acceptor_->accept();
         if( s == NULL ) { return count; }
+        if( fanout_ ) { fanout_->add( boost::shared_ptr< io::ostream >( s ) ); ++count; continue; }
         streams_.insert( boost::shared_ptr< io::ostream >( s ) );
         select_.write().add( *s );
         ++count;
@@ -307,6 +346,15 @@ void publisher::remove_( streams::iterator it )
     streams_.erase( it );
 }
 
-std::size_t publisher::size() const { return streams_.size(); }
+void publisher::remove_( const std::vector< fanout::stream_type >& removed )
+{
+    for( std::size_t i = 0; i < removed.size(); ++i )
+    {
+        removed[i]->close();
+        if( acceptor_ ) { acceptor_->notify_closed(); }
+    }
+}
+
+std::size_t publisher::size() const { return fanout_ ? fanout_->size() : udp_ ? 1 : shm_ ? shm_->readers() : streams_.size(); }
 
 } } } // namespace comma { namespace io { namespace impl {
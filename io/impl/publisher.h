@@ -34,11 +34,15 @@
 #define COMMA_IO_IMPL_PUBLISHER_H_
 
 #include <set>
+#include <sstream>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include "../file_descriptor.h"
-#include "../select.h"
+#include "../poller.h"
 #include "../stream.h"
+#include "fanout.h"
+#include "shm_ring.h"
+#include "udp_sender.h"
 
 namespace comma { namespace io {
     
@@ -62,11 +66,25 @@ class publisher
     public:
         publisher( const std::string& name, io::mode::value mode, bool blocking = false, bool flush = true );
 
+        publisher( const std::string& name, io::mode::value mode, std::size_t buffer_size, fanout::policy::values policy );
+
+        publisher( const std::string& name, io::mode::value mode, const udp_sender::options& options, bool flush = true );
+
         unsigned int write( const char* buf, std::size_t size, bool do_accept = true );
 
         template < typename T >
         impl::publisher& operator<<( const T& lhs ) // quick and dirty, inefficient, but then ascii is meant to be slow...
         {
+            if( fanout_ || udp_ || shm_ ) // accumulate and write whole lines, e.g. one datagram per line
+            {
+                std::ostringstream oss;
+                oss << lhs;
+                line_ += oss.str();
+                std::string::size_type begin = 0;
+                for( std::string::size_type end = line_.find( '\n' ); end != std::string::npos; begin = end + 1, end = line_.find( '\n', begin ) ) { write( &line_[begin], end + 1 - begin ); }
+                line_.erase( 0, begin );
+                return *this;
+            }
             accept();
             select_.check();
             unsigned int count = 0;
@@ -97,8 +115,14 @@ class publisher
         boost::scoped_ptr< io::impl::acceptor > acceptor_;
         typedef std::set< boost::shared_ptr< io::ostream > > streams;
         streams streams_;
-        io::select select_;
+        io::poller select_;
+        boost::scoped_ptr< fanout > fanout_;
+        boost::scoped_ptr< udp_sender > udp_;
+        boost::scoped_ptr< shm_writer > shm_;
+        std::string line_; // incomplete line output with operator<<
+        void init_( const std::string& name, io::mode::value mode, const udp_sender::options& udp = udp_sender::options() );
         void remove_( streams::iterator it );
+        void remove_( const std::vector< fanout::stream_type >& removed );
 };
 
 } } } // namespace comma { namespace io { namespace impl {
@@ -0,0 +1,435 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <boost/lexical_cast.hpp>
+#include "../../base/exception.h"
+#include "../../base/last_error.h"
+#include "../../string/string.h"
+#include "shm_ring.h"
+
+namespace comma { namespace io { namespace impl {
+
+#ifndef WIN32
+
+enum { max_readers = 64 };
+
+static const comma::uint64 magic = 0x31676e69726d6f63ULL; // "comring1"
+
+// lives at the beginning of shared memory object, followed by ring data;
+// atomics are lock-free and therefore can be shared between processes
+// fields touched by writer and by readers are kept in separate cache lines
+struct shm_header
+{
+    std::atomic< comma::uint64 > magic;
+    comma::uint64 capacity;
+    std::atomic< comma::int32 > writer; // writer pid
+    alignas( 64 ) std::atomic< comma::uint64 > head; // number of bytes written so far
+    std::atomic< comma::uint64 > reserved; // number of bytes written or being written
+    alignas( 64 ) std::atomic< comma::uint32 > data; // futex: incremented on new data and on close
+    std::atomic< comma::uint32 > readers_waiting;
+    std::atomic< comma::uint32 > closed;
+    alignas( 64 ) std::atomic< comma::uint32 > space; // futex: incremented, when a reader moves its cursor and writer waits
+    std::atomic< comma::uint32 > writer_waiting;
+    struct slot
+    {
+        alignas( 64 ) std::atomic< comma::uint64 > cursor; // number of bytes read so far
+        std::atomic< comma::int32 > pid; // 0: slot free
+    };
+    slot readers[ max_readers ];
+};
+
+static std::size_t header_size_()
+{
+    std::size_t page = ::sysconf( _SC_PAGESIZE );
+    return ( ( sizeof( shm_header ) + page - 1 ) / page ) * page;
+}
+
+static std::string shm_name_( const std::string& name, std::size_t* size = NULL )
+{
+    const std::vector< std::string >& v = comma::split( name, ':' );
+    if( v[0] != "shm" || v.size() < 2 || v.size() > 3 || v[1].empty() ) { COMMA_THROW( comma::exception, "expected shm:<name>[:<bytes>], got '" << name << "'" ); }
+    if( size && v.size() == 3 ) { *size = boost::lexical_cast< std::size_t >( v[2] ); }
+    return "/" + v[1];
+}
+
+static bool alive_( comma::int32 pid ) { return pid == 0 || ::kill( pid, 0 ) == 0 || errno != ESRCH; } // pid 0: unknown, assume alive
+
+/// return pid of the live writer of existing ring with given name, if any
+static comma::int32 live_writer_( const std::string& name )
+{
+    int fd = ::shm_open( &name[0], O_RDONLY, 0 );
+    if( fd < 0 ) { return 0; }
+    comma::int32 pid = 0;
+    struct ::stat s;
+    if( ::fstat( fd, &s ) == 0 && std::size_t( s.st_size ) >= sizeof( shm_header ) )
+    {
+        void* p = ::mmap( NULL, sizeof( shm_header ), PROT_READ, MAP_SHARED, fd, 0 );
+        if( p != MAP_FAILED )
+        {
+            const shm_header* h = reinterpret_cast< const shm_header* >( p );
+            if( h->magic.load() == magic && !h->closed.load() && h->writer.load() != 0 && alive_( h->writer.load() ) ) { pid = h->writer.load(); }
+            ::munmap( p, sizeof( shm_header ) );
+        }
+    }
+    ::close( fd );
+    return pid;
+}
+
+static void futex_wait_( std::atomic< comma::uint32 >& word, comma::uint32 value, const boost::posix_time::time_duration& timeout )
+{
+#ifdef __linux__
+    ::timespec t;
+    t.tv_sec = timeout.total_seconds();
+    t.tv_nsec = ( timeout.total_microseconds() % 1000000 ) * 1000;
+    ::syscall( SYS_futex, reinterpret_cast< int* >( &word ), FUTEX_WAIT, value, &t, NULL, 0 ); // not private: futex is shared between processes
+#else
+    if( word.load() == value ) { ::usleep( std::min< comma::int64 >( timeout.total_microseconds(), 1000 ) ); } // quick and dirty: poll
+#endif
+}
+
+static void futex_wake_( std::atomic< comma::uint32 >& word )
+{
+#ifdef __linux__
+    ::syscall( SYS_futex, reinterpret_cast< int* >( &word ), FUTEX_WAKE, INT_MAX, NULL, NULL, 0 );
+#else
+    (void)word;
+#endif
+}
+
+shm_writer::shm_writer( const std::string& name, bool blocking )
+    : blocking_( blocking )
+    , fd_( -1 )
+    , capacity_( 16 * 1024 * 1024 )
+    , mapped_( 0 )
+    , header_( NULL )
+    , data_( NULL )
+    , head_( 0 )
+    , tail_( 0 )
+{
+    name_ = shm_name_( name, &capacity_ );
+    if( capacity_ == 0 ) { COMMA_THROW( comma::exception, "expected positive ring size, got '" << name << "'" ); }
+    comma::int32 pid = live_writer_( name_ );
+    if( pid != 0 ) { COMMA_THROW( comma::exception, "shared memory " << name_ << " is in use by writer with pid " << pid ); }
+    ::shm_unlink( &name_[0] ); // remove ring possibly left behind by writer that crashed
+    fd_ = ::shm_open( &name_[0], O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH );
+    if( fd_ < 0 ) { last_error::to_exception( "failed to create shared memory " + name_ ); }
+    mapped_ = header_size_() + capacity_;
+    if( ::ftruncate( fd_, mapped_ ) != 0 ) { ::close( fd_ ); ::shm_unlink( &name_[0] ); COMMA_THROW( comma::exception, "failed to allocate " << mapped_ << " bytes of shared memory " << name_ ); }
+    void* p = ::mmap( NULL, mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0 );
+    if( p == MAP_FAILED ) { ::close( fd_ ); ::shm_unlink( &name_[0] ); COMMA_THROW( comma::exception, "failed to map " << mapped_ << " bytes of shared memory " << name_ ); }
+    header_ = reinterpret_cast< shm_header* >( p ); // zero-filled by ftruncate
+    data_ = reinterpret_cast< char* >( p ) + header_size_();
+    header_->capacity = capacity_;
+    header_->writer.store( ::getpid() );
+    header_->magic.store( magic ); // readers can attach from now on
+}
+
+shm_writer::~shm_writer() { close(); }
+
+void shm_writer::write( const char* buf, std::size_t size )
+{
+    if( !header_ ) { COMMA_THROW( comma::exception, "write to closed shared memory " << name_ ); }
+    if( !blocking_ && size > capacity_ ) { COMMA_THROW( comma::exception, "record of " << size << " bytes does not fit into shared memory " << name_ << " of " << capacity_ << " bytes; increase ring size" ); }
+    while( size > 0 )
+    {
+        std::size_t n = std::min( size, capacity_ );
+        if( blocking_ ) { wait_for_space_( n ); }
+        header_->reserved.store( head_ + n, std::memory_order_relaxed ); // let readers detect, if data they copy gets overwritten
+        std::atomic_thread_fence( std::memory_order_release );
+        std::size_t offset = head_ % capacity_;
+        std::size_t first = std::min( n, capacity_ - offset );
+        ::memcpy( data_ + offset, buf, first );
+        if( first < n ) { ::memcpy( data_, buf + first, n - first ); }
+        head_ += n;
+        header_->head.store( head_ );
+        header_->data.fetch_add( 1 );
+        if( header_->readers_waiting.load() > 0 ) { futex_wake_( header_->data ); }
+        buf += n;
+        size -= n;
+    }
+}
+
+void shm_writer::wait_for_space_( std::size_t size )
+{
+    if( head_ + size <= tail_ + capacity_ ) { return; }
+    while( true )
+    {
+        comma::uint32 space = header_->space.load();
+        tail_ = min_cursor_( false );
+        if( head_ + size <= tail_ + capacity_ ) { return; }
+        header_->writer_waiting.store( 1 );
+        tail_ = min_cursor_( true ); // check again, since a reader might have moved before seeing writer waiting
+        if( head_ + size <= tail_ + capacity_ ) { header_->writer_waiting.store( 0 ); return; }
+        futex_wait_( header_->space, space, boost::posix_time::milliseconds( 100 ) ); // timeout to notice readers that died
+        header_->writer_waiting.store( 0 );
+    }
+}
+
+comma::uint64 shm_writer::min_cursor_( bool check_alive )
+{
+    comma::uint64 m = head_;
+    for( unsigned int i = 0; i < max_readers; ++i )
+    {
+        comma::int32 pid = header_->readers[i].pid.load();
+        if( pid == 0 ) { continue; }
+        if( check_alive && ::kill( pid, 0 ) != 0 && errno == ESRCH ) { header_->readers[i].pid.compare_exchange_strong( pid, 0 ); continue; }
+        m = std::min( m, header_->readers[i].cursor.load() );
+    }
+    return m;
+}
+
+void shm_writer::close()
+{
+    if( !header_ ) { return; }
+    header_->closed.store( 1 );
+    header_->data.fetch_add( 1 );
+    futex_wake_( header_->data );
+    ::munmap( header_, mapped_ );
+    ::close( fd_ );
+    ::shm_unlink( &name_[0] ); // readers still attached keep reading the remaining data
+    header_ = NULL;
+}
+
+std::size_t shm_writer::readers() const
+{
+    if( !header_ ) { return 0; }
+    std::size_t count = 0;
+    for( unsigned int i = 0; i < max_readers; ++i ) { if( header_->readers[i].pid.load() != 0 ) { ++count; } }
+    return count;
+}
+
+shm_reader::shm_reader( const std::string& name )
+    : fd_( ::shm_open( &shm_name_( name )[0], O_RDWR, 0 ) )
+    , capacity_( 0 )
+    , mapped_( 0 )
+    , header_( NULL )
+    , data_( NULL )
+    , slot_( 0 )
+    , cursor_( 0 )
+    , dropped_( 0 )
+{
+    if( fd_ < 0 ) { COMMA_THROW( comma::exception, "failed to open shared memory '" << name << "'; writer not running?" ); }
+    struct ::stat s;
+    if( ::fstat( fd_, &s ) != 0 || std::size_t( s.st_size ) <= header_size_() ) { ::close( fd_ ); COMMA_THROW( comma::exception, "shared memory '" << name << "' is not ready or is not a ring" ); }
+    mapped_ = s.st_size;
+    void* p = ::mmap( NULL, mapped_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0 );
+    if( p == MAP_FAILED ) { ::close( fd_ ); COMMA_THROW( comma::exception, "failed to map shared memory '" << name << "'" ); }
+    header_ = reinterpret_cast< shm_header* >( p );
+    if( header_->magic.load() != magic || header_size_() + header_->capacity != mapped_ ) { close(); COMMA_THROW( comma::exception, "shared memory '" << name << "' is not ready or is not a ring" ); }
+    capacity_ = header_->capacity;
+    data_ = reinterpret_cast< const char* >( p ) + header_size_();
+    for( ; slot_ < max_readers; ++slot_ ) { comma::int32 pid = 0; if( header_->readers[slot_].pid.compare_exchange_strong( pid, ::getpid() ) ) { break; } }
+    if( slot_ == max_readers ) { close(); COMMA_THROW( comma::exception, "shared memory '" << name << "': more than " << max_readers << " readers: not supported" ); }
+    cursor_ = header_->head.load(); // loaded after taking slot, so that writer either sees the slot or has already written up to cursor
+    header_->readers[slot_].cursor.store( cursor_ );
+    if( header_->writer_waiting.load() ) { header_->space.fetch_add( 1 ); futex_wake_( header_->space ); }
+}
+
+shm_reader::~shm_reader() { close(); }
+
+std::size_t shm_reader::read( char* buf, std::size_t size, bool blocking )
+{
+    if( !header_ || size == 0 ) { return 0; }
+    while( true )
+    {
+        comma::uint64 head = header_->head.load();
+        if( head - cursor_ > capacity_ ) { dropped_ += head - cursor_; cursor_ = head; } // fell behind non-blocking writer, which always writes whole records
+        if( head > cursor_ )
+        {
+            std::size_t n = std::min< comma::uint64 >( size, head - cursor_ );
+            std::size_t offset = cursor_ % capacity_;
+            std::size_t first = std::min( n, capacity_ - offset );
+            ::memcpy( buf, data_ + offset, first );
+            if( first < n ) { ::memcpy( buf + first, data_, n - first ); }
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if( header_->reserved.load( std::memory_order_relaxed ) > cursor_ + capacity_ ) // overwritten by non-blocking writer while copying
+            {
+                head = header_->head.load();
+                dropped_ += head - cursor_;
+                cursor_ = head;
+                continue;
+            }
+            cursor_ += n;
+            header_->readers[slot_].cursor.store( cursor_ );
+            if( header_->writer_waiting.load() ) { header_->space.fetch_add( 1 ); futex_wake_( header_->space ); }
+            return n;
+        }
+        if( header_->closed.load() ) { if( header_->head.load() == cursor_ ) { return 0; } continue; }
+        if( !blocking ) { return 0; }
+        wait( boost::posix_time::seconds( 1 ) );
+    }
+}
+
+bool shm_reader::wait( const boost::posix_time::time_duration& timeout )
+{
+    if( !header_ ) { return true; }
+    comma::uint32 data = header_->data.load();
+    if( available() > 0 || header_->closed.load() ) { return true; }
+    if( !alive_( header_->writer.load() ) ) { header_->closed.store( 1 ); return true; } // writer killed without closing the ring
+    header_->readers_waiting.fetch_add( 1 );
+    futex_wait_( header_->data, data, timeout );
+    header_->readers_waiting.fetch_sub( 1 );
+    return available() > 0 || header_->closed.load();
+}
+
+std::size_t shm_reader::available() const { return header_ ? std::min< comma::uint64 >( header_->head.load() - cursor_, capacity_ ) : 0; }
+
+bool shm_reader::eof() const
+{
+    if( !header_ ) { return true; }
+    bool closed = header_->closed.load();
+    return closed && header_->head.load() == cursor_;
+}
+
+void shm_reader::close()
+{
+    if( header_ )
+    {
+        if( slot_ < max_readers && data_ )
+        {
+            header_->readers[slot_].pid.store( 0 );
+            if( header_->writer_waiting.load() ) { header_->space.fetch_add( 1 ); futex_wake_( header_->space ); }
+        }
+        ::munmap( header_, mapped_ );
+        header_ = NULL;
+    }
+    if( fd_ >= 0 ) { ::close( fd_ ); fd_ = -1; }
+}
+
+#else // #ifndef WIN32
+
+struct shm_header {};
+
+shm_writer::shm_writer( const std::string&, bool ) { COMMA_THROW( comma::exception, "shared memory ring: not implemented on windows" ); }
+shm_writer::~shm_writer() {}
+void shm_writer::write( const char*, std::size_t ) {}
+void shm_writer::close() {}
+std::size_t shm_writer::readers() const { return 0; }
+shm_reader::shm_reader( const std::string& ) { COMMA_THROW( comma::exception, "shared memory ring: not implemented on windows" ); }
+shm_reader::~shm_reader() {}
+std::size_t shm_reader::read( char*, std::size_t, bool ) { return 0; }
+bool shm_reader::wait( const boost::posix_time::time_duration& ) { return true; }
+std::size_t shm_reader::available() const { return 0; }
+bool shm_reader::eof() const { return true; }
+void shm_reader::close() {}
+
+#endif // #ifndef WIN32
+
+shm_istreambuf::shm_istreambuf( const std::string& name, std::size_t size ) : reader_( name ), buffer_( size ) { setg( &buffer_[0], &buffer_[0], &buffer_[0] ); }
+
+shm_istreambuf::int_type shm_istreambuf::underflow()
+{
+    if( gptr() < egptr() ) { return traits_type::to_int_type( *gptr() ); }
+    std::size_t size = reader_.read( &buffer_[0], buffer_.size() );
+    if( size == 0 ) { return traits_type::eof(); }
+    setg( &buffer_[0], &buffer_[0], &buffer_[0] + size );
+    return traits_type::to_int_type( *gptr() );
+}
+
+std::streamsize shm_istreambuf::xsgetn( char* s, std::streamsize size )
+{
+    std::streamsize count = 0;
+    while( count < size )
+    {
+        std::streamsize buffered = egptr() - gptr();
+        if( buffered > 0 )
+        {
+            std::streamsize n = std::min( buffered, size - count );
+            ::memcpy( s + count, gptr(), n );
+            gbump( n );
+            count += n;
+        }
+        else if( std::size_t( size - count ) >= buffer_.size() ) // large read: copy from ring directly
+        {
+            std::size_t n = reader_.read( s + count, size - count );
+            if( n == 0 ) { break; }
+            count += n;
+        }
+        else if( underflow() == traits_type::eof() )
+        {
+            break;
+        }
+    }
+    return count;
+}
+
+std::streamsize shm_istreambuf::showmanyc() { return reader_.eof() ? -1 : std::streamsize( reader_.available() ); }
+
+shm_ostreambuf::shm_ostreambuf( const std::string& name, std::size_t size ) : writer_( name, true ), buffer_( size ) { setp( &buffer_[0], &buffer_[0] + buffer_.size() ); }
+
+shm_ostreambuf::~shm_ostreambuf() { try { sync(); } catch( ... ) {} }
+
+void shm_ostreambuf::close() { sync(); writer_.close(); }
+
+shm_ostreambuf::int_type shm_ostreambuf::overflow( int_type c )
+{
+    sync();
+    if( traits_type::eq_int_type( c, traits_type::eof() ) ) { return traits_type::not_eof( c ); }
+    *pptr() = traits_type::to_char_type( c );
+    pbump( 1 );
+    return c;
+}
+
+std::streamsize shm_ostreambuf::xsputn( const char* s, std::streamsize size )
+{
+    if( std::size_t( size ) < buffer_.size() ) { return std::streambuf::xsputn( s, size ); }
+    sync();
+    writer_.write( s, size ); // large write: copy to ring directly
+    return size;
+}
+
+int shm_ostreambuf::sync()
+{
+    if( pptr() == pbase() ) { return 0; }
+    writer_.write( pbase(), pptr() - pbase() );
+    setp( &buffer_[0], &buffer_[0] + buffer_.size() );
+    return 0;
+}
+
+} } } // namespace comma { namespace io { namespace impl {
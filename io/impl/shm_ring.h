@@ -0,0 +1,174 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_IO_IMPL_SHM_RING_H_
+#define COMMA_IO_IMPL_SHM_RING_H_
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include "../../base/types.h"
+
+namespace comma { namespace io { namespace impl {
+
+struct shm_header;
+
+/// single-producer multi-consumer byte ring in posix shared memory
+///
+/// address: shm:<name>[:<bytes>], shared memory object /<name> (e.g. /dev/shm/<name> on linux)
+/// of given size, default: 16MB; size is used only by writer
+///
+/// writer creates the ring and removes it on close; a ring left behind by a writer that died
+/// is replaced, but creating a ring that a live writer owns fails; readers attach to a running
+/// writer and start reading from the current write position; each reader has
+/// its own cursor in the ring, so that data gets passed without system calls;
+/// a futex is used only to wake up readers waiting for data or writer waiting for space
+class shm_writer : public boost::noncopyable
+{
+    public:
+        /// @param name shm:<name>[:<bytes>]
+        /// @param blocking if true, wait for the slowest reader, if ring is full, i.e. no data loss;
+        ///                 otherwise, never wait and overwrite old data: a reader that falls
+        ///                 behind by more than ring size skips all the data written so far
+        shm_writer( const std::string& name, bool blocking = true );
+
+        ~shm_writer();
+
+        /// write data; if not blocking, size must not exceed ring size
+        /// @note if size fits into the ring, it is written at once, i.e. readers never see a part of it
+        void write( const char* buf, std::size_t size );
+
+        /// mark ring as closed, wake up readers, and remove shared memory object
+        void close();
+
+        /// @return number of attached readers
+        std::size_t readers() const;
+
+        /// @return ring size in bytes
+        std::size_t capacity() const { return capacity_; }
+
+    private:
+        std::string name_;
+        bool blocking_;
+        int fd_;
+        std::size_t capacity_;
+        std::size_t mapped_;
+        shm_header* header_;
+        char* data_;
+        comma::uint64 head_;
+        comma::uint64 tail_;
+        comma::uint64 min_cursor_( bool check_alive );
+        void wait_for_space_( std::size_t size );
+};
+
+/// shared memory ring reader, see shm_writer
+class shm_reader : public boost::noncopyable
+{
+    public:
+        /// attach to ring; throw, if there is no writer
+        /// @param name shm:<name>[:<bytes>], size is ignored
+        shm_reader( const std::string& name );
+
+        ~shm_reader();
+
+        /// read up to size bytes
+        /// @param blocking if true, wait for data
+        /// @return number of bytes read, 0 on end of stream or, if not blocking, if no data available
+        std::size_t read( char* buf, std::size_t size, bool blocking = true );
+
+        /// wait for data or end of stream, but not longer than timeout;
+        /// if the writer died without closing the ring, it is treated as closed
+        /// @return true, if data available or writer closed
+        bool wait( const boost::posix_time::time_duration& timeout );
+
+        /// @return number of bytes available for reading
+        std::size_t available() const;
+
+        /// @return true, if writer closed and all data has been read
+        bool eof() const;
+
+        /// @return number of bytes lost, since reader fell behind non-blocking writer
+        comma::uint64 dropped() const { return dropped_; }
+
+        /// detach from ring
+        void close();
+
+    private:
+        int fd_;
+        std::size_t capacity_;
+        std::size_t mapped_;
+        shm_header* header_;
+        const char* data_;
+        unsigned int slot_;
+        comma::uint64 cursor_;
+        comma::uint64 dropped_;
+};
+
+/// stream buffer reading from shared memory ring, e.g. for std::istream
+class shm_istreambuf : public std::streambuf
+{
+    public:
+        shm_istreambuf( const std::string& name, std::size_t size = 65536 );
+        void close() { reader_.close(); }
+
+    protected:
+        int_type underflow();
+        std::streamsize xsgetn( char* s, std::streamsize size );
+        std::streamsize showmanyc();
+
+    private:
+        shm_reader reader_;
+        std::vector< char > buffer_;
+};
+
+/// stream buffer writing to shared memory ring, e.g. for std::ostream
+class shm_ostreambuf : public std::streambuf
+{
+    public:
+        shm_ostreambuf( const std::string& name, std::size_t size = 65536 );
+        ~shm_ostreambuf();
+        void close();
+
+    protected:
+        int_type overflow( int_type c );
+        std::streamsize xsputn( const char* s, std::streamsize size );
+        int sync();
+
+    private:
+        shm_writer writer_;
+        std::vector< char > buffer_;
+};
+
+} } } // namespace comma { namespace io { namespace impl {
+
+#endif // #ifndef COMMA_IO_IMPL_SHM_RING_H_
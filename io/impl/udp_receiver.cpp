@@ -0,0 +1,187 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef WIN32
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#endif
+#include <algorithm>
+#include "../../base/exception.h"
+#include "../../base/last_error.h"
+#include "udp_receiver.h"
+
+namespace comma { namespace io { namespace impl {
+
+#ifndef WIN32
+
+#ifdef __linux__
+typedef ::mmsghdr message_type;
+static ::msghdr& header_( message_type& m ) { return m.msg_hdr; }
+#else
+typedef ::msghdr message_type;
+static ::msghdr& header_( message_type& m ) { return m; }
+#endif
+
+static const std::size_t control_size = CMSG_SPACE( sizeof( ::timespec ) );
+
+udp_receiver::udp_receiver( unsigned short port, const options& o )
+    : options_( o )
+    , fd_( ::socket( AF_INET, SOCK_DGRAM, 0 ) )
+    , count_( 0 )
+{
+    if( fd_ < 0 ) { last_error::to_exception( "failed to create udp socket" ); }
+    if( options_.size == 0 || options_.batch == 0 ) { ::close( fd_ ); COMMA_THROW( comma::exception, "expected positive datagram size and batch size, got " << options_.size << " and " << options_.batch ); }
+#ifndef __linux__
+    options_.batch = 1;
+#endif
+    int on = 1;
+    if( ::setsockopt( fd_, SOL_SOCKET, SO_BROADCAST, &on, sizeof( on ) ) != 0 ) { ::close( fd_ ); COMMA_THROW( comma::exception, "failed to set broadcast option on port " << port ); }
+    if( options_.reuse_address && ::setsockopt( fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) ) != 0 ) { ::close( fd_ ); COMMA_THROW( comma::exception, "failed to set reuse address option on port " << port ); }
+    if( options_.receive_buffer > 0 )
+    {
+        int size = options_.receive_buffer;
+#ifdef SO_RCVBUFFORCE
+        if( ::setsockopt( fd_, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof( size ) ) != 0 ) // only if privileged, but not capped by system maximum
+#endif
+        if( ::setsockopt( fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof( size ) ) != 0 ) { ::close( fd_ ); COMMA_THROW( comma::exception, "failed to set receive buffer size to " << size << " on port " << port ); }
+    }
+#ifdef SO_TIMESTAMPNS
+    if( options_.kernel_timestamps && ::setsockopt( fd_, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof( on ) ) != 0 ) { options_.kernel_timestamps = false; }
+#else
+    options_.kernel_timestamps = false;
+#endif
+    ::sockaddr_in address;
+    ::memset( &address, 0, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_ANY );
+    address.sin_port = htons( port );
+    if( ::bind( fd_, reinterpret_cast< ::sockaddr* >( &address ), sizeof( address ) ) != 0 ) { ::close( fd_ ); COMMA_THROW( comma::exception, "failed to bind port " << port ); }
+    if( !options_.group.empty() )
+    {
+        ::ip_mreq request;
+        ::memset( &request, 0, sizeof( request ) );
+        if( ::inet_pton( AF_INET, &options_.group[0], &request.imr_multiaddr ) != 1 ) { ::close( fd_ ); COMMA_THROW( comma::exception, "expected multicast group ipv4 address, got '" << options_.group << "'" ); }
+        if( options_.interface.empty() ) { request.imr_interface.s_addr = htonl( INADDR_ANY ); }
+        else if( ::inet_pton( AF_INET, &options_.interface[0], &request.imr_interface ) != 1 ) { ::close( fd_ ); COMMA_THROW( comma::exception, "expected multicast interface ipv4 address, got '" << options_.interface << "'" ); }
+        if( ::setsockopt( fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof( request ) ) != 0 ) { ::close( fd_ ); last_error::to_exception( "failed to join multicast group " + options_.group ); }
+    }
+    buffer_.resize( options_.size * options_.batch );
+    control_.resize( control_size * options_.batch );
+    sizes_.resize( options_.batch );
+    timestamps_.resize( options_.batch );
+    messages_.resize( ( sizeof( message_type ) + sizeof( ::iovec ) ) * options_.batch );
+    message_type* messages = reinterpret_cast< message_type* >( &messages_[0] );
+    ::iovec* iov = reinterpret_cast< ::iovec* >( &messages_[ sizeof( message_type ) * options_.batch ] );
+    for( std::size_t i = 0; i < options_.batch; ++i )
+    {
+        iov[i].iov_base = &buffer_[ i * options_.size ];
+        iov[i].iov_len = options_.size;
+        ::memset( &messages[i], 0, sizeof( message_type ) );
+        header_( messages[i] ).msg_iov = &iov[i];
+        header_( messages[i] ).msg_iovlen = 1;
+    }
+}
+
+udp_receiver::~udp_receiver() { ::close( fd_ ); }
+
+std::size_t udp_receiver::receive( bool blocking )
+{
+    count_ = 0;
+    message_type* messages = reinterpret_cast< message_type* >( &messages_[0] );
+    for( std::size_t i = 0; i < options_.batch; ++i )
+    {
+        header_( messages[i] ).msg_control = options_.kernel_timestamps ? &control_[ i * control_size ] : NULL;
+        header_( messages[i] ).msg_controllen = options_.kernel_timestamps ? control_size : 0;
+        header_( messages[i] ).msg_flags = 0;
+    }
+#ifdef __linux__
+    int size = ::recvmmsg( fd_, messages, options_.batch, blocking ? MSG_WAITFORONE : MSG_DONTWAIT, NULL );
+#else
+    ::ssize_t bytes = ::recvmsg( fd_, messages, blocking ? 0 : MSG_DONTWAIT );
+    int size = bytes < 0 ? -1 : 1;
+#endif
+    if( size < 0 )
+    {
+        if( errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK ) { return 0; }
+        last_error::to_exception( "udp: failed to receive" );
+    }
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    static const boost::posix_time::ptime epoch( boost::gregorian::date( 1970, 1, 1 ) );
+    for( int i = 0; i < size; ++i )
+    {
+#ifdef __linux__
+        sizes_[i] = std::min( std::size_t( messages[i].msg_len ), options_.size );
+#else
+        sizes_[i] = std::min( std::size_t( bytes ), options_.size );
+#endif
+        timestamps_[i] = now;
+        if( !options_.kernel_timestamps ) { continue; }
+#ifdef SO_TIMESTAMPNS
+        ::msghdr& h = header_( messages[i] );
+        for( ::cmsghdr* c = CMSG_FIRSTHDR( &h ); c != NULL; c = CMSG_NXTHDR( &h, c ) )
+        {
+            if( c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_TIMESTAMPNS ) { continue; }
+            ::timespec t;
+            ::memcpy( &t, CMSG_DATA( c ), sizeof( t ) );
+            timestamps_[i] = epoch + boost::posix_time::seconds( t.tv_sec ) + boost::posix_time::microseconds( t.tv_nsec / 1000 );
+            break;
+        }
+#endif
+    }
+    count_ = size;
+    return count_;
+}
+
+std::size_t udp_receiver::receive_buffer_size() const
+{
+    int size = 0;
+    ::socklen_t length = sizeof( size );
+    if( ::getsockopt( fd_, SOL_SOCKET, SO_RCVBUF, &size, &length ) != 0 ) { last_error::to_exception( "failed to get receive buffer size" ); }
+    return size;
+}
+
+#else // #ifndef WIN32
+
+udp_receiver::udp_receiver( unsigned short, const options& ) { COMMA_THROW( comma::exception, "udp_receiver: not implemented on windows" ); }
+udp_receiver::~udp_receiver() {}
+std::size_t udp_receiver::receive( bool ) { return 0; }
+std::size_t udp_receiver::receive_buffer_size() const { return 0; }
+
+#endif // #ifndef WIN32
+
+} } } // namespace comma { namespace io { namespace impl {
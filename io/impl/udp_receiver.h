@@ -0,0 +1,113 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_IO_IMPL_UDP_RECEIVER_H_
+#define COMMA_IO_IMPL_UDP_RECEIVER_H_
+
+#include <string>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "../file_descriptor.h"
+
+namespace comma { namespace io { namespace impl {
+
+/// receives udp datagrams in batches (recvmmsg on linux), optionally
+/// with kernel receive timestamps (SO_TIMESTAMPNS)
+class udp_receiver
+{
+    public:
+        struct options
+        {
+            /// maximum datagram size; longer datagrams get truncated
+            std::size_t size;
+
+            /// maximum number of datagrams received at once
+            std::size_t batch;
+
+            /// if true, take timestamps from kernel, if available
+            bool kernel_timestamps;
+
+            /// socket receive buffer size in bytes, 0: system default
+            std::size_t receive_buffer;
+
+            /// reuse address/port
+            bool reuse_address;
+
+            /// multicast group to join, if not empty
+            std::string group;
+
+            /// multicast interface address, if empty, let the system choose
+            std::string interface;
+
+            options() : size( 16384 ), batch( 64 ), kernel_timestamps( true ), receive_buffer( 0 ), reuse_address( false ) {}
+        };
+
+        /// bind to given port on all interfaces; receives broadcast datagrams as well
+        udp_receiver( unsigned short port, const options& o = options() );
+
+        ~udp_receiver();
+
+        /// receive available datagrams, at least one, if blocking
+        /// @return number of datagrams received, 0 if not blocking and nothing available
+        std::size_t receive( bool blocking = true );
+
+        /// number of datagrams received by last receive()
+        std::size_t count() const { return count_; }
+
+        /// datagram data
+        const char* data( std::size_t i ) const { return &buffer_[ i * options_.size ]; }
+
+        /// datagram size
+        std::size_t size( std::size_t i ) const { return sizes_[i]; }
+
+        /// datagram receive time: from kernel, if available, otherwise system time after receive
+        const boost::posix_time::ptime& timestamp( std::size_t i ) const { return timestamps_[i]; }
+
+        /// socket file descriptor
+        io::file_descriptor fd() const { return fd_; }
+
+        /// actual socket receive buffer size as reported by system
+        std::size_t receive_buffer_size() const;
+
+    private:
+        options options_;
+        io::file_descriptor fd_;
+        std::vector< char > buffer_;
+        std::vector< char > control_;
+        std::vector< char > messages_;
+        std::vector< std::size_t > sizes_;
+        std::vector< boost::posix_time::ptime > timestamps_;
+        std::size_t count_;
+};
+
+} } } // namespace comma { namespace io { namespace impl {
+
+#endif // #ifndef COMMA_IO_IMPL_UDP_RECEIVER_H_
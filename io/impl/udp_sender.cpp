@@ -0,0 +1,223 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef WIN32
+#include <errno.h>
+#include <netdb.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#endif
+#include <boost/lexical_cast.hpp>
+#include "../../base/exception.h"
+#include "../../base/last_error.h"
+#include "../../string/string.h"
+#include "udp_sender.h"
+
+namespace comma { namespace io { namespace impl {
+
+static const std::size_t batch_size = 64; // arbitrary
+static const std::size_t max_datagram_size = 65507;
+
+#ifndef WIN32
+
+static bool is_transient_( int error ) // datagram is lost, but it is not a reason to stop sending
+{
+    switch( error )
+    {
+        case EAGAIN: case ENOBUFS: case ECONNREFUSED: case EHOSTUNREACH: case ENETUNREACH: case EHOSTDOWN: case ENETDOWN: return true;
+        default: return false;
+    }
+}
+
+static void to_little_endian_( boost::uint64_t v, char* buf ) { for( unsigned int i = 0; i < sizeof( boost::uint64_t ); ++i, v >>= 8 ) { buf[i] = static_cast< char >( v & 0xff ); } }
+
+udp_sender::udp_sender( const std::string& name, const options& o )
+    : options_( o )
+    , fd_( io::invalid_file_descriptor )
+    , size_( 0 )
+    , sequence_( 0 )
+{
+    std::vector< std::string > v = comma::split( name, ':' );
+    if( v[0] != "udp" || v.size() < 2 || v.size() > 3 ) { COMMA_THROW( comma::exception, "expected udp:<port> or udp:<address>:<port>, got '" << name << "'" ); }
+    if( options_.mtu <= header_size_() || options_.mtu > max_datagram_size ) { COMMA_THROW( comma::exception, "expected mtu greater than " << header_size_() << " and not greater than " << max_datagram_size << ", got " << options_.mtu ); }
+    const std::string& host = v.size() == 2 ? std::string( "255.255.255.255" ) : v[1];
+    const std::string& port = v.back();
+    boost::lexical_cast< unsigned short >( port );
+    ::addrinfo hints;
+    ::memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    ::addrinfo* info = NULL;
+    int error = ::getaddrinfo( &host[0], &port[0], &hints, &info );
+    if( error != 0 ) { COMMA_THROW( comma::exception, "failed to resolve '" << host << "': " << ::gai_strerror( error ) ); }
+    address_.assign( reinterpret_cast< const char* >( info->ai_addr ), reinterpret_cast< const char* >( info->ai_addr ) + info->ai_addrlen );
+    ::freeaddrinfo( info );
+    fd_ = ::socket( AF_INET, SOCK_DGRAM, 0 );
+    if( fd_ < 0 ) { last_error::to_exception( "failed to create udp socket" ); }
+    int on = 1;
+    if( ::setsockopt( fd_, SOL_SOCKET, SO_BROADCAST, &on, sizeof( on ) ) != 0 ) { ::close( fd_ ); last_error::to_exception( "failed to set broadcast option on udp socket" ); }
+    const ::sockaddr_in* a = reinterpret_cast< const ::sockaddr_in* >( &address_[0] );
+    if( IN_MULTICAST( ntohl( a->sin_addr.s_addr ) ) )
+    {
+        int ttl = options_.ttl;
+        if( ::setsockopt( fd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof( ttl ) ) != 0 ) { ::close( fd_ ); last_error::to_exception( "failed to set multicast ttl" ); }
+        if( !options_.interface.empty() )
+        {
+            ::in_addr i;
+            if( ::inet_pton( AF_INET, &options_.interface[0], &i ) != 1 ) { ::close( fd_ ); COMMA_THROW( comma::exception, "expected multicast interface ipv4 address, got '" << options_.interface << "'" ); }
+            if( ::setsockopt( fd_, IPPROTO_IP, IP_MULTICAST_IF, &i, sizeof( i ) ) != 0 ) { ::close( fd_ ); last_error::to_exception( "failed to set multicast interface " + options_.interface ); }
+        }
+    }
+    if( ::connect( fd_, reinterpret_cast< const ::sockaddr* >( &address_[0] ), address_.size() ) != 0 ) { ::close( fd_ ); last_error::to_exception( "failed to set udp destination " + name ); }
+    buffer_.resize( options_.mtu * batch_size );
+    sizes_.reserve( batch_size );
+}
+
+udp_sender::~udp_sender()
+{
+    try { close(); } catch( ... ) {}
+}
+
+void udp_sender::write( const char* buf, std::size_t size, bool flush )
+{
+    if( size == 0 ) { return; }
+    if( header_size_() + size > options_.mtu ) { this->flush(); send_( buf, size ); return; }
+    if( size_ > 0 && size_ + size > options_.mtu ) { finish_(); }
+    if( size_ == 0 )
+    {
+        if( sizes_.size() == batch_size ) { this->flush(); }
+        start_( slot_( sizes_.size() ) );
+    }
+    ::memcpy( slot_( sizes_.size() ) + size_, buf, size );
+    size_ += size;
+    if( flush ) { this->flush(); }
+}
+
+void udp_sender::start_( char* buf )
+{
+    if( options_.sequence ) { to_little_endian_( sequence_, buf ); }
+    size_ = header_size_();
+    ++sequence_;
+}
+
+void udp_sender::finish_()
+{
+    if( size_ == 0 ) { return; }
+    sizes_.push_back( size_ );
+    size_ = 0;
+}
+
+void udp_sender::flush()
+{
+    finish_();
+    if( sizes_.empty() ) { return; }
+#ifdef __linux__
+    ::mmsghdr messages[ batch_size ];
+    ::iovec iov[ batch_size ];
+    for( std::size_t i = 0; i < sizes_.size(); ++i )
+    {
+        iov[i].iov_base = slot_( i );
+        iov[i].iov_len = sizes_[i];
+        ::memset( &messages[i], 0, sizeof( ::mmsghdr ) );
+        messages[i].msg_hdr.msg_iov = &iov[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    for( std::size_t i = 0; i < sizes_.size(); )
+    {
+        int sent = ::sendmmsg( fd_, messages + i, sizes_.size() - i, 0 );
+        if( sent > 0 ) { i += sent; continue; }
+        if( errno == EINTR ) { continue; }
+        if( is_transient_( errno ) ) { ++i; continue; }
+        sizes_.clear();
+        last_error::to_exception( "udp: sendmmsg() failed" );
+    }
+#else
+    for( std::size_t i = 0; i < sizes_.size(); )
+    {
+        if( ::send( fd_, slot_( i ), sizes_[i], 0 ) >= 0 || is_transient_( errno ) ) { ++i; continue; }
+        if( errno == EINTR ) { continue; }
+        sizes_.clear();
+        last_error::to_exception( "udp: send() failed" );
+    }
+#endif
+    sizes_.clear();
+}
+
+void udp_sender::send_( const char* buf, std::size_t size )
+{
+    if( header_size_() + size > max_datagram_size ) { COMMA_THROW( comma::exception, "udp: expected record of size not greater than " << ( max_datagram_size - header_size_() ) << " bytes, got " << size << " bytes" ); }
+    char header[ sizeof( boost::uint64_t ) ];
+    start_( header );
+    size_ = 0;
+    ::iovec iov[2];
+    iov[0].iov_base = header;
+    iov[0].iov_len = header_size_();
+    iov[1].iov_base = const_cast< char* >( buf );
+    iov[1].iov_len = size;
+    ::msghdr message;
+    ::memset( &message, 0, sizeof( message ) );
+    message.msg_iov = iov[0].iov_len ? iov : iov + 1;
+    message.msg_iovlen = iov[0].iov_len ? 2 : 1;
+    while( ::sendmsg( fd_, &message, 0 ) < 0 )
+    {
+        if( errno == EINTR ) { continue; }
+        if( is_transient_( errno ) ) { return; }
+        last_error::to_exception( "udp: sendmsg() failed" );
+    }
+}
+
+void udp_sender::close()
+{
+    if( fd_ == io::invalid_file_descriptor ) { return; }
+    flush();
+    ::close( fd_ );
+    fd_ = io::invalid_file_descriptor;
+}
+
+#else // #ifndef WIN32
+
+udp_sender::udp_sender( const std::string&, const options& ) { COMMA_THROW( comma::exception, "udp: not implemented on windows" ); }
+udp_sender::~udp_sender() {}
+void udp_sender::write( const char*, std::size_t, bool ) {}
+void udp_sender::flush() {}
+void udp_sender::close() {}
+void udp_sender::start_( char* ) {}
+void udp_sender::finish_() {}
+void udp_sender::send_( const char*, std::size_t ) {}
+
+#endif // #ifndef WIN32
+
+} } } // namespace comma { namespace io { namespace impl {
@@ -0,0 +1,107 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_IO_IMPL_UDP_SENDER_H_
+#define COMMA_IO_IMPL_UDP_SENDER_H_
+
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+#include "../file_descriptor.h"
+
+namespace comma { namespace io { namespace impl {
+
+/// sends records as udp datagrams to unicast, broadcast, or multicast address
+///
+/// records are packed into datagrams of up to mtu bytes, complete datagrams
+/// are sent in batches (sendmmsg on linux); a record is never split across
+/// datagrams, a record larger than mtu is sent in a datagram of its own
+class udp_sender
+{
+    public:
+        struct options
+        {
+            /// maximum datagram payload size in bytes, including sequence number
+            std::size_t mtu;
+
+            /// if true, each datagram starts with 8-byte little-endian unsigned
+            /// sequence number, so that receivers can detect lost datagrams
+            bool sequence;
+
+            /// multicast time to live
+            unsigned int ttl;
+
+            /// multicast interface address, if empty, let the system choose
+            std::string interface;
+
+            options() : mtu( 1472 ), sequence( false ), ttl( 1 ) {}
+        };
+
+        /// @param name udp:<port> for broadcast, or udp:<address>:<port> for unicast, broadcast, or multicast address
+        udp_sender( const std::string& name, const options& o = options() );
+
+        /// send pending records and close
+        ~udp_sender();
+
+        /// add record to current datagram
+        /// @param flush if true, send pending datagrams immediately
+        void write( const char* buf, std::size_t size, bool flush = true );
+
+        /// send pending datagrams
+        void flush();
+
+        /// send pending datagrams and close socket
+        void close();
+
+        /// return socket file descriptor
+        io::file_descriptor fd() const { return fd_; }
+
+        /// return number of datagrams sent so far (equal to next sequence number)
+        boost::uint64_t sent() const { return sequence_; }
+
+    private:
+        options options_;
+        io::file_descriptor fd_;
+        std::vector< char > address_;
+        std::vector< char > buffer_;
+        std::vector< std::size_t > sizes_;
+        std::size_t size_;
+        boost::uint64_t sequence_;
+        std::size_t header_size_() const { return options_.sequence ? sizeof( boost::uint64_t ) : 0; }
+        char* slot_( std::size_t i ) { return &buffer_[ i * options_.mtu ]; }
+        void start_( char* buf );
+        void finish_();
+        void send_( const char* buf, std::size_t size );
+};
+
+} } } // namespace comma { namespace io { namespace impl {
+
+#endif // #ifndef COMMA_IO_IMPL_UDP_SENDER_H_
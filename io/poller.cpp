@@ -0,0 +1,270 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#include <cerrno>
+#include <climits>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/epoll.h>
+#elif !defined( WIN32 )
+#include <poll.h>
+#else
+#include "select.h"
+#endif
+#include "../base/exception.h"
+#include "../base/last_error.h"
+#include "poller.h"
+
+namespace comma { namespace io {
+
+static const unsigned int edge = 8;
+
+poller::poller()
+    : read_descriptors_( *this )
+    , write_descriptors_( *this )
+    , except_descriptors_( *this )
+#ifdef __linux__
+    , fd_( ::epoll_create1( EPOLL_CLOEXEC ) )
+{
+    if( fd_ < 0 ) { last_error::to_exception( "failed to create epoll descriptor" ); }
+}
+#else
+    , fd_( -1 )
+{
+}
+#endif
+
+poller::~poller()
+{
+#ifdef __linux__
+    ::close( fd_ );
+#endif
+}
+
+std::size_t poller::wait() { return wait_( -1 ); }
+
+std::size_t poller::wait( unsigned int timeout_seconds, unsigned int timeout_nanoseconds )
+{
+    unsigned long long milliseconds = static_cast< unsigned long long >( timeout_seconds ) * 1000 + ( timeout_nanoseconds + 999999 ) / 1000000;
+    return wait_( milliseconds > INT_MAX ? INT_MAX : static_cast< int >( milliseconds ) );
+}
+
+std::size_t poller::wait( boost::posix_time::time_duration timeout )
+{
+    if( timeout.is_special() ) { return timeout.is_pos_infinity() ? wait() : check(); }
+    if( timeout.is_negative() ) { return check(); }
+    boost::int64_t milliseconds = ( timeout.total_microseconds() + 999 ) / 1000;
+    return wait_( milliseconds > INT_MAX ? INT_MAX : static_cast< int >( milliseconds ) );
+}
+
+std::size_t poller::check() { return wait_( 0 ); }
+
+void poller::on( file_descriptor fd, unsigned int events, const handler& h )
+{
+    if( fd == invalid_file_descriptor ) { COMMA_THROW( comma::exception, "expected valid file descriptor" ); }
+    handlers_[fd] = std::make_pair( events, h );
+    changed_.insert( fd );
+}
+
+void poller::off( file_descriptor fd )
+{
+    handlers_.erase( fd );
+    changed_.insert( fd );
+}
+
+void poller::descriptors::add( file_descriptor fd )
+{
+    if( fd == invalid_file_descriptor ) { return; }
+    descriptors_.insert( fd );
+    poller_.changed_.insert( fd );
+}
+
+void poller::descriptors::remove( file_descriptor fd )
+{
+    if( fd == invalid_file_descriptor ) { return; }
+    descriptors_.erase( fd );
+    ready_.erase( fd );
+    poller_.changed_.insert( fd );
+}
+
+unsigned int poller::mask_( file_descriptor fd ) const
+{
+    unsigned int mask = ( read_descriptors_.descriptors_.count( fd ) ? events::read : 0 )
+                      | ( write_descriptors_.descriptors_.count( fd ) ? events::write : 0 )
+                      | ( except_descriptors_.descriptors_.count( fd ) ? events::except : 0 );
+    std::map< file_descriptor, std::pair< unsigned int, handler > >::const_iterator it = handlers_.find( fd );
+    if( it == handlers_.end() ) { return mask; }
+    if( mask ) { COMMA_THROW( comma::exception, "file descriptor " << fd << " has handler and is also in read, write, or except descriptors" ); }
+    return it->second.first | edge;
+}
+
+void poller::update_()
+{
+    for( std::set< file_descriptor >::const_iterator i = changed_.begin(); i != changed_.end(); ++i )
+    {
+        file_descriptor fd = *i;
+        unsigned int mask = mask_( fd );
+        std::map< file_descriptor, unsigned int >::iterator it = registered_.find( fd );
+        if( mask == 0 )
+        {
+            if( it == registered_.end() ) { continue; }
+#ifdef __linux__
+            if( unpollable_.find( fd ) == unpollable_.end() ) { ::epoll_ctl( fd_, EPOLL_CTL_DEL, fd, NULL ); } // may fail, if fd already closed, which is fine
+#endif
+            unpollable_.erase( fd );
+            registered_.erase( it );
+            continue;
+        }
+        bool added = it == registered_.end();
+        registered_[fd] = mask;
+#ifdef __linux__
+        if( unpollable_.find( fd ) != unpollable_.end() ) { continue; }
+        ::epoll_event e;
+        e.events = ( mask & events::read ? EPOLLIN : 0 ) | ( mask & events::write ? EPOLLOUT : 0 ) | ( mask & events::except ? EPOLLPRI : 0 ) | ( mask & edge ? EPOLLET : 0 );
+        e.data.fd = fd;
+        int op = added ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if( ::epoll_ctl( fd_, op, fd, &e ) == 0 ) { continue; }
+        if( errno == ( added ? EEXIST : ENOENT ) && ::epoll_ctl( fd_, added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &e ) == 0 ) { continue; } // e.g. fd closed and reopened without remove()
+        if( errno != EPERM ) { registered_.erase( fd ); last_error::to_exception( "failed to add file descriptor to epoll" ); }
+        unpollable_.insert( fd ); // regular file: always ready
+        if( mask & edge ) { fired_.push_back( std::make_pair( fd, mask & ~edge ) ); }
+#else
+        (void)added;
+#endif
+    }
+    changed_.clear();
+}
+
+std::size_t poller::mark_( file_descriptor fd, unsigned int ready )
+{
+    std::map< file_descriptor, std::pair< unsigned int, handler > >::const_iterator it = handlers_.find( fd );
+    if( it != handlers_.end() )
+    {
+        if( !( ready & it->second.first ) ) { return 0; }
+        fired_.push_back( std::make_pair( fd, ready & it->second.first ) );
+        return 1;
+    }
+    std::size_t count = 0;
+    if( ( ready & events::read ) && read_descriptors_.descriptors_.count( fd ) ) { read_descriptors_.ready_.insert( fd ); ++count; }
+    if( ( ready & events::write ) && write_descriptors_.descriptors_.count( fd ) ) { write_descriptors_.ready_.insert( fd ); ++count; }
+    if( ( ready & events::except ) && except_descriptors_.descriptors_.count( fd ) ) { except_descriptors_.ready_.insert( fd ); ++count; }
+    return count;
+}
+
+void poller::dispatch_()
+{
+    for( std::size_t i = 0; i < fired_.size(); ++i )
+    {
+        std::map< file_descriptor, std::pair< unsigned int, handler > >::const_iterator it = handlers_.find( fired_[i].first );
+        if( it == handlers_.end() ) { continue; } // removed by previous handler
+        handler h = it->second.second;
+        h( fired_[i].first, fired_[i].second );
+    }
+    fired_.clear();
+}
+
+std::size_t poller::wait_( int timeout )
+{
+    read_descriptors_.ready_.clear();
+    write_descriptors_.ready_.clear();
+    except_descriptors_.ready_.clear();
+    fired_.clear();
+    update_();
+    if( registered_.empty() ) { return 0; } // as select
+    std::size_t count = fired_.size();
+    for( std::set< file_descriptor >::const_iterator it = unpollable_.begin(); it != unpollable_.end(); ++it )
+    {
+        if( handlers_.find( *it ) == handlers_.end() ) { count += mark_( *it, events::read | events::write ); }
+    }
+    if( count > 0 ) { timeout = 0; }
+#ifdef __linux__
+    if( registered_.size() > unpollable_.size() )
+    {
+        events_.resize( registered_.size() * sizeof( ::epoll_event ) );
+        ::epoll_event* e = reinterpret_cast< ::epoll_event* >( &events_[0] );
+        int size = ::epoll_wait( fd_, e, registered_.size(), timeout );
+        if( size < 0 )
+        {
+            if( errno != EINTR ) { last_error::to_exception( "epoll_wait() failed" ); } // do no throw if interrupted by signal
+            size = 0;
+        }
+        for( int i = 0; i < size; ++i )
+        {
+            unsigned int ready = ( e[i].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ? events::read : 0 )
+                               | ( e[i].events & ( EPOLLOUT | EPOLLHUP | EPOLLERR ) ? events::write : 0 )
+                               | ( e[i].events & EPOLLPRI ? events::except : 0 );
+            count += mark_( e[i].data.fd, ready );
+        }
+    }
+#elif !defined( WIN32 )
+    events_.resize( registered_.size() * sizeof( ::pollfd ) );
+    ::pollfd* p = reinterpret_cast< ::pollfd* >( &events_[0] );
+    std::size_t n = 0;
+    for( std::map< file_descriptor, unsigned int >::const_iterator it = registered_.begin(); it != registered_.end(); ++it, ++n )
+    {
+        p[n].fd = it->first;
+        p[n].events = ( it->second & events::read ? POLLIN : 0 ) | ( it->second & events::write ? POLLOUT : 0 ) | ( it->second & events::except ? POLLPRI : 0 );
+        p[n].revents = 0;
+    }
+    int size = ::poll( p, n, timeout );
+    if( size < 0 && errno != EINTR ) { last_error::to_exception( "poll() failed" ); }
+    for( std::size_t i = 0; size > 0 && i < n; ++i ) // handlers are level-triggered here
+    {
+        if( p[i].revents == 0 ) { continue; }
+        unsigned int ready = ( p[i].revents & ( POLLIN | POLLHUP | POLLERR ) ? events::read : 0 )
+                           | ( p[i].revents & ( POLLOUT | POLLHUP | POLLERR ) ? events::write : 0 )
+                           | ( p[i].revents & POLLPRI ? events::except : 0 );
+        count += mark_( p[i].fd, ready );
+    }
+#else
+    io::select select;
+    for( std::map< file_descriptor, unsigned int >::const_iterator it = registered_.begin(); it != registered_.end(); ++it )
+    {
+        if( it->second & events::read ) { select.read().add( it->first ); }
+        if( it->second & events::write ) { select.write().add( it->first ); }
+        if( it->second & events::except ) { select.except().add( it->first ); }
+    }
+    if( ( timeout < 0 ? select.wait() : select.wait( boost::posix_time::milliseconds( timeout ) ) ) > 0 )
+    {
+        for( std::map< file_descriptor, unsigned int >::const_iterator it = registered_.begin(); it != registered_.end(); ++it )
+        {
+            unsigned int ready = ( select.read().ready( it->first ) ? events::read : 0 )
+                               | ( select.write().ready( it->first ) ? events::write : 0 )
+                               | ( select.except().ready( it->first ) ? events::except : 0 );
+            if( ready ) { count += mark_( it->first, ready ); }
+        }
+    }
+#endif
+    dispatch_();
+    return count;
+}
+
+} } // namespace comma { namespace io {
@@ -0,0 +1,151 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_set.hpp>
+#include "file_descriptor.h"
+
+namespace comma { namespace io {
+
+/// scalable alternative to io::select with the same interface: epoll on linux, poll() on
+/// other posix systems, select() on windows; without epoll, handlers below are level-triggered
+///
+/// differences from io::select:
+///     - no FD_SETSIZE limit on number or value of file descriptors
+///     - wait() costs O(number of ready descriptors) rather than O(number of descriptors)
+///     - timeout resolution is milliseconds (rounded up)
+///     - not copyable, since it owns epoll descriptor
+///     - regular files (which epoll does not support) are always ready, as with select()
+///
+/// in addition, edge-triggered callback interface: on( fd, events, handler ) makes
+/// wait() call the handler, when fd becomes ready; since the handler will not be
+/// called again until fd becomes not ready and then ready again, the handler
+/// should read or write until it would block (EAGAIN)
+///
+/// a descriptor can be either in read(), write(), except() sets or have a handler, but not both
+class poller : public boost::noncopyable
+{
+    public:
+        /// events for edge-triggered interface
+        struct events { enum values { read = 1, write = 2, except = 4 }; };
+
+        /// handler called with file descriptor and its ready events
+        typedef boost::function< void( file_descriptor, unsigned int ) > handler;
+
+        /// constructor
+        poller();
+
+        /// destructor
+        ~poller();
+
+        /// blocking wait, if OK, returns number of ready descriptors, as select() would, otherwise throws
+        std::size_t wait();
+
+        /// wait with timeout, if OK, returns number of ready descriptors, as select() would, otherwise throws
+        std::size_t wait( unsigned int timeout_seconds, unsigned int timeout_nanoseconds = 0 );
+
+        /// wait with timeout, if OK, returns number of ready descriptors, as select() would, otherwise throws
+        std::size_t wait( boost::posix_time::time_duration timeout );
+
+        /// same as wait( 0 )
+        std::size_t check();
+
+        /// call handler, when given file descriptor becomes ready for given events (edge-triggered)
+        void on( file_descriptor fd, unsigned int events, const handler& h );
+
+        /// stop watching file descriptor registered with on()
+        void off( file_descriptor fd );
+
+        /// descriptor pool to monitor, same as select::descriptors
+        class descriptors
+        {
+            public:
+                /// add file descriptor
+                void add( file_descriptor fd );
+                template < typename T > void add( const T& t ) { add( t.fd() ); }
+
+                /// remove file descriptor
+                void remove( file_descriptor fd );
+                template < typename T > void remove( const T& t ) { remove( t.fd() ); }
+
+                /// return true, if file descriptor found in descriptor list and ready
+                bool ready( file_descriptor fd ) const { return ready_.find( fd ) != ready_.end(); }
+                template < typename T > bool ready( const T& t ) const { return ready( t.fd() ); }
+
+                /// return set of descriptors
+                const std::set< file_descriptor >& operator()() const { return descriptors_; }
+
+            private:
+                friend class poller;
+                descriptors( poller& p ) : poller_( p ) {}
+                poller& poller_;
+                std::set< file_descriptor > descriptors_;
+                boost::unordered_set< file_descriptor > ready_;
+        };
+
+        /// return read descriptors
+        descriptors& read() { return read_descriptors_; }
+        const descriptors& read() const { return read_descriptors_; }
+
+        /// return write descriptors
+        descriptors& write() { return write_descriptors_; }
+        const descriptors& write() const { return write_descriptors_; }
+
+        /// return except descriptors
+        descriptors& except() { return except_descriptors_; }
+        const descriptors& except() const { return except_descriptors_; }
+
+    private:
+        descriptors read_descriptors_;
+        descriptors write_descriptors_;
+        descriptors except_descriptors_;
+        std::map< file_descriptor, std::pair< unsigned int, handler > > handlers_;
+        std::map< file_descriptor, unsigned int > registered_;
+        std::set< file_descriptor > changed_;
+        std::set< file_descriptor > unpollable_;
+        std::vector< std::pair< file_descriptor, unsigned int > > fired_;
+        int fd_;
+        std::vector< char > events_;
+        std::size_t wait_( int timeout_milliseconds );
+        void update_();
+        unsigned int mask_( file_descriptor fd ) const;
+        std::size_t mark_( file_descriptor fd, unsigned int ready );
+        void dispatch_();
+};
+
+} } // namespace comma { namespace io {
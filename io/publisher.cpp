@@ -36,6 +36,10 @@ namespace comma { namespace io {
 
 publisher::publisher( const std::string& name, comma::io::mode::value mode, bool blocking, bool flush ) : pimpl_( new impl::publisher( name, mode, blocking, flush ) ) {}
 
+publisher::publisher( const std::string& name, comma::io::mode::value mode, std::size_t buffer_size, policy::values policy ) : pimpl_( new impl::publisher( name, mode, buffer_size, policy ) ) {}
+
+publisher::publisher( const std::string& name, comma::io::mode::value mode, const udp_options& options, bool flush ) : pimpl_( new impl::publisher( name, mode, options, flush ) ) {}
+
 publisher::~publisher() { delete pimpl_; }
 
 std::size_t publisher::write( const char* buf, std::size_t size, bool do_accept ) { return pimpl_->write( buf, size, do_accept ); }
@@ -46,9 +46,12 @@ class publisher : public boost::noncopyable
 {
     public:
         /// constructor
-        /// @param name ::= tcp:<port> | udp:<port> | <filename>
+        /// @param name ::= tcp:<port> | udp:<port> | udp:<address>:<port> | shm:<name>[:<bytes>] | <filename>
         ///     if tcp:<port>, create tcp server
-        ///     @todo if udp:<port>, broadcast on udp
+        ///     if udp:<port>, broadcast on udp; if udp:<address>:<port>, send to unicast, broadcast, or multicast address;
+        ///         with flush, each record is sent in its own datagram, otherwise records are packed into datagrams
+        ///     if shm:<name>[:<bytes>], write to shared memory ring of given size (default: 16MB), see impl/shm_ring.h;
+        ///         if not blocking, a reader that falls behind by more than ring size skips the data it missed, otherwise wait for the slowest reader
         ///     if <filename> is a regular file, just write to it
         ///     @todo if <filename> is named pipe, keep reopening it, if closed
         ///     if <filename> is Linux domain socket, create Linux domain socket server
@@ -56,10 +59,29 @@ class publisher : public boost::noncopyable
         /// @param blocking if true, blocking write to a client, otherwise discard, if client not ready
         publisher( const std::string& name, io::mode::value mode, bool blocking = false, bool flush = true );
 
+        /// what to do with a new packet, if client buffer is full: drop-oldest, drop-newest, or disconnect
+        typedef impl::fanout::policy policy;
+
+        /// constructor for buffered publishing: packets are queued for each client
+        /// and written in background with non-blocking partial writes, so that
+        /// a slow client neither blocks the writer nor other clients
+        /// and never receives a partial packet
+        /// @param name as above, except zeromq
+        /// @param buffer_size maximum number of bytes queued for a client
+        /// @param policy what to do with a new packet, if client buffer is full
+        publisher( const std::string& name, io::mode::value mode, std::size_t buffer_size, policy::values policy );
+
+        /// udp options: mtu, sequence numbers, multicast ttl and interface
+        typedef impl::udp_sender::options udp_options;
+
+        /// constructor for udp publishing with given options
+        /// @param name udp:<port> or udp:<address>:<port>
+        publisher( const std::string& name, io::mode::value mode, const udp_options& options, bool flush = true );
+
         /// destructor
         ~publisher();
 
-        /// publish to all existing connections (blocking), return number of clients with successful write
+        /// publish to all existing connections (blocking, unless buffered), return number of clients with successful write
         std::size_t write( const char* buf, std::size_t size, bool do_accept = true );
 
         /// publish to all existing connections (blocking)
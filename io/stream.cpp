@@ -55,6 +55,7 @@
 #include "../base/exception.h"
 #include "../string/string.h"
 #include "file_descriptor.h"
+#include "impl/shm_ring.h"
 #include "select.h"
 #include "stream.h"
 
@@ -66,6 +67,17 @@ namespace comma { namespace io {
 
 namespace impl {
 
+template < typename B, typename S >
+class shm_stream : public S
+{
+    public:
+        shm_stream( const std::string& name ) : S( NULL ), buffer_( name ) { this->init( &buffer_ ); }
+        void close() { buffer_.close(); }
+
+    private:
+        B buffer_;
+};
+
 template < typename S >
 struct traits {};
 
@@ -94,6 +106,12 @@ struct traits < std::istream >
     #else
     static io::file_descriptor open( const std::string& name ) { return ::open( &name[0], O_RDONLY | O_NONBLOCK ); }
     #endif
+    static std::istream* shm( const std::string& name, boost::function< void() >& close )
+    {
+        shm_stream< shm_istreambuf, std::istream >* s = new shm_stream< shm_istreambuf, std::istream >( name );
+        close = boost::bind( &shm_stream< shm_istreambuf, std::istream >::close, s );
+        return s;
+    }
 };
 
 template <>
@@ -129,6 +147,12 @@ struct traits < std::ostream >
             static io::file_descriptor open( const std::string& name ) { return ::open( &name[0], O_WRONLY | O_CREAT | O_NONBLOCK, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ); }
         #endif
     #endif
+    static std::ostream* shm( const std::string& name, boost::function< void() >& close )
+    {
+        shm_stream< shm_ostreambuf, std::ostream >* s = new shm_stream< shm_ostreambuf, std::ostream >( name );
+        close = boost::bind( &shm_stream< shm_ostreambuf, std::ostream >::close, s );
+        return s;
+    }
 };
 
 template <>
@@ -147,6 +171,7 @@ struct traits < std::iostream >
             static io::file_descriptor open( const std::string& name ) { return ::open( &name[0], O_RDWR | O_NONBLOCK ); }
         #endif
     #endif
+    static std::iostream* shm( const std::string& name, boost::function< void() >& ) { COMMA_THROW( comma::exception, "shared memory input/output stream: not supported, got: " << name ); }
 };
 
 template < typename S > void close_file_stream( typename traits< S >::file_stream* s, int fd )
@@ -327,6 +352,12 @@ stream< S >::stream( const std::string& name, mode::value m, mode::blocking_valu
         stream_ = ls;
     }
 #endif
+#ifndef WIN32
+    else if( v[0] == "shm" )
+    {
+        stream_ = impl::traits< S >::shm( name, close_ );
+    }
+#endif
 #ifdef USE_ZEROMQ
     else if( v[0] == "zero-local" || v[0] == "zmq-local" )
     {
@@ -52,6 +52,9 @@ struct mode
 ///     filename: file stream
 ///     -: std::cin or std::cout
 ///     tcp:address:port: tcp client socket stream
+///     shm:name[:bytes]: shared memory ring (see impl/shm_ring.h); no file descriptor,
+///         i.e. fd() returns invalid_file_descriptor; input stream waits for writer data,
+///         output stream waits for the slowest reader, if ring is full
 ///     @todo udp:address:port: udp socket stream
 ///     @todo linux socket name: linux socket client stream
 ///     @todo serial device name: serial stream
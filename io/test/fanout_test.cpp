@@ -0,0 +1,184 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+/// @author vsevolod vlaskine
+
+#ifdef __linux__
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include "../impl/fanout.h"
+
+namespace comma { namespace io { namespace test {
+
+#ifdef __linux__
+
+static const std::size_t packet_size = 100;
+static const unsigned int packet_count = 5000;
+
+static std::string make_packet( unsigned int index )
+{
+    char header[16];
+    ::snprintf( header, sizeof( header ), "%08u", index );
+    std::string p( packet_size, 'a' + index % 26 );
+    p.replace( 0, 8, header );
+    return p;
+}
+
+/// @return indices of whole packets in data; -1 marks a broken packet
+static std::vector< int > packets( const std::string& data )
+{
+    std::vector< int > v;
+    for( std::size_t i = 0; i + packet_size <= data.size(); i += packet_size )
+    {
+        unsigned int index = 0;
+        std::string p = data.substr( i, packet_size );
+        v.push_back( ::sscanf( p.c_str(), "%08u", &index ) == 1 && p == make_packet( index ) ? int( index ) : -1 );
+    }
+    return v;
+}
+
+static void read_all( int fd, std::string* data )
+{
+    char buf[4096];
+    for( ::ssize_t n; ( n = ::read( fd, buf, sizeof( buf ) ) ) != 0; ) { if( n > 0 ) { data->append( buf, n ); } }
+}
+
+struct stalled_client_result
+{
+    std::string fast;
+    std::string stalled;
+    std::size_t dropped;
+    std::size_t removed;
+    std::size_t size;
+};
+
+// one client reads every packet as soon as it is written, the other does not read until all packets are written
+static stalled_client_result run_stalled_client( impl::fanout::policy::values policy )
+{
+    int fast[2];
+    int stalled[2];
+    EXPECT_EQ( 0, ::socketpair( AF_UNIX, SOCK_STREAM, 0, fast ) );
+    EXPECT_EQ( 0, ::socketpair( AF_UNIX, SOCK_STREAM, 0, stalled ) );
+    int size = 4096;
+    ::setsockopt( stalled[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof( size ) );
+    impl::fanout fanout( 10 * packet_size, policy );
+    fanout.add( impl::fanout::stream_type( new io::ostream( new std::ostringstream, fast[0], mode::binary, boost::function< void() >() ) ) );
+    fanout.add( impl::fanout::stream_type( new io::ostream( new std::ostringstream, stalled[0], mode::binary, boost::function< void() >() ) ) );
+    stalled_client_result r;
+    r.removed = 0;
+    for( unsigned int i = 0; i < packet_count; ++i )
+    {
+        std::string p = make_packet( i );
+        fanout.write( &p[0], p.size() );
+        std::string q( packet_size, 0 );
+        for( std::size_t n = 0; n < q.size(); ) { ::ssize_t k = ::read( fast[1], &q[n], q.size() - n ); if( k <= 0 ) { break; } n += k; }
+        r.fast += q;
+    }
+    r.removed = fanout.removed().size();
+    r.size = fanout.size();
+    boost::thread reader( boost::bind( &read_all, stalled[1], &r.stalled ) );
+    r.removed += fanout.close( boost::posix_time::seconds( 1 ) ).size();
+    r.dropped = fanout.dropped();
+    ::close( fast[0] );
+    ::close( stalled[0] );
+    reader.join();
+    ::close( fast[1] );
+    ::close( stalled[1] );
+    return r;
+}
+
+static void expect_in_order( const std::vector< int >& v )
+{
+    for( std::size_t i = 0; i < v.size(); ++i )
+    {
+        EXPECT_NE( -1, v[i] ) << "broken packet " << i;
+        if( i > 0 ) { EXPECT_LT( v[i-1], v[i] ); }
+    }
+}
+
+static void expect_all( const std::string& data )
+{
+    std::vector< int > v = packets( data );
+    ASSERT_EQ( packet_count * packet_size, data.size() );
+    for( std::size_t i = 0; i < v.size(); ++i ) { EXPECT_EQ( int( i ), v[i] ); }
+}
+
+TEST( fanout, stalled_client_drop_oldest )
+{
+    stalled_client_result r = run_stalled_client( impl::fanout::policy::drop_oldest );
+    expect_all( r.fast );
+    EXPECT_EQ( 2u, r.size );
+    EXPECT_GT( r.dropped, 0u );
+    EXPECT_EQ( 0u, r.stalled.size() % packet_size ); // whole packets only
+    std::vector< int > v = packets( r.stalled );
+    expect_in_order( v );
+    EXPECT_LT( v.size(), std::size_t( packet_count ) );
+    ASSERT_FALSE( v.empty() );
+    EXPECT_EQ( int( packet_count - 1 ), v.back() ); // newest packets kept
+}
+
+TEST( fanout, stalled_client_drop_newest )
+{
+    stalled_client_result r = run_stalled_client( impl::fanout::policy::drop_newest );
+    expect_all( r.fast );
+    EXPECT_EQ( 2u, r.size );
+    EXPECT_GT( r.dropped, 0u );
+    EXPECT_EQ( 0u, r.stalled.size() % packet_size ); // whole packets only
+    std::vector< int > v = packets( r.stalled );
+    expect_in_order( v );
+    EXPECT_LT( v.size(), std::size_t( packet_count ) );
+    ASSERT_FALSE( v.empty() );
+    EXPECT_EQ( 0, v.front() ); // oldest packets kept
+    EXPECT_LT( v.back(), int( packet_count - 1 ) );
+}
+
+TEST( fanout, stalled_client_disconnect )
+{
+    stalled_client_result r = run_stalled_client( impl::fanout::policy::disconnect );
+    expect_all( r.fast );
+    EXPECT_EQ( 1u, r.size ); // stalled client removed, fast client stays
+    EXPECT_EQ( 2u, r.removed );
+    EXPECT_EQ( 0u, r.dropped );
+    std::vector< int > v = packets( r.stalled ); // packets written before disconnecting, the last one may be incomplete
+    ASSERT_FALSE( v.empty() );
+    ASSERT_LT( v.size(), std::size_t( packet_count ) );
+    for( std::size_t i = 0; i < v.size(); ++i ) { EXPECT_EQ( int( i ), v[i] ); }
+}
+
+#endif // #ifdef __linux__
+
+} } } // namespace comma { namespace io { namespace test {
@@ -0,0 +1,131 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/bind.hpp>
+#include "../../base/exception.h"
+#include "../poller.h"
+
+namespace comma { namespace io { namespace test {
+
+struct pipe
+{
+    int fd[2];
+    pipe() { EXPECT_EQ( 0, ::pipe( fd ) ); ::fcntl( fd[0], F_SETFL, O_NONBLOCK ); ::fcntl( fd[1], F_SETFL, O_NONBLOCK ); }
+    ~pipe() { ::close( fd[0] ); ::close( fd[1] ); }
+};
+
+static void count( std::vector< unsigned int >& v, comma::io::file_descriptor, unsigned int events ) { v.push_back( events ); }
+
+TEST( poller, read_write )
+{
+    pipe p;
+    comma::io::poller poller;
+    poller.read().add( p.fd[0] );
+    EXPECT_EQ( 0u, poller.check() );
+    EXPECT_FALSE( poller.read().ready( p.fd[0] ) );
+    EXPECT_EQ( 1, ::write( p.fd[1], "x", 1 ) );
+    EXPECT_EQ( 1u, poller.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_TRUE( poller.read().ready( p.fd[0] ) );
+    EXPECT_EQ( 1u, poller.check() ); // level-triggered: still ready
+    poller.write().add( p.fd[1] );
+    EXPECT_EQ( 2u, poller.check() );
+    EXPECT_TRUE( poller.write().ready( p.fd[1] ) );
+    char c;
+    EXPECT_EQ( 1, ::read( p.fd[0], &c, 1 ) );
+    EXPECT_EQ( 1u, poller.check() );
+    EXPECT_FALSE( poller.read().ready( p.fd[0] ) );
+    poller.read().remove( p.fd[0] );
+    poller.write().remove( p.fd[1] );
+    EXPECT_EQ( 0u, poller.check() );
+    EXPECT_TRUE( poller.read()().empty() );
+}
+
+TEST( poller, regular_file )
+{
+    std::FILE* f = std::tmpfile();
+    comma::io::poller poller;
+    poller.read().add( fileno( f ) );
+    EXPECT_EQ( 1u, poller.wait() );
+    EXPECT_TRUE( poller.read().ready( fileno( f ) ) );
+    std::fclose( f );
+}
+
+TEST( poller, many_descriptors )
+{
+    ::rlimit limit;
+    ::getrlimit( RLIMIT_NOFILE, &limit );
+    if( limit.rlim_cur < 2200 ) { limit.rlim_cur = limit.rlim_max < 2200 ? limit.rlim_max : 2200; ::setrlimit( RLIMIT_NOFILE, &limit ); }
+    if( limit.rlim_cur < 2200 ) { return; }
+    std::vector< pipe* > pipes;
+    for( unsigned int i = 0; i < 1000; ++i ) { pipes.push_back( new pipe ); }
+    comma::io::poller poller;
+    for( unsigned int i = 0; i < pipes.size(); ++i ) { poller.read().add( pipes[i]->fd[0] ); }
+    EXPECT_GT( pipes.back()->fd[0], FD_SETSIZE );
+    EXPECT_EQ( 1, ::write( pipes.back()->fd[1], "x", 1 ) );
+    EXPECT_EQ( 1u, poller.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_TRUE( poller.read().ready( pipes.back()->fd[0] ) );
+    EXPECT_FALSE( poller.read().ready( pipes.front()->fd[0] ) );
+    for( unsigned int i = 0; i < pipes.size(); ++i ) { delete pipes[i]; }
+}
+
+TEST( poller, edge_triggered )
+{
+    pipe p;
+    comma::io::poller poller;
+    std::vector< unsigned int > events;
+    poller.on( p.fd[0], comma::io::poller::events::read, boost::bind( &count, boost::ref( events ), _1, _2 ) );
+    EXPECT_EQ( 0u, poller.check() );
+    EXPECT_TRUE( events.empty() );
+    EXPECT_EQ( 1, ::write( p.fd[1], "x", 1 ) );
+    EXPECT_EQ( 1u, poller.wait( boost::posix_time::seconds( 1 ) ) );
+    EXPECT_EQ( 1u, events.size() );
+    EXPECT_EQ( 0u, poller.check() ); // edge-triggered: not called again, although not read
+    EXPECT_EQ( 1u, events.size() );
+    EXPECT_EQ( 1, ::write( p.fd[1], "y", 1 ) );
+    EXPECT_EQ( 1u, poller.check() );
+    EXPECT_EQ( 2u, events.size() );
+    poller.off( p.fd[0] );
+    EXPECT_EQ( 1, ::write( p.fd[1], "z", 1 ) );
+    EXPECT_EQ( 0u, poller.check() );
+    EXPECT_EQ( 2u, events.size() );
+    poller.read().add( p.fd[0] );
+    EXPECT_EQ( 1u, poller.check() );
+    poller.on( p.fd[0], comma::io::poller::events::read, boost::bind( &count, boost::ref( events ), _1, _2 ) );
+    EXPECT_THROW( poller.check(), comma::exception );
+}
+
+} } } // namespace comma { namespace io { namespace test {
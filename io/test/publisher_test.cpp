@@ -0,0 +1,159 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include <boost/lexical_cast.hpp>
+#include "../../base/exception.h"
+#include "../impl/shm_ring.h"
+#include "../impl/udp_receiver.h"
+#include "../publisher.h"
+
+namespace comma { namespace io { namespace test {
+
+class udp_receiver
+{
+    public:
+        udp_receiver() : fd_( ::socket( AF_INET, SOCK_DGRAM, 0 ) )
+        {
+            ::sockaddr_in a = ::sockaddr_in();
+            a.sin_family = AF_INET;
+            a.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+            EXPECT_EQ( 0, ::bind( fd_, reinterpret_cast< ::sockaddr* >( &a ), sizeof( a ) ) );
+            ::socklen_t size = sizeof( a );
+            ::getsockname( fd_, reinterpret_cast< ::sockaddr* >( &a ), &size );
+            port_ = ntohs( a.sin_port );
+            ::timeval t = { 1, 0 };
+            ::setsockopt( fd_, SOL_SOCKET, SO_RCVTIMEO, &t, sizeof( t ) );
+        }
+        ~udp_receiver() { ::close( fd_ ); }
+        std::string address() const { return "udp:127.0.0.1:" + boost::lexical_cast< std::string >( port_ ); }
+        std::string receive() { char buf[65536]; ::ssize_t size = ::recv( fd_, buf, sizeof( buf ), 0 ); return size < 0 ? std::string() : std::string( buf, size ); }
+    private:
+        int fd_;
+        unsigned short port_;
+};
+
+TEST( publisher, udp )
+{
+    udp_receiver receiver;
+    {
+        comma::io::publisher publisher( receiver.address(), comma::io::mode::ascii );
+        EXPECT_EQ( 1u, publisher.write( "hello\n", 6 ) );
+        EXPECT_EQ( "hello\n", receiver.receive() );
+        publisher << "world\n";
+        EXPECT_EQ( "world\n", receiver.receive() );
+        publisher << 1 << ',' << 2.5 << "\n" << "a" << "b\nc";
+        EXPECT_EQ( "1,2.5\n", receiver.receive() );
+        EXPECT_EQ( "ab\n", receiver.receive() );
+        publisher.close();
+        EXPECT_EQ( "c", receiver.receive() );
+    }
+}
+
+TEST( publisher, udp_packing )
+{
+    udp_receiver receiver;
+    comma::io::publisher::udp_options options;
+    options.mtu = 8 + 25;
+    options.sequence = true;
+    {
+        comma::io::publisher publisher( receiver.address(), comma::io::mode::binary, options, false );
+        for( unsigned int i = 0; i < 7; ++i ) { std::string s( 10, 'a' + i ); publisher.write( &s[0], s.size() ); }
+        std::string large( 30, 'z' );
+        publisher.write( &large[0], large.size() );
+        publisher.close();
+    }
+    const char* expected[] = { "aaaaaaaaaabbbbbbbbbb", "ccccccccccdddddddddd", "eeeeeeeeeeffffffffff", "gggggggggg", "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzz" };
+    for( unsigned int i = 0; i < 5; ++i )
+    {
+        std::string d = receiver.receive();
+        ASSERT_GT( d.size(), 8u );
+        EXPECT_EQ( std::string( 1, char( i ) ) + std::string( 7, '\0' ), d.substr( 0, 8 ) ); // little-endian sequence number
+        EXPECT_EQ( expected[i], d.substr( 8 ) );
+    }
+}
+
+TEST( publisher, udp_receiver )
+{
+    comma::io::impl::udp_receiver::options options;
+    options.batch = 4;
+    comma::io::impl::udp_receiver receiver( 0, options ); // any port
+    ::sockaddr_in a = ::sockaddr_in();
+    ::socklen_t size = sizeof( a );
+    ::getsockname( receiver.fd(), reinterpret_cast< ::sockaddr* >( &a ), &size );
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    {
+        comma::io::publisher publisher( "udp:127.0.0.1:" + boost::lexical_cast< std::string >( ntohs( a.sin_port ) ), comma::io::mode::ascii );
+        for( unsigned int i = 0; i < 6; ++i ) { std::string s = boost::lexical_cast< std::string >( i ); publisher.write( &s[0], s.size() ); }
+    }
+    EXPECT_EQ( 4u, receiver.receive() );
+    EXPECT_EQ( 2u, receiver.receive() );
+    EXPECT_EQ( "4", std::string( receiver.data( 0 ), receiver.size( 0 ) ) );
+    EXPECT_EQ( "5", std::string( receiver.data( 1 ), receiver.size( 1 ) ) );
+    EXPECT_LE( start, receiver.timestamp( 0 ) );
+    EXPECT_LE( receiver.timestamp( 0 ), boost::posix_time::microsec_clock::universal_time() );
+    EXPECT_EQ( 0u, receiver.receive( false ) );
+}
+
+TEST( publisher, shm )
+{
+    comma::io::publisher publisher( "shm:comma-publisher-test:1000", comma::io::mode::binary );
+    comma::io::impl::shm_reader reader( "shm:comma-publisher-test" );
+    EXPECT_EQ( 1u, publisher.size() );
+    std::string s( 400, 0 );
+    for( char c = 'a'; c < 'e'; ++c ) { s[0] = c; EXPECT_EQ( 1u, publisher.write( &s[0], s.size() ) ); } // reader falls behind
+    EXPECT_THROW( publisher.write( &s[0], 1001 ), comma::exception );
+    std::string t( s.size(), 0 );
+    EXPECT_EQ( 0u, reader.read( &t[0], t.size(), false ) ); // skipped to the end of data
+    EXPECT_EQ( 1600u, reader.dropped() );
+    s[0] = 'e';
+    publisher.write( &s[0], s.size() );
+    EXPECT_EQ( s.size(), reader.read( &t[0], t.size() ) );
+    EXPECT_EQ( s, t );
+    publisher.close();
+    EXPECT_TRUE( reader.eof() );
+    EXPECT_EQ( 0u, reader.read( &t[0], t.size() ) );
+}
+
+TEST( publisher, udp_invalid )
+{
+    EXPECT_THROW( comma::io::publisher( "udp:localhost:1:2", comma::io::mode::ascii ), comma::exception );
+    comma::io::publisher::udp_options options;
+    options.mtu = 100000;
+    EXPECT_THROW( comma::io::publisher( "udp:localhost:12345", comma::io::mode::ascii, options ), comma::exception );
+}
+
+} } } // namespace comma { namespace io { namespace test {
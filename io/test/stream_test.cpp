@@ -30,10 +30,16 @@
 #include <cstdio>
 #include <fstream>
 #include <gtest/gtest.h>
+#ifndef WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/local/stream_protocol.hpp>
 #include <boost/filesystem/operations.hpp>
+#include "../../base/exception.h"
 #include "../select.h"
 #include "../stream.h"
 
@@ -143,6 +149,70 @@ TEST( io, local_stream )
     #endif
 }
 
+TEST( io, shm_stream )
+{
+    #ifndef WIN32
+    EXPECT_THROW( comma::io::istream( "shm:comma-stream-test" ), comma::exception );
+    comma::io::ostream ostream( "shm:comma-stream-test:1024" );
+    EXPECT_EQ( comma::io::invalid_file_descriptor, ostream.fd() );
+    comma::io::istream istream( "shm:comma-stream-test" );
+    comma::io::istream other( "shm:comma-stream-test" );
+    *ostream << "hello, world" << std::endl;
+    std::string s( 1000, 'x' );
+    ostream->write( &s[0], s.size() );
+    ostream->flush();
+    std::string line;
+    std::getline( *istream, line );
+    EXPECT_EQ( "hello, world", line );
+    std::getline( *other, line );
+    EXPECT_EQ( "hello, world", line );
+    std::string t( s.size(), 0 );
+    istream->read( &t[0], t.size() );
+    EXPECT_EQ( s, t );
+    EXPECT_EQ( 0, istream->rdbuf()->in_avail() );
+    other->read( &t[0], t.size() ); // each reader reads at its own pace
+    EXPECT_EQ( s, t );
+    *ostream << "bye" << std::endl;
+    ostream.close();
+    std::getline( *istream, line );
+    EXPECT_EQ( "bye", line );
+    EXPECT_FALSE( std::getline( *istream, line ) );
+    EXPECT_THROW( comma::io::istream( "shm:comma-stream-test" ), comma::exception );
+    #endif
+}
+
+TEST( io, shm_stream_writer )
+{
+    #ifndef WIN32
+    {
+        comma::io::ostream ostream( "shm:comma-stream-test:1024" );
+        EXPECT_THROW( comma::io::ostream( "shm:comma-stream-test:1024" ), comma::exception ); // live writer owns the ring
+    }
+    int fds[2];
+    ASSERT_EQ( 0, ::pipe( fds ) );
+    pid_t pid = ::fork();
+    ASSERT_NE( -1, pid );
+    if( pid == 0 )
+    {
+        comma::io::ostream ostream( "shm:comma-stream-test:1024" );
+        *ostream << "hello, world" << std::endl;
+        char c = 0;
+        if( ::write( fds[1], &c, 1 ) != 1 ) { ::_exit( 1 ); }
+        while( true ) { ::pause(); }
+    }
+    char c;
+    ASSERT_EQ( 1, ::read( fds[0], &c, 1 ) );
+    comma::io::istream istream( "shm:comma-stream-test" );
+    ::kill( pid, SIGKILL ); // writer dies without closing the ring
+    ::waitpid( pid, NULL, 0 );
+    ::close( fds[0] );
+    ::close( fds[1] );
+    std::string line;
+    EXPECT_FALSE( std::getline( *istream, line ) ); // reader sees end of stream instead of waiting forever
+    comma::io::ostream ostream( "shm:comma-stream-test:1024" ); // ring of dead writer is replaced
+    #endif
+}
+
 int main( int argc, char* argv[] )
 {
     ::testing::InitGoogleTest(&argc, argv);
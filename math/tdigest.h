@@ -0,0 +1,156 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#ifndef COMMA_MATH_TDIGEST_H_
+#define COMMA_MATH_TDIGEST_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "../base/exception.h"
+
+namespace comma { namespace math {
+
+/// mergeable streaming quantile sketch (merging t-digest by Dunning and Ertl)
+/// keeps O( compression ) centroids regardless of the number of values;
+/// quantiles close to 0 or 1 are more accurate than the median
+class tdigest
+{
+    public:
+        /// centroid: mean of values in it and their count
+        struct centroid
+        {
+            double mean;
+            double weight;
+            centroid( double mean = 0, double weight = 0 ) : mean( mean ), weight( weight ) {}
+            bool operator<( const centroid& rhs ) const { return mean < rhs.mean; }
+        };
+
+        /// constructor; greater compression: more accurate, more memory
+        tdigest( double compression = 100 ) : compression_( compression ), count_( 0 ), min_( std::numeric_limits< double >::max() ), max_( -std::numeric_limits< double >::max() )
+        {
+            if( !( compression_ > 0 ) ) { COMMA_THROW( comma::exception, "expected positive compression, got: " << compression ); }
+        }
+
+        /// add value
+        void push( double value, double weight = 1 )
+        {
+            buffer_.push_back( centroid( value, weight ) );
+            count_ += weight;
+            if( value < min_ ) { min_ = value; }
+            if( value > max_ ) { max_ = value; }
+            if( buffer_.size() >= buffer_size_() ) { compress(); }
+        }
+
+        /// merge another digest into this one, e.g. digests of the same id calculated in parallel
+        void merge( const tdigest& rhs )
+        {
+            if( rhs.count_ == 0 ) { return; }
+            buffer_.insert( buffer_.end(), rhs.centroids_.begin(), rhs.centroids_.end() );
+            buffer_.insert( buffer_.end(), rhs.buffer_.begin(), rhs.buffer_.end() );
+            count_ += rhs.count_;
+            min_ = std::min( min_, rhs.min_ );
+            max_ = std::max( max_, rhs.max_ );
+            compress();
+        }
+
+        /// merge buffered values into centroids
+        void compress()
+        {
+            if( buffer_.empty() ) { return; }
+            buffer_.insert( buffer_.end(), centroids_.begin(), centroids_.end() );
+            std::sort( buffer_.begin(), buffer_.end() );
+            centroids_.clear();
+            centroids_.push_back( buffer_[0] );
+            double done = 0; // weight of centroids before the last one
+            for( std::size_t i = 1; i < buffer_.size(); ++i )
+            {
+                centroid& last = centroids_.back();
+                double weight = last.weight + buffer_[i].weight;
+                double q = ( done + weight / 2 ) / count_;
+                if( weight <= 4 * count_ * q * ( 1 - q ) / compression_ )
+                {
+                    last.mean += ( buffer_[i].mean - last.mean ) * buffer_[i].weight / weight;
+                    last.weight = weight;
+                }
+                else
+                {
+                    done += last.weight;
+                    centroids_.push_back( buffer_[i] );
+                }
+            }
+            buffer_.clear();
+        }
+
+        /// return approximate value at given quantile in [0,1], interpolating between centroids
+        double quantile( double q )
+        {
+            if( count_ == 0 ) { COMMA_THROW( comma::exception, "quantile of empty digest" ); }
+            compress();
+            if( centroids_.size() == 1 || q <= 0 ) { return q <= 0 ? min_ : centroids_[0].mean; }
+            if( q >= 1 ) { return max_; }
+            double index = q * count_;
+            if( index < centroids_[0].weight / 2 ) { return min_ + ( centroids_[0].mean - min_ ) * index * 2 / centroids_[0].weight; }
+            double weight = centroids_[0].weight / 2; // weight before the middle of centroid i
+            for( std::size_t i = 0; i + 1 < centroids_.size(); ++i )
+            {
+                double step = ( centroids_[i].weight + centroids_[ i + 1 ].weight ) / 2;
+                if( index < weight + step ) { return centroids_[i].mean + ( centroids_[ i + 1 ].mean - centroids_[i].mean ) * ( index - weight ) / step; }
+                weight += step;
+            }
+            const centroid& last = centroids_.back();
+            return last.mean + ( max_ - last.mean ) * std::min( 1.0, ( index - weight ) * 2 / last.weight );
+        }
+
+        /// return number of values
+        double count() const { return count_; }
+
+        /// return compression
+        double compression() const { return compression_; }
+
+        /// return centroids, call compress() first to include buffered values
+        const std::vector< centroid >& centroids() const { return centroids_; }
+
+    private:
+        double compression_;
+        double count_;
+        double min_;
+        double max_;
+        std::vector< centroid > centroids_;
+        std::vector< centroid > buffer_;
+
+        std::size_t buffer_size_() const { return static_cast< std::size_t >( compression_ * 5 ) + 16; }
+};
+
+} } // namespace comma { namespace math {
+
+#endif // COMMA_MATH_TDIGEST_H_
@@ -0,0 +1,94 @@
+// This file is part of comma, a generic and flexible library
+// Copyright (c) 2011 The University of Sydney
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+// 3. Neither the name of the University of Sydney nor the
+//    names of its contributors may be used to endorse or promote products
+//    derived from this software without specific prior written permission.
+//
+// NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE
+// GRANTED BY THIS LICENSE.  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT
+// HOLDERS AND CONTRIBUTORS \"AS IS\" AND ANY EXPRESS OR IMPLIED
+// WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+// OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+// IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @author vsevolod vlaskine
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include <gtest/gtest.h>
+#include "../tdigest.h"
+
+namespace comma { namespace math {
+
+TEST( tdigest, small )
+{
+    tdigest d;
+    for( unsigned int i = 1; i <= 5; ++i ) { d.push( i ); }
+    EXPECT_EQ( 5, d.count() );
+    EXPECT_DOUBLE_EQ( 1, d.quantile( 0 ) );
+    EXPECT_DOUBLE_EQ( 3, d.quantile( 0.5 ) );
+    EXPECT_DOUBLE_EQ( 5, d.quantile( 1 ) );
+    tdigest e;
+    e.push( 7 );
+    EXPECT_DOUBLE_EQ( 7, e.quantile( 0.3 ) );
+    EXPECT_THROW( tdigest().quantile( 0.5 ), comma::exception );
+    EXPECT_THROW( tdigest( 0 ), comma::exception );
+}
+
+TEST( tdigest, accuracy )
+{
+    std::srand( 1 );
+    std::vector< double > values( 100000 );
+    for( std::size_t i = 0; i < values.size(); ++i ) { values[i] = double( std::rand() ) / RAND_MAX; }
+    tdigest d( 100 );
+    for( std::size_t i = 0; i < values.size(); ++i ) { d.push( values[i] ); }
+    d.compress();
+    EXPECT_GT( 1000u, d.centroids().size() );
+    std::sort( values.begin(), values.end() );
+    const double quantiles[] = { 0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 0.999 };
+    for( unsigned int i = 0; i < sizeof( quantiles ) / sizeof( double ); ++i )
+    {
+        double exact = values[ std::size_t( quantiles[i] * values.size() ) ];
+        double tolerance = 0.01 * std::min( quantiles[i], 1 - quantiles[i] ) * 4 + 0.0005;
+        EXPECT_NEAR( exact, d.quantile( quantiles[i] ), tolerance ) << "quantile: " << quantiles[i];
+    }
+}
+
+TEST( tdigest, merge )
+{
+    std::srand( 2 );
+    tdigest all;
+    std::vector< tdigest > parts( 4 );
+    for( std::size_t i = 0; i < 40000; ++i )
+    {
+        double v = double( std::rand() ) / RAND_MAX * 1000;
+        all.push( v );
+        parts[ i % parts.size() ].push( v );
+    }
+    tdigest merged;
+    for( std::size_t i = 0; i < parts.size(); ++i ) { merged.merge( parts[i] ); }
+    EXPECT_EQ( all.count(), merged.count() );
+    EXPECT_NEAR( all.quantile( 0.5 ), merged.quantile( 0.5 ), 5 );
+    EXPECT_NEAR( all.quantile( 0.99 ), merged.quantile( 0.99 ), 1 );
+    EXPECT_DOUBLE_EQ( all.quantile( 0 ), merged.quantile( 0 ) );
+    EXPECT_DOUBLE_EQ( all.quantile( 1 ), merged.quantile( 1 ) );
+}
+
+} } // namespace comma { namespace math {